@@ -156,6 +156,9 @@ unix:!macx {
 }
 
 SOURCES += \
+    src/blockfiles.cpp \
+    src/blockfilter.cpp \
+    src/blockprecheck.cpp \
     src/bloom.cpp \
     src/hash.cpp \
     src/activeservicenode.cpp \
@@ -174,6 +177,7 @@ SOURCES += \
     src/eccryptoverify.cpp \
     src/leveldbwrapper.cpp \
     src/merkleblock.cpp \
+    src/messageexecutor.cpp \
     src/obfuscation.cpp \
     src/obfuscation-relay.cpp \
     src/pow.cpp \
@@ -242,6 +246,9 @@ SOURCES += \
     src/crypto/sha1.cpp \
     src/crypto/sha256.cpp \
     src/crypto/sha512.cpp \
+    src/crypto/quark.cpp \
+    src/crypto/jh_sse2.cpp \
+    src/crypto/groestl_aesni.cpp \
     src/crypto/aes_helper.c \
     src/crypto/blake.c \
     src/crypto/bmw.c \
@@ -391,6 +398,7 @@ HEADERS += \
     src/qt/editaddressdialog.h \
     src/qt/bitcoinaddressvalidator.h \
     src/alert.h \
+    src/addressindex.h \
     src/addrman.h \
     src/base58.h \
     src/checkpoints.h \
@@ -402,8 +410,10 @@ HEADERS += \
     src/kernel.h \
     src/serialize.h \
     src/main.h \
+    src/memusage.h \
     src/miner.h \
     src/net.h \
+    src/nodepool.h \
     src/key.h \
     src/db.h \
     src/txdb.h \
@@ -448,6 +458,9 @@ HEADERS += \
     src/version.h \
     src/netbase.h \
     src/clientversion.h \
+    src/blockfiles.h \
+    src/blockfilter.h \
+    src/blockprecheck.h \
     src/bloom.h \
     src/checkqueue.h \
     src/hash.h \
@@ -469,6 +482,7 @@ HEADERS += \
     src/eccryptoverify.h \
     src/leveldbwrapper.h \
     src/merkleblock.h \
+    src/messageexecutor.h \
     src/noui.h \
     src/obfuscation.h \
     src/obfuscation-relay.h \
@@ -522,6 +536,7 @@ HEADERS += \
     src/crypto/hmac_sha256.h \
     src/crypto/hmac_sha512.h \
     src/crypto/rfc6979_hmac_sha256.h \
+    src/crypto/quark.h \
     src/crypto/ripemd160.h \
     src/crypto/scrypt.h \
     src/crypto/sha1.h \
@@ -619,6 +634,7 @@ SOURCES += \
     src/miner.cpp \
     src/init.cpp \
     src/net.cpp \
+    src/nodepool.cpp \
     src/checkpoints.cpp \
     src/addrman.cpp \
     src/db.cpp \
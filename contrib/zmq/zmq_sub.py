@@ -15,6 +15,8 @@ zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtxlock")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawblock")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtx")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtxlock")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"xbridgeorder")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"xbridgetrade")
 zmqSubSocket.connect("tcp://127.0.0.1:%i" % port)
 
 try:
@@ -46,6 +48,12 @@ try:
         elif topic == "rawtxlock":
             print('- RAW TX LOCK ('+sequence+') -')
             print(binascii.hexlify(body).decode("utf-8"))
+        elif topic == "xbridgeorder":
+            print('- XBRIDGE ORDER ('+sequence+') -')
+            print(str(struct.unpack('<B', body[:1])[0]) + ' ' + binascii.hexlify(body[32:0:-1]).decode("utf-8"))
+        elif topic == "xbridgetrade":
+            print('- XBRIDGE TRADE ('+sequence+') -')
+            print(str(struct.unpack('<i', body[:4])[0]) + ' ' + binascii.hexlify(body[35:3:-1]).decode("utf-8"))
 
 except KeyboardInterrupt:
     zmqContext.destroy()
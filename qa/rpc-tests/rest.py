@@ -82,6 +82,42 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(json_string)
         for tx in txs:
             assert_equal(tx in json_obj['tx'], True)
+
+        # check the headers of the chain, from the block before the new one on
+        json_string = http_get_call(url.hostname, url.port, '/rest/headers/5/'+bb_hash+self.FORMAT_SEPARATOR+'json')
+        json_obj = json.loads(json_string)
+        assert_equal(len(json_obj), 2)
+        assert_equal(json_obj[0]['hash'], bb_hash)
+        assert_equal(json_obj[1]['hash'], newblockhash[0])
+        assert_equal(json_obj[1]['previousblockhash'], bb_hash)
+        response = http_get_call(url.hostname, url.port, '/rest/headers/5/'+bb_hash+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        assert_equal(int(response.getheader('content-length')), 2 * 80)
+        response = http_get_call(url.hostname, url.port, '/rest/headers/0/'+bb_hash+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+
+        # check the chain info
+        json_string = http_get_call(url.hostname, url.port, '/rest/chaininfo'+self.FORMAT_SEPARATOR+'json')
+        json_obj = json.loads(json_string)
+        assert_equal(json_obj['blocks'], self.nodes[0].getblockcount())
+        assert_equal(json_obj['bestblockhash'], newblockhash[0])
+
+        # the outputs of the last transaction are unspent, one past them is not there
+        json_string = http_get_call(url.hostname, url.port, '/rest/getutxos/'+txs[2]+'-0/'+txs[2]+'-1/'+txs[2]+'-9'+self.FORMAT_SEPARATOR+'json')
+        json_obj = json.loads(json_string)
+        assert_equal(json_obj['chaintipHash'], newblockhash[0])
+        assert_equal(json_obj['bitmap'], "110")
+        assert_equal(len(json_obj['utxos']), 2)
+        response = http_get_call(url.hostname, url.port, '/rest/getutxos/checkmempool/'+txs[2]+'-0'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        response = http_get_call(url.hostname, url.port, '/rest/getutxos/'+txs[2]+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 400)
+
+        # no XBridge orders on a fresh node
+        json_string = http_get_call(url.hostname, url.port, '/rest/xbridge/orders'+self.FORMAT_SEPARATOR+'json')
+        assert_equal(json.loads(json_string), [])
+        json_string = http_get_call(url.hostname, url.port, '/rest/xbridge/history/BLOCK-LTC'+self.FORMAT_SEPARATOR+'json')
+        assert_equal(json.loads(json_string), [])
                 
         
 
@@ -192,15 +192,12 @@ bool CActiveServicenode::SendServicenodePing(std::string& errorMessage, bool for
         }
 
         pmn->lastPing = mnp;
-        mnodeman.mapSeenServicenodePing.insert(make_pair(mnp.GetHash(), mnp));
+        pmn->fDirty = true;
+        mnodeman.AddSeenPing(mnp);
 
         //mnodeman.mapSeenServicenodeBroadcast.lastPing is probably outdated, so we'll update it
         CServicenodeBroadcast mnb(*pmn);
-        uint256 hash = mnb.GetHash();
-        if (mnodeman.mapSeenServicenodeBroadcast.count(hash))
-        {
-            mnodeman.mapSeenServicenodeBroadcast[hash].lastPing = mnp;
-        }
+        mnodeman.UpdateSeenBroadcastPing(mnb.GetHash(), mnp);
 
         mnp.Relay();
 
@@ -303,7 +300,7 @@ bool CActiveServicenode::Register(CTxIn vin, CService service, CKey keyCollatera
         LogPrintf("CActiveServicenode::Register() -  %s\n", errorMessage);
         return false;
     }
-    mnodeman.mapSeenServicenodePing.insert(make_pair(mnp.GetHash(), mnp));
+    mnodeman.AddSeenPing(mnp);
 
     LogPrintf("CActiveServicenode::Register() - Adding to Servicenode list\n    service: %s\n    vin: %s\n", service.ToString(), vin.ToString());
 
@@ -322,7 +319,7 @@ bool CActiveServicenode::Register(CTxIn vin, CService service, CKey keyCollatera
     // Assign the new vin
     this->vin = vin;
 
-    mnodeman.mapSeenServicenodeBroadcast.insert(make_pair(mnb.GetHash(), mnb));
+    mnodeman.AddSeenBroadcast(mnb);
     servicenodeSync.AddedServicenodeList(mnb.GetHash());
 
     CServicenode* pmn = mnodeman.Find(vin);
@@ -0,0 +1,164 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "crypto/common.h"
+#include "serialize.h"
+#include "uint256.h"
+
+class CScript;
+
+/** Default for -addressindex */
+static const bool DEFAULT_ADDRESSINDEX = false;
+/** Default for -spentindex */
+static const bool DEFAULT_SPENTINDEX = false;
+
+/** Kinds of address in the address index, as explorers number them */
+enum AddressIndexType {
+    ADDRESS_NONE = 0,
+    ADDRESS_P2PKH = 1, // pay to pubkey and pay to pubkey hash outputs both count as the key's address
+    ADDRESS_P2SH = 2,
+};
+
+/** The indexed address an output script pays to, if any */
+bool ExtractIndexAddress(const CScript& script, int& type, uint160& hashBytes);
+
+template <typename Stream>
+static inline void WriteIndexBE32(Stream& s, uint32_t n)
+{
+    unsigned char buf[4];
+    WriteBE32(buf, n);
+    s.write((char*)buf, 4);
+}
+
+template <typename Stream>
+static inline uint32_t ReadIndexBE32(Stream& s)
+{
+    unsigned char buf[4];
+    s.read((char*)buf, 4);
+    return ReadBE32(buf);
+}
+
+/**
+ * One entry of the address index: an output paying to an address, or an
+ * input spending from it (fSpending, with a negative amount as value).
+ * Heights and indexes are big endian, so an address's entries sort by
+ * height in the database and a height range is a single seek.
+ */
+struct CAddressIndexKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int nHeight;
+    uint256 txhash;
+    unsigned int nIndex; // output index, or input index if fSpending
+    bool fSpending;
+
+    CAddressIndexKey() : type(ADDRESS_NONE), nHeight(0), nIndex(0), fSpending(false) {}
+    CAddressIndexKey(int typeIn, const uint160& hashBytesIn, int nHeightIn, const uint256& txhashIn, unsigned int nIndexIn, bool fSpendingIn)
+        : type(typeIn), hashBytes(hashBytesIn), nHeight(nHeightIn), txhash(txhashIn), nIndex(nIndexIn), fSpending(fSpendingIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + 20 + 4 + 32 + 4 + 1;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, type, nType, nVersion);
+        hashBytes.Serialize(s, nType, nVersion);
+        WriteIndexBE32(s, nHeight);
+        txhash.Serialize(s, nType, nVersion);
+        WriteIndexBE32(s, nIndex);
+        ::Serialize(s, fSpending, nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, type, nType, nVersion);
+        hashBytes.Unserialize(s, nType, nVersion);
+        nHeight = ReadIndexBE32(s);
+        txhash.Unserialize(s, nType, nVersion);
+        nIndex = ReadIndexBE32(s);
+        ::Unserialize(s, fSpending, nType, nVersion);
+    }
+};
+
+/** Where the entries of an address start, or those from nHeight on */
+struct CAddressIndexIteratorKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int nHeight; // 0 for all of them
+
+    CAddressIndexIteratorKey(int typeIn, const uint160& hashBytesIn, int nHeightIn = 0)
+        : type(typeIn), hashBytes(hashBytesIn), nHeight(nHeightIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return nHeight > 0 ? 25 : 21;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, type, nType, nVersion);
+        hashBytes.Serialize(s, nType, nVersion);
+        if (nHeight > 0)
+            WriteIndexBE32(s, nHeight);
+    }
+};
+
+/** An output in the spent index */
+struct CSpentIndexKey {
+    uint256 txid;
+    unsigned int nIndex;
+
+    CSpentIndexKey() : nIndex(0) {}
+    CSpentIndexKey(const uint256& txidIn, unsigned int nIndexIn) : txid(txidIn), nIndex(nIndexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(nIndex);
+    }
+};
+
+/** The input spending an output, with what the output held */
+struct CSpentIndexValue {
+    uint256 txid;
+    unsigned int nInputIndex;
+    int nHeight;
+    CAmount nValue;
+    unsigned char addressType;
+    uint160 addressHash;
+
+    CSpentIndexValue() : nInputIndex(0), nHeight(0), nValue(0), addressType(ADDRESS_NONE) {}
+    CSpentIndexValue(const uint256& txidIn, unsigned int nInputIndexIn, int nHeightIn, CAmount nValueIn, int addressTypeIn, const uint160& addressHashIn)
+        : txid(txidIn), nInputIndex(nInputIndexIn), nHeight(nHeightIn), nValue(nValueIn), addressType(addressTypeIn), addressHash(addressHashIn) {}
+
+    /** An empty value in a batch erases the entry */
+    bool IsNull() const { return txid.IsNull(); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(nInputIndex);
+        READWRITE(nHeight);
+        READWRITE(nValue);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+};
+
+#endif // BITCOIN_ADDRESSINDEX_H
@@ -0,0 +1,20 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "crypto/quark.h"
+#include "util.h"
+
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    SetupEnvironment();
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+
+    std::cout << "Quark implementation: " << QuarkAutoDetect() << "\n";
+    benchmark::BenchRunner::RunAll();
+}
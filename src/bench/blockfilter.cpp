@@ -0,0 +1,138 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "blockfilter.h"
+#include "clientversion.h"
+#include "main.h"
+#include "random.h"
+#include "streams.h"
+
+static const int BENCH_BLOCKS = 200;
+static const int BENCH_BLOCK_TXS = 200;
+static const int BENCH_WALLET_SCRIPTS = 100;
+//! One block in this many pays to the wallet
+static const int BENCH_WALLET_BLOCK_INTERVAL = 50;
+
+static CScript RandomScript()
+{
+    uint256 hash = GetRandHash();
+    return CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(hash.begin(), hash.begin() + 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+}
+
+/**
+ * A chain of serialized blocks, as a rescan finds them on disk, with their
+ * basic filters as the index stores them.
+ */
+struct BenchChain {
+    std::vector<std::vector<unsigned char> > vBlocks;
+    std::vector<std::pair<uint256, std::vector<unsigned char> > > vFilters;
+    std::set<CScript> setWalletScripts;
+    GCSFilter::ElementSet setWalletElements;
+
+    BenchChain()
+    {
+        std::vector<CScript> vWalletScripts;
+        for (int i = 0; i < BENCH_WALLET_SCRIPTS; i++) {
+            vWalletScripts.push_back(RandomScript());
+            setWalletScripts.insert(vWalletScripts.back());
+            setWalletElements.insert(GCSFilter::Element(vWalletScripts.back().begin(), vWalletScripts.back().end()));
+        }
+
+        for (int n = 0; n < BENCH_BLOCKS; n++) {
+            CBlock block;
+            CBlockUndo blockundo;
+            for (int i = 0; i < BENCH_BLOCK_TXS; i++) {
+                CMutableTransaction tx;
+                tx.vin.resize(1);
+                tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+                tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+                tx.vout.resize(2);
+                for (int j = 0; j < 2; j++) {
+                    tx.vout[j].nValue = COIN;
+                    tx.vout[j].scriptPubKey = RandomScript();
+                }
+                if (i == 0 && n % BENCH_WALLET_BLOCK_INTERVAL == 0)
+                    tx.vout[0].scriptPubKey = vWalletScripts[n % vWalletScripts.size()];
+                block.vtx.push_back(tx);
+                if (i > 0) {
+                    blockundo.vtxundo.push_back(CTxUndo());
+                    blockundo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(COIN, RandomScript())));
+                }
+            }
+
+            CDataStream ss(SER_DISK, CLIENT_VERSION);
+            ss << block;
+            vBlocks.push_back(std::vector<unsigned char>(ss.begin(), ss.end()));
+            BlockFilter filter(block, blockundo);
+            vFilters.push_back(std::make_pair(filter.GetBlockHash(), filter.GetEncodedFilter()));
+        }
+    }
+};
+
+/** What a rescan thread does with a block it read: deserialize and screen its outputs */
+static int ScanBlock(const std::vector<unsigned char>& vData, const std::set<CScript>& setScripts)
+{
+    CDataStream ss(vData, SER_DISK, CLIENT_VERSION);
+    CBlock block;
+    ss >> block;
+    int nFound = 0;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+            if (setScripts.count(txout.scriptPubKey)) {
+                nFound++;
+                break;
+            }
+        }
+    }
+    return nFound;
+}
+
+// Rescanning a wallet by reading every block
+static void RescanFullBlocks(benchmark::State& state)
+{
+    BenchChain chain;
+    while (state.KeepRunning()) {
+        int nFound = 0;
+        for (size_t n = 0; n < chain.vBlocks.size(); n++)
+            nFound += ScanBlock(chain.vBlocks[n], chain.setWalletScripts);
+        assert(nFound == BENCH_BLOCKS / BENCH_WALLET_BLOCK_INTERVAL);
+    }
+}
+
+// Rescanning the same wallet, reading only the blocks whose filter matches
+static void RescanWithFilters(benchmark::State& state)
+{
+    BenchChain chain;
+    while (state.KeepRunning()) {
+        int nFound = 0;
+        for (size_t n = 0; n < chain.vBlocks.size(); n++) {
+            BlockFilter filter(chain.vFilters[n].first, chain.vFilters[n].second);
+            if (filter.GetFilter().MatchAny(chain.setWalletElements))
+                nFound += ScanBlock(chain.vBlocks[n], chain.setWalletScripts);
+        }
+        assert(nFound == BENCH_BLOCKS / BENCH_WALLET_BLOCK_INTERVAL);
+    }
+}
+
+// Building the filter of one block, as the index does for every block connected
+static void BlockFilterBuild(benchmark::State& state)
+{
+    BenchChain chain;
+    CDataStream ss(chain.vBlocks[0], SER_DISK, CLIENT_VERSION);
+    CBlock block;
+    ss >> block;
+    CBlockUndo blockundo;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        blockundo.vtxundo.push_back(CTxUndo());
+        blockundo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(COIN, RandomScript())));
+    }
+    while (state.KeepRunning())
+        BlockFilter filter(block, blockundo);
+}
+
+BENCHMARK(RescanFullBlocks);
+BENCHMARK(RescanWithFilters);
+BENCHMARK(BlockFilterBuild);
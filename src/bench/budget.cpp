@@ -0,0 +1,81 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "random.h"
+#include "servicenode-budget.h"
+
+#include <algorithm>
+
+static const int BENCH_BUDGET_PROPOSALS = 10000;
+static const int BENCH_BUDGET_VOTERS = 5000;
+// Votes each voter casts; every voter on every proposal would be 50M votes
+static const int BENCH_BUDGET_VOTES_PER_VOTER = 100;
+
+/** BENCH_BUDGET_PROPOSALS proposals, voted on by BENCH_BUDGET_VOTERS servicenodes */
+static void BenchProposals(CBudgetManager& manager)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < BENCH_BUDGET_PROPOSALS; i++) {
+        CBudgetProposal proposal(strprintf("bench%d", i), "", 0, 1000000, CScript() << OP_TRUE, 10 * COIN, GetRandHash());
+        proposal.nTime = 0;
+        vHashes.push_back(proposal.GetHash());
+        manager.mapProposals.insert(std::make_pair(vHashes.back(), proposal));
+    }
+
+    std::string strError;
+    for (int i = 0; i < BENCH_BUDGET_VOTERS; i++) {
+        CTxIn vin(COutPoint(GetRandHash(), 0));
+        for (int j = 0; j < BENCH_BUDGET_VOTES_PER_VOTER; j++) {
+            const uint256& hash = vHashes[GetRand(vHashes.size())];
+            CBudgetVote vote(vin, hash, j % 3 == 0 ? VOTE_NO : VOTE_YES);
+            manager.mapProposals[hash].AddOrUpdateVote(vote, strError);
+        }
+    }
+}
+
+// What mnbudget show and the budget sorting read from every proposal
+static void BudgetProposalTallies(benchmark::State& state)
+{
+    CBudgetManager manager;
+    BenchProposals(manager);
+    std::vector<CBudgetProposal*> vProposals = manager.GetAllProposals();
+    while (state.KeepRunning()) {
+        std::vector<std::pair<int, CBudgetProposal*> > vSort;
+        int64_t nTotal = 0;
+        for (size_t i = 0; i < vProposals.size(); i++) {
+            nTotal += vProposals[i]->GetYeas() + vProposals[i]->GetNays() + vProposals[i]->GetAbstains();
+            vSort.push_back(std::make_pair(vProposals[i]->Votes(), vProposals[i]));
+        }
+        std::sort(vSort.begin(), vSort.end());
+        assert(nTotal > 0);
+    }
+}
+
+// The budget projection asked for again at the same height
+static void BudgetProjectionCached(benchmark::State& state)
+{
+    CBudgetManager manager;
+    BenchProposals(manager);
+    manager.GetBudget(1);
+    while (state.KeepRunning())
+        manager.GetBudget(1);
+}
+
+// The budget projection at every new block, which rechecks every vote
+static void BudgetProjectionNewBlock(benchmark::State& state)
+{
+    CBudgetManager manager;
+    BenchProposals(manager);
+    int nHeight = 1;
+    while (state.KeepRunning())
+        manager.GetBudget(nHeight++);
+}
+
+BENCHMARK(BudgetProposalTallies);
+BENCHMARK(BudgetProjectionCached);
+BENCHMARK(BudgetProjectionNewBlock);
@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "blockprecheck.h"
+#include "main.h"
+#include "primitives/block.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+static const int BENCH_BLOCKS = 32;
+static const int BENCH_BLOCK_TXS = 500;
+static const int BENCH_PRECHECK_THREADS = 4;
+
+/** A proof-of-work block of BENCH_BLOCK_TXS one-in two-out transactions with a valid merkle root */
+static boost::shared_ptr<CBlock> BenchBlock(int n)
+{
+    boost::shared_ptr<CBlock> pblock(new CBlock());
+    pblock->nVersion = 3;
+    pblock->nTime = 1502214073 + n * 60;
+    pblock->nBits = 0x1e0ffff0;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << n << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 50 * COIN;
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    pblock->vtx.push_back(coinbase);
+
+    for (int i = 1; i < BENCH_BLOCK_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(pblock->vtx[i - 1].GetHash(), 0);
+        tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+        tx.vout.resize(2);
+        for (int j = 0; j < 2; j++) {
+            tx.vout[j].nValue = COIN;
+            tx.vout[j].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, j) << OP_EQUALVERIFY << OP_CHECKSIG;
+        }
+        pblock->vtx.push_back(tx);
+    }
+    pblock->hashMerkleRoot = pblock->BuildMerkleTree();
+    return pblock;
+}
+
+static std::vector<boost::shared_ptr<CBlock> > BenchBlocks()
+{
+    std::vector<boost::shared_ptr<CBlock> > vBlocks;
+    for (int n = 0; n < BENCH_BLOCKS; n++)
+        vBlocks.push_back(BenchBlock(n));
+    return vBlocks;
+}
+
+static void ResetChecks(const std::vector<boost::shared_ptr<CBlock> >& vBlocks)
+{
+    for (size_t i = 0; i < vBlocks.size(); i++) {
+        vBlocks[i]->fChecked = false;
+        vBlocks[i]->fSignatureChecked = false;
+    }
+}
+
+// Context-free checks of a batch of blocks, one after the other as the
+// import loop did before the precheck threads
+static void PrecheckBlocksSerial(benchmark::State& state)
+{
+    std::vector<boost::shared_ptr<CBlock> > vBlocks = BenchBlocks();
+    while (state.KeepRunning()) {
+        ResetChecks(vBlocks);
+        for (size_t i = 0; i < vBlocks.size(); i++)
+            assert(PrecheckBlock(*vBlocks[i]));
+    }
+}
+
+// The same batch through CBlockPrecheckQueue, waited for in order the way
+// LoadExternalBlockFile() consumes it
+static void PrecheckBlocksQueue(benchmark::State& state)
+{
+    std::vector<boost::shared_ptr<CBlock> > vBlocks = BenchBlocks();
+    CBlockPrecheckQueue queue;
+    boost::thread_group threadGroup;
+    for (int i = 0; i < BENCH_PRECHECK_THREADS; i++)
+        threadGroup.create_thread(boost::bind(&CBlockPrecheckQueue::Thread, &queue));
+    while (!queue.IsRunning())
+        boost::this_thread::yield();
+
+    while (state.KeepRunning()) {
+        ResetChecks(vBlocks);
+        std::vector<boost::shared_ptr<CBlockPrecheck> > vJobs;
+        for (size_t i = 0; i < vBlocks.size(); i++) {
+            vJobs.push_back(boost::shared_ptr<CBlockPrecheck>(new CBlockPrecheck(vBlocks[i])));
+            queue.Push(vJobs.back());
+        }
+        for (size_t i = 0; i < vJobs.size(); i++)
+            assert(queue.Wait(vJobs[i])->fChecked);
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BENCHMARK(PrecheckBlocksSerial);
+BENCHMARK(PrecheckBlocksQueue);
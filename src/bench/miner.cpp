@@ -0,0 +1,93 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "coins.h"
+#include "main.h"
+#include "miner.h"
+#include "random.h"
+#include "txmempool.h"
+
+static const int BENCH_HEIGHT = 1000;
+
+/**
+ * A pool of nTxs transactions paying random fees, every tenth of them with a
+ * child, all funded by one confirmed transaction in base.
+ */
+static void BenchPool(CTxMemPool& pool, CCoinsViewCache& base, int nTxs)
+{
+    CMutableTransaction funding;
+    funding.vin.resize(1);
+    funding.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    funding.vout.resize(nTxs);
+    for (int i = 0; i < nTxs; i++) {
+        funding.vout[i].nValue = COIN;
+        funding.vout[i].scriptPubKey = CScript() << OP_TRUE;
+    }
+    CTransaction txFunding(funding);
+    base.ModifyCoins(txFunding.GetHash())->FromTx(txFunding, 1);
+
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(txFunding.GetHash(), i);
+        tx.vout.resize(1);
+        CAmount nFee = 1000 + insecure_rand() % 100000;
+        tx.vout[0].nValue = COIN - nFee;
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, nFee, 0, 0.0, 1));
+
+        if (i % 10 == 0) {
+            CMutableTransaction child;
+            child.vin.resize(1);
+            child.vin[0].prevout = COutPoint(tx.GetHash(), 0);
+            child.vout.resize(1);
+            CAmount nChildFee = 1000 + insecure_rand() % 100000;
+            child.vout[0].nValue = tx.vout[0].nValue - nChildFee;
+            child.vout[0].scriptPubKey = CScript() << OP_TRUE;
+            pool.addUnchecked(child.GetHash(), CTxMemPoolEntry(child, nChildFee, 0, 0.0, 1));
+        }
+    }
+}
+
+// Filling a default sized block from a pool of nTxs transactions, as
+// getblocktemplate and the miner do on every refresh
+static void BlockTemplateAssembly(benchmark::State& state, int nTxs)
+{
+    CCoinsView viewDummy;
+    CCoinsViewCache base(&viewDummy);
+    CTxMemPool pool(CFeeRate(1000));
+    BenchPool(pool, base, nTxs);
+
+    // CheckInputs looks up the height of the view's best block
+    CBlockIndex index;
+    index.nHeight = BENCH_HEIGHT - 1;
+    uint256 hashBest = GetRandHash();
+    BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(hashBest, &index)).first;
+    base.SetBestBlock(hashBest);
+
+    LOCK(pool.cs);
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(&base);
+        CBlockTemplate blocktemplate;
+        uint64_t nBlockSize = 0;
+        uint64_t nBlockTx = 0;
+        AssembleBlockTransactions(pool, view, BENCH_HEIGHT, &blocktemplate, nBlockSize, nBlockTx);
+    }
+    mapBlockIndex.erase(mi);
+}
+
+static void BlockTemplateAssembly1k(benchmark::State& state)
+{
+    BlockTemplateAssembly(state, 1000);
+}
+
+static void BlockTemplateAssembly20k(benchmark::State& state)
+{
+    BlockTemplateAssembly(state, 20000);
+}
+
+BENCHMARK(BlockTemplateAssembly1k);
+BENCHMARK(BlockTemplateAssembly20k);
@@ -0,0 +1,107 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "coins.h"
+#include "nodepool.h"
+#include "random.h"
+#include "txmempool.h"
+
+#include <map>
+
+#include <boost/unordered_map.hpp>
+
+static const int BENCH_BLOCK_TXS = 1000;
+static const int BENCH_FLUSH_INTERVAL = 20;
+
+/** One-in two-out transactions, each spending the previous one */
+static std::vector<CTransaction> BenchTransactions(int nTxs)
+{
+    std::vector<CTransaction> vtx;
+    uint256 hashPrev = GetRandHash();
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(hashPrev, 0);
+        tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+        tx.vout.resize(2);
+        for (int j = 0; j < 2; j++) {
+            tx.vout[j].nValue = COIN;
+            tx.vout[j].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, j) << OP_EQUALVERIFY << OP_CHECKSIG;
+        }
+        vtx.push_back(tx);
+        hashPrev = vtx.back().GetHash();
+    }
+    return vtx;
+}
+
+// The coins cache side of connecting blocks: every transaction adds its
+// outputs and spends the first output of its parent, and the cache is
+// flushed every BENCH_FLUSH_INTERVAL blocks.
+static void CoinsCacheConnect(benchmark::State& state)
+{
+    std::vector<CTransaction> vtx = BenchTransactions(BENCH_BLOCK_TXS);
+    CCoinsView viewDummy;
+    CCoinsViewCache cache(&viewDummy);
+    int nBlock = 0;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vtx.size(); i++) {
+            CCoinsModifier coins = cache.ModifyCoins(vtx[i].GetHash());
+            coins->FromTx(vtx[i], nBlock);
+            if (i > 0)
+                cache.ModifyCoins(vtx[i - 1].GetHash())->Spend(0);
+        }
+        if (++nBlock % BENCH_FLUSH_INTERVAL == 0)
+            cache.Flush();
+    }
+}
+
+// Raw insert/erase churn on the coins map, with and without the node pool
+template <typename Map>
+static void MapChurn(benchmark::State& state)
+{
+    std::vector<uint256> vKeys;
+    for (int i = 0; i < BENCH_BLOCK_TXS; i++)
+        vKeys.push_back(GetRandHash());
+    Map map;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vKeys.size(); i++)
+            map[vKeys[i]].flags = CCoinsCacheEntry::DIRTY;
+        for (size_t i = 0; i < vKeys.size(); i++)
+            map.erase(vKeys[i]);
+    }
+}
+
+static void CoinsMapChurnStd(benchmark::State& state)
+{
+    MapChurn<boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> >(state);
+}
+
+static void CoinsMapChurnPooled(benchmark::State& state)
+{
+    MapChurn<CCoinsMap>(state);
+}
+
+// The mempool side of accepting transactions and connecting the block that
+// confirms them: a block's worth of addUnchecked() followed by removeForBlock()
+static void MempoolAddRemove(benchmark::State& state)
+{
+    std::vector<CTransaction> vtx = BenchTransactions(BENCH_BLOCK_TXS);
+    std::vector<CTxMemPoolEntry> vEntries;
+    for (size_t i = 0; i < vtx.size(); i++)
+        vEntries.push_back(CTxMemPoolEntry(vtx[i], 10000, 0, 0.0, 1));
+    CTxMemPool pool(CFeeRate(1000));
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vEntries.size(); i++)
+            pool.addUnchecked(vtx[i].GetHash(), vEntries[i]);
+        std::list<CTransaction> conflicts;
+        pool.removeForBlock(vtx, 2, conflicts);
+    }
+}
+
+BENCHMARK(CoinsCacheConnect);
+BENCHMARK(CoinsMapChurnStd);
+BENCHMARK(CoinsMapChurnPooled);
+BENCHMARK(MempoolAddRemove);
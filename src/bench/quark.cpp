@@ -0,0 +1,44 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "crypto/quark.h"
+#include "primitives/block.h"
+#include "utilstrencodings.h"
+
+/** A typical 80-byte header, hashed the way CBlockHeader::GetHash() does. */
+static CBlockHeader BenchHeader()
+{
+    CBlockHeader header;
+    header.nVersion = 3;
+    header.hashPrevBlock.SetHex("00000eb7919102da5a07dc90905651664e6ebf0811c28f06573b9a0fd84ab7b8");
+    header.hashMerkleRoot.SetHex("b1f0e93f6df55af4c23a0719ab33be2b8115e2b6127fc1d926a06c60a8b56bf2");
+    header.nTime = 1502214073;
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = 0;
+    return header;
+}
+
+static void QuarkHeaderReference(benchmark::State& state)
+{
+    CBlockHeader header = BenchHeader();
+    unsigned char hash[QUARK_OUTPUT_SIZE];
+    while (state.KeepRunning()) {
+        QuarkHashReference((const unsigned char*)BEGIN(header.nVersion), END(header.nNonce) - BEGIN(header.nVersion), hash);
+        header.nNonce++;
+    }
+}
+
+static void QuarkHeaderSelected(benchmark::State& state)
+{
+    CBlockHeader header = BenchHeader();
+    while (state.KeepRunning()) {
+        header.GetHash();
+        header.nNonce++;
+    }
+}
+
+BENCHMARK(QuarkHeaderReference);
+BENCHMARK(QuarkHeaderSelected);
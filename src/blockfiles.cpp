@@ -0,0 +1,134 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfiles.h"
+
+#include "main.h"
+#include "util.h"
+
+#include <limits>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileCache blockFileCache(DEFAULT_BLOCK_MAPPINGS);
+
+boost::shared_ptr<CMappedFile> CMappedFile::Open(const boost::filesystem::path& path)
+{
+#ifdef WIN32
+    // Block files are appended to while mapped, so share them for writing
+    HANDLE hFile = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return boost::shared_ptr<CMappedFile>();
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > std::numeric_limits<size_t>::max()) {
+        CloseHandle(hFile);
+        return boost::shared_ptr<CMappedFile>();
+    }
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (hMapping == NULL) {
+        LogPrintf("Unable to map file %s\n", path.string());
+        return boost::shared_ptr<CMappedFile>();
+    }
+    void* pData = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (pData == NULL) {
+        LogPrintf("Unable to map file %s\n", path.string());
+        CloseHandle(hMapping);
+        return boost::shared_ptr<CMappedFile>();
+    }
+    return boost::shared_ptr<CMappedFile>(new CMappedFile((const char*)pData, (size_t)size.QuadPart, hMapping));
+#else
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return boost::shared_ptr<CMappedFile>();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > std::numeric_limits<size_t>::max()) {
+        close(fd);
+        return boost::shared_ptr<CMappedFile>();
+    }
+    void* pData = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pData == MAP_FAILED) {
+        LogPrintf("Unable to map file %s\n", path.string());
+        return boost::shared_ptr<CMappedFile>();
+    }
+    return boost::shared_ptr<CMappedFile>(new CMappedFile((const char*)pData, (size_t)st.st_size, NULL));
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifdef WIN32
+    UnmapViewOfFile(pData);
+    CloseHandle(hMapping);
+#else
+    munmap((void*)pData, nSize);
+#endif
+}
+
+void CBlockFileCache::SetMaxMappings(unsigned int n)
+{
+    LOCK(cs);
+    nMaxMappings = n;
+    while (listMappings.size() > nMaxMappings)
+        listMappings.pop_back();
+}
+
+boost::shared_ptr<CMappedFile> CBlockFileCache::Get(int nFile, uint64_t nMinSize)
+{
+    LOCK(cs);
+    if (nMaxMappings == 0)
+        return boost::shared_ptr<CMappedFile>();
+
+    for (MappingList::iterator it = listMappings.begin(); it != listMappings.end(); ++it) {
+        if (it->first != nFile)
+            continue;
+        if (it->second->size() >= nMinSize) {
+            listMappings.splice(listMappings.begin(), listMappings, it);
+            return listMappings.front().second;
+        }
+        // The file grew since it was mapped
+        listMappings.erase(it);
+        break;
+    }
+
+    boost::shared_ptr<CMappedFile> file = CMappedFile::Open(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"));
+    if (!file || file->size() < nMinSize)
+        return boost::shared_ptr<CMappedFile>();
+    listMappings.push_front(std::make_pair(nFile, file));
+    while (listMappings.size() > nMaxMappings)
+        listMappings.pop_back();
+    return file;
+}
+
+void CBlockFileCache::Invalidate(int nFile)
+{
+    LOCK(cs);
+    for (MappingList::iterator it = listMappings.begin(); it != listMappings.end(); ++it) {
+        if (it->first == nFile) {
+            listMappings.erase(it);
+            return;
+        }
+    }
+}
+
+void CBlockFileCache::Clear()
+{
+    LOCK(cs);
+    listMappings.clear();
+}
+
+size_t CBlockFileCache::GetMappingCount()
+{
+    LOCK(cs);
+    return listMappings.size();
+}
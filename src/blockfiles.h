@@ -0,0 +1,113 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILES_H
+#define BITCOIN_BLOCKFILES_H
+
+#include "sync.h"
+
+#include <list>
+#include <stdint.h>
+#include <utility>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+
+/** Default for -blockmaps, the number of block files kept mapped for reading */
+static const unsigned int DEFAULT_BLOCK_MAPPINGS = sizeof(void*) > 4 ? 16 : 2;
+
+/** A read-only memory mapping of a whole file */
+class CMappedFile
+{
+public:
+    /** Map the file at path as it is now, or return NULL if it is missing or empty */
+    static boost::shared_ptr<CMappedFile> Open(const boost::filesystem::path& path);
+    ~CMappedFile();
+
+    const char* data() const { return pData; }
+    size_t size() const { return nSize; }
+
+private:
+    CMappedFile(const char* pDataIn, size_t nSizeIn, void* hMappingIn) : pData(pDataIn), nSize(nSizeIn), hMapping(hMappingIn) {}
+    CMappedFile(const CMappedFile&);
+    CMappedFile& operator=(const CMappedFile&);
+
+    const char* pData;
+    size_t nSize;
+    void* hMapping; // the mapping object on Windows
+};
+
+/**
+ * The serialized bytes of a block as they are stored on disk, in a block
+ * file mapping or a buffer of their own, which stays alive while the
+ * CRawBlock does. Serializing it writes the bytes as they are, so a block
+ * can be sent to a peer or a REST client without decoding it.
+ */
+class CRawBlock
+{
+public:
+    CRawBlock() : pBegin(NULL), nSize(0) {}
+    CRawBlock(const boost::shared_ptr<const void>& ownerIn, const char* pBeginIn, size_t nSizeIn)
+        : owner(ownerIn), pBegin(pBeginIn), nSize(nSizeIn) {}
+
+    const char* begin() const { return pBegin; }
+    const char* end() const { return pBegin + nSize; }
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return nSize;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        s.write(pBegin, nSize);
+    }
+
+private:
+    boost::shared_ptr<const void> owner;
+    const char* pBegin;
+    size_t nSize;
+};
+
+/**
+ * Keeps the most recently read block files mapped, so that reading a block
+ * does not open, seek and close its file every time. Mappings are shared
+ * with the CRawBlocks taken from them, so one can be evicted or replaced
+ * while a reader still uses it.
+ */
+class CBlockFileCache
+{
+public:
+    explicit CBlockFileCache(unsigned int nMaxMappingsIn) : nMaxMappings(nMaxMappingsIn) {}
+
+    /** Change the number of files kept mapped; 0 turns mapping off */
+    void SetMaxMappings(unsigned int n);
+
+    /**
+     * The mapping of blk file nFile, covering at least its first nMinSize
+     * bytes. A file that grew since it was mapped is mapped again. Returns
+     * NULL if mapping is off or the file is shorter than that.
+     */
+    boost::shared_ptr<CMappedFile> Get(int nFile, uint64_t nMinSize);
+
+    /** Drop the mapping of a file, before it is truncated */
+    void Invalidate(int nFile);
+    void Clear();
+
+    size_t GetMappingCount();
+
+private:
+    typedef std::list<std::pair<int, boost::shared_ptr<CMappedFile> > > MappingList;
+
+    CCriticalSection cs;
+    unsigned int nMaxMappings;
+    MappingList listMappings; // most recently used first
+};
+
+extern CBlockFileCache blockFileCache;
+
+#endif // BITCOIN_BLOCKFILES_H
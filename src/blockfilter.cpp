@@ -0,0 +1,427 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <boost/thread.hpp>
+
+CBlockFilterIndex* pblockfilterindex = NULL;
+
+/** (x * n) >> 64, mapping a 64-bit hash uniformly onto [0, n) without a division */
+static uint64_t FastRange64(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)x * (unsigned __int128)n) >> 64);
+#else
+    uint64_t x_hi = x >> 32, x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32, n_lo = n & 0xFFFFFFFF;
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+
+namespace
+{
+/** Appends bits to a byte vector, most significant bit first */
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+
+    void Write(uint64_t nData, int nBits)
+    {
+        while (nBits > 0) {
+            int nTake = std::min(8 - nOffset, nBits);
+            nBuffer |= ((nData >> (nBits - nTake)) & ((1U << nTake) - 1)) << (8 - nOffset - nTake);
+            nOffset += nTake;
+            nBits -= nTake;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    /** Pad the last byte with zero bits */
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+
+private:
+    std::vector<unsigned char>& vch;
+    unsigned char nBuffer;
+    int nOffset; // bits used in nBuffer
+};
+
+/** Reads the bits written by a BitWriter */
+class BitReader
+{
+public:
+    BitReader(const std::vector<unsigned char>& vchIn, size_t nPosIn) : vch(vchIn), nPos(nPosIn), nOffset(0) {}
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t nData = 0;
+        while (nBits > 0) {
+            if (nPos >= vch.size())
+                throw std::ios_base::failure("BitReader::Read(): end of data");
+            int nTake = std::min(8 - nOffset, nBits);
+            nData = (nData << nTake) | ((vch[nPos] >> (8 - nOffset - nTake)) & ((1U << nTake) - 1));
+            nOffset += nTake;
+            nBits -= nTake;
+            if (nOffset == 8) {
+                nPos++;
+                nOffset = 0;
+            }
+        }
+        return nData;
+    }
+
+private:
+    const std::vector<unsigned char>& vch;
+    size_t nPos;
+    int nOffset; // bits consumed of vch[nPos]
+};
+
+void GolombRiceEncode(BitWriter& writer, int nP, uint64_t x)
+{
+    // Quotient in unary, terminated by a 0
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = (int)std::min<uint64_t>(q, 64);
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+    writer.Write(x, nP);
+}
+
+uint64_t GolombRiceDecode(BitReader& reader, int nP)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        q++;
+    uint64_t r = reader.Read(nP);
+    return (q << nP) + r;
+}
+}
+
+GCSFilter::GCSFilter(uint64_t k0In, uint64_t k1In, int nPIn, uint32_t nMIn)
+    : k0(k0In), k1(k1In), nP(nPIn), nM(nMIn), nN(0), nF(0)
+{
+    vEncoded.push_back(0); // CompactSize N
+}
+
+GCSFilter::GCSFilter(uint64_t k0In, uint64_t k1In, int nPIn, uint32_t nMIn, const std::vector<unsigned char>& vEncodedIn)
+    : k0(k0In), k1(k1In), nP(nPIn), nM(nMIn), vEncoded(vEncodedIn)
+{
+    CDataStream stream(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t nElements = ReadCompactSize(stream);
+    if (nElements > std::numeric_limits<uint32_t>::max())
+        throw std::ios_base::failure("GCSFilter: N must be < 2^32");
+    nN = (uint32_t)nElements;
+    nF = (uint64_t)nN * nM;
+
+    // Walk the deltas once so that a truncated filter is refused up front
+    BitReader reader(vEncoded, vEncoded.size() - stream.size());
+    for (uint32_t i = 0; i < nN; i++)
+        GolombRiceDecode(reader, nP);
+}
+
+GCSFilter::GCSFilter(uint64_t k0In, uint64_t k1In, int nPIn, uint32_t nMIn, const ElementSet& elements)
+    : k0(k0In), k1(k1In), nP(nPIn), nM(nMIn)
+{
+    if (elements.size() > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("GCSFilter: N must be < 2^32");
+    nN = (uint32_t)elements.size();
+    nF = (uint64_t)nN * nM;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(stream, nN);
+    vEncoded.assign(stream.begin(), stream.end());
+
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(nN);
+    for (ElementSet::const_iterator it = elements.begin(); it != elements.end(); ++it)
+        vHashes.push_back(HashToRange(*it));
+    std::sort(vHashes.begin(), vHashes.end());
+
+    BitWriter writer(vEncoded);
+    uint64_t nLast = 0;
+    for (size_t i = 0; i < vHashes.size(); i++) {
+        GolombRiceEncode(writer, nP, vHashes[i] - nLast);
+        nLast = vHashes[i];
+    }
+    writer.Flush();
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = CSipHasher(k0, k1).Write(element.empty() ? NULL : &element[0], element.size()).Finalize();
+    return FastRange64(hash, nF);
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* pQuery, size_t nQuery) const
+{
+    CDataStream stream(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    ReadCompactSize(stream);
+    BitReader reader(vEncoded, vEncoded.size() - stream.size());
+
+    // Merge the sorted queries with the sorted set
+    uint64_t nValue = 0;
+    size_t nQueryPos = 0;
+    for (uint32_t i = 0; i < nN; i++) {
+        nValue += GolombRiceDecode(reader, nP);
+        while (true) {
+            if (nQueryPos == nQuery)
+                return false;
+            if (pQuery[nQueryPos] == nValue)
+                return true;
+            if (pQuery[nQueryPos] > nValue)
+                break;
+            nQueryPos++;
+        }
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    if (nN == 0)
+        return false;
+    uint64_t nQuery = HashToRange(element);
+    return MatchInternal(&nQuery, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (nN == 0 || elements.empty())
+        return false;
+    std::vector<uint64_t> vQueries;
+    vQueries.reserve(elements.size());
+    for (ElementSet::const_iterator it = elements.begin(); it != elements.end(); ++it)
+        vQueries.push_back(HashToRange(*it));
+    std::sort(vQueries.begin(), vQueries.end());
+    return MatchInternal(&vQueries[0], vQueries.size());
+}
+
+static uint64_t FilterKey(const uint256& hashBlock, int nPart)
+{
+    return ReadLE64(hashBlock.begin() + 8 * nPart);
+}
+
+static GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockundo)
+{
+    GCSFilter::ElementSet elements;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+            const CScript& script = txout.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+    BOOST_FOREACH (const CTxUndo& txundo, blockundo.vtxundo) {
+        BOOST_FOREACH (const CTxInUndo& prevout, txundo.vprevout) {
+            const CScript& script = prevout.txout.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+    return elements;
+}
+
+BlockFilter::BlockFilter(const uint256& hashBlockIn, const std::vector<unsigned char>& vEncoded)
+    : hashBlock(hashBlockIn),
+      filter(FilterKey(hashBlockIn, 0), FilterKey(hashBlockIn, 1), GCSFilter::BASIC_P, GCSFilter::BASIC_M, vEncoded)
+{
+}
+
+BlockFilter::BlockFilter(const CBlock& block, const CBlockUndo& blockundo)
+    : hashBlock(block.GetHash()),
+      filter(FilterKey(hashBlock, 0), FilterKey(hashBlock, 1), GCSFilter::BASIC_P, GCSFilter::BASIC_M, BasicFilterElements(block, blockundo))
+{
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vEncoded = filter.GetEncoded();
+    return Hash(vEncoded.begin(), vEncoded.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& hashPrevHeader) const
+{
+    uint256 hashFilter = GetHash();
+    return Hash(hashFilter.begin(), hashFilter.end(), hashPrevHeader.begin(), hashPrevHeader.end());
+}
+
+CBlockFilterIndex::CBlockFilterIndex(size_t nCacheSize, bool fMemory, bool fWipe)
+    : pdb(new CBlockFilterDB(nCacheSize, fMemory, fWipe)), fTipChanged(false), pindexBest(NULL)
+{
+}
+
+CBlockFilterIndex::~CBlockFilterIndex()
+{
+    delete pdb;
+}
+
+bool CBlockFilterIndex::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter, uint256* pheader) const
+{
+    std::vector<unsigned char> vEncoded;
+    uint256 hashHeader;
+    if (!pdb->ReadFilter(pindex->GetBlockHash(), vEncoded, hashHeader))
+        return false;
+    try {
+        filter = BlockFilter(pindex->GetBlockHash(), vEncoded);
+    } catch (const std::exception& e) {
+        return error("%s : bad filter for block %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    if (pheader)
+        *pheader = hashHeader;
+    return true;
+}
+
+int CBlockFilterIndex::GetBestHeight() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return pindexBest ? pindexBest->nHeight : -1;
+}
+
+void CBlockFilterIndex::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fTipChanged = true;
+    condTip.notify_all();
+}
+
+bool CBlockFilterIndex::IndexBlock(const CBlockIndex* pindex)
+{
+    CBlock block;
+    CBlockUndo blockundo;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s : cannot read block %s", __func__, pindex->GetBlockHash().ToString());
+    if (pindex->pprev) {
+        CDiskBlockPos pos;
+        {
+            LOCK(cs_main);
+            pos = pindex->GetUndoPos();
+        }
+        if (pos.IsNull() || !blockundo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()))
+            return error("%s : cannot read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    BlockFilter filter(block, blockundo);
+    uint256 hashHeader = filter.ComputeHeader(hashBestHeader);
+    if (!pdb->WriteFilter(pindex->GetBlockHash(), filter.GetEncodedFilter(), hashHeader))
+        return error("%s : cannot write filter of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    pindexBest = pindex;
+    hashBestHeader = hashHeader;
+    return true;
+}
+
+void CBlockFilterIndex::Thread()
+{
+    {
+        uint256 hashBest;
+        LOCK(cs_main);
+        if (pdb->ReadBestBlock(hashBest)) {
+            BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+            if (mi != mapBlockIndex.end()) {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                pindexBest = mi->second;
+            }
+        }
+    }
+
+    int64_t nStart = GetTimeMillis();
+    int nStartHeight = GetBestHeight();
+    bool fSynced = false;
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindexNext;
+        const CBlockIndex* pindexFork = NULL;
+        bool fRewind = false;
+        {
+            LOCK(cs_main);
+            if (pindexBest && !chainActive.Contains(pindexBest)) {
+                fRewind = true;
+                pindexFork = chainActive.FindFork(pindexBest);
+            }
+            const CBlockIndex* pindex = fRewind ? pindexFork : pindexBest;
+            pindexNext = pindex ? chainActive.Next(pindex) : chainActive.Genesis();
+        }
+
+        if (fRewind || (pindexBest && hashBestHeader.IsNull())) {
+            // Reorged away, or just started: pick up the header chain at
+            // the block the index continues from
+            const CBlockIndex* pindex = fRewind ? pindexFork : pindexBest;
+            uint256 hashHeader;
+            std::vector<unsigned char> vEncoded;
+            if (pindex && !pdb->ReadFilter(pindex->GetBlockHash(), vEncoded, hashHeader)) {
+                LogPrintf("%s : filter of block %s missing, rebuilding the index\n", __func__, pindex->GetBlockHash().ToString());
+                pindex = NULL;
+            }
+            if (pindex && fRewind && !pdb->WriteBestBlock(pindex->GetBlockHash())) {
+                error("%s : cannot write best block", __func__);
+                return;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            pindexBest = pindex;
+            hashBestHeader = pindex ? hashHeader : uint256();
+            continue;
+        }
+
+        if (!pindexNext) {
+            if (!fSynced) {
+                LogPrintf("Block filter index synced to height %d in %.2fs (%d blocks)\n", GetBestHeight(),
+                    (GetTimeMillis() - nStart) * 0.001, GetBestHeight() - nStartHeight);
+                fSynced = true;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!fTipChanged)
+                condTip.timed_wait(lock, boost::posix_time::seconds(1));
+            fTipChanged = false;
+            continue;
+        }
+
+        if (!IndexBlock(pindexNext)) {
+            // Retry later; the block may have been pruned from under us by a reindex
+            MilliSleep(1000);
+            continue;
+        }
+        if (!fSynced && pindexNext->nHeight % 10000 == 0)
+            LogPrintf("Block filter index at height %d\n", pindexNext->nHeight);
+    }
+}
+
+void ThreadBlockFilterIndex()
+{
+    RenameThread("blocknetdx-filterindex");
+    pblockfilterindex->Thread();
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+class CBlockFilterDB;
+class CBlockUndo;
+
+/**
+ * Golomb-coded set (BIP158): a compact probabilistic set of byte strings,
+ * hashed with SipHash into [0, N * M) and stored as Golomb-Rice coded
+ * deltas of the sorted hashes. A query matches every element that was
+ * added, and any other element with a probability of about 1 / M.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    /** Golomb-Rice parameter and false positive rate of the basic filter */
+    static const int BASIC_P = 19;
+    static const uint32_t BASIC_M = 784931;
+
+    /** An empty filter */
+    GCSFilter(uint64_t k0 = 0, uint64_t k1 = 0, int nP = BASIC_P, uint32_t nM = BASIC_M);
+    /** A filter from its encoding; throws std::ios_base::failure if it does not decode */
+    GCSFilter(uint64_t k0, uint64_t k1, int nP, uint32_t nM, const std::vector<unsigned char>& vEncodedIn);
+    /** A filter of the given elements */
+    GCSFilter(uint64_t k0, uint64_t k1, int nP, uint32_t nM, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+    /** Whether element may be in the set */
+    bool Match(const Element& element) const;
+    /** Whether any of elements may be in the set; cheaper than calling Match() for each */
+    bool MatchAny(const ElementSet& elements) const;
+
+private:
+    uint64_t HashToRange(const Element& element) const;
+    bool MatchInternal(const uint64_t* pQuery, size_t nQuery) const;
+
+    uint64_t k0, k1;
+    int nP;
+    uint32_t nM;
+    uint32_t nN;
+    uint64_t nF; // range of the hashed elements, N * M
+    std::vector<unsigned char> vEncoded;
+};
+
+/**
+ * The basic filter of a block: the output scripts it creates, except
+ * OP_RETURN ones, and the scripts of the outputs it spends, keyed by the
+ * block hash.
+ */
+class BlockFilter
+{
+public:
+    BlockFilter() {}
+    BlockFilter(const uint256& hashBlockIn, const std::vector<unsigned char>& vEncoded);
+    BlockFilter(const CBlock& block, const CBlockUndo& blockundo);
+
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** Double SHA256 of the encoded filter */
+    uint256 GetHash() const;
+    /** Commitment to this filter and all those before it: Hash(GetHash() || hashPrevHeader) */
+    uint256 ComputeHeader(const uint256& hashPrevHeader) const;
+
+private:
+    uint256 hashBlock;
+    GCSFilter filter;
+};
+
+/**
+ * Optional index of the basic filter of every block in the active chain
+ * (-blockfilterindex), kept in blocks/filters. A background thread builds
+ * the filters of the blocks already on disk, then follows the tip, woken
+ * by UpdatedBlockTip(); it reads blocks and undo data without cs_main, so
+ * validation is never held up by it. Filters are stored by block hash, so
+ * a reorg only moves the index's best block back to the fork.
+ */
+class CBlockFilterIndex : public CValidationInterface
+{
+public:
+    CBlockFilterIndex(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CBlockFilterIndex();
+
+    /** Filter, and optionally filter header, of a block; false if it is not indexed (yet) */
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter, uint256* pheader = NULL) const;
+
+    /** Height of the last block indexed in the active chain, -1 if none */
+    int GetBestHeight() const;
+
+    /** Thread body, see ThreadBlockFilterIndex() */
+    void Thread();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+
+private:
+    /** Build and store the filter of pindex, the active chain's next block */
+    bool IndexBlock(const CBlockIndex* pindex);
+
+    CBlockFilterDB* pdb;
+
+    mutable boost::mutex mutex;
+    boost::condition_variable condTip;
+    bool fTipChanged;
+    const CBlockIndex* pindexBest;
+    uint256 hashBestHeader;
+};
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+
+/** The block filter index, or NULL without -blockfilterindex */
+extern CBlockFilterIndex* pblockfilterindex;
+
+/** Run the block filter index until interrupted */
+void ThreadBlockFilterIndex();
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -0,0 +1,134 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockprecheck.h"
+
+#include "main.h"
+#include "primitives/block.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+CBlockPrecheck::CBlockPrecheck(const CDataStream& vRecv)
+    : vData(vRecv), status(QUEUED), fAhead(false)
+{
+}
+
+CBlockPrecheck::CBlockPrecheck(const boost::shared_ptr<CBlock>& pblockIn)
+    : vData(SER_NETWORK, PROTOCOL_VERSION), pblock(pblockIn), status(QUEUED), fAhead(false)
+{
+}
+
+bool CBlockPrecheck::Run()
+{
+    if (!pblock) {
+        try {
+            boost::shared_ptr<CBlock> pblockNew(new CBlock());
+            vData >> *pblockNew;
+            pblock = pblockNew;
+        } catch (const std::exception&) {
+            // Left to the message handler, which rejects the message as malformed
+        }
+        vData.clear();
+        if (!pblock)
+            return false;
+    }
+
+    // The header hash is memoised as well, and needed by everybody after us
+    pblock->GetHash();
+    PrecheckBlock(*pblock);
+    return true;
+}
+
+CBlockPrecheckQueue::CBlockPrecheckQueue() : nThreads(0), nChecked(0), nAhead(0)
+{
+}
+
+bool CBlockPrecheckQueue::IsRunning()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nThreads > 0;
+}
+
+void CBlockPrecheckQueue::Push(const boost::shared_ptr<CBlockPrecheck>& job)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nThreads == 0)
+        return;
+    queue.push_back(job);
+    condWork.notify_one();
+}
+
+void CBlockPrecheckQueue::Finish(CBlockPrecheck& job)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    job.status = CBlockPrecheck::DONE;
+    nChecked++;
+    if (job.fAhead)
+        nAhead++;
+    condDone.notify_all();
+}
+
+boost::shared_ptr<CBlock> CBlockPrecheckQueue::Wait(const boost::shared_ptr<CBlockPrecheck>& job)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (job->status == CBlockPrecheck::RUNNING)
+            condDone.wait(lock);
+        if (job->status == CBlockPrecheck::DONE)
+            return job->pblock;
+        // Not picked up yet: the queue entry is skipped when a thread gets to it
+        job->status = CBlockPrecheck::RUNNING;
+    }
+    job->Run();
+    Finish(*job);
+    return job->pblock;
+}
+
+size_t CBlockPrecheckQueue::GetQueueSize()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return queue.size();
+}
+
+void CBlockPrecheckQueue::GetStats(uint64_t& nCheckedOut, uint64_t& nAheadOut)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nCheckedOut = nChecked;
+    nAheadOut = nAhead;
+}
+
+void CBlockPrecheckQueue::Thread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nThreads++;
+    }
+
+    try {
+        while (true) {
+            boost::shared_ptr<CBlockPrecheck> job;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (queue.empty())
+                    condWork.wait(lock);
+                job = queue.front();
+                queue.pop_front();
+                if (job->status != CBlockPrecheck::QUEUED)
+                    continue;
+                job->status = CBlockPrecheck::RUNNING;
+                job->fAhead = true;
+            }
+            job->Run();
+            Finish(*job);
+        }
+    } catch (...) {
+        // Interrupted at shutdown. Whatever is still queued gets checked by
+        // its waiter, so the queue can be dropped once the last thread is gone.
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (--nThreads == 0)
+            queue.clear();
+        throw;
+    }
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKPRECHECK_H
+#define BITCOIN_BLOCKPRECHECK_H
+
+#include "streams.h"
+
+#include <deque>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+
+/**
+ * One block waiting for its context-free checks (see PrecheckBlock()).
+ * Created either from a received "block" message, which is then also
+ * deserialized off the message thread, or from an already decoded block.
+ */
+class CBlockPrecheck
+{
+public:
+    explicit CBlockPrecheck(const CDataStream& vRecv);
+    explicit CBlockPrecheck(const boost::shared_ptr<CBlock>& pblockIn);
+
+private:
+    friend class CBlockPrecheckQueue;
+
+    enum Status {
+        QUEUED,
+        RUNNING,
+        DONE
+    };
+
+    /** Decode the block if needed and check it. Returns false if the message did not decode. */
+    bool Run();
+
+    CDataStream vData;
+    boost::shared_ptr<CBlock> pblock;
+    Status status;
+    bool fAhead; // checked by a precheck thread rather than by the waiting thread
+};
+
+/**
+ * Runs the context-free block checks on a pool of threads, so that blocks
+ * which arrive ahead of the one being connected are already verified by the
+ * time they reach ProcessNewBlock(). Results are memoised in the blocks
+ * themselves (CBlock::fChecked and fSignatureChecked); a block that fails
+ * is simply checked again, in order, by CheckBlock() and ProcessNewBlock(),
+ * which report the error and punish the peer.
+ *
+ * Without any running threads Wait() does the work on the calling thread,
+ * so callers do not need to care whether the pool is enabled.
+ */
+class CBlockPrecheckQueue
+{
+public:
+    CBlockPrecheckQueue();
+
+    /** Whether any precheck threads are running */
+    bool IsRunning();
+
+    /** Hand a block to the precheck threads; a no-op when none are running. */
+    void Push(const boost::shared_ptr<CBlockPrecheck>& job);
+
+    /**
+     * Wait for a block's checks to finish, running them here if no thread
+     * has started on them yet. Returns the block, or NULL if it could not be
+     * deserialized.
+     */
+    boost::shared_ptr<CBlock> Wait(const boost::shared_ptr<CBlockPrecheck>& job);
+
+    /** Number of blocks that are queued but not started */
+    size_t GetQueueSize();
+
+    /** Blocks checked so far, and how many of those were done ahead by the pool */
+    void GetStats(uint64_t& nCheckedOut, uint64_t& nAheadOut);
+
+    /** Thread body, see ThreadBlockPrecheck() */
+    void Thread();
+
+private:
+    void Finish(CBlockPrecheck& job);
+
+    boost::mutex mutex;
+    boost::condition_variable condWork;
+    boost::condition_variable condDone;
+    std::deque<boost::shared_ptr<CBlockPrecheck> > queue;
+    int nThreads;
+    uint64_t nChecked;
+    uint64_t nAhead;
+};
+
+#endif // BITCOIN_BLOCKPRECHECK_H
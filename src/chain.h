@@ -450,6 +450,10 @@ public:
 
     uint256 GetBlockHash() const
     {
+        // Built from an in-memory index entry: the hash is already known.
+        if (phashBlock)
+            return *phashBlock;
+
         CBlockHeader block;
         block.nVersion = nVersion;
         block.hashPrevBlock = hashPrev;
@@ -7,6 +7,8 @@
 #define BITCOIN_COINS_H
 
 #include "compressor.h"
+#include "memusage.h"
+#include "nodepool.h"
 #include "script/standard.h"
 #include "serialize.h"
 #include "uint256.h"
@@ -283,6 +285,15 @@ public:
                 return false;
         return true;
     }
+
+    //! heap memory held by this entry: the vout array and the scripts
+    size_t DynamicMemoryUsage() const
+    {
+        size_t ret = memusage::DynamicUsage(vout);
+        BOOST_FOREACH (const CTxOut& out, vout)
+            ret += memusage::DynamicUsage(*static_cast<const std::vector<unsigned char>*>(&out.scriptPubKey));
+        return ret;
+    }
 };
 
 class CCoinsKeyHasher
@@ -316,7 +327,9 @@ struct CCoinsCacheEntry {
     CCoinsCacheEntry() : coins(), flags(0) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
+/** Nodes are pool-allocated, see node_pool_allocator */
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>,
+    node_pool_allocator<std::pair<const uint256, CCoinsCacheEntry> > > CCoinsMap;
 
 struct CCoinsStats {
     int nHeight;
@@ -369,6 +382,7 @@ public:
     bool HaveCoins(const uint256& txid) const;
     uint256 GetBestBlock() const;
     void SetBackend(CCoinsView& viewIn);
+    CCoinsView* GetBackend() const { return base; }
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
 };
@@ -398,7 +412,8 @@ class CCoinsModifier
 private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
-    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_);
+    size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
     CCoins* operator->() { return &it->second.coins; }
@@ -421,8 +436,16 @@ protected:
     mutable uint256 hashBlock;
     mutable CCoinsMap cacheCoins;
 
+    /* Cached dynamic memory usage for the inner CCoins objects. */
+    mutable size_t cachedCoinsUsage;
+
 public:
-    CCoinsViewCache(CCoinsView* baseIn);
+    /**
+     * A cache lives in the node pool of the thread creating it, unless
+     * fOwnPool is set for a cache that is used from other threads as well
+     * (under a lock) or outlives its thread.
+     */
+    CCoinsViewCache(CCoinsView* baseIn, bool fOwnPool = false);
     ~CCoinsViewCache();
 
     // Standard CCoinsView methods
@@ -446,6 +469,16 @@ public:
      */
     CCoinsModifier ModifyCoins(const uint256& txid);
 
+    //! Whether an entry for txid is loaded, without reading it from the base view
+    bool HaveCoinsInCache(const uint256& txid) const;
+
+    /**
+     * Insert coins that were read from the base view ahead of time, the way
+     * FetchCoins() would have on a miss; coins is swapped into the cache.
+     * Entries already cached are left alone, as they may be newer.
+     */
+    void Prefill(const uint256& txid, CCoins& coins);
+
     /**
      * Push the modifications applied to this cache to its base.
      * Failure to call this method before destruction will cause the changes to be forgotten.
@@ -456,6 +489,21 @@ public:
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
+    //! Calculate the size of the cache (in bytes)
+    size_t DynamicMemoryUsage() const;
+
+    //! Bytes of chunks held by the cache's node pool, free slots (and the
+    //! nodes of other caches sharing it) included
+    size_t GetPoolBytes() const;
+
+    /**
+     * Remove entries that are identical to the base view (not DIRTY) until
+     * DynamicMemoryUsage() is at most nMaxUsage, or no clean entries are left.
+     * This frees memory without writing anything. Pointers returned by
+     * AccessCoins() must not be in use. Returns the number of entries removed.
+     */
+    unsigned int UncacheClean(size_t nMaxUsage);
+
     /** 
      * Amount of blocknetdx coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
@@ -0,0 +1,203 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Groestl-512 of a single 64-byte message using AES-NI.
+//
+// The 8x16 byte state is kept row-wise, one row per 128-bit register.
+// SubBytes and ShiftBytes are done with one PSHUFB (which also undoes
+// the AES ShiftRows step) followed by AESENCLAST with a zero key, and
+// MixBytes is computed with vectorised GF(2^8) doublings. A 64-byte
+// message always fits in a single padded 128-byte block, so the hash is
+// one compression followed by the output transformation.
+//
+// The functions are compiled for AES-NI/SSSE3 through target attributes;
+// callers must check CPU support (see QuarkAutoDetect) before using them.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <stdint.h>
+#include <string.h>
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+#define GROESTL_TARGET __attribute__((target("aes,ssse3")))
+
+namespace groestl_aesni
+{
+namespace
+{
+typedef __m128i State[8];
+
+/**
+ * Per-row PSHUFB masks: the ShiftBytes rotation of each row (P: 0, 1, 2, 3,
+ * 4, 5, 6, 11; Q: 1, 3, 5, 11, 0, 2, 4, 6) pre-composed with the inverse
+ * AES ShiftRows so that AESENCLAST with a zero key yields a plain SubBytes.
+ */
+// P1024
+static const unsigned char SHIFT_P[8][16] __attribute__((aligned(16))) = {
+    {0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3},
+    {1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4},
+    {2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5},
+    {3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6},
+    {4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7},
+    {5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8},
+    {6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9},
+    {11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14}};
+// Q1024
+static const unsigned char SHIFT_Q[8][16] __attribute__((aligned(16))) = {
+    {1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4},
+    {3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6},
+    {5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8},
+    {11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14},
+    {0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3},
+    {2, 15, 12, 9, 6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5},
+    {4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3, 0, 13, 10, 7},
+    {6, 3, 0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9}};
+
+/** Multiply every byte by x (i.e. 2) in GF(2^8) modulo the AES polynomial. */
+#define XTIME(x) _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(_mm_cmplt_epi8(x, zero), poly))
+
+#define SUBSHIFT(i, shift) a##i = _mm_aesenclast_si128(_mm_shuffle_epi8(s##i, _mm_load_si128((const __m128i*)shift[i])), zero)
+
+// MixBytes with circ(02, 02, 03, 04, 05, 03, 05, 07). Output row i is
+// A ^ x * (B ^ x * C), where with t_j = a_j ^ a_{j+1} (indices mod 8):
+//   A = a_{i+2} ^ t_{i+4} ^ t_{i+6}
+//   B = t_i ^ a_{i+2} ^ a_{i+5} ^ a_{i+7}
+//   C = t_{i+3} ^ t_{i+6}
+#define MIX(o, b0, b2, b5, b7, u0, u3, u4, u6)                                        \
+    do {                                                                          \
+        __m128i c = _mm_xor_si128(u3, u6);                                        \
+        __m128i b = _mm_xor_si128(_mm_xor_si128(u0, b2), _mm_xor_si128(b5, b7));  \
+        __m128i a = _mm_xor_si128(b2, _mm_xor_si128(u4, u6));                     \
+        b = _mm_xor_si128(b, XTIME(c));                                           \
+        o = _mm_xor_si128(a, XTIME(b));                                           \
+    } while (0)
+
+#define SUBSHIFTMIX(shift)                                \
+    do {                                                  \
+        __m128i a0, a1, a2, a3, a4, a5, a6, a7;           \
+        SUBSHIFT(0, shift);                               \
+        SUBSHIFT(1, shift);                               \
+        SUBSHIFT(2, shift);                               \
+        SUBSHIFT(3, shift);                               \
+        SUBSHIFT(4, shift);                               \
+        SUBSHIFT(5, shift);                               \
+        SUBSHIFT(6, shift);                               \
+        SUBSHIFT(7, shift);                               \
+        const __m128i t0 = _mm_xor_si128(a0, a1);         \
+        const __m128i t1 = _mm_xor_si128(a1, a2);         \
+        const __m128i t2 = _mm_xor_si128(a2, a3);         \
+        const __m128i t3 = _mm_xor_si128(a3, a4);         \
+        const __m128i t4 = _mm_xor_si128(a4, a5);         \
+        const __m128i t5 = _mm_xor_si128(a5, a6);         \
+        const __m128i t6 = _mm_xor_si128(a6, a7);         \
+        const __m128i t7 = _mm_xor_si128(a7, a0);         \
+        MIX(s0, a0, a2, a5, a7, t0, t3, t4, t6);          \
+        MIX(s1, a1, a3, a6, a0, t1, t4, t5, t7);          \
+        MIX(s2, a2, a4, a7, a1, t2, t5, t6, t0);          \
+        MIX(s3, a3, a5, a0, a2, t3, t6, t7, t1);          \
+        MIX(s4, a4, a6, a1, a3, t4, t7, t0, t2);          \
+        MIX(s5, a5, a7, a2, a4, t5, t0, t1, t3);          \
+        MIX(s6, a6, a0, a3, a5, t6, t1, t2, t4);          \
+        MIX(s7, a7, a1, a4, a6, t7, t2, t3, t5);          \
+    } while (0)
+
+#define LOAD_STATE                                                            \
+    const __m128i zero = _mm_setzero_si128();                                 \
+    const __m128i poly = _mm_set1_epi8(0x1b);                                 \
+    __m128i s0 = s[0], s1 = s[1], s2 = s[2], s3 = s[3];                       \
+    __m128i s4 = s[4], s5 = s[5], s6 = s[6], s7 = s[7];
+
+#define STORE_STATE                                                           \
+    s[0] = s0, s[1] = s1, s[2] = s2, s[3] = s3;                               \
+    s[4] = s4, s[5] = s5, s[6] = s6, s[7] = s7;
+
+GROESTL_TARGET void PermuteP(State& s)
+{
+    LOAD_STATE
+    const __m128i cols = _mm_set_epi8(0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x90, 0x80, 0x70, 0x60, 0x50, 0x40, 0x30, 0x20, 0x10, 0x00);
+    for (int r = 0; r < 14; r++) {
+        s0 = _mm_xor_si128(s0, _mm_xor_si128(cols, _mm_set1_epi8(r)));
+        SUBSHIFTMIX(SHIFT_P);
+    }
+    STORE_STATE
+}
+
+GROESTL_TARGET void PermuteQ(State& s)
+{
+    LOAD_STATE
+    const __m128i ones = _mm_set1_epi32(-1);
+    const __m128i cols = _mm_set_epi8(0x0f, 0x1f, 0x2f, 0x3f, 0x4f, 0x5f, 0x6f, 0x7f, 0x8f, 0x9f, 0xaf, 0xbf, 0xcf, 0xdf, 0xef, 0xff);
+    for (int r = 0; r < 14; r++) {
+        s0 = _mm_xor_si128(s0, ones);
+        s1 = _mm_xor_si128(s1, ones);
+        s2 = _mm_xor_si128(s2, ones);
+        s3 = _mm_xor_si128(s3, ones);
+        s4 = _mm_xor_si128(s4, ones);
+        s5 = _mm_xor_si128(s5, ones);
+        s6 = _mm_xor_si128(s6, ones);
+        s7 = _mm_xor_si128(s7, _mm_xor_si128(cols, _mm_set1_epi8(r)));
+        SUBSHIFTMIX(SHIFT_Q);
+    }
+    STORE_STATE
+}
+
+#undef XTIME
+#undef SUBSHIFT
+#undef MIX
+#undef SUBSHIFTMIX
+#undef LOAD_STATE
+#undef STORE_STATE
+
+} // namespace
+
+GROESTL_TARGET void Hash64(const unsigned char* in, unsigned char* out)
+{
+    // Padded block, transposed from column-major bytes into rows:
+    // message, 0x80, zeroes, then the 64-bit big-endian block count (1).
+    unsigned char block[8][16];
+    memset(block, 0, sizeof(block));
+    for (int col = 0; col < 8; col++)
+        for (int row = 0; row < 8; row++)
+            block[row][col] = in[8 * col + row];
+    block[0][8] = 0x80;
+    block[7][15] = 0x01;
+
+    // Initial value: the output size (512) in the last two bytes.
+    unsigned char iv[8][16];
+    memset(iv, 0, sizeof(iv));
+    iv[6][15] = 0x02;
+
+    State m, h, p, q;
+    for (int i = 0; i < 8; i++) {
+        m[i] = _mm_loadu_si128((const __m128i*)block[i]);
+        h[i] = _mm_loadu_si128((const __m128i*)iv[i]);
+    }
+
+    // Compression: h' = P(h ^ m) ^ Q(m) ^ h
+    for (int i = 0; i < 8; i++) {
+        p[i] = _mm_xor_si128(h[i], m[i]);
+        q[i] = m[i];
+    }
+    PermuteP(p);
+    PermuteQ(q);
+    for (int i = 0; i < 8; i++)
+        h[i] = _mm_xor_si128(h[i], _mm_xor_si128(p[i], q[i]));
+
+    // Output transformation: trunc512(P(h') ^ h')
+    for (int i = 0; i < 8; i++)
+        p[i] = h[i];
+    PermuteP(p);
+    for (int i = 0; i < 8; i++)
+        _mm_storeu_si128((__m128i*)block[i], _mm_xor_si128(p[i], h[i]));
+    for (int col = 8; col < 16; col++)
+        for (int row = 0; row < 8; row++)
+            out[8 * (col - 8) + row] = block[row][col];
+}
+
+} // namespace groestl_aesni
+
+#endif
@@ -0,0 +1,257 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/quark.h"
+
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_skein.h"
+
+#include <atomic>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define QUARK_X86 1
+#endif
+
+#if defined(__SSE2__)
+namespace jh_sse2
+{
+void Hash64(const unsigned char* in, unsigned char* out);
+}
+#endif
+
+#if defined(QUARK_X86)
+namespace groestl_aesni
+{
+void Hash64(const unsigned char* in, unsigned char* out);
+}
+#endif
+
+// Internal implementation code.
+namespace
+{
+/** Hash a 64-byte intermediate digest into a 64-byte digest. */
+typedef void (*Stage64)(const unsigned char* in, unsigned char* out);
+
+/** Context states right after sph_*512_init, computed once. */
+struct InitialContexts {
+    sph_blake512_context blake;
+    sph_bmw512_context bmw;
+    sph_groestl512_context groestl;
+    sph_jh512_context jh;
+    sph_keccak512_context keccak;
+    sph_skein512_context skein;
+
+    InitialContexts()
+    {
+        sph_blake512_init(&blake);
+        sph_bmw512_init(&bmw);
+        sph_groestl512_init(&groestl);
+        sph_jh512_init(&jh);
+        sph_keccak512_init(&keccak);
+        sph_skein512_init(&skein);
+    }
+};
+
+const InitialContexts& Initial()
+{
+    static const InitialContexts contexts;
+    return contexts;
+}
+
+#define QUARK_STAGE(name, algo)                                          \
+    void name(const unsigned char* in, unsigned char* out)              \
+    {                                                                    \
+        sph_##algo##512_context ctx = Initial().algo;                    \
+        sph_##algo##512(&ctx, in, 64);                                   \
+        sph_##algo##512_close(&ctx, out);                                \
+    }
+
+QUARK_STAGE(Blake64, blake)
+QUARK_STAGE(Bmw64, bmw)
+QUARK_STAGE(Groestl64, groestl)
+QUARK_STAGE(JH64, jh)
+QUARK_STAGE(Keccak64, keccak)
+QUARK_STAGE(Skein64, skein)
+
+#undef QUARK_STAGE
+
+/** The stages that have accelerated variants. Plain function pointers, so they are valid during static initialisation. */
+Stage64 groestl64 = Groestl64;
+Stage64 jh64 = JH64;
+
+std::atomic<uint64_t> nQuarkHashes(0);
+
+/** The branch condition of the Quark chain: bit 3 of the first 32-bit word of the digest. */
+inline bool Bit3(const unsigned char* digest)
+{
+    uint32_t word;
+    memcpy(&word, digest, sizeof(word));
+    return (word & 8) != 0;
+}
+
+/** Check an accelerated stage against the sph one on a few fixed inputs. */
+bool SelfTest(Stage64 fast, Stage64 reference)
+{
+    unsigned char in[64], expected[64], actual[64];
+    for (int n = 0; n < 8; n++) {
+        for (int i = 0; i < 64; i++)
+            in[i] = (unsigned char)(n * 251 + i * 37 + (i >> 3));
+        reference(in, expected);
+        fast(in, actual);
+        if (memcmp(expected, actual, sizeof(expected)) != 0)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void QuarkHashReference(const unsigned char* data, size_t len, unsigned char hash[QUARK_OUTPUT_SIZE])
+{
+    sph_blake512_context ctx_blake;
+    sph_bmw512_context ctx_bmw;
+    sph_groestl512_context ctx_groestl;
+    sph_jh512_context ctx_jh;
+    sph_keccak512_context ctx_keccak;
+    sph_skein512_context ctx_skein;
+    unsigned char digest[9][64];
+
+    sph_blake512_init(&ctx_blake);
+    sph_blake512(&ctx_blake, data, len);
+    sph_blake512_close(&ctx_blake, digest[0]);
+
+    sph_bmw512_init(&ctx_bmw);
+    sph_bmw512(&ctx_bmw, digest[0], 64);
+    sph_bmw512_close(&ctx_bmw, digest[1]);
+
+    if (Bit3(digest[1])) {
+        sph_groestl512_init(&ctx_groestl);
+        sph_groestl512(&ctx_groestl, digest[1], 64);
+        sph_groestl512_close(&ctx_groestl, digest[2]);
+    } else {
+        sph_skein512_init(&ctx_skein);
+        sph_skein512(&ctx_skein, digest[1], 64);
+        sph_skein512_close(&ctx_skein, digest[2]);
+    }
+
+    sph_groestl512_init(&ctx_groestl);
+    sph_groestl512(&ctx_groestl, digest[2], 64);
+    sph_groestl512_close(&ctx_groestl, digest[3]);
+
+    sph_jh512_init(&ctx_jh);
+    sph_jh512(&ctx_jh, digest[3], 64);
+    sph_jh512_close(&ctx_jh, digest[4]);
+
+    if (Bit3(digest[4])) {
+        sph_blake512_init(&ctx_blake);
+        sph_blake512(&ctx_blake, digest[4], 64);
+        sph_blake512_close(&ctx_blake, digest[5]);
+    } else {
+        sph_bmw512_init(&ctx_bmw);
+        sph_bmw512(&ctx_bmw, digest[4], 64);
+        sph_bmw512_close(&ctx_bmw, digest[5]);
+    }
+
+    sph_keccak512_init(&ctx_keccak);
+    sph_keccak512(&ctx_keccak, digest[5], 64);
+    sph_keccak512_close(&ctx_keccak, digest[6]);
+
+    sph_skein512_init(&ctx_skein);
+    sph_skein512(&ctx_skein, digest[6], 64);
+    sph_skein512_close(&ctx_skein, digest[7]);
+
+    if (Bit3(digest[7])) {
+        sph_keccak512_init(&ctx_keccak);
+        sph_keccak512(&ctx_keccak, digest[7], 64);
+        sph_keccak512_close(&ctx_keccak, digest[8]);
+    } else {
+        sph_jh512_init(&ctx_jh);
+        sph_jh512(&ctx_jh, digest[7], 64);
+        sph_jh512_close(&ctx_jh, digest[8]);
+    }
+
+    memcpy(hash, digest[8], QUARK_OUTPUT_SIZE);
+}
+
+uint64_t QuarkHashCount()
+{
+    return nQuarkHashes.load(std::memory_order_relaxed);
+}
+
+void QuarkHash(const unsigned char* data, size_t len, unsigned char hash[QUARK_OUTPUT_SIZE])
+{
+    nQuarkHashes.fetch_add(1, std::memory_order_relaxed);
+
+    // Every stage after the first hashes exactly 64 bytes, so two buffers are
+    // enough to carry the intermediate digests through the chain.
+    unsigned char a[64], b[64];
+
+    sph_blake512_context ctx_blake = Initial().blake;
+    sph_blake512(&ctx_blake, data, len);
+    sph_blake512_close(&ctx_blake, a);
+
+    Bmw64(a, b);
+    if (Bit3(b))
+        groestl64(b, a);
+    else
+        Skein64(b, a);
+    groestl64(a, b);
+    jh64(b, a);
+    if (Bit3(a))
+        Blake64(a, b);
+    else
+        Bmw64(a, b);
+    Keccak64(b, a);
+    Skein64(a, b);
+    if (Bit3(b))
+        Keccak64(b, a);
+    else
+        jh64(b, a);
+
+    memcpy(hash, a, QUARK_OUTPUT_SIZE);
+}
+
+std::string QuarkAutoDetect()
+{
+    std::string ret = "sph";
+    groestl64 = Groestl64;
+    jh64 = JH64;
+
+#if defined(QUARK_X86)
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+#if defined(__SSE2__)
+        if ((edx >> 26) & 1 && SelfTest(jh_sse2::Hash64, JH64)) {
+            jh64 = jh_sse2::Hash64;
+            ret += ",jh-sse2";
+        }
+#endif
+        if ((ecx >> 25) & 1 && (ecx >> 9) & 1 && SelfTest(groestl_aesni::Hash64, Groestl64)) {
+            groestl64 = groestl_aesni::Hash64;
+            ret += ",groestl-aesni";
+        }
+    }
+#endif
+
+    // Final check of the whole chain; fall back to the sph stages on any mismatch.
+    unsigned char data[80], expected[QUARK_OUTPUT_SIZE], actual[QUARK_OUTPUT_SIZE];
+    for (int n = 0; n < 16; n++) {
+        for (size_t i = 0; i < sizeof(data); i++)
+            data[i] = (unsigned char)(n * 131 + i * 17);
+        QuarkHashReference(data, sizeof(data), expected);
+        QuarkHash(data, sizeof(data), actual);
+        if (memcmp(expected, actual, sizeof(expected)) != 0) {
+            groestl64 = Groestl64;
+            jh64 = JH64;
+            return "sph";
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_QUARK_H
+#define BITCOIN_CRYPTO_QUARK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Size of a Quark hash: the low 256 bits of the final 512-bit digest. */
+static const size_t QUARK_OUTPUT_SIZE = 32;
+
+/**
+ * Compute the Quark hash (blake, bmw, groestl|skein, groestl, jh, blake|bmw,
+ * keccak, skein, keccak|jh) of len bytes at data, using the implementation
+ * selected by QuarkAutoDetect(). Until that is called the portable sph_*
+ * pipeline is used.
+ */
+void QuarkHash(const unsigned char* data, size_t len, unsigned char hash[QUARK_OUTPUT_SIZE]);
+
+/**
+ * Number of QuarkHash() calls made by this process so far. Used to spot
+ * redundant header hashing; the counter is process-wide, so a delta only
+ * belongs to one caller when no other thread is hashing.
+ */
+uint64_t QuarkHashCount();
+
+/** Plain sph_* implementation with one context init per stage; the reference for self-tests. */
+void QuarkHashReference(const unsigned char* data, size_t len, unsigned char hash[QUARK_OUTPUT_SIZE]);
+
+/**
+ * Select the fastest Quark stages supported by this CPU, keeping only those
+ * that agree with the reference on a self-test. Returns a description of
+ * the selection. Must be called before any other threads use QuarkHash().
+ */
+std::string QuarkAutoDetect();
+
+#endif // BITCOIN_CRYPTO_QUARK_H
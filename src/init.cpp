@@ -15,19 +15,25 @@
 #include "activeservicenode.h"
 #include "addrman.h"
 #include "amount.h"
+#include "blockfiles.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
+#include "crypto/quark.h"
 #include "key.h"
 #include "main.h"
 #include "servicenode-budget.h"
 #include "servicenode-payments.h"
+#include "servicenode-sync.h"
 #include "servicenodeconfig.h"
+#include "servicenodedb.h"
 #include "servicenodeman.h"
 #include "miner.h"
 #include "net.h"
 #include "rpcserver.h"
 #include "script/standard.h"
 #include "spork.h"
+#include "swifttx.h"
 #include "txdb.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -187,9 +193,9 @@ void PrepareShutdown()
     GenerateBitcoins(false, NULL, 0);
 #endif
     StopNode();
-    DumpServicenodes();
-    DumpBudgets();
-    DumpServicenodePayments();
+    FlushServicenodeState();
+    delete pservicenodedb;
+    pservicenodedb = NULL;
     UnregisterNodeSignals(GetNodeSignals());
 
     if (fFeeEstimatesInitialized) {
@@ -232,6 +238,13 @@ void PrepareShutdown()
     }
 #endif
 
+    if (pblockfilterindex) {
+        UnregisterValidationInterface(pblockfilterindex);
+        delete pblockfilterindex;
+        pblockfilterindex = NULL;
+    }
+    blockFileCache.Clear();
+
 #ifndef WIN32
     boost::filesystem::remove(GetPidFile());
 #endif
@@ -321,6 +334,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
+    strUsage += HelpMessageOpt("-blockprecheckthreads=<n>", strprintf(_("Number of threads checking received and imported blocks ahead of validation (0 to %d, 0 = check when connecting, default: %d)"), MAX_BLOCK_PRECHECK_THREADS, DEFAULT_BLOCK_PRECHECK_THREADS));
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Number of threads reading the coins spent by a block from disk before connecting it, including the validation thread (0 to %d, 0 = read while connecting, default: %d)"), MAX_COINS_PREFETCH_THREADS, DEFAULT_COINS_PREFETCH_THREADS));
+    strUsage += HelpMessageOpt("-blockmaps=<n>", strprintf(_("Keep up to <n> block files memory mapped for reading blocks, 0 to read them through the file system (default: %u)"), DEFAULT_BLOCK_MAPPINGS));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 500));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3));
@@ -334,6 +350,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
+    strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "blocknetdxd.pid"));
@@ -342,6 +360,9 @@ std::string HelpMessage(HelpMessageMode mode)
 #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain an index of the transactions of every address, used by the getaddress* rpc calls and /rest/address (default: %u)"), DEFAULT_ADDRESSINDEX));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain an index of compact block filters, used by the getblockfilter rpc call and to speed up wallet rescans (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
+    strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain an index of the inputs spending every output, used by the getspentinfo rpc call and /rest/spent (default: %u)"), DEFAULT_SPENTINDEX));
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), 0));
     strUsage += HelpMessageOpt("-forcestart", _("Attempt to force blockchain corruption recovery") + " " + _("on startup"));
 
@@ -360,6 +381,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
+    strUsage += HelpMessageOpt("-msghandlerthreads=<n>", strprintf(_("Number of threads processing peer messages (1 to %d, default: %d)"), MAX_MESSAGE_HANDLER_THREADS, DEFAULT_MESSAGE_HANDLER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
@@ -390,6 +412,7 @@ std::string HelpMessage(HelpMessageMode mode)
             FormatMoney(CWallet::minTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-paytxfee=<amt>", strprintf(_("Fee (in BLOCK/kB) to add to transactions you send (default: %s)"), FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-rescanthreads=<n>", strprintf(_("Number of threads reading blocks for a rescan (1 to %d, default: %d)"), MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet.dat") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-sendfreetransactions", strprintf(_("Send transactions as zero-fee transactions if possible (default: %u)"), 0));
     strUsage += HelpMessageOpt("-spendzeroconfchange", strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"), 1));
@@ -413,6 +436,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via SwiftTX) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubxbridgeorder=<address>", _("Enable publish XBridge order book changes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubxbridgetrade=<address>", _("Enable publish XBridge order state changes in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -447,6 +472,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), 1));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> entries (default: %u)"), 50000));
+        strUsage += HelpMessageOpt("-maxmsgsigcachesize=<n>", strprintf(_("Limit size of the servicenode, budget and SwiftTX message signature cache to <n> entries (default: %u)"), DEFAULT_MAX_MSG_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in BLOCK/Kb) smaller than this are considered zero fee for relaying (default: %s)"), FormatMoney(::minRelayTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-printtoconsole", strprintf(_("Send trace/debug info to console instead of debug.log file (default: %u)"), 0));
@@ -489,6 +515,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("SwiftTX options:"));
     strUsage += HelpMessageOpt("-enableswifttx=<n>", strprintf(_("Enable swifttx, show confirmations for locked transactions (bool, default: %s)"), "true"));
     strUsage += HelpMessageOpt("-swifttxdepth=<n>", strprintf(_("Show N confirmations for a successfully locked transaction (0-9999, default: %u)"), nSwiftTXDepth));
+    strUsage += HelpMessageOpt("-maxswifttxmem=<n>", strprintf(_("Keep SwiftTX lock requests, votes and locks below <n> megabytes of memory (default: %u)"), DEFAULT_MAX_SWIFTTX_MEMORY));
 
     strUsage += HelpMessageGroup(_("Node relay options:"));
     strUsage += HelpMessageOpt("-datacarrier", strprintf(_("Relay and mine data carrier transactions (default: %u)"), 1));
@@ -510,7 +537,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 41414, 41419));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
-    strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), 4));
+    strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf(_("Set the depth of the work queue to service RPC calls (default: %d)"), DEFAULT_HTTP_WORKQUEUE));
+    strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf(_("Timeout in seconds for idle or stalled RPC connections (default: %d)"), DEFAULT_HTTP_SERVER_TIMEOUT));
     strUsage += HelpMessageOpt("-rpckeepalive", strprintf(_("RPC support for HTTP persistent connections (default: %d)"), 1));
 
     strUsage += HelpMessageGroup(_("RPC SSL options: (see the Bitcoin Wiki for SSL setup instructions)"));
@@ -830,6 +859,9 @@ bool AppInit2(boost::thread_group& threadGroup)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    blockFileCache.SetMaxMappings(std::max(GetArg("-blockmaps", DEFAULT_BLOCK_MAPPINGS), (int64_t)0));
+    messageSignatureCache.SetMaxSize(std::max(GetArg("-maxmsgsigcachesize", DEFAULT_MAX_MSG_SIG_CACHE_SIZE), (int64_t)0));
+
     fServer = GetBoolArg("-server", false);
     setvbuf(stdout, NULL, _IOLBF, 0); /// ***TODO*** do we still need this after -printtoconsole is gone?
 
@@ -902,6 +934,8 @@ bool AppInit2(boost::thread_group& threadGroup)
 #endif // ENABLE_WALLET
 
     fIsBareMultisigStd = GetArg("-permitbaremultisig", true) != 0;
+    nMaxMempoolUsage = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    nMempoolExpiry = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
     nMaxDatacarrierBytes = GetArg("-datacarriersize", nMaxDatacarrierBytes);
 
     fAlerts = GetBoolArg("-alerts", DEFAULT_ALERTS);
@@ -915,6 +949,8 @@ bool AppInit2(boost::thread_group& threadGroup)
     // Initialize elliptic curve code
     // std::string sha256_algo = SHA256AutoDetect();
     // LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string quark_algo = QuarkAutoDetect();
+    LogPrintf("Using the '%s' Quark implementation\n", quark_algo);
 
     globalVerifyHandle.reset(new ECCVerifyHandle());
 
@@ -961,8 +997,21 @@ bool AppInit2(boost::thread_group& threadGroup)
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // As many again verify the signatures of servicenode and budget sync messages
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            threadGroup.create_thread(&ThreadServicenodeSigCheck);
     }
 
+    int nBlockPrecheckThreads = std::max(0, std::min(MAX_BLOCK_PRECHECK_THREADS, (int)GetArg("-blockprecheckthreads", DEFAULT_BLOCK_PRECHECK_THREADS)));
+    LogPrintf("Using %u threads for block prechecks\n", nBlockPrecheckThreads);
+    for (int i = 0; i < nBlockPrecheckThreads; i++)
+        threadGroup.create_thread(&ThreadBlockPrecheck);
+
+    nCoinsPrefetchThreads = std::max(0, std::min(MAX_COINS_PREFETCH_THREADS, (int)GetArg("-prefetchthreads", DEFAULT_COINS_PREFETCH_THREADS)));
+    LogPrintf("Using %u threads for coins prefetch\n", nCoinsPrefetchThreads);
+    for (int i = 0; i < nCoinsPrefetchThreads - 1; i++)
+        threadGroup.create_thread(&ThreadCoinsPrefetch);
+
     if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -1242,12 +1291,22 @@ bool AppInit2(boost::thread_group& threadGroup)
     else if (nTotalCache > (nMaxDbCache << 20))
         nTotalCache = (nMaxDbCache << 20); // total cache cannot be greater than nMaxDbCache
     size_t nBlockTreeDBCache = nTotalCache / 8;
-    if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", true))
+    if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", true) && !GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
+    size_t nBlockFilterDBCache = 0;
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+        nBlockFilterDBCache = std::min(nTotalCache / 8, (size_t)(16 << 20)); // filters are read back rarely
+    nTotalCache -= nBlockFilterDBCache;
     size_t nCoinDBCache = nTotalCache / 2; // use half of the remaining cache for coindb cache
     nTotalCache -= nCoinDBCache;
-    nCoinCacheSize = nTotalCache / 300; // coins in memory require around 300 bytes
+    nCoinCacheUsage = nTotalCache; // the rest is the byte budget of the in-memory coins cache
+    LogPrintf("Cache configuration:\n");
+    LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (nBlockFilterDBCache)
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     while (!fLoaded) {
@@ -1268,7 +1327,7 @@ bool AppInit2(boost::thread_group& threadGroup)
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                pcoinsTip = new CCoinsViewCache(pcoinscatcher, true);
 
                 if (fReindex)
                     pblocktree->WriteReindexing(true);
@@ -1295,6 +1354,16 @@ bool AppInit2(boost::thread_group& threadGroup)
                     break;
                 }
 
+                // Check for changed -addressindex and -spentindex state
+                if (fAddressIndex != GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -addressindex");
+                    break;
+                }
+                if (fSpentIndex != GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -spentindex");
+                    break;
+                }
+
                 uiInterface.InitMessage(_("Verifying blocks..."));
                 if (!CVerifyDB().VerifyDB(pcoinsdbview, GetArg("-checklevel", 3),
                         GetArg("-checkblocks", 500))) {
@@ -1345,6 +1414,12 @@ bool AppInit2(boost::thread_group& threadGroup)
         mempool.ReadFeeEstimates(est_filein);
     fFeeEstimatesInitialized = true;
 
+    if (nBlockFilterDBCache) {
+        pblockfilterindex = new CBlockFilterIndex(nBlockFilterDBCache, false, fReindex);
+        RegisterValidationInterface(pblockfilterindex);
+        threadGroup.create_thread(&ThreadBlockFilterIndex);
+    }
+
 // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
     if (fDisableWallet) {
@@ -1434,6 +1509,14 @@ bool AppInit2(boost::thread_group& threadGroup)
                 pindexRescan = FindForkInGlobalIndex(chainActive, locator);
             else
                 pindexRescan = chainActive.Genesis();
+            // Pick up a rescan that was cut short by a shutdown
+            if (walletdb.ReadRescanBlock(locator)) {
+                CBlockIndex* pindexResume = FindForkInGlobalIndex(chainActive, locator);
+                if (pindexResume && pindexRescan && pindexResume->nHeight < pindexRescan->nHeight) {
+                    LogPrintf("Resuming the rescan interrupted at block %d\n", pindexResume->nHeight);
+                    pindexRescan = pindexResume;
+                }
+            }
         }
         if (chainActive.Tip() && chainActive.Tip() != pindexRescan) {
             uiInterface.InitMessage(_("Rescanning..."));
@@ -1494,51 +1577,24 @@ bool AppInit2(boost::thread_group& threadGroup)
 
     uiInterface.InitMessage(_("Loading servicenode cache..."));
 
-    CServicenodeDB mndb;
-    CServicenodeDB::ReadResult readResult = mndb.Read(mnodeman);
-    if (readResult == CServicenodeDB::FileError)
-        LogPrintf("Missing servicenode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CServicenodeDB::Ok) {
-        LogPrintf("Error reading mncache.dat: ");
-        if (readResult == CServicenodeDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-    }
-
-    uiInterface.InitMessage(_("Loading budget cache..."));
-
-    CBudgetDB budgetdb;
-    CBudgetDB::ReadResult readResult2 = budgetdb.Read(budget);
-
-    if (readResult2 == CBudgetDB::FileError)
-        LogPrintf("Missing budget cache - budget.dat, will try to recreate\n");
-    else if (readResult2 != CBudgetDB::Ok) {
-        LogPrintf("Error reading budget.dat: ");
-        if (readResult2 == CBudgetDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-    }
+    pservicenodedb = new CServicenodeStateDB(1 << 21);
+    pservicenodedb->Load(mnodeman, budget, servicenodePayments);
+    mnodeman.CheckAndRemove(true);
+    budget.CheckAndRemove();
+    servicenodePayments.CleanPaymentList();
 
     //flag our cached items so we send them to our peers
     budget.ResetSync();
     budget.ClearSeen();
 
-
-    uiInterface.InitMessage(_("Loading servicenode payment cache..."));
-
-    CServicenodePaymentDB mnpayments;
-    CServicenodePaymentDB::ReadResult readResult3 = mnpayments.Read(servicenodePayments);
-
-    if (readResult3 == CServicenodePaymentDB::FileError)
-        LogPrintf("Missing servicenode payment cache - mnpayments.dat, will try to recreate\n");
-    else if (readResult3 != CServicenodePaymentDB::Ok) {
-        LogPrintf("Error reading mnpayments.dat: ");
-        if (readResult3 == CServicenodePaymentDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
+    // the flat file caches of earlier versions are not read anymore
+    const char* pszOldCaches[] = {"mncache.dat", "budget.dat", "mnpayments.dat"};
+    BOOST_FOREACH (const char* pszOldCache, pszOldCaches) {
+        boost::filesystem::path pathOldCache = GetDataDir() / pszOldCache;
+        if (boost::filesystem::exists(pathOldCache)) {
+            LogPrintf("Removing obsolete %s\n", pszOldCache);
+            boost::filesystem::remove(pathOldCache);
+        }
     }
 
     fServiceNode = GetBoolArg("-servicenode", false);
@@ -1614,6 +1670,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     fEnableSwiftTX = GetBoolArg("-enableswifttx", fEnableSwiftTX);
     nSwiftTXDepth = GetArg("-swifttxdepth", nSwiftTXDepth);
     nSwiftTXDepth = std::min(std::max(nSwiftTXDepth, 0), 60);
+    txLockManager.SetMaxMemory(std::max(GetArg("-maxswifttxmem", DEFAULT_MAX_SWIFTTX_MEMORY), (int64_t)1) * 1000000);
 
     //lite mode disables all Servicenode and Obfuscation related functionality
     fLiteMode = GetBoolArg("-litemode", false);
@@ -1670,6 +1727,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     LogPrintf("mapAddressBook.size() = %u\n", pwalletMain ? pwalletMain->mapAddressBook.size() : 0);
 #endif
 
+    StartMessageExecutors(threadGroup);
     StartNode(threadGroup);
 
 #ifdef ENABLE_WALLET
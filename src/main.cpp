@@ -11,15 +11,20 @@
 
 #include "addrman.h"
 #include "alert.h"
+#include "blockfiles.h"
+#include "blockprecheck.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "crypto/quark.h"
 #include "init.h"
 #include "kernel.h"
 #include "servicenode-budget.h"
 #include "servicenode-payments.h"
+#include "servicenode-sync.h"
 #include "servicenodeman.h"
 #include "merkleblock.h"
+#include "messageexecutor.h"
 #include "net.h"
 #include "obfuscation.h"
 #include "pow.h"
@@ -30,9 +35,11 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "validationinterface.h"
 #include "xbridge/xbridgeapp.h"
 #include "coinvalidator.h"
 
+#include <atomic>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -59,17 +66,23 @@ map<uint256, uint256> mapProofOfStake;
 set<pair<COutPoint, unsigned int> > setStakeSeen;
 map<unsigned int, unsigned int> mapHashedBlocks;
 CChain chainActive;
+static std::atomic<const CBlockIndex*> pindexTipSnapshot(NULL);
 CBlockIndex* pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nCoinsPrefetchThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
+bool fAddressIndex = false;
+bool fSpentIndex = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
-unsigned int nCoinCacheSize = 5000;
+size_t nCoinCacheUsage = 5000 * 300;
+size_t nMaxMempoolUsage = DEFAULT_MAX_MEMPOOL_SIZE * 1000000;
+int64_t nMempoolExpiry = DEFAULT_MEMPOOL_EXPIRY * 60 * 60;
 bool fAlerts = DEFAULT_ALERTS;
 CoinValidator &coinValidator = CoinValidator::instance();
 
@@ -889,10 +902,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
     if (nResult < 0) nResult = 0;
 
     if (nResult < 6) {
-        std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-        if (i != mapTxLocks.end()) {
-            sigs = (*i).second.CountSignatures();
-        }
+        sigs = txLockManager.GetSignatures(nTXHash);
         if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
             return nSwiftTXDepth + nResult;
         }
@@ -903,12 +913,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
 
 int GetIXConfirmations(uint256 nTXHash)
 {
-    int sigs = 0;
-
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-    if (i != mapTxLocks.end()) {
-        sigs = (*i).second.CountSignatures();
-    }
+    int sigs = txLockManager.GetSignatures(nTXHash);
     if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
         return nSwiftTXDepth;
     }
@@ -1114,6 +1119,24 @@ CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowF
 }
 
 
+void LimitMempoolSize(CTxMemPool& pool, size_t limit, int64_t age)
+{
+    AssertLockHeld(cs_main);
+    int64_t nExpireTime = GetTime() - age;
+    bool fExpire = pool.HasExpired(nExpireTime);
+    if (!fExpire && pool.DynamicMemoryUsage() <= limit)
+        return;
+
+    // Only collected when something may have to go
+    std::set<uint256> setProtected;
+    txLockManager.GetProtected(setProtected);
+
+    if (fExpire)
+        pool.Expire(nExpireTime, setProtected);
+    if (pool.DynamicMemoryUsage() > limit)
+        pool.TrimToSize(limit, setProtected);
+}
+
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
 {
     AssertLockHeld(cs_main);
@@ -1147,14 +1170,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
     // ----------- swiftTX transaction scanning -----------
 
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
-            }
-        }
+    uint256 hashLock;
+    if (txLockManager.GetConflictingLock(tx, hashLock)) {
+        return state.DoS(0,
+            error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
+            REJECT_INVALID, "tx-lock-conflict");
     }
 
     // Check for conflicts with in-memory transactions
@@ -1252,6 +1272,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                                         hash.ToString(), nFees, txMinFee),
                     REJECT_INSUFFICIENTFEE, "insufficient fee");
 
+            // While the pool is under pressure, only take what pays more than what was evicted
+            CAmount mempoolRejectFee = pool.GetMinFee(nMaxMempoolUsage).GetFee(nSize);
+            if (fLimitFree && mempoolRejectFee > ::minRelayTxFee.GetFee(nSize) && nFees < mempoolRejectFee)
+                return state.DoS(0, error("AcceptToMemoryPool : mempool min fee not met %s, %d < %d",
+                                        hash.ToString(), nFees, mempoolRejectFee),
+                    REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+
             // Require that free transactions have sufficient priority to be mined in the next block.
             if (GetBoolArg("-relaypriority", true) && nFees < ::minRelayTxFee.GetFee(nSize) && !AllowFree(view.GetPriority(tx, chainActive.Height() + 1))) {
                 return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "insufficient priority");
@@ -1306,7 +1333,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         }
 
         // Store transaction in memory
-        pool.addUnchecked(hash, entry);
+        if (!pool.addUnchecked(hash, entry))
+            return state.Invalid(false, REJECT_DUPLICATE, "txn-already-in-mempool");
+
+        // Make room for it, unless it is what has to go
+        LimitMempoolSize(pool, nMaxMempoolUsage, nMempoolExpiry);
+        if (!pool.exists(hash))
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
     }
 
     SyncWithWallets(tx, NULL);
@@ -1343,14 +1376,11 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
     // ----------- swiftTX transaction scanning -----------
 
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
-            }
-        }
+    uint256 hashLock;
+    if (txLockManager.GetConflictingLock(tx, hashLock)) {
+        return state.DoS(0,
+            error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
+            REJECT_INVALID, "tx-lock-conflict");
     }
 
     // Check for conflicts with in-memory transactions
@@ -1505,6 +1535,43 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
     return true;
 }
 
+bool ExtractIndexAddress(const CScript& script, int& type, uint160& hashBytes)
+{
+    if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+        script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        type = ADDRESS_P2PKH;
+        memcpy(hashBytes.begin(), &script[3], 20);
+        return true;
+    }
+    if (script.IsPayToScriptHash()) {
+        type = ADDRESS_P2SH;
+        memcpy(hashBytes.begin(), &script[2], 20);
+        return true;
+    }
+    // Pay to pubkey, as stakes are paid: indexed under the key's address
+    if ((script.size() == 35 || script.size() == 67) && script[0] == script.size() - 2 && script.back() == OP_CHECKSIG) {
+        type = ADDRESS_P2PKH;
+        hashBytes = Hash160(script.begin() + 1, script.end() - 1);
+        return true;
+    }
+    return false;
+}
+
+bool GetAddressIndex(int type, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries,
+    int nStart, int nEnd, size_t nSkip, size_t nLimit)
+{
+    if (!fAddressIndex)
+        return error("%s : address index not enabled", __func__);
+    return pblocktree->ReadAddressIndex(type, hashBytes, vEntries, nStart, nEnd, nSkip, nLimit);
+}
+
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    if (!fSpentIndex)
+        return false;
+    return pblocktree->ReadSpentIndex(key, value);
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow)
 {
@@ -1594,20 +1661,96 @@ bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos)
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+/**
+ * The bytes of the block at pos from its block file mapping, if block files
+ * are mapped. Like WriteBlockToDisk() wrote them, the block is preceded by
+ * the network magic and its size.
+ */
+static bool MapBlockFromDisk(CRawBlock& raw, const CDiskBlockPos& pos)
 {
-    block.SetNull();
+    if (pos.IsNull() || pos.nPos < MESSAGE_START_SIZE + 4)
+        return false;
+    boost::shared_ptr<CMappedFile> file = blockFileCache.Get(pos.nFile, pos.nPos);
+    if (!file)
+        return false;
+    const char* pHeader = file->data() + pos.nPos - MESSAGE_START_SIZE - 4;
+    if (memcmp(pHeader, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+        return false;
+    unsigned int nSize = ReadLE32((const unsigned char*)pHeader + MESSAGE_START_SIZE);
+    if (file->size() < (uint64_t)pos.nPos + nSize) {
+        file = blockFileCache.Get(pos.nFile, (uint64_t)pos.nPos + nSize);
+        if (!file)
+            return false;
+    }
+    raw = CRawBlock(file, file->data() + pos.nPos, nSize);
+    return true;
+}
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+bool ReadRawBlockFromDisk(CRawBlock& raw, const CDiskBlockPos& pos)
+{
+    if (MapBlockFromDisk(raw, pos))
+        return true;
+
+    if (pos.IsNull() || pos.nPos < MESSAGE_START_SIZE + 4)
+        return error("ReadRawBlockFromDisk : invalid position %d:%u", pos.nFile, pos.nPos);
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - MESSAGE_START_SIZE - 4), true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+        return error("ReadRawBlockFromDisk : OpenBlockFile failed");
 
-    // Read block
     try {
-        filein >> block;
+        MessageStartChars pchMessageStart;
+        unsigned int nSize;
+        filein >> FLATDATA(pchMessageStart) >> nSize;
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0 || nSize > MAX_SIZE)
+            return error("ReadRawBlockFromDisk : no block at %d:%u", pos.nFile, pos.nPos);
+        boost::shared_ptr<std::vector<char> > vData(new std::vector<char>(nSize));
+        if (nSize > 0)
+            filein.read(&(*vData)[0], nSize);
+        raw = CRawBlock(vData, nSize > 0 ? &(*vData)[0] : NULL, nSize);
     } catch (std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CRawBlock& raw, const CBlockIndex* pindex)
+{
+    if (!ReadRawBlockFromDisk(raw, pindex->GetBlockPos()))
+        return false;
+    CBlockHeader header;
+    try {
+        CMemoryReader(raw.begin(), raw.end(), SER_DISK, CLIENT_VERSION) >> header;
+    } catch (std::exception& e) {
+        return error("%s : Deserialize error - %s", __func__, e.what());
+    }
+    if (header.GetHash() != pindex->GetBlockHash())
+        return error("ReadRawBlockFromDisk(CRawBlock&, CBlockIndex*) : GetHash() doesn't match index");
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+{
+    block.SetNull();
+
+    // Read block, straight from the mapped file if there is one
+    CRawBlock raw;
+    if (MapBlockFromDisk(raw, pos)) {
+        try {
+            CMemoryReader(raw.begin(), raw.end(), SER_DISK, CLIENT_VERSION) >> block;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk : OpenBlockFile failed");
+
+        try {
+            filein >> block;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Check the header
@@ -1998,11 +2141,25 @@ bool DisconnectBlock(CBlock& block, CValidationState& /*state*/, CBlockIndex* pi
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("DisconnectBlock() : block and undo data inconsistent");
 
+    // The indexes are only touched when the tip really goes, not by VerifyDB()
+    bool fUpdateIndexes = pfClean == NULL;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > vSpentIndex;
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction& tx = block.vtx[i];
         uint256 hash = tx.GetHash();
 
+        if (fUpdateIndexes && fAddressIndex) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                int type;
+                uint160 hashBytes;
+                if (ExtractIndexAddress(tx.vout[k].scriptPubKey, type, hashBytes))
+                    vAddressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, pindex->nHeight, hash, k, false), tx.vout[k].nValue));
+            }
+        }
+
         // Check that all outputs are available and match the outputs in the block itself
         // exactly. Note that transactions with only provably unspendable outputs won't
         // have outputs available even in the block itself, so we handle that case
@@ -2051,10 +2208,22 @@ bool DisconnectBlock(CBlock& block, CValidationState& /*state*/, CBlockIndex* pi
                 if (coins->vout.size() < out.n + 1)
                     coins->vout.resize(out.n + 1);
                 coins->vout[out.n] = undo.txout;
+
+                if (fUpdateIndexes && fSpentIndex)
+                    vSpentIndex.push_back(std::make_pair(CSpentIndexKey(out.hash, out.n), CSpentIndexValue()));
+                int type;
+                uint160 hashBytes;
+                if (fUpdateIndexes && fAddressIndex && ExtractIndexAddress(undo.txout.scriptPubKey, type, hashBytes))
+                    vAddressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, pindex->nHeight, hash, j, true), -undo.txout.nValue));
             }
         }
     }
 
+    if (!vAddressIndex.empty() && !pblocktree->EraseAddressIndex(vAddressIndex))
+        return error("DisconnectBlock() : failed to erase address index");
+    if (!vSpentIndex.empty() && !pblocktree->UpdateSpentIndex(vSpentIndex))
+        return error("DisconnectBlock() : failed to erase spent index");
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
@@ -2072,6 +2241,9 @@ void static FlushBlockFile(bool fFinalize = false)
 
     CDiskBlockPos posOld(nLastBlockFile, 0);
 
+    if (fFinalize)
+        blockFileCache.Invalidate(nLastBlockFile);
+
     FILE* fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
@@ -2099,6 +2271,140 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+static CBlockPrecheckQueue blockprecheckqueue;
+
+void ThreadBlockPrecheck()
+{
+    RenameThread("blocknetdx-precheck");
+    blockprecheckqueue.Thread();
+}
+
+/**
+ * Reads the coins of one prevout transaction from the coins database into a
+ * slot of the prefetch batch, timing the read.
+ */
+class CCoinsPrefetch
+{
+private:
+    const CCoinsView* pview;
+    uint256 txid;
+    CCoins* pcoins;
+    char* pfFound;
+    int64_t* pnTime;
+
+public:
+    CCoinsPrefetch() : pview(NULL), pcoins(NULL), pfFound(NULL), pnTime(NULL) {}
+    CCoinsPrefetch(const CCoinsView* pviewIn, const uint256& txidIn, CCoins* pcoinsIn, char* pfFoundIn, int64_t* pnTimeIn)
+        : pview(pviewIn), txid(txidIn), pcoins(pcoinsIn), pfFound(pfFoundIn), pnTime(pnTimeIn) {}
+
+    bool operator()()
+    {
+        int64_t nTimeStart = GetTimeMicros();
+        *pfFound = pview->GetCoins(txid, *pcoins);
+        *pnTime = GetTimeMicros() - nTimeStart;
+        return true;
+    }
+
+    void swap(CCoinsPrefetch& check)
+    {
+        std::swap(pview, check.pview);
+        std::swap(txid, check.txid);
+        std::swap(pcoins, check.pcoins);
+        std::swap(pfFound, check.pfFound);
+        std::swap(pnTime, check.pnTime);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetch> coinsprefetchqueue(16);
+
+void ThreadCoinsPrefetch()
+{
+    RenameThread("blocknetdx-prefetch");
+    coinsprefetchqueue.Thread();
+}
+
+static uint64_t nPrefetchLookups = 0; // prevout txs from outside their block
+static uint64_t nPrefetchCached = 0;  // ... already in pcoinsTip
+static uint64_t nPrefetchRead = 0;    // ... read ahead into pcoinsTip
+static int64_t nTimePrefetch = 0;
+static int64_t nTimePrefetchSaved = 0; // serial read time minus the parallel wall time
+
+/**
+ * Load the coins spent by a block into pcoinsTip before it is connected, so
+ * that ConnectBlock() finds them in memory rather than reading them from
+ * LevelDB one after the other. The reads happen on the prefetch threads
+ * against the database view below pcoinsTip, while cs_main keeps anybody
+ * else from writing to either.
+ */
+static void PrefetchBlockCoins(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (!nCoinsPrefetchThreads)
+        return;
+
+    int64_t nTimeStart = GetTimeMicros();
+    std::set<uint256> setBlockTxs;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx)
+        setBlockTxs.insert(tx.GetHash());
+    std::set<uint256> setFetch;
+    unsigned int nCached = 0;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+            const uint256& hash = txin.prevout.hash;
+            if (setBlockTxs.count(hash) || setFetch.count(hash))
+                continue;
+            if (pcoinsTip->HaveCoinsInCache(hash))
+                nCached++;
+            else
+                setFetch.insert(hash);
+        }
+    }
+    nPrefetchLookups += nCached + setFetch.size();
+    nPrefetchCached += nCached;
+    if (setFetch.empty())
+        return;
+
+    std::vector<uint256> vTxids(setFetch.begin(), setFetch.end());
+    std::vector<CCoins> vCoins(vTxids.size());
+    std::vector<char> vFound(vTxids.size(), 0);
+    std::vector<int64_t> vTime(vTxids.size(), 0);
+    {
+        CCheckQueueControl<CCoinsPrefetch> control(&coinsprefetchqueue);
+        std::vector<CCoinsPrefetch> vChecks;
+        vChecks.reserve(vTxids.size());
+        for (size_t i = 0; i < vTxids.size(); i++)
+            vChecks.push_back(CCoinsPrefetch(pcoinsTip->GetBackend(), vTxids[i], &vCoins[i], &vFound[i], &vTime[i]));
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    int64_t nTimeSerial = 0;
+    unsigned int nRead = 0;
+    for (size_t i = 0; i < vTxids.size(); i++) {
+        nTimeSerial += vTime[i];
+        if (vFound[i]) {
+            pcoinsTip->Prefill(vTxids[i], vCoins[i]);
+            nRead++;
+        }
+    }
+    nPrefetchRead += nRead;
+    int64_t nTime = GetTimeMicros() - nTimeStart;
+    nTimePrefetch += nTime;
+    nTimePrefetchSaved += nTimeSerial - nTime;
+    LogPrint("bench", "  - Prefetch %u prevout txs (%u cached): %.2fms, ~%.2fms saved [%.2fs]\n", nRead, nCached, nTime * 0.001, (nTimeSerial - nTime) * 0.001, nTimePrefetch * 0.000001);
+}
+
+/** Share of prevout lookups served from pcoinsTip, and the estimated time the prefetch saved so far */
+static std::string PrefetchStats()
+{
+    if (!nCoinsPrefetchThreads || !nPrefetchLookups)
+        return "";
+    return strprintf(" (prefetch: %.1f%% cached, %.1f%% read ahead, %.2fs saved)",
+        100.0 * nPrefetchCached / nPrefetchLookups, 100.0 * nPrefetchRead / nPrefetchLookups, nTimePrefetchSaved * 0.000001);
+}
+
 //static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex) {
 //    AssertLockHeld(cs_main);
 
@@ -2138,6 +2444,34 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/**
+ * Queue the address and spent index entries of a transaction being connected;
+ * the outputs it spends are taken from its undo data.
+ */
+static void AddToIndexes(const CTransaction& tx, const CTxUndo* ptxundo, int nHeight,
+    std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex,
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vSpentIndex)
+{
+    const uint256& hash = tx.GetHash();
+    for (unsigned int j = 0; ptxundo && j < tx.vin.size(); j++) {
+        const CTxOut& prevout = ptxundo->vprevout[j].txout;
+        int type = ADDRESS_NONE;
+        uint160 hashBytes;
+        bool fAddress = ExtractIndexAddress(prevout.scriptPubKey, type, hashBytes);
+        if (fAddressIndex && fAddress)
+            vAddressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, hash, j, true), -prevout.nValue));
+        if (fSpentIndex)
+            vSpentIndex.push_back(std::make_pair(CSpentIndexKey(tx.vin[j].prevout.hash, tx.vin[j].prevout.n),
+                CSpentIndexValue(hash, j, nHeight, prevout.nValue, type, hashBytes)));
+    }
+    for (unsigned int k = 0; fAddressIndex && k < tx.vout.size(); k++) {
+        int type;
+        uint160 hashBytes;
+        if (ExtractIndexAddress(tx.vout[k].scriptPubKey, type, hashBytes))
+            vAddressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, nHeight, hash, k, false), tx.vout[k].nValue));
+    }
+}
+
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck)
 {
     AssertLockHeld(cs_main);
@@ -2219,6 +2553,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > vSpentIndex;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     int64_t nValueOut = 0;
     int64_t nValueIn = 0;
@@ -2262,6 +2598,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
         UpdateCoins(tx, state, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
+        if ((fAddressIndex || fSpentIndex) && !fJustCheck)
+            AddToIndexes(tx, i == 0 ? NULL : &blockundo.vtxundo.back(), pindex->nHeight, vAddressIndex, vSpentIndex);
+
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
@@ -2276,7 +2615,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     int64_t nTime1 = GetTimeMicros();
     nTimeConnect += nTime1 - nTimeStart;
-    LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime1 - nTimeStart) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime1 - nTimeStart) / (nInputs - 1), nTimeConnect * 0.000001);
+    LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]%s\n", (unsigned)block.vtx.size(), 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime1 - nTimeStart) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime1 - nTimeStart) / (nInputs - 1), nTimeConnect * 0.000001, PrefetchStats());
 
     //PoW phase redistributed fees to miner. PoS stage destroys fees.
     CAmount nExpectedMint = GetBlockValue(pindex->pprev->nHeight);
@@ -2295,7 +2634,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return state.DoS(100, false);
     int64_t nTime2 = GetTimeMicros();
     nTimeVerify += nTime2 - nTimeStart;
-    LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs - 1), nTimeVerify * 0.000001);
+    LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]%s\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs - 1), nTimeVerify * 0.000001, PrefetchStats());
 
     if (fJustCheck)
         return true;
@@ -2322,6 +2661,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Abort("Failed to write transaction index");
 
+    if (!vAddressIndex.empty() && !pblocktree->WriteAddressIndex(vAddressIndex))
+        return state.Abort("Failed to write address index");
+
+    if (!vSpentIndex.empty() && !pblocktree->UpdateSpentIndex(vSpentIndex))
+        return state.Abort("Failed to write spent index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2352,14 +2697,30 @@ enum FlushStateMode {
  * The caches and indexes are flushed if either they're too large, forceWrite is set, or
  * fast is not set and it's been a while since the last write.
  */
+static uint64_t nCoinsCacheSizeFlushes = 0;
+static uint64_t nCoinsCacheUncached = 0;
+
 bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
 {
     LOCK(cs_main);
     static int64_t nLastWrite = 0;
     try {
+        size_t nCacheUsage = pcoinsTip->DynamicMemoryUsage();
+        if ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && nCacheUsage > nCoinCacheUsage) {
+            // Entries that were only read cost nothing to drop, so try that
+            // before writing everything out
+            unsigned int nUncached = pcoinsTip->UncacheClean(nCoinCacheUsage * 9 / 10);
+            nCoinsCacheUncached += nUncached;
+            LogPrint("coindb", "%s: coins cache %.1fMiB over %.1fMiB, dropped %u clean entries, now %.1fMiB\n", __func__,
+                nCacheUsage * (1.0 / (1 << 20)), nCoinCacheUsage * (1.0 / (1 << 20)), nUncached, pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)));
+            nCacheUsage = pcoinsTip->DynamicMemoryUsage();
+        }
+        bool fCacheFull = (mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && nCacheUsage > nCoinCacheUsage;
         if ((mode == FLUSH_STATE_ALWAYS) ||
-            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->GetCacheSize() > nCoinCacheSize) ||
+            fCacheFull ||
             (mode == FLUSH_STATE_PERIODIC && GetTimeMicros() > nLastWrite + DATABASE_WRITE_INTERVAL * 1000000)) {
+            if (fCacheFull)
+                nCoinsCacheSizeFlushes++;
             // Typical CCoins structures on disk are around 100 bytes in size.
             // Pushing a new one to the database can cause it to be written
             // twice (once in the log, and once in the tables). This is already
@@ -2409,19 +2770,44 @@ void FlushStateToDisk()
     FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
 }
 
+CCoinsCacheUsage GetCoinsCacheUsage()
+{
+    LOCK(cs_main);
+    CCoinsCacheUsage usage;
+    usage.nUsage = pcoinsTip->DynamicMemoryUsage();
+    usage.nPoolBytes = pcoinsTip->GetPoolBytes();
+    usage.nLimit = nCoinCacheUsage;
+    usage.nEntries = pcoinsTip->GetCacheSize();
+    usage.nSizeFlushes = nCoinsCacheSizeFlushes;
+    usage.nUncached = nCoinsCacheUncached;
+    return usage;
+}
+
 /** Update chainActive and related internal data structures. */
-void static UpdateTip(CBlockIndex* pindexNew)
+const CBlockIndex* GetChainTipSnapshot()
+{
+    return pindexTipSnapshot.load();
+}
+
+/** Move chainActive's tip and publish it to readers that do not hold cs_main */
+static void SetActiveTip(CBlockIndex* pindexNew)
 {
     chainActive.SetTip(pindexNew);
+    pindexTipSnapshot.store(pindexNew);
+}
+
+void static UpdateTip(CBlockIndex* pindexNew)
+{
+    SetActiveTip(pindexNew);
 
     // New best block
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
 
-    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%u\n",
+    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%.1fMiB(%utx)\n",
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), log(chainActive.Tip()->nChainWork.getdouble()) / log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
         DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
-              SyncProgress(chainActive.Height()), (unsigned int)pcoinsTip->GetCacheSize());
+              SyncProgress(chainActive.Height()), pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)), (unsigned int)pcoinsTip->GetCacheSize());
 
     cvBlockChange.notify_all();
 
@@ -2517,6 +2903,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    PrefetchBlockCoins(*pblock);
     {
         CInv inv(MSG_BLOCK, pindexNew->GetBlockHash());
         bool rv = ConnectBlock(*pblock, state, pindexNew, view);
@@ -2842,6 +3229,7 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock)
                         pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
             }
             // Notify external listeners about the new tip.
+            GetMainSignals().UpdatedBlockTip(pindexNewTip);
             uiInterface.NotifyBlockTip(hashNewTip);
         }
     } while (pindexMostWork != chainActive.Tip());
@@ -3128,23 +3516,13 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool f
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, bool /*fCheckPOW*/, bool fCheckMerkleRoot, bool /*fCheckSig*/)
+/**
+ * The part of CheckBlock() that depends on nothing but the block itself:
+ * merkle root, size, coinbase/coinstake layout and sigop count. Success
+ * with fCheckMerkleRoot is memoised in block.fChecked.
+ */
+static bool CheckBlockStructure(const CBlock& block, CValidationState& state, bool fCheckMerkleRoot)
 {
-    // These are checks that are independent of context.
-
-    // Check that the header is valid (particularly PoW).  This is mostly
-    // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, block.IsProofOfWork()))
-        return state.DoS(100, error("CheckBlock() : CheckBlockHeader failed"),
-            REJECT_INVALID, "bad-header", true);
-
-    // Check timestamp
-    LogPrint("debug", "%s: block=%s  is proof of stake=%d\n", __func__, block.GetHash().ToString().c_str(), block.IsProofOfStake());
-    if (block.GetBlockTime() > GetAdjustedTime() + (block.IsProofOfStake() ? 180 : 7200)) // 3 minute future drift for PoS
-        return state.Invalid(error("CheckBlock() : block timestamp too far in the future"),
-            REJECT_INVALID, "time-too-new");
-
-
     // Check the merkle root.
     if (fCheckMerkleRoot) {
         bool mutated;
@@ -3192,21 +3570,65 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool /*fCheckPOW*/
                 return state.DoS(100, error("CheckBlock() : more than one coinstake"));
     }
 
+    unsigned int nSigOps = 0;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        nSigOps += GetLegacySigOpCount(tx);
+    }
+    if (nSigOps > MAX_BLOCK_SIGOPS)
+        return state.DoS(100, error("CheckBlock() : out-of-bounds SigOpCount"),
+            REJECT_INVALID, "bad-blk-sigops", true);
+
+    if (fCheckMerkleRoot)
+        block.fChecked = true;
+    return true;
+}
+
+bool PrecheckBlock(const CBlock& block)
+{
+    CValidationState state;
+    if (!block.fChecked && !CheckBlockStructure(block, state, true))
+        return false;
+
+    if (!block.fSignatureChecked) {
+        if (!block.CheckBlockSignature())
+            return false;
+        block.fSignatureChecked = true;
+    }
+    return true;
+}
+
+bool CheckBlock(const CBlock& block, CValidationState& state, bool /*fCheckPOW*/, bool fCheckMerkleRoot, bool /*fCheckSig*/)
+{
+    // These are checks that are independent of context.
+
+    // Check that the header is valid (particularly PoW).  This is mostly
+    // redundant with the call in AcceptBlockHeader.
+    if (!CheckBlockHeader(block, state, block.IsProofOfWork()))
+        return state.DoS(100, error("CheckBlock() : CheckBlockHeader failed"),
+            REJECT_INVALID, "bad-header", true);
+
+    // Check timestamp
+    LogPrint("debug", "%s: block=%s  is proof of stake=%d\n", __func__, block.GetHash().ToString().c_str(), block.IsProofOfStake());
+    if (block.GetBlockTime() > GetAdjustedTime() + (block.IsProofOfStake() ? 180 : 7200)) // 3 minute future drift for PoS
+        return state.Invalid(error("CheckBlock() : block timestamp too far in the future"),
+            REJECT_INVALID, "time-too-new");
+
+    // Merkle root, size, layout and sigops; possibly done ahead by PrecheckBlock()
+    if (!block.fChecked && !CheckBlockStructure(block, state, fCheckMerkleRoot))
+        return false;
+
     // ----------- swiftTX transaction scanning -----------
 
     if (IsSporkActive(SPORK_3_SWIFTTX_BLOCK_FILTERING)) {
         BOOST_FOREACH (const CTransaction& tx, block.vtx) {
             if (!tx.IsCoinBase()) {
                 //only reject blocks when it's based on complete consensus
-                BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                    if (mapLockedInputs.count(in.prevout)) {
-                        if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                            mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
-                            LogPrintf("CheckBlock() : found conflicting transaction with transaction lock %s %s\n", mapLockedInputs[in.prevout].ToString(), tx.GetHash().ToString());
-                            return state.DoS(0, error("CheckBlock() : found conflicting transaction with transaction lock"),
-                                REJECT_INVALID, "conflicting-tx-ix");
-                        }
-                    }
+                uint256 hashLock;
+                if (txLockManager.GetConflictingLock(tx, hashLock)) {
+                    mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+                    LogPrintf("CheckBlock() : found conflicting transaction with transaction lock %s %s\n", hashLock.ToString(), tx.GetHash().ToString());
+                    return state.DoS(0, error("CheckBlock() : found conflicting transaction with transaction lock"),
+                        REJECT_INVALID, "conflicting-tx-ix");
                 }
             }
         }
@@ -3246,14 +3668,6 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool /*fCheckPOW*/
         if (!CheckTransaction(tx, state))
             return error("CheckBlock() : CheckTransaction failed");
 
-    unsigned int nSigOps = 0;
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        nSigOps += GetLegacySigOpCount(tx);
-    }
-    if (nSigOps > MAX_BLOCK_SIGOPS)
-        return state.DoS(100, error("CheckBlock() : out-of-bounds SigOpCount"),
-            REJECT_INVALID, "bad-blk-sigops", true);
-
     return true;
 }
 
@@ -3533,6 +3947,8 @@ void CBlockIndex::BuildSkip()
 
 bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDiskBlockPos* dbp)
 {
+    uint64_t nQuarkStart = QuarkHashCount();
+
     // Preliminary checks
     bool checked = CheckBlock(*pblock, state);
 
@@ -3543,7 +3959,7 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
     //    return error("ProcessNewBlock() : duplicate proof-of-stake (%s, %d) for block %s", pblock->GetProofOfStake().first.ToString().c_str(), pblock->GetProofOfStake().second, pblock->GetHash().ToString().c_str());
 
     // NovaCoin: check proof-of-stake block signature
-    if (!pblock->CheckBlockSignature())
+    if (!pblock->fSignatureChecked && !pblock->CheckBlockSignature())
         return error("ProcessNewBlock() : bad proof-of-stake block signature");
 
     if (pblock->GetHash() != Params().HashGenesisBlock() && pfrom != NULL) {
@@ -3582,6 +3998,8 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
     if (!ActivateBestChain(state, pblock))
         return error("%s : ActivateBestChain failed", __func__);
 
+    LogPrint("bench", "- Quark hashes for block %s: %u\n", pblock->GetHash().ToString(), (unsigned)(QuarkHashCount() - nQuarkStart));
+
     if (!fLiteMode) {
         if (servicenodeSync.RequestedServicenodeAssets > SERVICENODE_SYNC_LIST) {
             obfuScationPool.NewBlock();
@@ -3829,7 +4247,7 @@ bool static LoadBlockIndexDB()
         }
 
         //set the chain to the block before lastMeta so that the meta block will be seen as new
-        chainActive.SetTip(pindexLastMeta->pprev);
+        SetActiveTip(pindexLastMeta->pprev);
 
         //Process the lastMetaBlock again, using the known location on disk
         CDiskBlockPos blockPos = pindexLastMeta->GetBlockPos();
@@ -3882,6 +4300,14 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have an address index
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
+
+    // Check whether we have a spent index
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("LoadBlockIndexDB(): spent index %s\n", fSpentIndex ? "enabled" : "disabled");
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -3889,7 +4315,7 @@ bool static LoadBlockIndexDB()
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
         return true;
-    chainActive.SetTip(it->second);
+    SetActiveTip(it->second);
 
     PruneBlockIndexCandidates();
 
@@ -3951,7 +4377,7 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
             }
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
+        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             bool fClean = true;
             if (!DisconnectBlock(block, state, pindex, coins, &fClean))
                 return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -3992,7 +4418,7 @@ void UnloadBlockIndex()
 {
     mapBlockIndex.clear();
     setBlockIndexCandidates.clear();
-    chainActive.SetTip(NULL);
+    SetActiveTip(NULL);
     pindexBestInvalid = NULL;
 }
 
@@ -4015,6 +4441,10 @@ bool InitBlockIndex()
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -4045,18 +4475,85 @@ bool InitBlockIndex()
 }
 
 
+/**
+ * Process a block read by LoadExternalBlockFile(), then any blocks of the
+ * file that were waiting for it as their parent. Returns false on a fatal
+ * error.
+ */
+static bool ProcessExternalBlock(const boost::shared_ptr<CBlockPrecheck>& precheck, CDiskBlockPos* dbp, std::multimap<uint256, CDiskBlockPos>& mapBlocksUnknownParent, int& nLoaded)
+{
+    try {
+        CBlock& block = *blockprecheckqueue.Wait(precheck);
+
+        // detect out of order blocks, and store them for later
+        uint256 hash = block.GetHash();
+        if (hash != Params().HashGenesisBlock() && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+            LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+            if (dbp)
+                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+            return true;
+        }
+
+        // process in case the block isn't known yet
+        if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+            CValidationState state;
+            if (ProcessNewBlock(state, NULL, &block, dbp))
+                nLoaded++;
+            if (state.IsError())
+                return false;
+        } else if (hash != Params().HashGenesisBlock() && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+            LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+        }
+
+        // Recursively process earlier encountered successors of this block
+        deque<uint256> queue;
+        queue.push_back(hash);
+        while (!queue.empty()) {
+            uint256 head = queue.front();
+            queue.pop_front();
+            std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+            while (range.first != range.second) {
+                std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+                if (ReadBlockFromDisk(block, it->second)) {
+                    LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+                        head.ToString());
+                    CValidationState dummy;
+                    if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
+                        nLoaded++;
+                        queue.push_back(block.GetHash());
+                    }
+                }
+                range.first++;
+                mapBlocksUnknownParent.erase(it);
+            }
+        }
+    } catch (std::exception& e) {
+        LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    // Blocks are processed in file order, but only once the reader is
+    // BLOCK_PRECHECK_AHEAD blocks further, so that the precheck threads can
+    // verify those in the meantime.
+    std::deque<std::pair<boost::shared_ptr<CBlockPrecheck>, CDiskBlockPos> > vPending;
+    uint64_t nPrecheckedStart, nAheadStart;
+    blockprecheckqueue.GetStats(nPrecheckedStart, nAheadStart);
+
     int nLoaded = 0;
+    bool fAbort = false;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE, MAX_BLOCK_SIZE + 8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        while (!blkdat.eof() && !fAbort) {
             boost::this_thread::interruption_point();
 
             blkdat.SetPos(nRewind);
@@ -4086,62 +4583,38 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                     dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
+                boost::shared_ptr<CBlock> pblock(new CBlock());
+                blkdat >> *pblock;
                 nRewind = blkdat.GetPos();
 
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != Params().HashGenesisBlock() && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                        block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    CValidationState state;
-                    if (ProcessNewBlock(state, NULL, &block, dbp))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != Params().HashGenesisBlock() && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
-
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                head.ToString());
-                            CValidationState dummy;
-                            if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                    }
-                }
+                boost::shared_ptr<CBlockPrecheck> precheck(new CBlockPrecheck(pblock));
+                blockprecheckqueue.Push(precheck);
+                vPending.push_back(std::make_pair(precheck, dbp ? *dbp : CDiskBlockPos()));
             } catch (std::exception& e) {
                 LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
             }
+
+            while (vPending.size() > BLOCK_PRECHECK_AHEAD && !fAbort) {
+                fAbort = !ProcessExternalBlock(vPending.front().first, dbp ? &vPending.front().second : NULL, mapBlocksUnknownParent, nLoaded);
+                vPending.pop_front();
+            }
+        }
+
+        while (!vPending.empty() && !fAbort) {
+            boost::this_thread::interruption_point();
+            fAbort = !ProcessExternalBlock(vPending.front().first, dbp ? &vPending.front().second : NULL, mapBlocksUnknownParent, nLoaded);
+            vPending.pop_front();
         }
     } catch (std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
     if (nLoaded > 0)
         LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+
+    uint64_t nPrechecked, nAhead;
+    blockprecheckqueue.GetStats(nPrechecked, nAhead);
+    LogPrint("bench", "- Import prechecks: %u blocks, %u done ahead by the precheck threads\n",
+        (unsigned)(nPrechecked - nPrecheckedStart), (unsigned)(nAhead - nAheadStart));
     return nLoaded > 0;
 }
 
@@ -4483,50 +4956,49 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_BLOCK:
         return mapBlockIndex.count(inv.hash);
     case MSG_TXLOCK_REQUEST:
-        return mapTxLockReq.count(inv.hash) ||
-               mapTxLockReqRejected.count(inv.hash);
+        return txLockManager.HaveRequest(inv.hash);
     case MSG_TXLOCK_VOTE:
-        return mapTxLockVote.count(inv.hash);
+        return txLockManager.HaveVote(inv.hash);
     case MSG_SPORK:
         return mapSporks.count(inv.hash);
     case MSG_SERVICENODE_WINNER:
-        if (servicenodePayments.mapServicenodePayeeVotes.count(inv.hash)) {
+        if (servicenodePayments.HavePayeeVote(inv.hash)) {
             servicenodeSync.AddedServicenodeWinner(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_VOTE:
-        if (budget.mapSeenServicenodeBudgetVotes.count(inv.hash)) {
+        if (budget.HaveSeen(budget.mapSeenServicenodeBudgetVotes, inv.hash)) {
             servicenodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_PROPOSAL:
-        if (budget.mapSeenServicenodeBudgetProposals.count(inv.hash)) {
+        if (budget.HaveSeen(budget.mapSeenServicenodeBudgetProposals, inv.hash)) {
             servicenodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_FINALIZED_VOTE:
-        if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
+        if (budget.HaveSeen(budget.mapSeenFinalizedBudgetVotes, inv.hash)) {
             servicenodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_BUDGET_FINALIZED:
-        if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
+        if (budget.HaveSeen(budget.mapSeenFinalizedBudgets, inv.hash)) {
             servicenodeSync.AddedBudgetItem(inv.hash);
             return true;
         }
         return false;
     case MSG_SERVICENODE_ANNOUNCE:
-        if (mnodeman.mapSeenServicenodeBroadcast.count(inv.hash)) {
+        if (mnodeman.HaveSeenBroadcast(inv.hash)) {
             servicenodeSync.AddedServicenodeList(inv.hash);
             return true;
         }
         return false;
     case MSG_SERVICENODE_PING:
-        return mnodeman.mapSeenServicenodePing.count(inv.hash);
+        return mnodeman.HaveSeenPing(inv.hash);
     }
     // Don't know what it is, just say we already got one
     return true;
@@ -4570,13 +5042,17 @@ void static ProcessGetData(CNode* pfrom)
                 }
                 if (send) {
                     // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    if (inv.type == MSG_BLOCK) {
+                        // The stored bytes are what we would send, so skip decoding and encoding them
+                        CRawBlock raw;
+                        if (!ReadRawBlockFromDisk(raw, (*mi).second))
+                            assert(!"cannot load block from disk");
+                        pfrom->PushMessage("block", raw);
+                    } else // MSG_FILTERED_BLOCK)
                     {
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second))
+                            assert(!"cannot load block from disk");
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
                             CMerkleBlock merkleBlock(block, *pfrom->pfilter);
@@ -4630,19 +5106,21 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-                    if (mapTxLockVote.count(inv.hash)) {
+                    CConsensusVote vote;
+                    if (txLockManager.GetVote(inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
+                        ss << vote;
                         pfrom->PushMessage("txlvote", ss);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-                    if (mapTxLockReq.count(inv.hash)) {
+                    CTransaction txLock;
+                    if (txLockManager.GetRequest(inv.hash, txLock)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
+                        ss << txLock;
                         pfrom->PushMessage("ix", ss);
                         pushed = true;
                     }
@@ -4657,69 +5135,76 @@ void static ProcessGetData(CNode* pfrom)
                     }
                 }
                 if (!pushed && inv.type == MSG_SERVICENODE_WINNER) {
-                    if (servicenodePayments.mapServicenodePayeeVotes.count(inv.hash)) {
+                    CServicenodePaymentWinner winner;
+                    if (servicenodePayments.GetPayeeVote(inv.hash, winner)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << servicenodePayments.mapServicenodePayeeVotes[inv.hash];
+                        ss << winner;
                         pfrom->PushMessage("mnw", ss);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_BUDGET_VOTE) {
-                    if (budget.mapSeenServicenodeBudgetVotes.count(inv.hash)) {
+                    CBudgetVote vote;
+                    if (budget.GetSeen(budget.mapSeenServicenodeBudgetVotes, inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenServicenodeBudgetVotes[inv.hash];
+                        ss << vote;
                         pfrom->PushMessage("mvote", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_PROPOSAL) {
-                    if (budget.mapSeenServicenodeBudgetProposals.count(inv.hash)) {
+                    CBudgetProposalBroadcast proposal;
+                    if (budget.GetSeen(budget.mapSeenServicenodeBudgetProposals, inv.hash, proposal)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenServicenodeBudgetProposals[inv.hash];
+                        ss << proposal;
                         pfrom->PushMessage("mprop", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED_VOTE) {
-                    if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
+                    CFinalizedBudgetVote vote;
+                    if (budget.GetSeen(budget.mapSeenFinalizedBudgetVotes, inv.hash, vote)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
+                        ss << vote;
                         pfrom->PushMessage("fbvote", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED) {
-                    if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
+                    CFinalizedBudgetBroadcast finalizedBudget;
+                    if (budget.GetSeen(budget.mapSeenFinalizedBudgets, inv.hash, finalizedBudget)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgets[inv.hash];
+                        ss << finalizedBudget;
                         pfrom->PushMessage("fbs", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_SERVICENODE_ANNOUNCE) {
-                    if (mnodeman.mapSeenServicenodeBroadcast.count(inv.hash)) {
+                    CServicenodeBroadcast mnb;
+                    if (mnodeman.GetSeenBroadcast(inv.hash, mnb)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenServicenodeBroadcast[inv.hash];
+                        ss << mnb;
                         pfrom->PushMessage("mnb", ss);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_SERVICENODE_PING) {
-                    if (mnodeman.mapSeenServicenodePing.count(inv.hash)) {
+                    CServicenodePing mnp;
+                    if (mnodeman.GetSeenPing(inv.hash, mnp)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenServicenodePing[inv.hash];
+                        ss << mnp;
                         pfrom->PushMessage("mnp", ss);
                         pushed = true;
                     }
@@ -4764,15 +5249,11 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
-bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
+bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived, CBlock* pblockRecv = NULL)
 {
+    // The receive log and -dropmessagestest are applied by ProcessMessages,
+    // before messages are routed to their executors
     RandAddSeedPerfmon();
-    if (fDebug)
-        LogPrintf("received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
-    if (mapArgs.count("-dropmessagestest") && GetRand(atoi(mapArgs["-dropmessagestest"])) == 0) {
-        LogPrintf("dropmessagestest DROPPING RECV MESSAGE\n");
-        return true;
-    }
 
     if (strCommand == "version") {
         // Each connection can only send one version message
@@ -5138,6 +5619,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
                 ignoreFees = true;
                 pmn->allowFreeTx = false;
+                pmn->fDirty = true;
 
                 if (!mapObfuscationBroadcastTxes.count(tx.GetHash())) {
                     CObfuscationBroadcastTx dstx;
@@ -5310,8 +5792,13 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
     else if (strCommand == "block" && !fImporting && !fReindex) // Ignore blocks received while importing
     {
-        CBlock block;
-        vRecv >> block;
+        // Usually decoded and prechecked by ProcessMessages() already
+        CBlock blockRecv;
+        if (!pblockRecv) {
+            vRecv >> blockRecv;
+            pblockRecv = &blockRecv;
+        }
+        CBlock& block = *pblockRecv;
         uint256 hashBlock = block.GetHash();
         CInv inv(MSG_BLOCK, hashBlock);
         LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
@@ -5560,78 +6047,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         }
     }
 
-    else if (strCommand == "xbridge")
-    {
-        std::vector<unsigned char> raw;
-        vRecv >> raw;
-
-        // Top-level validation checks
-        if (raw.size() < (20 + sizeof(time_t)))
-        {
-            // bad packet, small penalty (don't relay)
-            Misbehaving(pfrom->GetId(), 10);
-        }
-        else
-        {
-            // packet's top-level hash
-            uint256 hash = Hash(raw.begin(), raw.end());
-            auto &app = xbridge::App::instance();
-
-            // If we haven't seen this packet before, proceed
-            if (!app.isKnownMessage(hash))
-            {
-                app.addToKnown(hash);
-
-                // Relay packets we haven't seen before
-                {
-                    LOCK(cs_vNodes);
-                    for  (CNode * pnode : vNodes)
-                        pnode->PushMessage("xbridge", raw);
-                }
-
-                // Only process the packet if we are an exchange capable node, a servicenode, or xrouter node
-                if (app.isEnabled() || GetBoolArg("-xrouter", false))
-                {
-                    CValidationState state;
-
-                    static std::vector<unsigned char> zero(20, 0);
-                    std::vector<unsigned char> addr(raw.begin(), raw.begin()+20);
-                    // remove addr from raw
-                    raw.erase(raw.begin(), raw.begin()+20);
-                    // remove timestamp from raw
-                    raw.erase(raw.begin(), raw.begin()+sizeof(uint64_t));
-
-                    if (addr != zero)
-                    {
-                        app.onMessageReceived(addr, raw, state);
-                    }
-                    else
-                    {
-                        app.onBroadcastReceived(raw, state);
-                    }
-
-                    int dos = 0;
-                    if (state.IsInvalid(dos))
-                    {
-                        LogPrint("xbridge", "invalid xbridge packet from peer=%d %s : %s\n",
-                            pfrom->id, pfrom->cleanSubVer,
-                            state.GetRejectReason());
-                        if (dos > 0)
-                        {
-                            Misbehaving(pfrom->GetId(), dos);
-                        }
-                    }
-                    else if (state.IsError())
-                    {
-                        LogPrint("xbridge", "xbridge packet from peer=%d %s processed with error: %s\n",
-                            pfrom->id, pfrom->cleanSubVer,
-                            state.GetRejectReason());
-                    }
-                }
-            }
-        }
-    }
-
     // messages
     // TODO move to xbridge packet processing fn
 //    else if (strCommand == "message")
@@ -5683,20 +6098,166 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
     else
     {
-        //probably one the extensions
+        //probably one the extensions; servicenode, budget, SwiftTX and
+        //XBridge messages were already routed to their executors
         obfuScationPool.ProcessMessageObfuscation(pfrom, strCommand, vRecv);
-        mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
-        budget.ProcessMessage(pfrom, strCommand, vRecv);
-        servicenodePayments.ProcessMessageServicenodePayments(pfrom, strCommand, vRecv);
-        ProcessMessageSwiftTX(pfrom, strCommand, vRecv);
         ProcessSpork(pfrom, strCommand, vRecv);
-        servicenodeSync.ProcessMessage(pfrom, strCommand, vRecv);
     }
 
 
     return true;
 }
 
+static void ProcessMessageServicenode(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
+    servicenodePayments.ProcessMessageServicenodePayments(pfrom, strCommand, vRecv);
+    servicenodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessMessageBudget(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    budget.ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+static void ProcessMessageXBridge(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    std::vector<unsigned char> raw;
+    vRecv >> raw;
+
+    // Top-level validation checks
+    if (raw.size() < (20 + sizeof(time_t)))
+    {
+        // bad packet, small penalty (don't relay)
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 10);
+    }
+    else
+    {
+        // packet's top-level hash
+        uint256 hash = Hash(raw.begin(), raw.end());
+        auto &app = xbridge::App::instance();
+
+        // If we haven't seen this packet before, proceed
+        if (!app.isKnownMessage(hash))
+        {
+            app.addToKnown(hash);
+
+            // Relay packets we haven't seen before
+            {
+                LOCK(cs_vNodes);
+                for  (CNode * pnode : vNodes)
+                    pnode->PushMessage("xbridge", raw);
+            }
+
+            // Only process the packet if we are an exchange capable node, a servicenode, or xrouter node
+            if (app.isEnabled() || GetBoolArg("-xrouter", false))
+            {
+                CValidationState state;
+
+                static std::vector<unsigned char> zero(20, 0);
+                std::vector<unsigned char> addr(raw.begin(), raw.begin()+20);
+                // remove addr from raw
+                raw.erase(raw.begin(), raw.begin()+20);
+                // remove timestamp from raw
+                raw.erase(raw.begin(), raw.begin()+sizeof(uint64_t));
+
+                if (addr != zero)
+                {
+                    app.onMessageReceived(addr, raw, state);
+                }
+                else
+                {
+                    app.onBroadcastReceived(raw, state);
+                }
+
+                int dos = 0;
+                if (state.IsInvalid(dos))
+                {
+                    LogPrint("xbridge", "invalid xbridge packet from peer=%d %s : %s\n",
+                        pfrom->id, pfrom->cleanSubVer,
+                        state.GetRejectReason());
+                    if (dos > 0)
+                    {
+                        LOCK(cs_main);
+                        Misbehaving(pfrom->GetId(), dos);
+                    }
+                }
+                else if (state.IsError())
+                {
+                    LogPrint("xbridge", "xbridge packet from peer=%d %s processed with error: %s\n",
+                        pfrom->id, pfrom->cleanSubVer,
+                        state.GetRejectReason());
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Serialises the handlers that were written for a single message handler
+ * thread and run on the peer threads: the core protocol, ProcessGetData and
+ * SendMessages. It is always taken before cs_main and before any node's
+ * cs_vSend. The executors do not take it; the servicenode, budget and
+ * SwiftTX state the peer threads look at (the seen-message maps and the
+ * SwiftTX locks) is guarded by its owners' own locks.
+ */
+static CCriticalSection cs_processMessage;
+
+/**
+ * Serialises the servicenode and budget handlers with each other. They
+ * share servicenodeSync and the payment/budget interplay and were written
+ * to run one at a time; block and transaction relay no longer waits on
+ * them. Taken before cs_main.
+ */
+static CCriticalSection cs_servicenodeMessages;
+
+static CMessageExecutor servicenodeExecutor("servicenode", MESSAGE_EXECUTOR_QUEUE_SIZE, ProcessMessageServicenode, &cs_servicenodeMessages, PrecheckServicenodeMessages);
+static CMessageExecutor budgetExecutor("budget", MESSAGE_EXECUTOR_QUEUE_SIZE, ProcessMessageBudget, &cs_servicenodeMessages, PrecheckServicenodeMessages);
+static CMessageExecutor swifttxExecutor("swifttx", MESSAGE_EXECUTOR_QUEUE_SIZE, ProcessMessageSwiftTX, NULL);
+static CMessageExecutor xbridgeExecutor("xbridge", MESSAGE_EXECUTOR_QUEUE_SIZE, ProcessMessageXBridge, NULL);
+
+/** Latency of the messages handled on the peer threads */
+static CMessageStats peerMessageStats;
+
+/** The executor that handles strCommand, or NULL for the peer threads */
+static CMessageExecutor* GetMessageExecutor(const std::string& strCommand)
+{
+    if (strCommand == "mnb" || strCommand == "mnp" || strCommand == "dseg" || strCommand == "dsee" ||
+        strCommand == "dseep" || strCommand == "mnget" || strCommand == "mnw" || strCommand == "ssc")
+        return &servicenodeExecutor;
+    if (strCommand == "mnvs" || strCommand == "mprop" || strCommand == "mvote" || strCommand == "fbs" || strCommand == "fbvote")
+        return &budgetExecutor;
+    if (strCommand == "ix" || strCommand == "txlvote")
+        return &swifttxExecutor;
+    if (strCommand == "xbridge")
+        return &xbridgeExecutor;
+    return NULL;
+}
+
+void StartMessageExecutors(boost::thread_group& threadGroup)
+{
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msgsn", boost::function<void()>(boost::bind(&CMessageExecutor::Thread, &servicenodeExecutor))));
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msgbudget", boost::function<void()>(boost::bind(&CMessageExecutor::Thread, &budgetExecutor))));
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msgix", boost::function<void()>(boost::bind(&CMessageExecutor::Thread, &swifttxExecutor))));
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msgxbridge", boost::function<void()>(boost::bind(&CMessageExecutor::Thread, &xbridgeExecutor))));
+}
+
+std::vector<CMessageExecutor*> GetMessageExecutors()
+{
+    std::vector<CMessageExecutor*> vExecutors;
+    vExecutors.push_back(&servicenodeExecutor);
+    vExecutors.push_back(&budgetExecutor);
+    vExecutors.push_back(&swifttxExecutor);
+    vExecutors.push_back(&xbridgeExecutor);
+    return vExecutors;
+}
+
+const CMessageStats& GetPeerMessageStats()
+{
+    return peerMessageStats;
+}
+
 int ActiveProtocol()
 {
     if (IsSporkActive(SPORK_14_NEW_PROTOCOL_ENFORCEMENT)) {
@@ -5723,12 +6284,29 @@ bool ProcessMessages(CNode* pfrom)
     //
     bool fOk = true;
 
-    if (!pfrom->vRecvGetData.empty())
+    if (!pfrom->vRecvGetData.empty()) {
+        LOCK(cs_processMessage);
         ProcessGetData(pfrom);
+    }
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return fOk;
 
+    // Start the context-free checks of the blocks queued behind the current
+    // message, so they are done by the time their turn comes
+    if (!fImporting && !fReindex && blockprecheckqueue.IsRunning()) {
+        unsigned int nAhead = 0;
+        for (std::deque<CNetMessage>::iterator itBlock = pfrom->vRecvMsg.begin(); itBlock != pfrom->vRecvMsg.end() && itBlock->complete() && nAhead < BLOCK_PRECHECK_AHEAD; itBlock++) {
+            if (itBlock->hdr.GetCommand() != "block")
+                continue;
+            if (!itBlock->precheck) {
+                itBlock->precheck.reset(new CBlockPrecheck(itBlock->vRecv));
+                blockprecheckqueue.Push(itBlock->precheck);
+            }
+            nAhead++;
+        }
+    }
+
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
         // Don't bother if send buffer is too full to respond anyway
@@ -5779,10 +6357,64 @@ bool ProcessMessages(CNode* pfrom)
             continue;
         }
 
+        // A message left over because its executor was full has been logged
+        // and gone through -dropmessagestest already
+        bool fRetry = pfrom->fRecvExecutorFull;
+        pfrom->fRecvExecutorFull = false;
+        if (fDebug && !fRetry)
+            LogPrintf("received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
+        if (!fRetry && mapArgs.count("-dropmessagestest") && GetRand(atoi(mapArgs["-dropmessagestest"])) == 0) {
+            LogPrintf("dropmessagestest DROPPING RECV MESSAGE\n");
+            break;
+        }
+
+        // Servicenode, budget, SwiftTX and XBridge messages are handed to their
+        // executors, but only once the peer has sent its version
+        CMessageExecutor* pexecutor = GetMessageExecutor(strCommand);
+        if (pexecutor && pfrom->nVersion == 0) {
+            {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 1);
+            }
+            LogPrintf("ProcessMessage(%s, %u bytes) FAILED peer=%d\n", SanitizeString(strCommand), nMessageSize, pfrom->id);
+            break;
+        }
+
+        // If the executor is backed up the message stays in vRecvMsg, which
+        // throttles the peer through the receive flood limit. This thread
+        // does not wait for room: the executor wakes it once there is some.
+        if (pexecutor && pexecutor->IsRunning()) {
+            if (!pexecutor->Post(pfrom, strCommand, vRecv)) {
+                pfrom->fRecvExecutorFull = true;
+                --it;
+            }
+            break;
+        }
+
         // Process message
         bool fRet = false;
+        int64_t nStart = GetTimeMicros();
         try {
-            fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
+            if (pexecutor) {
+                pexecutor->Handle(pfrom, strCommand, vRecv, 0);
+                fRet = true;
+            } else {
+                // Blocks are decoded and prechecked before taking the lock,
+                // so that this overlaps with the other threads' messages
+                boost::shared_ptr<CBlock> pblockRecv;
+                if (strCommand == "block" && !fImporting && !fReindex) {
+                    if (msg.precheck) {
+                        pblockRecv = blockprecheckqueue.Wait(msg.precheck);
+                    } else {
+                        pblockRecv.reset(new CBlock());
+                        vRecv >> *pblockRecv;
+                        PrecheckBlock(*pblockRecv);
+                    }
+                }
+                LOCK(cs_processMessage);
+                fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, pblockRecv.get());
+                peerMessageStats.Record(strCommand, 0, GetTimeMicros() - nStart);
+            }
             boost::this_thread::interruption_point();
         } catch (std::ios_base::failure& e) {
             pfrom->PushMessage("reject", strCommand, REJECT_MALFORMED, string("error parsing message"));
@@ -5819,6 +6451,11 @@ bool ProcessMessages(CNode* pfrom)
 
 bool SendMessages(CNode* pto, bool fSendTrickle)
 {
+    LOCK(cs_processMessage);
+    TRY_LOCK(pto->cs_vSend, lockSend);
+    if (!lockSend)
+        return true;
+
     {
         // Don't send anything until we get their version message
         if (pto->nVersion == 0)
@@ -13,6 +13,7 @@
 #include "config/blocknetdx-config.h"
 #endif
 
+#include "addressindex.h"
 #include "amount.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -46,6 +47,9 @@ class CBlockIndex;
 class CBlockTreeDB;
 class CBloomFilter;
 class CInv;
+class CMessageExecutor;
+class CMessageStats;
+class CRawBlock;
 class CScriptCheck;
 class CValidationInterface;
 class CValidationState;
@@ -70,6 +74,10 @@ static const unsigned int MAX_P2SH_SIGOPS = 15;
 static const unsigned int MAX_TX_SIGOPS = MAX_BLOCK_SIGOPS / 5;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
+/** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
+static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -82,6 +90,16 @@ static const int COINBASE_MATURITY = 100;
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of block precheck threads allowed */
+static const int MAX_BLOCK_PRECHECK_THREADS = 16;
+/** -blockprecheckthreads default */
+static const int DEFAULT_BLOCK_PRECHECK_THREADS = 2;
+/** Maximum number of coins prefetch threads allowed */
+static const int MAX_COINS_PREFETCH_THREADS = 16;
+/** -prefetchthreads default (including the validation thread itself) */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 4;
+/** Blocks from one peer or import file handed to the precheck threads ahead of the one being connected */
+static const unsigned int BLOCK_PRECHECK_AHEAD = 16;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -98,6 +116,8 @@ static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 static const unsigned int DATABASE_WRITE_INTERVAL = 3600;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
+/** Messages each servicenode, budget, SwiftTX and XBridge executor may have queued */
+static const unsigned int MESSAGE_EXECUTOR_QUEUE_SIZE = 1000;
 
 /** "reject" message codes */
 static const unsigned char REJECT_MALFORMED = 0x01;
@@ -127,10 +147,16 @@ extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nCoinsPrefetchThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
-extern unsigned int nCoinCacheSize;
+extern size_t nCoinCacheUsage;
+/** -maxmempool in bytes and -mempoolexpiry in seconds */
+extern size_t nMaxMempoolUsage;
+extern int64_t nMempoolExpiry;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
 
@@ -198,6 +224,12 @@ void UnloadBlockIndex();
 int ActiveProtocol();
 /** Process protocol messages received from a given node */
 bool ProcessMessages(CNode* pfrom);
+/** Start the threads of the servicenode, budget, SwiftTX and XBridge message executors */
+void StartMessageExecutors(boost::thread_group& threadGroup);
+/** The message executors, for reporting */
+std::vector<CMessageExecutor*> GetMessageExecutors();
+/** Latency of the messages handled directly on the message handler threads */
+const CMessageStats& GetPeerMessageStats();
 /**
  * Send queued protocol messages to be sent to a give node.
  *
@@ -205,8 +237,29 @@ bool ProcessMessages(CNode* pfrom);
  * @param[in]   fSendTrickle    When true send the trickled data, otherwise trickle the data until true.
  */
 bool SendMessages(CNode* pto, bool fSendTrickle);
+/**
+ * Expire transactions older than -mempoolexpiry hours, then evict the lowest
+ * scoring packages until the pool fits -maxmempool. SwiftTX transactions,
+ * locked or waiting for their lock, are never dropped.
+ */
+void LimitMempoolSize(CTxMemPool& pool, size_t limit, int64_t age);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the block precheck thread */
+void ThreadBlockPrecheck();
+/** Run an instance of the coins prefetch thread */
+void ThreadCoinsPrefetch();
+
+/** Coins cache memory against its -dbcache share, see getmemoryinfo */
+struct CCoinsCacheUsage {
+    size_t nUsage;          // bytes held by pcoinsTip
+    size_t nPoolBytes;      // node pool chunks behind pcoinsTip, free slots included
+    size_t nLimit;          // nCoinCacheUsage
+    unsigned int nEntries;  // cached transactions
+    uint64_t nSizeFlushes;  // flushes forced by the budget since startup
+    uint64_t nUncached;     // clean entries dropped to stay within the budget
+};
+CCoinsCacheUsage GetCoinsCacheUsage();
 
 // ***TODO*** probably not the right place for these 2
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
@@ -218,6 +271,11 @@ bool IsInitialBlockDownload();
 std::string GetWarnings(std::string strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock, bool fAllowSlow = false);
+/** Entries of an address in the address index (see CBlockTreeDB::ReadAddressIndex()); false without -addressindex */
+bool GetAddressIndex(int type, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries,
+    int nStart = 0, int nEnd = 0, size_t nSkip = 0, size_t nLimit = 0);
+/** The input spending an output, from the spent index; false if unspent or without -spentindex */
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
 /** Find the best known block, and make it the tip of the block chain */
 
 bool DisconnectBlocksAndReprocess(int blocks);
@@ -413,6 +471,9 @@ public:
 bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** The serialized block as stored, for sending it on without decoding it */
+bool ReadRawBlockFromDisk(CRawBlock& raw, const CDiskBlockPos& pos);
+bool ReadRawBlockFromDisk(CRawBlock& raw, const CBlockIndex* pindex);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -432,6 +493,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig = true);
+/**
+ * The checks that need nothing but the block (merkle root, size, layout,
+ * sigops, block signature), safe to run on any thread before the block's
+ * parent is connected. Success is memoised in the block, so CheckBlock() and
+ * ProcessNewBlock() skip them later; failures are left to those to report.
+ */
+bool PrecheckBlock(const CBlock& block);
 bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev);
 
 /** Context-dependent validity checks */
@@ -525,6 +593,14 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex);
 /** The currently-connected chain of blocks. */
 extern CChain chainActive;
 
+/**
+ * The tip of chainActive as last published, readable without cs_main. Block
+ * index entries are never freed while running, and their hash, height, header
+ * fields and ancestors do not change, so a caller can read those and walk back
+ * with GetAncestor() while validation moves the tip on.
+ */
+const CBlockIndex* GetChainTipSnapshot();
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
@@ -0,0 +1,153 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "messageexecutor.h"
+
+#include "main.h"
+#include "net.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+
+#include <boost/thread.hpp>
+
+void CMessageStats::Record(const std::string& strCommand, int64_t nWaitMicros, int64_t nMicros)
+{
+    LOCK(cs);
+    CMessageCommandStats& entry = mapStats[strCommand];
+    entry.nCount++;
+    entry.nTotalWaitMicros += nWaitMicros;
+    entry.nTotalMicros += nMicros;
+    entry.nMaxMicros = std::max(entry.nMaxMicros, nMicros);
+}
+
+MessageStatsMap CMessageStats::Get() const
+{
+    LOCK(cs);
+    return mapStats;
+}
+
+CMessageExecutor::CMessageExecutor(const std::string& strNameIn, size_t nMaxQueueIn, Handler handlerIn, CCriticalSection* pcsHandlerIn, BatchPrecheck precheckIn)
+    : strName(strNameIn), nMaxQueue(nMaxQueueIn), handler(handlerIn), pcsHandler(pcsHandlerIn), precheck(precheckIn), fRunning(false)
+{
+}
+
+size_t CMessageExecutor::GetQueueSize()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return queue.size();
+}
+
+bool CMessageExecutor::IsRunning()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return fRunning;
+}
+
+bool CMessageExecutor::Post(CNode* pfrom, const std::string& strCommand, const CDataStream& vRecv)
+{
+    {
+        LOCK(cs_vNodes);
+        pfrom->AddRef();
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (queue.size() < nMaxQueue) {
+            queue.push_back(Item(pfrom, strCommand, vRecv, GetTimeMicros()));
+            condWork.notify_one();
+            return true;
+        }
+    }
+    LOCK(cs_vNodes);
+    pfrom->Release();
+    return false;
+}
+
+void CMessageExecutor::Handle(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nWaitMicros)
+{
+    // The peer may have been dropped while the message was queued
+    if (pfrom->fDisconnect)
+        return;
+
+    unsigned int nMessageSize = vRecv.size();
+    int64_t nStart = GetTimeMicros();
+    try {
+        if (pcsHandler) {
+            LOCK(*pcsHandler);
+            handler(pfrom, strCommand, vRecv);
+        } else {
+            handler(pfrom, strCommand, vRecv);
+        }
+        boost::this_thread::interruption_point();
+    } catch (std::ios_base::failure& e) {
+        pfrom->PushMessage("reject", strCommand, REJECT_MALFORMED, std::string("error parsing message"));
+        LogPrintf("%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(strCommand), nMessageSize, e.what());
+    } catch (boost::thread_interrupted) {
+        throw;
+    } catch (std::exception& e) {
+        PrintExceptionContinue(&e, std::string("CMessageExecutor::Handle() " + strCommand).c_str());
+    } catch (...) {
+        PrintExceptionContinue(NULL, std::string("CMessageExecutor::Handle() " + strCommand).c_str());
+    }
+    stats.Record(strCommand, nWaitMicros, GetTimeMicros() - nStart);
+}
+
+void CMessageExecutor::Thread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = true;
+    }
+
+    std::deque<Item> batch;
+    try {
+        while (true) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queue.empty())
+                condWork.wait(lock);
+            if (precheck) {
+                batch.swap(queue);
+            } else {
+                batch.push_back(queue.front());
+                queue.pop_front();
+            }
+            bool fWasFull = queue.size() + batch.size() >= nMaxQueue;
+            lock.unlock();
+
+            // Peers whose next message waits for room here are polled again
+            if (fWasFull)
+                WakeMessageHandler();
+
+            if (precheck) {
+                MessageBatch vBatch;
+                vBatch.reserve(batch.size());
+                BOOST_FOREACH (const Item& item, batch)
+                    vBatch.push_back(std::make_pair(item.strCommand, &item.vRecv));
+                precheck(vBatch);
+            }
+
+            while (!batch.empty()) {
+                Item& item = batch.front();
+                Handle(item.pfrom, item.strCommand, item.vRecv, GetTimeMicros() - item.nTimeQueued);
+                {
+                    LOCK(cs_vNodes);
+                    item.pfrom->Release();
+                }
+                batch.pop_front();
+            }
+        }
+    } catch (...) {
+        {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH (Item& item, batch)
+                item.pfrom->Release();
+        }
+        // Interrupted at shutdown: from now on messages are handled inline
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRunning = false;
+        lock.unlock();
+        WakeMessageHandler();
+        throw;
+    }
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MESSAGEEXECUTOR_H
+#define BITCOIN_MESSAGEEXECUTOR_H
+
+#include "streams.h"
+#include "sync.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CNode;
+
+/** Number of messages and handler latency for one command */
+struct CMessageCommandStats {
+    uint64_t nCount;
+    int64_t nTotalWaitMicros; // time spent queued, for executor commands
+    int64_t nTotalMicros;     // time spent in the handler
+    int64_t nMaxMicros;
+
+    CMessageCommandStats() : nCount(0), nTotalWaitMicros(0), nTotalMicros(0), nMaxMicros(0) {}
+};
+
+typedef std::map<std::string, CMessageCommandStats> MessageStatsMap;
+
+/** Per-command latency accounting, safe to update from several threads */
+class CMessageStats
+{
+public:
+    void Record(const std::string& strCommand, int64_t nWaitMicros, int64_t nMicros);
+    MessageStatsMap Get() const;
+
+private:
+    mutable CCriticalSection cs;
+    MessageStatsMap mapStats;
+};
+
+/**
+ * Runs the handlers of one family of P2P messages (servicenode, budget,
+ * SwiftTX, XBridge) on a thread of its own, so that a slow packet or a
+ * broadcast burst from one peer no longer holds up everybody else's block
+ * and transaction relay. Messages are handled in the order they were queued.
+ *
+ * The queue is bounded: when it is full ProcessMessages leaves the message
+ * in the sending peer's receive buffer and moves on, and the executor wakes
+ * the peer threads once it has taken messages off the queue.
+ *
+ * An executor with a batch precheck takes everything queued at once and
+ * hands it to the precheck before handling the messages one by one, so
+ * that e.g. their signatures can be verified in parallel first.
+ */
+class CMessageExecutor
+{
+public:
+    typedef void (*Handler)(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    typedef std::vector<std::pair<std::string, const CDataStream*> > MessageBatch;
+    typedef void (*BatchPrecheck)(const MessageBatch& vBatch);
+
+    /**
+     * @param[in] pcsHandler  Lock held while the handler runs, or NULL for
+     *                        handlers that are safe alongside the other
+     *                        message handlers.
+     * @param[in] precheck    Run on each batch of queued messages without
+     *                        that lock, or NULL to take them one at a time.
+     */
+    CMessageExecutor(const std::string& strNameIn, size_t nMaxQueueIn, Handler handlerIn, CCriticalSection* pcsHandlerIn, BatchPrecheck precheckIn = NULL);
+
+    const std::string& GetName() const { return strName; }
+    size_t GetMaxQueue() const { return nMaxQueue; }
+    size_t GetQueueSize();
+    bool IsRunning();
+
+    /**
+     * Queue a message unless the queue is full; never blocks. Takes a
+     * reference on pfrom until the message is handled.
+     * @return false if the queue was full and nothing was queued
+     */
+    bool Post(CNode* pfrom, const std::string& strCommand, const CDataStream& vRecv);
+
+    /** Handle a message on the calling thread, e.g. when the executor is not running. */
+    void Handle(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nWaitMicros);
+
+    /** Thread body, see StartMessageExecutors() */
+    void Thread();
+
+    const CMessageStats& GetStats() const { return stats; }
+
+private:
+    struct Item {
+        CNode* pfrom;
+        std::string strCommand;
+        CDataStream vRecv;
+        int64_t nTimeQueued;
+
+        Item(CNode* pfromIn, const std::string& strCommandIn, const CDataStream& vRecvIn, int64_t nTimeQueuedIn)
+            : pfrom(pfromIn), strCommand(strCommandIn), vRecv(vRecvIn), nTimeQueued(nTimeQueuedIn) {}
+    };
+
+    const std::string strName;
+    const size_t nMaxQueue;
+    const Handler handler;
+    CCriticalSection* const pcsHandler;
+    const BatchPrecheck precheck;
+
+    boost::mutex mutex;
+    boost::condition_variable condWork;
+    std::deque<Item> queue;
+    bool fRunning;
+
+    CMessageStats stats;
+};
+
+#endif // BITCOIN_MESSAGEEXECUTOR_H
@@ -49,8 +49,9 @@ public:
     set<uint256> setDependsOn;
     CFeeRate feeRate;
     double dPriority;
+    double dPriorityDelta;
 
-    COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
+    COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0), dPriorityDelta(0)
     {
     }
 };
@@ -60,7 +61,8 @@ uint64_t nLastBlockSize = 0;
 int64_t nLastCoinStakeSearchInterval = 0;
 
 // We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
+// (the PrioritiseTransaction() priority delta rides along, unsorted)
+typedef boost::tuple<double, CFeeRate, const CTransaction*, double> TxPriority;
 class TxPriorityCompare
 {
     bool byFee;
@@ -91,6 +93,185 @@ void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
         pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
 }
 
+/** Most transactions to look at in a row that do not fit, once the block is nearly full */
+static const int MAX_CONSECUTIVE_FAILURES = 100;
+
+CAmount AssembleBlockTransactions(CTxMemPool& pool, CCoinsViewCache& view, int nHeight, CBlockTemplate* pblocktemplate, uint64_t& nBlockSize, uint64_t& nBlockTx)
+{
+    AssertLockHeld(pool.cs);
+    CBlock* pblock = &pblocktemplate->block;
+
+    // Largest block you're willing to create:
+    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
+    // Limit to betweeen 1K and MAX_BLOCK_SIZE-1K for sanity:
+    nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SIZE - 1000), nBlockMaxSize));
+
+    // How much of the block should be dedicated to high-priority transactions,
+    // included regardless of the fees they pay
+    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
+    nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
+
+    // Minimum block size you want to create; block will be filled with free transactions
+    // until there are no more or the block reaches this size:
+    unsigned int nBlockMinSize = GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE);
+    nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
+
+    bool fPrintPriority = GetBoolArg("-printpriority", false);
+
+    // Transactions come off the mempool's priority or fee rate index, best
+    // first. One whose parents are in the pool but not yet in the block
+    // waits as a COrphan until they are, then competes from vecReady.
+    list<COrphan> vOrphan; // list memory doesn't move
+    map<uint256, vector<COrphan*> > mapDependers;
+    set<uint256> setVisited;
+    set<uint256> setInBlock;
+    vector<TxPriority> vecReady;
+
+    CAmount nFees = 0;
+    nBlockSize = 1000;
+    nBlockTx = 0;
+    int nBlockSigOps = 100;
+    int nConsecutiveFailed = 0;
+    bool fSortedByFee = (nBlockPrioritySize <= 0);
+    TxPriorityCompare comparer(fSortedByFee);
+
+    CTxMemPool::score_iterator itIndex = fSortedByFee ? pool.FeeRateBegin() : pool.PriorityBegin(nHeight);
+    while (true) {
+        // Next transaction from the index in use that has not been seen yet
+        CTxMemPool::score_iterator itEnd = fSortedByFee ? pool.FeeRateEnd() : pool.PriorityEnd();
+        while (itIndex != itEnd && setVisited.count(itIndex->second))
+            itIndex++;
+        bool fFromIndex = false;
+        TxPriority candidate;
+        if (itIndex != itEnd) {
+            const CTxMemPoolEntry& entry = pool.mapTx[itIndex->second];
+            candidate = TxPriority(entry.GetModifiedPriority(nHeight), CFeeRate(entry.GetModifiedFee(), entry.GetTxSize()), &entry.GetTx(), entry.GetPriorityDelta());
+            fFromIndex = true;
+        }
+        if (!vecReady.empty() && (!fFromIndex || comparer(candidate, vecReady.front()))) {
+            candidate = vecReady.front();
+            std::pop_heap(vecReady.begin(), vecReady.end(), comparer);
+            vecReady.pop_back();
+            fFromIndex = false;
+        } else if (fFromIndex) {
+            itIndex++;
+        } else {
+            break;
+        }
+
+        double dPriority = candidate.get<0>();
+        CFeeRate feeRate = candidate.get<1>();
+        const CTransaction& tx = *(candidate.get<2>());
+        double dPriorityDelta = candidate.get<3>();
+        const uint256& hash = tx.GetHash();
+
+        if (fFromIndex) {
+            setVisited.insert(hash);
+            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
+                continue;
+
+            // Has to wait for dependencies?
+            COrphan* porphan = NULL;
+            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+                if (setInBlock.count(txin.prevout.hash) || !pool.mapTx.count(txin.prevout.hash))
+                    continue;
+                if (!porphan) {
+                    vOrphan.push_back(COrphan(&tx));
+                    porphan = &vOrphan.back();
+                    porphan->dPriority = dPriority;
+                    porphan->feeRate = feeRate;
+                    porphan->dPriorityDelta = dPriorityDelta;
+                }
+                if (porphan->setDependsOn.insert(txin.prevout.hash).second)
+                    mapDependers[txin.prevout.hash].push_back(porphan);
+            }
+            if (porphan)
+                continue;
+        }
+
+        // Size limits
+        unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        if (nBlockSize + nTxSize >= nBlockMaxSize) {
+            if (nBlockSize > nBlockMaxSize - 2000 && ++nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES)
+                break;
+            continue;
+        }
+
+        // Legacy limits on sigOps:
+        unsigned int nTxSigOps = GetLegacySigOpCount(tx);
+        if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
+            continue;
+
+        // Skip free transactions if we're past the minimum block size, unless
+        // PrioritiseTransaction() raised their priority. The fee rate already
+        // counts its fee delta. A smaller one may still fit under the minimum
+        // size, so keep looking.
+        if (fSortedByFee && (dPriorityDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+            continue;
+
+        // Prioritise by fee once past the priority size or we run out of high-priority
+        // transactions:
+        if (!fSortedByFee &&
+            ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
+            fSortedByFee = true;
+            comparer = TxPriorityCompare(fSortedByFee);
+            std::make_heap(vecReady.begin(), vecReady.end(), comparer);
+            itIndex = pool.FeeRateBegin();
+        }
+
+        if (!view.HaveInputs(tx))
+            continue;
+
+        CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
+
+        nTxSigOps += GetP2SHSigOpCount(tx, view);
+        if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
+            continue;
+
+        // Note that flags: we don't want to set mempool/IsStandard()
+        // policy here, but we still have to ensure that the block we
+        // create only contains transactions that are valid in new blocks.
+        // The signatures were cached when the transaction entered the pool.
+        CValidationState state;
+        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+            continue;
+
+        CTxUndo txundo;
+        UpdateCoins(tx, state, view, txundo, nHeight);
+
+        // Added
+        pblock->vtx.push_back(tx);
+        pblocktemplate->vTxFees.push_back(nTxFees);
+        pblocktemplate->vTxSigOps.push_back(nTxSigOps);
+        nBlockSize += nTxSize;
+        ++nBlockTx;
+        nBlockSigOps += nTxSigOps;
+        nFees += nTxFees;
+        nConsecutiveFailed = 0;
+        setInBlock.insert(hash);
+
+        if (fPrintPriority) {
+            LogPrintf("priority %.1f fee %s txid %s\n",
+                dPriority, feeRate.ToString(), hash.ToString());
+        }
+
+        // Transactions that depend on this one can compete now
+        map<uint256, vector<COrphan*> >::iterator itDependers = mapDependers.find(hash);
+        if (itDependers != mapDependers.end()) {
+            BOOST_FOREACH (COrphan* porphan, itDependers->second) {
+                if (!porphan->setDependsOn.empty()) {
+                    porphan->setDependsOn.erase(hash);
+                    if (porphan->setDependsOn.empty()) {
+                        vecReady.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx, porphan->dPriorityDelta));
+                        std::push_heap(vecReady.begin(), vecReady.end(), comparer);
+                    }
+                }
+            }
+        }
+    }
+    return nFees;
+}
+
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake)
 {
     CReserveKey reservekey(pwallet);
@@ -143,21 +324,6 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             return NULL;
     }
 
-    // Largest block you're willing to create:
-    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
-    // Limit to betweeen 1K and MAX_BLOCK_SIZE-1K for sanity:
-    nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SIZE - 1000), nBlockMaxSize));
-
-    // How much of the block should be dedicated to high-priority transactions,
-    // included regardless of the fees they pay
-    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
-    nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
-
-    // Minimum block size you want to create; block will be filled with free transactions
-    // until there are no more or the block reaches this size:
-    unsigned int nBlockMinSize = GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE);
-    nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
-
     // Collect memory pool transactions into the block
     CAmount nFees = 0;
 
@@ -168,169 +334,9 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         const int nHeight = pindexPrev->nHeight + 1;
         CCoinsViewCache view(pcoinsTip);
 
-        // Priority order to process transactions
-        list<COrphan> vOrphan; // list memory doesn't move
-        map<uint256, vector<COrphan*> > mapDependers;
-        bool fPrintPriority = GetBoolArg("-printpriority", false);
-
-        // This vector will be sorted into a priority queue:
-        vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-             mi != mempool.mapTx.end(); ++mi) {
-            const CTransaction& tx = mi->second.GetTx();
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
-                continue;
-
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-            bool fMissingInputs = false;
-            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-                // Read prev transaction
-                if (!view.HaveCoins(txin.prevout.hash)) {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash)) {
-                        LogPrintf("ERROR: mempool transaction missing input\n");
-                        if (fDebug) assert("mempool transaction missing input" == 0);
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
-
-                    // Has to wait for dependencies
-                    if (!porphan) {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
-                    continue;
-                }
-                const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-                assert(coins);
-
-                CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-                nTotalIn += nValueIn;
-
-                int nConf = nHeight - coins->nHeight;
-
-                dPriority += (double)nValueIn * nConf;
-            }
-            if (fMissingInputs) continue;
-
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = tx.ComputePriority(dPriority, nTxSize);
-
-            uint256 hash = tx.GetHash();
-            mempool.ApplyDeltas(hash, dPriority, nTotalIn);
-
-            CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
-
-            if (porphan) {
-                porphan->dPriority = dPriority;
-                porphan->feeRate = feeRate;
-            } else
-                vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
-        }
-
-        // Collect transactions into block
-        uint64_t nBlockSize = 1000;
+        uint64_t nBlockSize = 0;
         uint64_t nBlockTx = 0;
-        int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
-
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
-
-            // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBlockSize + nTxSize >= nBlockMaxSize)
-                continue;
-
-            // Legacy limits on sigOps:
-            unsigned int nTxSigOps = GetLegacySigOpCount(tx);
-            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
-                continue;
-
-            // Skip free transactions if we're past the minimum block size:
-            const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            if (fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-                continue;
-
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
-
-            if (!view.HaveInputs(tx))
-                continue;
-
-            CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
-
-            nTxSigOps += GetP2SHSigOpCount(tx, view);
-            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
-                continue;
-
-            // Note that flags: we don't want to set mempool/IsStandard()
-            // policy here, but we still have to ensure that the block we
-            // create only contains transactions that are valid in new blocks.
-            CValidationState state;
-            if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
-                continue;
-
-            CTxUndo txundo;
-            UpdateCoins(tx, state, view, txundo, nHeight);
-
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
-
-            if (fPrintPriority) {
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                    dPriority, feeRate.ToString(), tx.GetHash().ToString());
-            }
-
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash)) {
-                BOOST_FOREACH (COrphan* porphan, mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
-                }
-            }
-        }
+        nFees = AssembleBlockTransactions(mempool, view, nHeight, pblocktemplate.get(), nBlockSize, nBlockTx);
 
         if (!fProofOfStake) {
             //Servicenode and general budget payments
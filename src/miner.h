@@ -6,13 +6,17 @@
 #ifndef BITCOIN_MINER_H
 #define BITCOIN_MINER_H
 
+#include "amount.h"
+
 #include <stdint.h>
 
 class CBlock;
 class CBlockHeader;
 class CBlockIndex;
+class CCoinsViewCache;
 class CReserveKey;
 class CScript;
+class CTxMemPool;
 class CWallet;
 
 struct CBlockTemplate;
@@ -22,6 +26,11 @@ void GenerateBitcoins(bool fGenerate, CWallet* pwallet, int nThreads);
 /** Generate a new block, without valid proof-of-work */
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake);
 CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet, bool fProofOfStake);
+/**
+ * Add pool transactions to pblocktemplate in priority and fee rate order,
+ * spending their inputs in view. Returns the fees collected.
+ */
+CAmount AssembleBlockTransactions(CTxMemPool& pool, CCoinsViewCache& view, int nHeight, CBlockTemplate* pblocktemplate, uint64_t& nBlockSize, uint64_t& nBlockTx);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 /** Check mined block */
@@ -25,6 +25,12 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define USE_EPOLL
+#endif
 #endif
 
 #ifdef USE_UPNP
@@ -113,6 +119,50 @@ boost::condition_variable messageHandlerCondition;
 static CNodeSignals g_signals;
 CNodeSignals& GetNodeSignals() { return g_signals; }
 
+#ifdef USE_EPOLL
+// epoll instance and eventfd of the socket handler, -1 until it has started
+// (or when the select() loop is used). Changed under cs_vNodes.
+static int hEpoll = -1;
+static int hWakeEvent = -1;
+
+// Nodes that queued a message behind unsent data (so no optimistic write
+// was attempted); drained by the socket handler after WakeSocketHandler().
+static CCriticalSection cs_vNodesSendWake;
+static vector<CNode*> vNodesSendWake;
+#endif
+
+static CCriticalSection cs_socketHandlerStats;
+static CSocketHandlerStats socketHandlerStats;
+
+// requires LOCK(cs_vNodes)
+static void RegisterNodeSocket(CNode* pnode)
+{
+#ifdef USE_EPOLL
+    if (hEpoll == -1 || pnode->hSocket == INVALID_SOCKET)
+        return;
+
+    // Edge-triggered and registered once for the lifetime of the socket:
+    // readiness is remembered in the socket handler until it is consumed.
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = pnode;
+    if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, pnode->hSocket, &event) == SOCKET_ERROR) {
+        LogPrintf("epoll_ctl add failed for peer=%d: %s\n", pnode->id, NetworkErrorString(WSAGetLastError()));
+        pnode->fDisconnect = true;
+    }
+#endif
+}
+
+static void UnregisterNodeSocket(CNode* pnode)
+{
+#ifdef USE_EPOLL
+    // Explicitly removed before close: a socket inherited by a child process
+    // would otherwise stay registered and report events for a deleted node.
+    if (hEpoll != -1 && pnode->hSocket != INVALID_SOCKET)
+        epoll_ctl(hEpoll, EPOLL_CTL_DEL, pnode->hSocket, NULL);
+#endif
+}
+
 void AddOneShot(string strDest)
 {
     LOCK(cs_vOneShots);
@@ -420,6 +470,7 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool obfuScationMa
         {
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
+            RegisterNodeSocket(pnode);
         }
 
         pnode->nTimeConnected = GetTime();
@@ -440,6 +491,7 @@ void CNode::CloseSocketDisconnect()
     fDisconnect = true;
     if (hSocket != INVALID_SOCKET) {
         LogPrint("net", "disconnecting peer=%d\n", id);
+        UnregisterNodeSocket(this);
         CloseSocket(hSocket);
     }
 
@@ -590,7 +642,7 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
 
         if (msg.complete()) {
             msg.nTime = GetTimeMicros();
-            messageHandlerCondition.notify_one();
+            messageHandlerCondition.notify_all();
         }
     }
 
@@ -689,65 +741,229 @@ void SocketSendData(CNode* pnode)
 
 static list<CNode*> vNodesDisconnected;
 
-void ThreadSocketHandler()
+// requires LOCK(pnode->cs_vSend)
+void WakeSocketHandler(CNode* pnode)
 {
-    unsigned int nPrevNodeCount = 0;
-    while (true) {
-        //
-        // Disconnect nodes
-        //
-        {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            vector<CNode*> vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
-                if (pnode->fDisconnect ||
-                    (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() && pnode->nSendSize == 0 && pnode->ssSend.empty())) {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
-
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
-
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+#ifdef USE_EPOLL
+    if (hWakeEvent == -1 || pnode->fSendWakePending)
+        return;
+    pnode->fSendWakePending = true;
+    {
+        LOCK(cs_vNodesSendWake);
+        vNodesSendWake.push_back(pnode);
+    }
+    uint64_t nOne = 1;
+    if (write(hWakeEvent, &nOne, sizeof(nOne)) != sizeof(nOne))
+        LogPrint("net", "socket handler wakeup failed\n");
+#endif
+}
 
-                    // hold in disconnected pool until all refs are released
-                    if (pnode->fNetworkNode || pnode->fInbound)
-                        pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
-                }
+void GetSocketHandlerStats(CSocketHandlerStats& stats)
+{
+    LOCK(cs_socketHandlerStats);
+    stats = socketHandlerStats;
+}
+
+static void RecordSocketHandlerIteration(int nReady, int64_t nMicros)
+{
+    LOCK(cs_socketHandlerStats);
+    socketHandlerStats.nIterations++;
+    socketHandlerStats.nLastReady = nReady;
+    socketHandlerStats.nTotalReady += nReady;
+    socketHandlerStats.nLastMicros = nMicros;
+    socketHandlerStats.nTotalMicros += nMicros;
+    socketHandlerStats.nMaxMicros = max(socketHandlerStats.nMaxMicros, nMicros);
+}
+
+static void DisconnectNodes(unsigned int& nPrevNodeCount)
+{
+    {
+        LOCK(cs_vNodes);
+        // Disconnect unused nodes
+        vector<CNode*> vNodesCopy = vNodes;
+        BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+            if (pnode->fDisconnect ||
+                (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() && pnode->nSendSize == 0 && pnode->ssSend.empty())) {
+                // remove from vNodes
+                vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+
+                // release outbound grant (if any)
+                pnode->grantOutbound.Release();
+
+                // close socket and cleanup
+                pnode->CloseSocketDisconnect();
+
+                // hold in disconnected pool until all refs are released
+                if (pnode->fNetworkNode || pnode->fInbound)
+                    pnode->Release();
+                vNodesDisconnected.push_back(pnode);
             }
         }
-        {
-            // Delete disconnected nodes
-            list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            BOOST_FOREACH (CNode* pnode, vNodesDisconnectedCopy) {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK(pnode->cs_vSend, lockSend);
-                        if (lockSend) {
-                            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                            if (lockRecv) {
-                                TRY_LOCK(pnode->cs_inventory, lockInv);
-                                if (lockInv)
-                                    fDelete = true;
-                            }
+    }
+    {
+        // Delete disconnected nodes
+        list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+        BOOST_FOREACH (CNode* pnode, vNodesDisconnectedCopy) {
+            // wait until threads are done using it
+            if (pnode->GetRefCount() <= 0) {
+                bool fDelete = false;
+                {
+                    TRY_LOCK(pnode->cs_vSend, lockSend);
+                    if (lockSend) {
+                        TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                        if (lockRecv) {
+                            TRY_LOCK(pnode->cs_inventory, lockInv);
+                            if (lockInv)
+                                fDelete = true;
                         }
                     }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        delete pnode;
+                }
+                if (fDelete) {
+#ifdef USE_EPOLL
+                    {
+                        LOCK(cs_vNodesSendWake);
+                        vNodesSendWake.erase(remove(vNodesSendWake.begin(), vNodesSendWake.end(), pnode), vNodesSendWake.end());
                     }
+#endif
+                    vNodesDisconnected.remove(pnode);
+                    delete pnode;
                 }
             }
         }
-        if (vNodes.size() != nPrevNodeCount) {
-            nPrevNodeCount = vNodes.size();
-            uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
+    }
+    if (vNodes.size() != nPrevNodeCount) {
+        nPrevNodeCount = vNodes.size();
+        uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
+    }
+}
+
+// epoll has no FD_SETSIZE limit
+static bool IsPollableSocket(SOCKET hSocket)
+{
+#ifdef USE_EPOLL
+    if (hEpoll != -1)
+        return true;
+#endif
+    return IsSelectableSocket(hSocket);
+}
+
+// Returns false if there was no connection to accept
+static bool AcceptConnection(const ListenSocket& hListenSocket)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
+    CAddress addr;
+    int nInbound = 0;
+
+    if (hSocket != INVALID_SOCKET)
+        if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
+            LogPrintf("Warning: Unknown socket family\n");
+
+    bool whitelisted = hListenSocket.whitelisted || CNode::IsWhitelistedRange(addr);
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes)
+            if (pnode->fInbound)
+                nInbound++;
+    }
+
+    if (hSocket == INVALID_SOCKET) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK)
+            LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
+        return false;
+    } else if (!IsPollableSocket(hSocket)) {
+        LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
+        CloseSocket(hSocket);
+    } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
+        LogPrint("net", "connection from %s dropped (full)\n", addr.ToString());
+        CloseSocket(hSocket);
+    } else if (CNode::IsBanned(addr) && !whitelisted) {
+        LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
+        CloseSocket(hSocket);
+    } else {
+        CNode* pnode = new CNode(hSocket, addr, "", true);
+        pnode->AddRef();
+        pnode->fWhitelisted = whitelisted;
+
+        {
+            LOCK(cs_vNodes);
+            vNodes.push_back(pnode);
+            RegisterNodeSocket(pnode);
+        }
+    }
+    return true;
+}
+
+// requires LOCK(cs_vRecvMsg)
+static bool WantReceive(CNode* pnode)
+{
+    return pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+           pnode->GetTotalRecvSize() <= ReceiveFloodSize();
+}
+
+// requires LOCK(cs_vRecvMsg)
+// Returns false once the socket has no more data to read (or was closed)
+static bool SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    if (nBytes > 0) {
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+            pnode->CloseSocketDisconnect();
+        pnode->nLastRecv = GetTime();
+        pnode->nRecvBytes += nBytes;
+        pnode->RecordBytesRecv(nBytes);
+        return true;
+    } else if (nBytes == 0) {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            LogPrint("net", "socket closed\n");
+        pnode->CloseSocketDisconnect();
+    } else if (nBytes < 0) {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+        } else if (nErr == WSAEINTR) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void InactivityCheck(CNode* pnode)
+{
+    int64_t nTime = GetTime();
+    if (nTime - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
         }
+    }
+}
+
+static void ThreadSocketHandlerSelect()
+{
+    unsigned int nPrevNodeCount = 0;
+    while (true) {
+        //
+        // Disconnect nodes
+        //
+        DisconnectNodes(nPrevNodeCount);
 
         //
         // Find which sockets have data to receive
@@ -804,8 +1020,7 @@ void ThreadSocketHandler()
                 }
                 {
                     TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
+                    if (lockRecv && WantReceive(pnode))
                         FD_SET(pnode->hSocket, &fdsetRecv);
                 }
             }
@@ -814,6 +1029,7 @@ void ThreadSocketHandler()
         int nSelect = select(have_fds ? hSocketMax + 1 : 0,
             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
         boost::this_thread::interruption_point();
+        int64_t nServiceStart = GetTimeMicros();
 
         if (nSelect == SOCKET_ERROR) {
             if (have_fds) {
@@ -831,49 +1047,8 @@ void ThreadSocketHandler()
         // Accept new connections
         //
         BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
-                struct sockaddr_storage sockaddr;
-                socklen_t len = sizeof(sockaddr);
-                SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
-                CAddress addr;
-                int nInbound = 0;
-
-                if (hSocket != INVALID_SOCKET)
-                    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
-                        LogPrintf("Warning: Unknown socket family\n");
-
-                bool whitelisted = hListenSocket.whitelisted || CNode::IsWhitelistedRange(addr);
-                {
-                    LOCK(cs_vNodes);
-                    BOOST_FOREACH (CNode* pnode, vNodes)
-                        if (pnode->fInbound)
-                            nInbound++;
-                }
-
-                if (hSocket == INVALID_SOCKET) {
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK)
-                        LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-                } else if (!IsSelectableSocket(hSocket)) {
-                    LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
-                    CloseSocket(hSocket);
-                } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
-                    LogPrint("net", "connection from %s dropped (full)\n", addr.ToString());
-                    CloseSocket(hSocket);
-                } else if (CNode::IsBanned(addr) && !whitelisted) {
-                    LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
-                    CloseSocket(hSocket);
-                } else {
-                    CNode* pnode = new CNode(hSocket, addr, "", true);
-                    pnode->AddRef();
-                    pnode->fWhitelisted = whitelisted;
-
-                    {
-                        LOCK(cs_vNodes);
-                        vNodes.push_back(pnode);
-                    }
-                }
-            }
+            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+                AcceptConnection(hListenSocket);
         }
 
         //
@@ -896,33 +1071,8 @@ void ThreadSocketHandler()
                 continue;
             if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                            pnode->nRecvBytes += nBytes;
-                            pnode->RecordBytesRecv(nBytes);
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint("net", "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+                if (lockRecv)
+                    SocketRecvData(pnode);
             }
 
             //
@@ -939,31 +1089,237 @@ void ThreadSocketHandler()
             //
             // Inactivity checking
             //
-            int64_t nTime = GetTime();
-            if (nTime - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-            }
+            InactivityCheck(pnode);
         }
         {
             LOCK(cs_vNodes);
             BOOST_FOREACH (CNode* pnode, vNodesCopy)
                 pnode->Release();
         }
+
+        RecordSocketHandlerIteration(max(nSelect, 0), GetTimeMicros() - nServiceStart);
+    }
+}
+
+#ifdef USE_EPOLL
+/**
+ * Socket handler built on edge-triggered epoll. Sockets are registered once,
+ * when their node is added to vNodes, and each wakeup only touches the
+ * sockets that became ready. An edge that cannot be consumed right away
+ * (lock contention, full receive buffer) is remembered in setRecvReady /
+ * setSendReady, which hold a reference on the node, and retried on the next
+ * iteration. The node list is swept for disconnects and timeouts on a timer
+ * instead of on every wakeup.
+ */
+static void ThreadSocketHandlerEpoll()
+{
+    static const int64_t DISCONNECT_SWEEP_MILLIS = 100;
+    static const int64_t INACTIVITY_SWEEP_MILLIS = 1000;
+    static const int MAX_EVENTS = 256;
+
+    unsigned int nPrevNodeCount = 0;
+    int64_t nLastDisconnectSweep = 0;
+    int64_t nLastInactivitySweep = 0;
+    set<CNode*> setRecvReady;
+    set<CNode*> setSendReady;
+    bool fProgress = false;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (true) {
+        int64_t nNow = GetTimeMillis();
+        if (nNow - nLastDisconnectSweep >= DISCONNECT_SWEEP_MILLIS) {
+            DisconnectNodes(nPrevNodeCount);
+            nLastDisconnectSweep = nNow;
+        }
+        if (nNow - nLastInactivitySweep >= INACTIVITY_SWEEP_MILLIS) {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH (CNode* pnode, vNodes)
+                InactivityCheck(pnode);
+            nLastInactivitySweep = nNow;
+        }
+
+        // Keep reading without waiting while peers have data buffered; edges that
+        // are blocked are retried at the old select() polling frequency.
+        int nTimeout = fProgress ? 0 : (setRecvReady.empty() && setSendReady.empty()) ? (int)DISCONNECT_SWEEP_MILLIS : 50;
+        fProgress = false;
+        int nEvents = epoll_wait(hEpoll, events, MAX_EVENTS, nTimeout);
+        boost::this_thread::interruption_point();
+        int64_t nServiceStart = GetTimeMicros();
+
+        if (nEvents == SOCKET_ERROR) {
+            int nErr = WSAGetLastError();
+            if (nErr != WSAEINTR) {
+                LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(nErr));
+                MilliSleep(50);
+            }
+            nEvents = 0;
+        }
+
+        vector<CNode*> vNodesReady;
+        vector<CNode*> vNodesWritable;
+        for (int i = 0; i < nEvents; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &hWakeEvent) {
+                uint64_t nCount;
+                if (read(hWakeEvent, &nCount, sizeof(nCount)) < 0)
+                    LogPrint("net", "socket handler wakeup read failed\n");
+                LOCK(cs_vNodesSendWake);
+                vNodesWritable.insert(vNodesWritable.end(), vNodesSendWake.begin(), vNodesSendWake.end());
+                vNodesSendWake.clear();
+                continue;
+            }
+
+            bool fListenEvent = false;
+            BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+                if (ptr == &hListenSocket) {
+                    // Level-triggered, one accept per wakeup like the select() loop
+                    AcceptConnection(hListenSocket);
+                    fListenEvent = true;
+                    break;
+                }
+            }
+            if (fListenEvent)
+                continue;
+
+            CNode* pnode = static_cast<CNode*>(ptr);
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                vNodesReady.push_back(pnode);
+            if (events[i].events & EPOLLOUT)
+                vNodesWritable.push_back(pnode);
+        }
+
+        if (!vNodesReady.empty() || !vNodesWritable.empty()) {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH (CNode* pnode, vNodesReady)
+                if (setRecvReady.insert(pnode).second)
+                    pnode->AddRef();
+            BOOST_FOREACH (CNode* pnode, vNodesWritable)
+                if (setSendReady.insert(pnode).second)
+                    pnode->AddRef();
+        }
+
+        vector<CNode*> vNodesDone;
+
+        //
+        // Receive
+        //
+        for (set<CNode*>::iterator it = setRecvReady.begin(); it != setRecvReady.end();) {
+            boost::this_thread::interruption_point();
+            CNode* pnode = *it;
+            bool fDone = pnode->fDisconnect || pnode->hSocket == INVALID_SOCKET;
+            if (!fDone) {
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                // Reads one buffer per node per iteration, so a fast peer cannot
+                // starve the others; the edge stays pending until recv() would block.
+                if (lockRecv && WantReceive(pnode)) {
+                    fDone = !SocketRecvData(pnode);
+                    fProgress |= !fDone;
+                }
+            }
+            if (fDone) {
+                vNodesDone.push_back(pnode);
+                setRecvReady.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+
+        //
+        // Send
+        //
+        for (set<CNode*>::iterator it = setSendReady.begin(); it != setSendReady.end();) {
+            boost::this_thread::interruption_point();
+            CNode* pnode = *it;
+            bool fDone = pnode->fDisconnect || pnode->hSocket == INVALID_SOCKET;
+            if (!fDone) {
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                if (lockSend) {
+                    // Whatever is left after this waits for the next EPOLLOUT edge
+                    pnode->fSendWakePending = false;
+                    if (!pnode->vSendMsg.empty())
+                        SocketSendData(pnode);
+                    fDone = true;
+                }
+            }
+            if (fDone) {
+                vNodesDone.push_back(pnode);
+                setSendReady.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+
+        if (!vNodesDone.empty()) {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH (CNode* pnode, vNodesDone)
+                pnode->Release();
+        }
+
+        RecordSocketHandlerIteration(nEvents, GetTimeMicros() - nServiceStart);
     }
 }
 
+static bool StartEpoll()
+{
+    int hEpollNew = epoll_create1(EPOLL_CLOEXEC);
+    if (hEpollNew == -1) {
+        LogPrintf("epoll_create1 failed: %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    int hWakeNew = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (hWakeNew == -1) {
+        LogPrintf("eventfd failed: %s\n", NetworkErrorString(WSAGetLastError()));
+        close(hEpollNew);
+        return false;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &hWakeEvent;
+    bool fOk = epoll_ctl(hEpollNew, EPOLL_CTL_ADD, hWakeNew, &event) == 0;
+    BOOST_FOREACH (ListenSocket& hListenSocket, vhListenSocket) {
+        event.events = EPOLLIN;
+        event.data.ptr = &hListenSocket;
+        fOk = fOk && epoll_ctl(hEpollNew, EPOLL_CTL_ADD, hListenSocket.socket, &event) == 0;
+    }
+    if (!fOk) {
+        LogPrintf("epoll_ctl failed: %s\n", NetworkErrorString(WSAGetLastError()));
+        close(hWakeNew);
+        close(hEpollNew);
+        return false;
+    }
+
+    // Nodes connected before the handler started are registered here, later
+    // ones where they are added to vNodes.
+    LOCK(cs_vNodes);
+    hEpoll = hEpollNew;
+    hWakeEvent = hWakeNew;
+    BOOST_FOREACH (CNode* pnode, vNodes)
+        RegisterNodeSocket(pnode);
+    return true;
+}
+#endif
+
+void ThreadSocketHandler()
+{
+#ifdef USE_EPOLL
+    if (StartEpoll()) {
+        {
+            LOCK(cs_socketHandlerStats);
+            socketHandlerStats.strBackend = "epoll";
+        }
+        LogPrintf("Using epoll for network sockets\n");
+        ThreadSocketHandlerEpoll();
+        return;
+    }
+#endif
+    {
+        LOCK(cs_socketHandlerStats);
+        socketHandlerStats.strBackend = "select";
+    }
+    ThreadSocketHandlerSelect();
+}
+
 
 #ifdef USE_UPNP
 void ThreadMapPort()
@@ -1335,7 +1691,14 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant* grantOu
 }
 
 
-void ThreadMessageHandler()
+void WakeMessageHandler()
+{
+    messageHandlerCondition.notify_all();
+}
+
+// Each message handler thread serves the peers with id % nThreads == nThread,
+// so a peer's messages are always processed in order by the same thread.
+void ThreadMessageHandler(int nThread, int nThreads)
 {
     boost::mutex condition_mutex;
     boost::unique_lock<boost::mutex> lock(condition_mutex);
@@ -1345,9 +1708,9 @@ void ThreadMessageHandler()
         vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
-                pnode->AddRef();
+            BOOST_FOREACH (CNode* pnode, vNodes) {
+                if (pnode->id % nThreads == nThread)
+                    vNodesCopy.push_back(pnode->AddRef());
             }
         }
 
@@ -1370,7 +1733,7 @@ void ThreadMessageHandler()
                         pnode->CloseSocketDisconnect();
 
                     if (pnode->nSendSize < SendBufferSize()) {
-                        if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete())) {
+                        if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete() && !pnode->fRecvExecutorFull)) {
                             fSleep = false;
                         }
                     }
@@ -1378,12 +1741,8 @@ void ThreadMessageHandler()
             }
             boost::this_thread::interruption_point();
 
-            // Send messages
-            {
-                TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    g_signals.SendMessages(pnode, pnode == pnodeTrickle || pnode->fWhitelisted);
-            }
+            // Send messages; takes cs_vSend itself, after the message processing lock
+            g_signals.SendMessages(pnode, pnode == pnodeTrickle || pnode->fWhitelisted);
             boost::this_thread::interruption_point();
         }
 
@@ -1594,7 +1953,10 @@ void StartNode(boost::thread_group& threadGroup)
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    int nMessageThreads = GetArg("-msghandlerthreads", DEFAULT_MESSAGE_HANDLER_THREADS);
+    nMessageThreads = max(1, min(nMessageThreads, MAX_MESSAGE_HANDLER_THREADS));
+    for (int i = 0; i < nMessageThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand", boost::function<void()>(boost::bind(&ThreadMessageHandler, i, nMessageThreads))));
 
     // Dump network addresses
     threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "dumpaddr", &DumpAddresses, DUMP_ADDRESSES_INTERVAL * 1000));
@@ -1644,6 +2006,17 @@ public:
         vNodes.clear();
         vNodesDisconnected.clear();
         vhListenSocket.clear();
+#ifdef USE_EPOLL
+        if (hEpoll != -1) {
+            close(hEpoll);
+            hEpoll = -1;
+        }
+        if (hWakeEvent != -1) {
+            close(hWakeEvent);
+            hWakeEvent = -1;
+        }
+        vNodesSendWake.clear();
+#endif
         delete semOutbound;
         semOutbound = NULL;
         delete pnodeLocalHost;
@@ -1886,6 +2259,7 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nLastRecv = 0;
     nSendBytes = 0;
     nRecvBytes = 0;
+    fRecvExecutorFull = false;
     nTimeConnected = GetTime();
     addr = addrIn;
     addrName = addrNameIn == "" ? addr.ToStringIPPort() : addrNameIn;
@@ -1898,6 +2272,7 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     fNetworkNode = false;
     fSuccessfullyConnected = false;
     fDisconnect = false;
+    fSendWakePending = false;
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
@@ -1932,6 +2307,7 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
 
 CNode::~CNode()
 {
+    UnregisterNodeSocket(this);
     CloseSocket(hSocket);
 
     if (pfilter)
@@ -2020,9 +2396,12 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     ssSend.GetAndClear(*it);
     nSendSize += (*it).size();
 
-    // If write queue empty, attempt "optimistic write"
+    // If write queue empty, attempt "optimistic write", otherwise make sure
+    // the socket handler knows there is more to send
     if (it == vSendMsg.begin())
         SocketSendData(this);
+    else
+        WakeSocketHandler(this);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
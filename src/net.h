@@ -28,10 +28,12 @@
 
 #include <boost/filesystem/path.hpp>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/signals2/signal.hpp>
 
 class CAddrMan;
 class CBlockIndex;
+class CBlockPrecheck;
 class CNode;
 
 namespace boost
@@ -57,6 +59,9 @@ static const bool DEFAULT_UPNP = USE_UPNP;
 #else
 static const bool DEFAULT_UPNP = false;
 #endif
+/** Default and maximum for -msghandlerthreads */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 2;
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 
@@ -77,6 +82,24 @@ bool BindListenPort(const CService& bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup);
 bool StopNode();
 void SocketSendData(CNode* pnode);
+void WakeSocketHandler(CNode* pnode);
+/** Wake the message handler threads, e.g. when a full message executor has room again */
+void WakeMessageHandler();
+
+/** Counters of the socket handler loop, reported by getnetworkinfo */
+struct CSocketHandlerStats {
+    std::string strBackend; // "epoll" or "select"
+    uint64_t nIterations;
+    int64_t nLastReady;     // sockets reported ready in the last iteration
+    uint64_t nTotalReady;
+    int64_t nLastMicros;    // time spent servicing sockets, excluding the wait
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+
+    CSocketHandlerStats() : nIterations(0), nLastReady(0), nTotalReady(0), nLastMicros(0), nTotalMicros(0), nMaxMicros(0) {}
+};
+
+void GetSocketHandlerStats(CSocketHandlerStats& stats);
 
 typedef int NodeId;
 
@@ -183,6 +206,8 @@ public:
 
     int64_t nTime; // time (in microseconds) of message receipt.
 
+    boost::shared_ptr<CBlockPrecheck> precheck; // "block" messages handed to the precheck threads early
+
     CNetMessage(int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), vRecv(nTypeIn, nVersionIn)
     {
         hdrbuf.resize(24);
@@ -227,6 +252,7 @@ public:
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
+    bool fRecvExecutorFull; // the first vRecvMsg entry waits for room in its message executor
     uint64_t nRecvBytes;
     int nRecvVersion;
 
@@ -260,6 +286,8 @@ public:
     // (even if it's relative to mixing e.g. for blinding) should NOT set this to 'true'.
     // For such cases node should be released manually (preferably right after corresponding code).
     bool fObfuScationMaster;
+    // Queued on the socket handler's wakeup list; protected by cs_vSend
+    bool fSendWakePending;
     CSemaphoreGrant grantOutbound;
     CCriticalSection cs_filter;
     CBloomFilter* pfilter;
@@ -0,0 +1,189 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "nodepool.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <boost/thread/tss.hpp>
+
+#ifdef WIN32
+#include <malloc.h>
+#endif
+
+/** Header at the start of every chunk; the nodes follow it */
+struct CNodePool::Chunk {
+    Chunk* pprev;
+    Chunk* pnext;
+    void* pfree;        // freed slots, linked through their first word
+    char* pfresh;       // start of the never used tail
+    char* pend;
+    size_t nNodeSize;
+    size_t nUsed;
+};
+
+// Room for the header, keeping the first node aligned for any type
+static const size_t CHUNK_HEADER_SIZE = 64;
+
+static void* AllocChunk()
+{
+#ifdef WIN32
+    void* p = _aligned_malloc(CNodePool::CHUNK_SIZE, CNodePool::CHUNK_SIZE);
+#else
+    void* p = NULL;
+    if (posix_memalign(&p, CNodePool::CHUNK_SIZE, CNodePool::CHUNK_SIZE) != 0)
+        p = NULL;
+#endif
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+static void FreeChunkMemory(void* p)
+{
+#ifdef WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+CNodePool::CNodePool(size_t nMaxSpareChunksIn) : nMaxSpareChunks(nMaxSpareChunksIn), nChunks(0), nNodes(0), nNodeBytes(0)
+{
+}
+
+CNodePool::~CNodePool()
+{
+    // Every container using the pool holds a reference to it, so they have
+    // all returned their nodes by now and all chunks are empty and on their
+    // size class' list.
+    for (size_t i = 0; i < sizeof(vSizeClasses) / sizeof(vSizeClasses[0]); i++) {
+        while (vSizeClasses[i].pavailable)
+            FreeChunk(vSizeClasses[i], vSizeClasses[i].pavailable);
+    }
+}
+
+boost::shared_ptr<CNodePool> CNodePool::GetThreadPool()
+{
+    // Containers keep the pool alive after their thread has exited
+    static boost::thread_specific_ptr<boost::shared_ptr<CNodePool> > ptrPool;
+    if (!ptrPool.get())
+        ptrPool.reset(new boost::shared_ptr<CNodePool>(new CNodePool()));
+    return *ptrPool;
+}
+
+size_t CNodePool::RoundSize(size_t nSize)
+{
+    // Every slot must hold the free list link, and stay 16-byte aligned
+    if (nSize < sizeof(void*))
+        nSize = sizeof(void*);
+    return (nSize + 15) & ~(size_t)15;
+}
+
+void CNodePool::Link(SizeClass& sizeClass, Chunk* pchunk)
+{
+    pchunk->pprev = NULL;
+    pchunk->pnext = sizeClass.pavailable;
+    if (sizeClass.pavailable)
+        sizeClass.pavailable->pprev = pchunk;
+    sizeClass.pavailable = pchunk;
+}
+
+void CNodePool::Unlink(SizeClass& sizeClass, Chunk* pchunk)
+{
+    if (pchunk->pprev)
+        pchunk->pprev->pnext = pchunk->pnext;
+    else
+        sizeClass.pavailable = pchunk->pnext;
+    if (pchunk->pnext)
+        pchunk->pnext->pprev = pchunk->pprev;
+    pchunk->pprev = pchunk->pnext = NULL;
+}
+
+CNodePool::Chunk* CNodePool::NewChunk(SizeClass& sizeClass, size_t nNodeSize)
+{
+    assert(sizeof(Chunk) <= CHUNK_HEADER_SIZE);
+    char* pmem = static_cast<char*>(AllocChunk());
+    Chunk* pchunk = reinterpret_cast<Chunk*>(pmem);
+    pchunk->pfree = NULL;
+    pchunk->pfresh = pmem + CHUNK_HEADER_SIZE;
+    pchunk->pend = pmem + CHUNK_SIZE;
+    pchunk->nNodeSize = nNodeSize;
+    pchunk->nUsed = 0;
+    Link(sizeClass, pchunk);
+    sizeClass.nEmpty++;
+    nChunks++;
+    return pchunk;
+}
+
+void CNodePool::FreeChunk(SizeClass& sizeClass, Chunk* pchunk)
+{
+    assert(pchunk->nUsed == 0);
+    Unlink(sizeClass, pchunk);
+    sizeClass.nEmpty--;
+    nChunks--;
+    FreeChunkMemory(pchunk);
+}
+
+void* CNodePool::Allocate(size_t nSize)
+{
+    const size_t nNodeSize = RoundSize(nSize);
+    assert(nNodeSize <= MAX_NODE_SIZE);
+    SizeClass& sizeClass = vSizeClasses[nNodeSize / 16];
+    Chunk* pchunk = sizeClass.pavailable;
+    if (!pchunk)
+        pchunk = NewChunk(sizeClass, nNodeSize);
+
+    void* p;
+    if (pchunk->pfree) {
+        p = pchunk->pfree;
+        pchunk->pfree = *static_cast<void**>(p);
+    } else {
+        p = pchunk->pfresh;
+        pchunk->pfresh += nNodeSize;
+    }
+    if (pchunk->nUsed++ == 0)
+        sizeClass.nEmpty--;
+    if (!pchunk->pfree && pchunk->pfresh + nNodeSize > pchunk->pend)
+        Unlink(sizeClass, pchunk); // full
+    nNodes++;
+    nNodeBytes += nNodeSize;
+    return p;
+}
+
+void CNodePool::Deallocate(void* p, size_t nSize)
+{
+    Chunk* pchunk = reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(CHUNK_SIZE - 1));
+    assert(pchunk->nNodeSize == RoundSize(nSize));
+    SizeClass& sizeClass = vSizeClasses[pchunk->nNodeSize / 16];
+
+    bool fWasFull = !pchunk->pfree && pchunk->pfresh + pchunk->nNodeSize > pchunk->pend;
+    *static_cast<void**>(p) = pchunk->pfree;
+    pchunk->pfree = p;
+    if (fWasFull)
+        Link(sizeClass, pchunk);
+    nNodes--;
+    nNodeBytes -= pchunk->nNodeSize;
+
+    if (--pchunk->nUsed == 0) {
+        sizeClass.nEmpty++;
+        if (sizeClass.nEmpty > nMaxSpareChunks)
+            FreeChunk(sizeClass, pchunk);
+    }
+}
+
+void CNodePool::ReleaseSpare()
+{
+    for (size_t i = 0; i < sizeof(vSizeClasses) / sizeof(vSizeClasses[0]); i++) {
+        Chunk* pchunk = vSizeClasses[i].pavailable;
+        while (pchunk && vSizeClasses[i].nEmpty > 0) {
+            Chunk* pnext = pchunk->pnext;
+            if (pchunk->nUsed == 0)
+                FreeChunk(vSizeClasses[i], pchunk);
+            pchunk = pnext;
+        }
+    }
+}
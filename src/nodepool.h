@@ -0,0 +1,171 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODEPOOL_H
+#define BITCOIN_NODEPOOL_H
+
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+
+#include <boost/shared_ptr.hpp>
+
+/**
+ * Slab storage for the nodes of node-based containers (std::map,
+ * boost::unordered_map). Nodes of one size are carved out of CHUNK_SIZE
+ * chunks aligned to their size, so freeing a node finds its chunk with a
+ * mask instead of a lookup, and a chunk whose nodes are all freed goes back
+ * to the system once more than nMaxSpareChunks of its size are empty.
+ *
+ * Not thread-safe: a pool is either the private pool of one thread
+ * (GetThreadPool()) or belongs to an owner whose lock covers every container
+ * placed in it.
+ */
+class CNodePool
+{
+public:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    /** Larger objects are not worth pooling and come from operator new */
+    static const size_t MAX_NODE_SIZE = 512;
+
+    explicit CNodePool(size_t nMaxSpareChunksIn = 1);
+    ~CNodePool();
+
+    void* Allocate(size_t nSize);
+    void Deallocate(void* p, size_t nSize);
+
+    /** Return all empty chunks to the system */
+    void ReleaseSpare();
+
+    /** Bytes held from the system, including free slots */
+    size_t GetChunkBytes() const { return nChunks * CHUNK_SIZE; }
+    /** Bytes of the slots handed out */
+    size_t GetNodeBytes() const { return nNodeBytes; }
+    /** Number of nodes handed out */
+    size_t GetNodeCount() const { return nNodes; }
+
+    /** Bytes of the slot an object of nSize takes */
+    static size_t RoundSize(size_t nSize);
+
+    /** The pool shared by the containers created on the calling thread */
+    static boost::shared_ptr<CNodePool> GetThreadPool();
+
+private:
+    struct Chunk;
+    struct SizeClass {
+        Chunk* pavailable; // chunks with free slots, doubly linked
+        size_t nEmpty;     // chunks without any nodes in use
+
+        SizeClass() : pavailable(NULL), nEmpty(0) {}
+    };
+
+    Chunk* NewChunk(SizeClass& sizeClass, size_t nNodeSize);
+    void FreeChunk(SizeClass& sizeClass, Chunk* pchunk);
+    static void Link(SizeClass& sizeClass, Chunk* pchunk);
+    static void Unlink(SizeClass& sizeClass, Chunk* pchunk);
+
+    const size_t nMaxSpareChunks;
+    SizeClass vSizeClasses[MAX_NODE_SIZE / 16 + 1]; // by slot size / 16
+    size_t nChunks;
+    size_t nNodes;
+    size_t nNodeBytes;
+
+    CNodePool(const CNodePool&);
+    CNodePool& operator=(const CNodePool&);
+};
+
+/** The nodes one container holds in a (possibly shared) CNodePool */
+struct CNodePoolShare {
+    boost::shared_ptr<CNodePool> pool;
+    size_t nNodes;
+    size_t nNodeBytes;
+
+    explicit CNodePoolShare(const boost::shared_ptr<CNodePool>& poolIn) : pool(poolIn), nNodes(0), nNodeBytes(0) {}
+};
+
+/**
+ * STL allocator placing single objects in a CNodePool; arrays (such as hash
+ * table buckets) use operator new. A default constructed allocator uses the
+ * pool of the calling thread, so the many short-lived caches on a thread
+ * reuse its chunks instead of each taking fresh ones; such a container must
+ * stay on the thread that created it. Containers shared between threads get
+ * a pool of their owner's instead. Rebound copies share the container's
+ * share, while a copied container gets a share of its own, so the nodes of
+ * each container can be told apart even when they sit in the same pool.
+ */
+template <typename T>
+class node_pool_allocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef node_pool_allocator<U> other;
+    };
+
+    node_pool_allocator() : share(new CNodePoolShare(CNodePool::GetThreadPool())) {}
+    explicit node_pool_allocator(const boost::shared_ptr<CNodePool>& pool) : share(new CNodePoolShare(pool)) {}
+    node_pool_allocator(const node_pool_allocator& a) : share(a.share) {}
+    template <typename U>
+    node_pool_allocator(const node_pool_allocator<U>& a) : share(a.share) {}
+
+    node_pool_allocator select_on_container_copy_construction() const { return node_pool_allocator(); }
+
+    T* allocate(size_t n, const void* hint = 0)
+    {
+        if (n == 1 && sizeof(T) <= CNodePool::MAX_NODE_SIZE) {
+            T* p = static_cast<T*>(share->pool->Allocate(sizeof(T)));
+            share->nNodes++;
+            share->nNodeBytes += CNodePool::RoundSize(sizeof(T));
+            return p;
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n == 1 && sizeof(T) <= CNodePool::MAX_NODE_SIZE) {
+            share->pool->Deallocate(p, sizeof(T));
+            share->nNodes--;
+            share->nNodeBytes -= CNodePool::RoundSize(sizeof(T));
+        } else
+            ::operator delete(p);
+    }
+
+    size_t max_size() const { return size_t(-1) / sizeof(T); }
+    T* address(T& x) const { return &x; }
+    const T* address(const T& x) const { return &x; }
+    void construct(T* p, const T& val) { new (static_cast<void*>(p)) T(val); }
+    void destroy(T* p) { p->~T(); }
+
+    /** The pool, which other containers may be using as well */
+    const CNodePool& GetPool() const { return *share->pool; }
+    CNodePool& GetPool() { return *share->pool; }
+    /** Bytes of the slots this container holds */
+    size_t GetNodeBytes() const { return share->nNodeBytes; }
+    /** Number of nodes this container holds */
+    size_t GetNodeCount() const { return share->nNodes; }
+
+    template <typename U>
+    friend class node_pool_allocator;
+    template <typename U>
+    bool operator==(const node_pool_allocator<U>& a) const { return share == a.share; }
+    template <typename U>
+    bool operator!=(const node_pool_allocator<U>& a) const { return share != a.share; }
+
+private:
+    boost::shared_ptr<CNodePoolShare> share;
+};
+
+#endif // BITCOIN_NODEPOOL_H
@@ -8,6 +8,7 @@
 #include "coincontrol.h"
 #include "init.h"
 #include "main.h"
+#include "servicenodedb.h"
 #include "servicenodeman.h"
 #include "script/sign.h"
 #include "swifttx.h"
@@ -29,6 +30,7 @@ using namespace boost;
 CObfuscationPool obfuScationPool;
 // A helper object for signing messages from Servicenodes
 CObfuScationSigner obfuScationSigner;
+CMessageSignatureCache messageSignatureCache;
 // The current Obfuscations in progress on the network
 std::vector<CObfuscationQueue> vecObfuscationQueue;
 // Keep track of the used Servicenodes
@@ -147,6 +149,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
             mnodeman.nDsqCount++;
             pmn->nLastDsq = mnodeman.nDsqCount;
             pmn->allowFreeTx = true;
+            pmn->fDirty = true;
 
             LogPrint("obfuscation", "dsq - new Obfuscation queue object - %s\n", addr.ToString());
             vecObfuscationQueue.push_back(dsq);
@@ -2167,8 +2170,12 @@ bool CObfuScationSigner::VerifyMessage(CPubKey pubkey, vector<unsigned char>& vc
     ss << strMessageMagic;
     ss << strMessage;
 
+    uint256 hashMessage = ss.GetHash();
+    if (messageSignatureCache.Get(hashMessage, vchSig, pubkey.GetID()))
+        return true;
+
     CPubKey pubkey2;
-    if (!pubkey2.RecoverCompact(ss.GetHash(), vchSig)) {
+    if (!pubkey2.RecoverCompact(hashMessage, vchSig)) {
         errorMessage = _("Error recovering public key.");
         return false;
     }
@@ -2176,7 +2183,88 @@ bool CObfuScationSigner::VerifyMessage(CPubKey pubkey, vector<unsigned char>& vc
     if (fDebug && pubkey2.GetID() != pubkey.GetID())
         LogPrintf("CObfuScationSigner::VerifyMessage -- keys don't match: %s %s\n", pubkey2.GetID().ToString(), pubkey.GetID().ToString());
 
-    return (pubkey2.GetID() == pubkey.GetID());
+    if (pubkey2.GetID() != pubkey.GetID())
+        return false;
+
+    messageSignatureCache.Set(hashMessage, vchSig, pubkey.GetID());
+    return true;
+}
+
+CMessageSignatureCache::CMessageSignatureCache() : salt(GetRandHash()), nMaxSize(DEFAULT_MAX_MSG_SIG_CACHE_SIZE), nHits(0), nMisses(0)
+{
+}
+
+uint256 CMessageSignatureCache::GetEntry(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CKeyID& keyID) const
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << salt << hashMessage << vchSig << keyID;
+    return ss.GetHash();
+}
+
+bool CMessageSignatureCache::Get(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CKeyID& keyID)
+{
+    uint256 entry = GetEntry(hashMessage, vchSig, keyID);
+
+    LOCK(cs);
+    if (setValid.count(entry)) {
+        nHits++;
+        return true;
+    }
+    nMisses++;
+    return false;
+}
+
+void CMessageSignatureCache::Set(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CKeyID& keyID)
+{
+    uint256 entry = GetEntry(hashMessage, vchSig, keyID);
+
+    LOCK(cs);
+    if (nMaxSize == 0 || setValid.count(entry))
+        return;
+
+    // Entries are uniformly distributed, so the one after a random hash
+    // is a random one
+    while (setValid.size() >= nMaxSize) {
+        std::set<uint256>::iterator it = setValid.lower_bound(GetRandHash());
+        if (it == setValid.end())
+            it = setValid.begin();
+        setValid.erase(it);
+    }
+    setValid.insert(entry);
+}
+
+void CMessageSignatureCache::SetMaxSize(size_t nMaxSizeIn)
+{
+    LOCK(cs);
+    nMaxSize = nMaxSizeIn;
+    while (setValid.size() > nMaxSize)
+        setValid.erase(setValid.begin());
+}
+
+void CMessageSignatureCache::Clear()
+{
+    LOCK(cs);
+    setValid.clear();
+    nHits = 0;
+    nMisses = 0;
+}
+
+size_t CMessageSignatureCache::GetSize()
+{
+    LOCK(cs);
+    return setValid.size();
+}
+
+uint64_t CMessageSignatureCache::GetHits()
+{
+    LOCK(cs);
+    return nHits;
+}
+
+uint64_t CMessageSignatureCache::GetMisses()
+{
+    LOCK(cs);
+    return nMisses;
 }
 
 bool CObfuscationQueue::Sign()
@@ -2310,7 +2398,7 @@ void ThreadCheckObfuScationPool()
                 CleanTransactionLocksList();
             }
 
-            //if(c % SERVICENODES_DUMP_SECONDS == 0) DumpServicenodes();
+            if (c % SERVICENODE_STATE_FLUSH_SECONDS == 0) FlushServicenodeState();
 
             obfuScationPool.CheckTimeout();
             obfuScationPool.CheckForCompleteQueue();
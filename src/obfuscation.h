@@ -50,8 +50,44 @@ class CActiveServicenode;
 static const int64_t OBFUSCATION_COLLATERAL = (10 * COIN);
 static const int64_t OBFUSCATION_POOL_MAX = (99999.99 * COIN);
 
+/** Default for -maxmsgsigcachesize, the number of verified message signatures remembered */
+static const unsigned int DEFAULT_MAX_MSG_SIG_CACHE_SIZE = 50000;
+
+/**
+ * Message signatures CObfuScationSigner already verified. The same
+ * servicenode, budget and SwiftTX messages reach us from many peers and
+ * again on every resync, and recovering the key of each costs far more
+ * than a lookup. Entries are salted hashes of the message hash, signature
+ * and key, so peers cannot choose which of them eviction drops.
+ */
+class CMessageSignatureCache
+{
+public:
+    CMessageSignatureCache();
+
+    bool Get(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CKeyID& keyID);
+    void Set(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CKeyID& keyID);
+    void SetMaxSize(size_t nMaxSizeIn);
+    void Clear();
+
+    size_t GetSize();
+    uint64_t GetHits();
+    uint64_t GetMisses();
+
+private:
+    uint256 GetEntry(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CKeyID& keyID) const;
+
+    CCriticalSection cs;
+    uint256 salt;
+    std::set<uint256> setValid;
+    size_t nMaxSize;
+    uint64_t nHits;
+    uint64_t nMisses;
+};
+
 extern CObfuscationPool obfuScationPool;
 extern CObfuScationSigner obfuScationSigner;
+extern CMessageSignatureCache messageSignatureCache;
 extern std::vector<CObfuscationQueue> vecObfuscationQueue;
 extern std::string strServiceNodePrivKey;
 extern map<uint256, CObfuscationBroadcastTx> mapObfuscationBroadcastTxes;
@@ -12,9 +12,91 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+namespace {
+/** Holds a header's memo spin lock; the critical sections are a few memcpys. */
+class MemoLock
+{
+public:
+    explicit MemoLock(std::atomic_flag& flagIn) : flag(flagIn)
+    {
+        while (flag.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+    ~MemoLock() { flag.clear(std::memory_order_release); }
+
+private:
+    std::atomic_flag& flag;
+};
+}
+
+CBlockHeader::CBlockHeader(const CBlockHeader& other)
+{
+    fMemoLock.clear();
+    fHashCached = false;
+    CopyFrom(other);
+}
+
+CBlockHeader& CBlockHeader::operator=(const CBlockHeader& other)
+{
+    if (this != &other)
+        CopyFrom(other);
+    return *this;
+}
+
+void CBlockHeader::CopyFrom(const CBlockHeader& other)
+{
+    nVersion = other.nVersion;
+    hashPrevBlock = other.hashPrevBlock;
+    hashMerkleRoot = other.hashMerkleRoot;
+    nTime = other.nTime;
+    nBits = other.nBits;
+    nNonce = other.nNonce;
+
+    unsigned char vchHeader[HEADER_SIZE];
+    uint256 hash;
+    bool fCached;
+    {
+        MemoLock lock(other.fMemoLock);
+        fCached = other.fHashCached;
+        if (fCached) {
+            memcpy(vchHeader, other.vchHashedHeader, HEADER_SIZE);
+            hash = other.hashCached;
+        }
+    }
+    MemoLock lock(fMemoLock);
+    fHashCached = fCached;
+    if (fCached) {
+        memcpy(vchHashedHeader, vchHeader, HEADER_SIZE);
+        hashCached = hash;
+    }
+}
+
+void CBlockHeader::InvalidateHash()
+{
+    MemoLock lock(fMemoLock);
+    fHashCached = false;
+}
+
 uint256 CBlockHeader::GetHash() const
 {
-    return HashQuark(BEGIN(nVersion), END(nNonce));
+    assert(END(nNonce) - BEGIN(nVersion) == (ptrdiff_t)HEADER_SIZE);
+    unsigned char vchHeader[HEADER_SIZE];
+    memcpy(vchHeader, BEGIN(nVersion), HEADER_SIZE);
+    {
+        MemoLock lock(fMemoLock);
+        if (fHashCached && memcmp(vchHashedHeader, vchHeader, HEADER_SIZE) == 0)
+            return hashCached;
+    }
+
+    // Hash outside the lock so concurrent callers never wait on Quark.
+    uint256 hash = HashQuark(vchHeader, vchHeader + HEADER_SIZE);
+    {
+        MemoLock lock(fMemoLock);
+        memcpy(vchHashedHeader, vchHeader, HEADER_SIZE);
+        hashCached = hash;
+        fHashCached = true;
+    }
+    return hash;
 }
 
 uint256 CBlock::BuildMerkleTree(bool* fMutated) const
@@ -11,6 +11,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <atomic>
+
 /** The maximum allowed size for a serialized block, in bytes (network rule) */
 static const unsigned int MAX_BLOCK_SIZE = 1000000;
 
@@ -35,9 +37,14 @@ public:
 
     CBlockHeader()
     {
+        fMemoLock.clear();
         SetNull();
     }
 
+    //! Copies carry the GetHash() memo, read under the source's memo lock.
+    CBlockHeader(const CBlockHeader& other);
+    CBlockHeader& operator=(const CBlockHeader& other);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -59,6 +66,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        InvalidateHash();
     }
 
     bool IsNull() const
@@ -66,12 +74,30 @@ public:
         return (nBits == 0);
     }
 
+    /** Quark hash of the header; memoised until any header field changes.
+     *  Safe to call from several threads on the same header. */
     uint256 GetHash() const;
 
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
+
+private:
+    //! Size of the hashed header fields, nVersion through nNonce
+    static const size_t HEADER_SIZE = 80;
+
+    //! GetHash() memo: the header bytes last hashed and their hash. The bytes
+    //! are compared on every call, so writes to the public fields invalidate it.
+    //! Blocks are shared between the precheck pool, rescan readers and the
+    //! filter index, so the memo is only touched while fMemoLock is held.
+    mutable std::atomic_flag fMemoLock;
+    mutable unsigned char vchHashedHeader[HEADER_SIZE];
+    mutable uint256 hashCached;
+    mutable bool fHashCached;
+
+    void InvalidateHash();
+    void CopyFrom(const CBlockHeader& other);
 };
 
 
@@ -88,6 +114,10 @@ public:
     mutable CScript payee;
     mutable std::vector<uint256> vMerkleTree;
 
+    // memory only: context-free checks passed, see CheckBlock() and PrecheckBlock()
+    mutable bool fChecked;
+    mutable bool fSignatureChecked;
+
     CBlock()
     {
         SetNull();
@@ -107,6 +137,10 @@ public:
         READWRITE(vtx);
 	if(vtx.size() > 1 && vtx[1].IsCoinStake())
 		READWRITE(vchBlockSig);
+        if (ser_action.ForRead()) {
+            fChecked = false;
+            fSignatureChecked = false;
+        }
     }
 
     void SetNull()
@@ -116,6 +150,8 @@ public:
         vMerkleTree.clear();
         payee = CScript();
         vchBlockSig.clear();
+        fChecked = false;
+        fSignatureChecked = false;
     }
 
     CBlockHeader GetBlockHeader() const
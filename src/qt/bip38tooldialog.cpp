@@ -212,10 +212,12 @@ void Bip38ToolDialog::on_importAddressButton_DEC_clicked()
     }
 
     CKeyID vchAddress = pubkey.GetID();
+    CBlockIndex* pindexGenesis;
     {
         ui->statusLabel_DEC->setStyleSheet("QLabel { color: red; }");
         ui->statusLabel_DEC->setText(tr("Please wait while key is imported"));
 
+        LOCK2(cs_main, pwalletMain->cs_wallet);
         pwalletMain->MarkDirty();
         pwalletMain->SetAddressBook(vchAddress, "", "receive");
 
@@ -236,9 +238,12 @@ void Bip38ToolDialog::on_importAddressButton_DEC_clicked()
 
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
-        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+        pindexGenesis = chainActive.Genesis();
     }
 
+    // The rescan takes cs_main and cs_wallet block by block itself
+    pwalletMain->ScanForWalletTransactions(pindexGenesis, true);
+
     ui->statusLabel_DEC->setStyleSheet("QLabel { color: green; }");
     ui->statusLabel_DEC->setText(tr("Successfully Added Private Key To Wallet"));
 }
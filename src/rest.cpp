@@ -3,14 +3,21 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfiles.h"
+#include "coins.h"
 #include "main.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "rpcserver.h"
 #include "streams.h"
 #include "sync.h"
+#include "txmempool.h"
 #include "utilstrencodings.h"
 #include "version.h"
+#include "xbridge/posixtimeconversion.h"
+#include "xbridge/util/xutil.h"
+#include "xbridge/xbridgeapp.h"
+#include "xbridge/xbridgetransactiondescr.h"
 
 #include <boost/algorithm/string.hpp>
 
@@ -42,7 +49,62 @@ public:
 };
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, Object& entry);
-extern Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, Object& out, bool fIncludeHex);
+extern Object blockHeaderToJSON(const CBlockHeader& block, const CBlockIndex* blockindex);
+extern void blockToJSON(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void GetAddressQueryEntries(const Value& param, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries, bool fPaged = true);
+extern Array AddressDeltasToJSON(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries);
+
+//! Page size of /rest/address when the request does not give one
+static const int DEFAULT_REST_ADDRESS_LIMIT = 1000;
+//! Most headers returned by one /rest/headers request
+static const long MAX_REST_HEADERS_RESULTS = 2000;
+//! Most outputs looked up by one /rest/getutxos request
+static const size_t MAX_GETUTXOS_OUTPOINTS = 100;
+
+//! An unspent output as /rest/getutxos returns it
+struct CCoin {
+    uint32_t nTxVer; // Don't call this nVersion, that name has a special meaning inside IMPLEMENT_SERIALIZE
+    uint32_t nHeight;
+    CTxOut out;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nTxVer);
+        READWRITE(nHeight);
+        READWRITE(out);
+    }
+};
+
+//! An XBridge order as the /rest/xbridge endpoints return it in binary
+struct CRestXBridgeOrder {
+    uint256 id;
+    std::string strMaker;
+    uint64_t nMakerSize;
+    std::string strTaker;
+    uint64_t nTakerSize;
+    int64_t nUpdated;
+    int64_t nCreated;
+    int32_t nState;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(id);
+        READWRITE(strMaker);
+        READWRITE(nMakerSize);
+        READWRITE(strTaker);
+        READWRITE(nTakerSize);
+        READWRITE(nUpdated);
+        READWRITE(nCreated);
+        READWRITE(nState);
+    }
+};
 
 static RestErr RESTERR(enum HTTPStatusCode status, string message)
 {
@@ -89,6 +151,17 @@ static bool ParseHashStr(const string& strReq, uint256& v)
     return true;
 }
 
+/** Reply with serialized data, as it is or hex encoded */
+static void WriteDataReply(AcceptedConnection* conn, enum RetFormat rf, const CDataStream& ssData, bool fRun)
+{
+    if (rf == RF_BINARY) {
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, ssData.size(), "application/octet-stream") << ssData.str() << std::flush;
+    } else {
+        string strHex = HexStr(ssData.begin(), ssData.end()) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
+    }
+}
+
 static bool rest_block(AcceptedConnection* conn,
     string& strReq,
     map<string, string>& /*mapHeaders*/,
@@ -103,7 +176,6 @@ static bool rest_block(AcceptedConnection* conn,
     if (!ParseHashStr(hashStr, hash))
         throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -111,30 +183,40 @@ static bool rest_block(AcceptedConnection* conn,
             throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
 
         pblockindex = mapBlockIndex[hash];
-        if (!ReadBlockFromDisk(block, pblockindex))
-            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
-        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryBlock.size(), "application/octet-stream") << binaryBlock << std::flush;
+        // Served as stored, straight from the block file
+        CRawBlock raw;
+        if (!ReadRawBlockFromDisk(raw, pblockindex))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, raw.size(), "application/octet-stream");
+        conn->stream().write(raw.begin(), raw.size());
+        conn->stream() << std::flush;
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        CRawBlock raw;
+        if (!ReadRawBlockFromDisk(raw, pblockindex))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        string strHex = HexStr(raw.begin(), raw.end()) + "\n";
         conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
         return true;
     }
 
     case RF_JSON: {
-        Object objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = write_string(Value(objBlock), false) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pblockindex))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+
+        // Written to the connection as it is produced, a transaction at a time
+        conn->BeginReply(HTTP_OK, fRun);
+        JSONStreamWriter writer(conn->stream(), 0);
+        blockToJSON(writer, block, pblockindex, showTxDetails);
+        conn->stream() << "\n";
+        conn->EndReply();
         return true;
     }
 
@@ -200,7 +282,317 @@ static bool rest_tx(AcceptedConnection* conn,
     case RF_JSON: {
         Object objTx;
         TxToJSON(tx, hashBlock, objTx);
-        string strJSON = write_string(Value(objTx), false) + "\n";
+        conn->BeginReply(HTTP_OK, fRun);
+        JSONStreamWriter(conn->stream(), 0).WriteValue(objTx);
+        conn->stream() << "\n";
+        conn->EndReply();
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+/** "/rest/address/<address>.json?start=<height>&end=<height>&skip=<n>&limit=<n>" */
+static bool rest_address(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& /*mapHeaders*/,
+    bool fRun)
+{
+    string strQuery;
+    size_t nQueryPos = strReq.find('?');
+    if (nQueryPos != string::npos) {
+        strQuery = strReq.substr(nQueryPos + 1);
+        strReq = strReq.substr(0, nQueryPos);
+    }
+
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    if (rf != RF_JSON)
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+
+    Object query;
+    Array addresses;
+    addresses.push_back(params[0]);
+    query.push_back(Pair("addresses", addresses));
+    bool fLimit = false;
+    vector<string> vArgs;
+    boost::split(vArgs, strQuery, boost::is_any_of("&"));
+    BOOST_FOREACH (const string& strArg, vArgs) {
+        size_t nEq = strArg.find('=');
+        if (nEq == string::npos)
+            continue;
+        string strName = strArg.substr(0, nEq);
+        if (strName != "start" && strName != "end" && strName != "skip" && strName != "limit")
+            throw RESTERR(HTTP_BAD_REQUEST, "Unknown parameter: " + strName);
+        query.push_back(Pair(strName, atoi(strArg.substr(nEq + 1))));
+        fLimit |= strName == "limit";
+    }
+    if (!fLimit)
+        query.push_back(Pair("limit", DEFAULT_REST_ADDRESS_LIMIT));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+    try {
+        GetAddressQueryEntries(query, vEntries);
+    } catch (const Object& objError) {
+        throw RESTERR(HTTP_BAD_REQUEST, find_value(objError, "message").get_str());
+    }
+
+    string strJSON = write_string(Value(AddressDeltasToJSON(vEntries)), false) + "\n";
+    conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+    return true;
+}
+
+/** "/rest/spent/<txid>-<n>.json" */
+static bool rest_spent(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& /*mapHeaders*/,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    if (rf != RF_JSON)
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+    if (!fSpentIndex)
+        throw RESTERR(HTTP_NOT_FOUND, "Spent index not enabled");
+
+    size_t nDash = params[0].find('-');
+    uint256 txid;
+    int32_t nOutput;
+    if (nDash == string::npos || !ParseHashStr(params[0].substr(0, nDash), txid) || !ParseInt32(params[0].substr(nDash + 1), &nOutput) || nOutput < 0)
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid output: " + params[0]);
+
+    CSpentIndexValue value;
+    if (!GetSpentIndex(CSpentIndexKey(txid, nOutput), value))
+        throw RESTERR(HTTP_NOT_FOUND, params[0] + " not spent");
+
+    Object result;
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.nInputIndex));
+    result.push_back(Pair("height", value.nHeight));
+    string strJSON = write_string(Value(result), false) + "\n";
+    conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+    return true;
+}
+
+/** "/rest/headers/<count>/<hash>": count headers of the active chain, from hash on */
+static bool rest_headers(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& /*mapHeaders*/,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    if (path.size() != 2)
+        throw RESTERR(HTTP_BAD_REQUEST, "No header count specified. Use /rest/headers/<count>/<hash>.<ext>.");
+
+    long count = strtol(path[0].c_str(), NULL, 10);
+    if (count < 1 || count > MAX_REST_HEADERS_RESULTS)
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Header count out of range: %s", path[0]));
+
+    string hashStr = path[1];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    // Headers come from the block index, serialized as they are on disk
+    vector<const CBlockIndex*> headers;
+    headers.reserve(count);
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        const CBlockIndex* pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
+        while (pindex != NULL && chainActive.Contains(pindex)) {
+            headers.push_back(pindex);
+            if (headers.size() == (unsigned long)count)
+                break;
+            pindex = chainActive.Next(pindex);
+        }
+    }
+
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+        BOOST_FOREACH (const CBlockIndex* pindex, headers)
+            ssHeader << pindex->GetBlockHeader();
+        WriteDataReply(conn, rf, ssHeader, fRun);
+        return true;
+    }
+
+    case RF_JSON: {
+        conn->BeginReply(HTTP_OK, fRun);
+        JSONStreamWriter writer(conn->stream(), 0);
+        writer.BeginArray();
+        BOOST_FOREACH (const CBlockIndex* pindex, headers) {
+            Object objHeader;
+            objHeader.push_back(Pair("hash", pindex->GetBlockHash().GetHex()));
+            objHeader.push_back(Pair("height", pindex->nHeight));
+            Object objFields = blockHeaderToJSON(pindex->GetBlockHeader(), pindex);
+            objHeader.insert(objHeader.end(), objFields.begin(), objFields.end());
+            writer.WriteValue(objHeader);
+        }
+        writer.EndArray();
+        conn->stream() << "\n";
+        conn->EndReply();
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+/** "/rest/chaininfo.json": what getblockchaininfo returns */
+static bool rest_chaininfo(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& /*mapHeaders*/,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    if (rf != RF_JSON || !params[0].empty())
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+
+    Value chainInfo;
+    {
+        LOCK(cs_main);
+        chainInfo = getblockchaininfo(Array(), false);
+    }
+    string strJSON = write_string(chainInfo, false) + "\n";
+    conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+    return true;
+}
+
+/** "/rest/getutxos[/checkmempool]/<txid>-<n>/<txid>-<n>...": which of the outputs are unspent */
+static bool rest_getutxos(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& /*mapHeaders*/,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    if (rf == RF_UNDEF)
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    // The request starts with a slash, so the first part is empty
+    size_t nFirst = 1;
+    bool fCheckMemPool = path.size() > 1 && path[1] == "checkmempool";
+    if (fCheckMemPool)
+        nFirst++;
+    if (path.size() <= nFirst || path[0] != "")
+        throw RESTERR(HTTP_BAD_REQUEST, "No outputs given. Use /rest/getutxos[/checkmempool]/<txid>-<n>/....<ext>");
+    if (path.size() - nFirst > MAX_GETUTXOS_OUTPOINTS)
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", MAX_GETUTXOS_OUTPOINTS, path.size() - nFirst));
+
+    vector<COutPoint> vOutPoints;
+    for (size_t i = nFirst; i < path.size(); i++) {
+        size_t nDash = path[i].find('-');
+        uint256 txid;
+        int32_t nOutput;
+        if (nDash == string::npos || !ParseHashStr(path[i].substr(0, nDash), txid) || !ParseInt32(path[i].substr(nDash + 1), &nOutput) || nOutput < 0)
+            throw RESTERR(HTTP_BAD_REQUEST, "Parse error: " + path[i]);
+        vOutPoints.push_back(COutPoint(txid, (uint32_t)nOutput));
+    }
+
+    vector<unsigned char> bitmap;
+    vector<CCoin> outs;
+    std::string bitmapStringRepresentation;
+    vector<bool> hits;
+    bitmap.resize((vOutPoints.size() + 7) / 8);
+    int nHeight;
+    uint256 hashTip;
+    {
+        LOCK2(cs_main, mempool.cs);
+
+        CCoinsView viewDummy;
+        CCoinsViewCache view(&viewDummy);
+
+        CCoinsViewCache& viewChain = *pcoinsTip;
+        CCoinsViewMemPool viewMempool(&viewChain, mempool);
+
+        if (fCheckMemPool)
+            view.SetBackend(viewMempool); // switch cache backend to db+mempool in case user likes to query mempool
+        else
+            view.SetBackend(viewChain);
+
+        for (size_t i = 0; i < vOutPoints.size(); i++) {
+            CCoins coins;
+            uint256 hash = vOutPoints[i].hash;
+            bool fHit = false;
+            if (view.GetCoins(hash, coins)) {
+                mempool.pruneSpent(hash, coins);
+                if (coins.IsAvailable(vOutPoints[i].n)) {
+                    fHit = true;
+                    // Safe to index into vout here because IsAvailable checked if it's off the end of the array, or if
+                    // n is valid but points to an already spent output (IsNull).
+                    CCoin coin;
+                    coin.nTxVer = coins.nVersion;
+                    coin.nHeight = coins.nHeight;
+                    coin.out = coins.vout.at(vOutPoints[i].n);
+                    assert(!coin.out.IsNull());
+                    outs.push_back(coin);
+                }
+            }
+
+            hits.push_back(fHit);
+            bitmapStringRepresentation.append(fHit ? "1" : "0"); // form a binary string representation (human-readable for json output)
+            bitmap[i / 8] |= ((uint8_t)fHit) << (i % 8);
+        }
+        nHeight = chainActive.Height();
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        // serialize data
+        // use exact same output as mentioned in Bip64
+        CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
+        ssGetUTXOResponse << nHeight << hashTip << bitmap << outs;
+        WriteDataReply(conn, rf, ssGetUTXOResponse, fRun);
+        return true;
+    }
+
+    case RF_JSON: {
+        Object objGetUTXOResponse;
+
+        // pack in some essentials
+        // use more or less the same output as mentioned in Bip64
+        objGetUTXOResponse.push_back(Pair("chainHeight", nHeight));
+        objGetUTXOResponse.push_back(Pair("chaintipHash", hashTip.GetHex()));
+        objGetUTXOResponse.push_back(Pair("bitmap", bitmapStringRepresentation));
+
+        Array utxos;
+        BOOST_FOREACH (const CCoin& coin, outs) {
+            Object utxo;
+            utxo.push_back(Pair("txvers", (int32_t)coin.nTxVer));
+            utxo.push_back(Pair("height", (int32_t)coin.nHeight));
+            utxo.push_back(Pair("value", ValueFromAmount(coin.out.nValue)));
+
+            // include the script in a json output
+            Object o;
+            ScriptPubKeyToJSON(coin.out.scriptPubKey, o, true);
+            utxo.push_back(Pair("scriptPubKey", o));
+            utxos.push_back(utxo);
+        }
+        objGetUTXOResponse.push_back(Pair("utxos", utxos));
+
+        // return json string
+        string strJSON = write_string(Value(objGetUTXOResponse), false) + "\n";
         conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
         return true;
     }
@@ -214,6 +606,111 @@ static bool rest_tx(AcceptedConnection* conn,
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Reply with XBridge orders, laid out in JSON as dxGetOrders does */
+static void WriteXBridgeOrders(AcceptedConnection* conn, enum RetFormat rf, const vector<xbridge::TransactionDescrPtr>& vOrders, bool fRun)
+{
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        vector<CRestXBridgeOrder> vEntries;
+        BOOST_FOREACH (const xbridge::TransactionDescrPtr& tr, vOrders) {
+            CRestXBridgeOrder entry;
+            entry.id = tr->id;
+            entry.strMaker = tr->fromCurrency;
+            entry.nMakerSize = tr->fromAmount;
+            entry.strTaker = tr->toCurrency;
+            entry.nTakerSize = tr->toAmount;
+            entry.nUpdated = boost::posix_time::to_time_t(tr->txtime);
+            entry.nCreated = boost::posix_time::to_time_t(tr->created);
+            entry.nState = tr->state;
+            vEntries.push_back(entry);
+        }
+        CDataStream ssOrders(SER_NETWORK, PROTOCOL_VERSION);
+        ssOrders << vEntries;
+        WriteDataReply(conn, rf, ssOrders, fRun);
+        return;
+    }
+
+    case RF_JSON: {
+        conn->BeginReply(HTTP_OK, fRun);
+        JSONStreamWriter writer(conn->stream(), 0);
+        writer.BeginArray();
+        BOOST_FOREACH (const xbridge::TransactionDescrPtr& tr, vOrders) {
+            Object jtr;
+            jtr.push_back(Pair("id", tr->id.GetHex()));
+            jtr.push_back(Pair("maker", tr->fromCurrency));
+            jtr.push_back(Pair("maker_size", util::xBridgeStringValueFromAmount(tr->fromAmount)));
+            jtr.push_back(Pair("taker", tr->toCurrency));
+            jtr.push_back(Pair("taker_size", util::xBridgeStringValueFromAmount(tr->toAmount)));
+            jtr.push_back(Pair("updated_at", util::iso8601(tr->txtime)));
+            jtr.push_back(Pair("created_at", util::iso8601(tr->created)));
+            jtr.push_back(Pair("status", tr->strState()));
+            writer.WriteValue(jtr);
+        }
+        writer.EndArray();
+        conn->stream() << "\n";
+        conn->EndReply();
+        return;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static bool XBridgeOrderNewer(const xbridge::TransactionDescrPtr& a, const xbridge::TransactionDescrPtr& b)
+{
+    return a->txtime > b->txtime;
+}
+
+/** "/rest/xbridge/orders": the open orders, as dxGetOrders lists them */
+static bool rest_xbridge_orders(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& /*mapHeaders*/,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    if (!params[0].empty())
+        throw RESTERR(HTTP_NOT_FOUND, "Use /rest/xbridge/orders.<ext>");
+
+    xbridge::App& xapp = xbridge::App::instance();
+    vector<xbridge::TransactionDescrPtr> vOrders;
+    BOOST_FOREACH (const PAIRTYPE(uint256, xbridge::TransactionDescrPtr) & item, xapp.transactions()) {
+        const xbridge::TransactionDescrPtr& tr = item.second;
+        if (xapp.connectorByCurrency(tr->fromCurrency) && xapp.connectorByCurrency(tr->toCurrency))
+            vOrders.push_back(tr);
+    }
+    WriteXBridgeOrders(conn, rf, vOrders, fRun);
+    return true;
+}
+
+/** "/rest/xbridge/history/<maker>-<taker>": the finished orders of a pair, newest first */
+static bool rest_xbridge_history(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& /*mapHeaders*/,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    size_t nDash = params[0].find('-');
+    if (nDash == string::npos || nDash == 0 || nDash + 1 == params[0].size())
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid pair: " + params[0] + ". Use /rest/xbridge/history/<maker>-<taker>.<ext>");
+    string strMaker = params[0].substr(0, nDash);
+    string strTaker = params[0].substr(nDash + 1);
+
+    vector<xbridge::TransactionDescrPtr> vOrders;
+    BOOST_FOREACH (const PAIRTYPE(uint256, xbridge::TransactionDescrPtr) & item, xbridge::App::instance().history()) {
+        const xbridge::TransactionDescrPtr& tr = item.second;
+        if (tr->state == xbridge::TransactionDescr::trFinished && tr->fromCurrency == strMaker && tr->toCurrency == strTaker)
+            vOrders.push_back(tr);
+    }
+    std::sort(vOrders.begin(), vOrders.end(), XBridgeOrderNewer);
+    WriteXBridgeOrders(conn, rf, vOrders, fRun);
+    return true;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(AcceptedConnection* conn,
@@ -224,6 +721,13 @@ static const struct {
     {"/rest/tx/", rest_tx},
     {"/rest/block/notxdetails/", rest_block_notxdetails},
     {"/rest/block/", rest_block_extended},
+    {"/rest/address/", rest_address},
+    {"/rest/spent/", rest_spent},
+    {"/rest/headers/", rest_headers},
+    {"/rest/chaininfo", rest_chaininfo},
+    {"/rest/getutxos", rest_getutxos},
+    {"/rest/xbridge/orders", rest_xbridge_orders},
+    {"/rest/xbridge/history/", rest_xbridge_history},
 };
 
 bool HTTPReq_REST(AcceptedConnection* conn,
@@ -240,10 +744,23 @@ bool HTTPReq_REST(AcceptedConnection* conn,
             unsigned int plen = strlen(uri_prefixes[i].prefix);
             if (strURI.substr(0, plen) == uri_prefixes[i].prefix) {
                 string strReq = strURI.substr(plen);
-                return uri_prefixes[i].handler(conn, strReq, mapHeaders, fRun);
+                string strName(uri_prefixes[i].prefix);
+                if (strName[strName.size() - 1] == '/')
+                    strName.erase(strName.size() - 1);
+                int64_t nStart = GetTimeMicros();
+                try {
+                    bool fOk = uri_prefixes[i].handler(conn, strReq, mapHeaders, fRun);
+                    RPCRecordCall(strName, GetTimeMicros() - nStart, !fOk);
+                    return fOk;
+                } catch (...) {
+                    RPCRecordCall(strName, GetTimeMicros() - nStart, true);
+                    throw;
+                }
             }
         }
     } catch (RestErr& re) {
+        if (!conn->CancelReply())
+            return false;
         conn->stream() << HTTPReply(re.status, re.message + "\r\n", false, false, "text/plain") << std::flush;
         return false;
     }
@@ -6,6 +6,8 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfiles.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "main.h"
 #include "rpcserver.h"
@@ -51,19 +53,41 @@ double GetDifficulty(const CBlockIndex* blockindex)
 }
 
 
-Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/**
+ * The fields of a block but its transactions: those going before them, and
+ * those going after. Needs cs_main, for the block's place in the chain.
+ */
+static void blockFieldsToJSON(const CBlock& block, const CBlockIndex* blockindex, Object& head, Object& tail)
 {
-    Object result;
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    AssertLockHeld(cs_main);
+    head.push_back(Pair("hash", block.GetHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
         confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+    head.push_back(Pair("confirmations", confirmations));
+    head.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
+    head.push_back(Pair("height", blockindex->nHeight));
+    head.push_back(Pair("version", block.nVersion));
+    head.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+
+    tail.push_back(Pair("time", block.GetBlockTime()));
+    tail.push_back(Pair("nonce", (uint64_t)block.nNonce));
+    tail.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    tail.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    tail.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+
+    if (blockindex->pprev)
+        tail.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+    CBlockIndex* pnext = chainActive.Next(blockindex);
+    if (pnext)
+        tail.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+}
+
+Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    Object result, tail;
+    blockFieldsToJSON(block, blockindex, result, tail);
     Array txs;
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
         if (txDetails) {
@@ -74,22 +98,42 @@ Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDe
             txs.push_back(tx.GetHash().GetHex());
     }
     result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
-
-    if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex* pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    result.insert(result.end(), tail.begin(), tail.end());
     return result;
 }
 
+/**
+ * Write what blockToJSON returns, without building it first. Only the
+ * fields around the transactions are taken under cs_main, which the caller
+ * must not hold, as writing waits for a slow client.
+ */
+void blockToJSON(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    Object head, tail;
+    {
+        LOCK(cs_main);
+        blockFieldsToJSON(block, blockindex, head, tail);
+    }
+    writer.BeginObject();
+    BOOST_FOREACH (const Pair& field, head)
+        writer.WritePair(field.name_, field.value_);
+    writer.Key("tx");
+    writer.BeginArray();
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        if (txDetails) {
+            Object objTx;
+            TxToJSON(tx, uint256(), objTx);
+            writer.WriteValue(objTx);
+        } else
+            writer.WriteValue(tx.GetHash().GetHex());
+    }
+    writer.EndArray();
+    BOOST_FOREACH (const Pair& field, tail)
+        writer.WritePair(field.name_, field.value_);
+    writer.EndObject();
+}
 
-Object blockHeaderToJSON(const CBlock& block, const CBlockIndex* blockindex)
+Object blockHeaderToJSON(const CBlockHeader& block, const CBlockIndex* blockindex)
 {
     Object result;
     result.push_back(Pair("version", block.nVersion));
@@ -114,7 +158,8 @@ Value getblockcount(const Array& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblockcount", "") + HelpExampleRpc("getblockcount", ""));
 
-    return chainActive.Height();
+    const CBlockIndex* pindexTip = GetChainTipSnapshot();
+    return pindexTip ? pindexTip->nHeight : -1;
 }
 
 Value getbestblockhash(const Array& params, bool fHelp)
@@ -128,7 +173,10 @@ Value getbestblockhash(const Array& params, bool fHelp)
             "\nExamples\n" +
             HelpExampleCli("getbestblockhash", "") + HelpExampleRpc("getbestblockhash", ""));
 
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    const CBlockIndex* pindexTip = GetChainTipSnapshot();
+    if (!pindexTip)
+        throw JSONRPCError(RPC_IN_WARMUP, "No blocks loaded yet");
+    return pindexTip->GetBlockHash().GetHex();
 }
 
 Value getdifficulty(const Array& params, bool fHelp)
@@ -142,9 +190,29 @@ Value getdifficulty(const Array& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getdifficulty", "") + HelpExampleRpc("getdifficulty", ""));
 
-    return GetDifficulty();
+    return GetDifficulty(GetChainTipSnapshot());
 }
 
+/** The verbose getrawmempool entry of a transaction; needs mempool.cs */
+static Object MempoolEntryToJSON(const CTxMemPoolEntry& e)
+{
+    Object info;
+    info.push_back(Pair("size", (int)e.GetTxSize()));
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
+    info.push_back(Pair("time", e.GetTime()));
+    info.push_back(Pair("height", (int)e.GetHeight()));
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
+    info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+    Array depends(setDepends.begin(), setDepends.end());
+    info.push_back(Pair("depends", depends));
+    return info;
+}
 
 Value getrawmempool(const Array& params, bool fHelp)
 {
@@ -181,28 +249,10 @@ Value getrawmempool(const Array& params, bool fHelp)
         fVerbose = params[0].get_bool();
 
     if (fVerbose) {
-        LOCK(mempool.cs);
+        LOCK2(cs_main, mempool.cs);
         Object o;
-        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx) {
-            const uint256& hash = entry.first;
-            const CTxMemPoolEntry& e = entry.second;
-            Object info;
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-            Array depends(setDepends.begin(), setDepends.end());
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
-        }
+        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx)
+            o.push_back(Pair(entry.first.ToString(), MempoolEntryToJSON(entry.second)));
         return o;
     } else {
         vector<uint256> vtxid;
@@ -216,6 +266,48 @@ Value getrawmempool(const Array& params, bool fHelp)
     }
 }
 
+void getrawmempool_stream(const Array& params, JSONStreamWriter& writer)
+{
+    if (params.size() > 1)
+        getrawmempool(params, true);
+
+    bool fVerbose = false;
+    if (params.size() > 0)
+        fVerbose = params[0].get_bool();
+
+    if (fVerbose) {
+        // Taken a batch at a time, and written without the locks, as writing
+        // waits for a slow client
+        writer.BeginObject();
+        uint256 hashLast;
+        bool fFirst = true;
+        while (true) {
+            std::vector<std::pair<uint256, Object> > vBatch;
+            {
+                LOCK2(cs_main, mempool.cs);
+                CTxMemPool::TxMap::const_iterator it = fFirst ? mempool.mapTx.begin() : mempool.mapTx.upper_bound(hashLast);
+                for (; it != mempool.mapTx.end() && vBatch.size() < 1000; ++it)
+                    vBatch.push_back(std::make_pair(it->first, MempoolEntryToJSON(it->second)));
+            }
+            if (vBatch.empty())
+                break;
+            for (size_t i = 0; i < vBatch.size(); i++)
+                writer.WritePair(vBatch[i].first.ToString(), vBatch[i].second);
+            hashLast = vBatch.back().first;
+            fFirst = false;
+        }
+        writer.EndObject();
+    } else {
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        writer.BeginArray();
+        BOOST_FOREACH (const uint256& hash, vtxid)
+            writer.WriteValue(hash.ToString());
+        writer.EndArray();
+    }
+}
+
 Value getblockhash(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -230,11 +322,11 @@ Value getblockhash(const Array& params, bool fHelp)
             HelpExampleCli("getblockhash", "1000") + HelpExampleRpc("getblockhash", "1000"));
 
     int nHeight = params[0].get_int();
-    if (nHeight < 0 || nHeight > chainActive.Height())
+    const CBlockIndex* pindexTip = GetChainTipSnapshot();
+    if (nHeight < 0 || !pindexTip || nHeight > pindexTip->nHeight)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight];
-    return pblockindex->GetBlockHash().GetHex();
+    return pindexTip->GetAncestor(nHeight)->GetBlockHash().GetHex();
 }
 
 Value getblock(const Array& params, bool fHelp)
@@ -278,23 +370,87 @@ Value getblock(const Array& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
+    LOCK(cs_main);
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
+    if (!fVerbose) {
+        CRawBlock raw;
+        if (!ReadRawBlockFromDisk(raw, pblockindex))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        return HexStr(raw.begin(), raw.end());
+    }
+
+    CBlock block;
     if (!ReadBlockFromDisk(block, pblockindex))
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
-    if (!fVerbose) {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+    return blockToJSON(block, pblockindex);
+}
+
+void getblock_stream(const Array& params, JSONStreamWriter& writer)
+{
+    if (params.size() < 1 || params.size() > 2 || (params.size() > 1 && !params[1].get_bool())) {
+        writer.WriteValue(getblock(params, false));
+        return;
     }
 
-    return blockToJSON(block, pblockindex);
+    uint256 hash(params[0].get_str());
+    CBlockIndex* pblockindex = NULL;
+    CBlock block;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+        pblockindex = mapBlockIndex[hash];
+        if (!ReadBlockFromDisk(block, pblockindex))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    }
+
+    blockToJSON(writer, block, pblockindex);
+}
+
+Value getblockfilter(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getblockfilter \"hash\"\n"
+            "\nReturns the basic compact filter (BIP158) of block 'hash'. Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"hash\"          (string, required) The block hash\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"xxxx\",   (string) The hex encoded filter data\n"
+            "  \"header\" : \"hash\"    (string) The filter header, committing to this filter and all those before it\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getblockfilter", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"") + HelpExampleRpc("getblockfilter", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\""));
+
+    if (!pblockfilterindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block filters are not enabled, start with -blockfilterindex");
+
+    uint256 hash(params[0].get_str());
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+    }
+
+    BlockFilter filter;
+    uint256 hashHeader;
+    if (!pblockfilterindex->LookupFilter(pblockindex, filter, &hashHeader))
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Filter not found, the index is at height %d", pblockfilterindex->GetBestHeight()));
+
+    Object result;
+    result.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    result.push_back(Pair("header", hashHeader.GetHex()));
+    return result;
 }
 
 Value getblockheader(const Array& params, bool fHelp)
@@ -328,23 +484,26 @@ Value getblockheader(const Array& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
+    // Only the lookup needs cs_main, the header is in the block index
+    CBlockIndex* pblockindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi != mapBlockIndex.end())
+            pblockindex = mi->second;
+    }
+    if (!pblockindex)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
-    if (!ReadBlockFromDisk(block, pblockindex))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
-
+    CBlockHeader header = pblockindex->GetBlockHeader();
     if (!fVerbose) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block.GetBlockHeader();
+        ssBlock << header;
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
         return strHex;
     }
 
-    return blockHeaderToJSON(block, pblockindex);
+    return blockHeaderToJSON(header, pblockindex);
 }
 
 Value gettxoutsetinfo(const Array& params, bool fHelp)
@@ -362,7 +521,10 @@ Value gettxoutsetinfo(const Array& params, bool fHelp)
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
             "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"total_amount\": x.xxx,         (numeric) The total amount\n"
+            "  \"cache_entries\": n,     (numeric) Transactions held by the coins cache before this call flushed it\n"
+            "  \"cache_usage\": n,       (numeric) Bytes held by the coins cache before this call flushed it\n"
+            "  \"cache_limit\": n        (numeric) Byte budget of the coins cache\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
@@ -370,6 +532,7 @@ Value gettxoutsetinfo(const Array& params, bool fHelp)
     Object ret;
 
     CCoinsStats stats;
+    CCoinsCacheUsage cache = GetCoinsCacheUsage();
     FlushStateToDisk();
     if (pcoinsTip->GetStats(stats)) {
         ret.push_back(Pair("height", (int64_t)stats.nHeight));
@@ -379,6 +542,9 @@ Value gettxoutsetinfo(const Array& params, bool fHelp)
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        ret.push_back(Pair("cache_entries", (int64_t)cache.nEntries));
+        ret.push_back(Pair("cache_usage", (int64_t)cache.nUsage));
+        ret.push_back(Pair("cache_limit", (int64_t)cache.nLimit));
     }
     return ret;
 }
@@ -620,6 +786,11 @@ Value getmempoolinfo(const Array& params, bool fHelp)
             "{\n"
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
+            "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee for tx to be accepted, in blocknetdx/kb\n"
+            "  \"evicted\": xxxxx             (numeric) Transactions evicted to stay below maxmempool since startup\n"
+            "  \"expired\": xxxxx             (numeric) Transactions expired after -mempoolexpiry hours since startup\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getmempoolinfo", "") + HelpExampleRpc("getmempoolinfo", ""));
@@ -627,6 +798,11 @@ Value getmempoolinfo(const Array& params, bool fHelp)
     Object ret;
     ret.push_back(Pair("size", (int64_t)mempool.size()));
     ret.push_back(Pair("bytes", (int64_t)mempool.GetTotalTxSize()));
+    ret.push_back(Pair("usage", (int64_t)mempool.DynamicMemoryUsage()));
+    ret.push_back(Pair("maxmempool", (int64_t)nMaxMempoolUsage));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(nMaxMempoolUsage).GetFeePerK())));
+    ret.push_back(Pair("evicted", (int64_t)mempool.GetEvictedCount()));
+    ret.push_back(Pair("expired", (int64_t)mempool.GetExpiredCount()));
 
     return ret;
 }
@@ -75,6 +75,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"getblockheader", 1},
         {"gettransaction", 1},
         {"getrawtransaction", 1},
+        {"getspentinfo", 0},
+        {"getaddressdeltas", 0},
+        {"getaddresstxids", 0},
+        {"getaddressbalance", 0},
         {"createrawtransaction", 0},
         {"createrawtransaction", 1},
         {"signrawtransaction", 1},
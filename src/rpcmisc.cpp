@@ -15,6 +15,7 @@
 #include "netbase.h"
 #include "rpcserver.h"
 #include "spork.h"
+#include "swifttx.h"
 #include "timedata.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
@@ -124,7 +125,9 @@ Value mnsync(const Array& params, bool fHelp)
     if (fHelp || params.size() != 1)
         throw runtime_error(
             "mnsync [status|reset]\n"
-            "Returns the sync status or resets sync.\n");
+            "Returns the sync status or resets sync.\n"
+            "The status includes how many milliseconds each sync stage took (syncMillis),\n"
+            "and how many message signatures were verified ahead of their messages, in parallel.\n");
 
     std::string strMode = params[0].get_str();
 
@@ -147,7 +150,25 @@ Value mnsync(const Array& params, bool fHelp)
         obj.push_back(Pair("countBudgetItemFin", servicenodeSync.countBudgetItemFin));
         obj.push_back(Pair("RequestedServicenodeAssets", servicenodeSync.RequestedServicenodeAssets));
         obj.push_back(Pair("RequestedServicenodeAttempt", servicenodeSync.RequestedServicenodeAttempt));
-
+        obj.push_back(Pair("signatureCacheSize", (uint64_t)messageSignatureCache.GetSize()));
+        obj.push_back(Pair("signatureCacheHits", messageSignatureCache.GetHits()));
+        obj.push_back(Pair("signatureCacheMisses", messageSignatureCache.GetMisses()));
+
+        uint64_t nBatches, nChecks;
+        int64_t nMicros;
+        GetServicenodeSigCheckStats(nBatches, nChecks, nMicros);
+        obj.push_back(Pair("signaturesVerifiedAhead", nChecks));
+        obj.push_back(Pair("signatureBatches", nBatches));
+        obj.push_back(Pair("signatureBatchMillis", nMicros / 1000));
+
+        Object times;
+        times.push_back(Pair("sporks", servicenodeSync.nAssetSyncMillis[SERVICENODE_SYNC_SPORKS]));
+        times.push_back(Pair("list", servicenodeSync.nAssetSyncMillis[SERVICENODE_SYNC_LIST]));
+        times.push_back(Pair("winners", servicenodeSync.nAssetSyncMillis[SERVICENODE_SYNC_MNW]));
+        times.push_back(Pair("budget", servicenodeSync.nAssetSyncMillis[SERVICENODE_SYNC_BUDGET]));
+        int64_t nSyncFinished = servicenodeSync.nSyncFinishedMillis;
+        times.push_back(Pair("total", (nSyncFinished ? nSyncFinished : GetTimeMillis()) - servicenodeSync.nSyncStartedMillis));
+        obj.push_back(Pair("syncMillis", times));
 
         return obj;
     }
@@ -208,6 +229,43 @@ public:
 };
 #endif
 
+Value getswifttxinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getswifttxinfo\n"
+            "\nReturns the state of the SwiftTX lock requests, votes and locks kept in memory.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"transactions\": n,       (numeric) transactions with a lock request, votes or a lock\n"
+            "  \"locks\": n,              (numeric) transactions whose votes are counted\n"
+            "  \"votes\": n,              (numeric) votes seen\n"
+            "  \"lockedinputs\": n,       (numeric) inputs held by locks\n"
+            "  \"usage\": n,              (numeric) memory used, in bytes\n"
+            "  \"maxusage\": n,           (numeric) memory budget (-maxswifttxmem), in bytes\n"
+            "  \"evicted\": n,            (numeric) transactions dropped to stay within the budget\n"
+            "  \"votesprocessed\": n,     (numeric) new votes processed\n"
+            "  \"avgvotems\": x.xxx,      (numeric) average time to process a vote, in milliseconds\n"
+            "  \"maxvotems\": x.xxx       (numeric) longest time to process a vote, in milliseconds\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getswifttxinfo", "") + HelpExampleRpc("getswifttxinfo", ""));
+
+    CTxLockStats stats = txLockManager.GetStats();
+    Object obj;
+    obj.push_back(Pair("transactions", (uint64_t)stats.nEntries));
+    obj.push_back(Pair("locks", (uint64_t)stats.nLocks));
+    obj.push_back(Pair("votes", (uint64_t)stats.nVotes));
+    obj.push_back(Pair("lockedinputs", (uint64_t)stats.nLockedInputs));
+    obj.push_back(Pair("usage", (uint64_t)stats.nUsage));
+    obj.push_back(Pair("maxusage", (uint64_t)stats.nMaxUsage));
+    obj.push_back(Pair("evicted", stats.nEvicted));
+    obj.push_back(Pair("votesprocessed", stats.nVotesProcessed));
+    obj.push_back(Pair("avgvotems", stats.nVotesProcessed ? 0.001 * stats.nTotalVoteMicros / stats.nVotesProcessed : 0.0));
+    obj.push_back(Pair("maxvotems", 0.001 * stats.nMaxVoteMicros));
+    return obj;
+}
+
 /*
     Used for updating/reading spork settings on the network
 */
@@ -464,6 +522,262 @@ Value setmocktime(const Array& params, bool fHelp)
     return Value::null;
 }
 
+Value getmemoryinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns an object containing information about memory usage.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coinscache\": {        (object) The in-memory UTXO cache\n"
+            "    \"usage\": n,          (numeric) Bytes currently held, entries and their scripts included\n"
+            "    \"poolbytes\": n,      (numeric) Bytes of node pool chunks behind the entries, free slots included\n"
+            "    \"limit\": n,          (numeric) Byte budget, from -dbcache\n"
+            "    \"entries\": n,        (numeric) Number of cached transactions\n"
+            "    \"sizeflushes\": n,    (numeric) Flushes to disk forced by the budget since startup\n"
+            "    \"uncached\": n        (numeric) Unmodified entries dropped to stay within the budget\n"
+            "  },\n"
+            "  \"mempool\": {           (object) The memory pool\n"
+            "    \"bytes\": n,          (numeric) Sum of the serialized transaction sizes\n"
+            "    \"poolbytes\": n       (numeric) Bytes of node pool chunks behind the pool's maps\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getmemoryinfo", "") + HelpExampleRpc("getmemoryinfo", ""));
+
+    CCoinsCacheUsage cache = GetCoinsCacheUsage();
+    Object coinscache;
+    coinscache.push_back(Pair("usage", (int64_t)cache.nUsage));
+    coinscache.push_back(Pair("poolbytes", (int64_t)cache.nPoolBytes));
+    coinscache.push_back(Pair("limit", (int64_t)cache.nLimit));
+    coinscache.push_back(Pair("entries", (int64_t)cache.nEntries));
+    coinscache.push_back(Pair("sizeflushes", (int64_t)cache.nSizeFlushes));
+    coinscache.push_back(Pair("uncached", (int64_t)cache.nUncached));
+
+    Object mempoolinfo;
+    mempoolinfo.push_back(Pair("bytes", (int64_t)mempool.GetTotalTxSize()));
+    mempoolinfo.push_back(Pair("poolbytes", (int64_t)mempool.GetPoolBytes()));
+
+    Object obj;
+    obj.push_back(Pair("coinscache", coinscache));
+    obj.push_back(Pair("mempool", mempoolinfo));
+    return obj;
+}
+
+/** An address query: the addresses, and the heights and page of the entries wanted */
+struct CAddressQuery {
+    std::vector<std::pair<int, uint160> > vAddresses;
+    int nStart;
+    int nEnd;
+    size_t nSkip;
+    size_t nLimit;
+
+    CAddressQuery() : nStart(0), nEnd(0), nSkip(0), nLimit(0) {}
+};
+
+static void AddQueryAddress(CAddressQuery& query, const std::string& strAddress)
+{
+    CTxDestination dest = CBitcoinAddress(strAddress).Get();
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest))
+        query.vAddresses.push_back(std::make_pair((int)ADDRESS_P2PKH, uint160(*keyID)));
+    else if (const CScriptID* scriptID = boost::get<CScriptID>(&dest))
+        query.vAddresses.push_back(std::make_pair((int)ADDRESS_P2SH, uint160(*scriptID)));
+    else
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + strAddress);
+}
+
+/** Either an address, or {"addresses": [...], "start": n, "end": n, "skip": n, "limit": n} */
+static CAddressQuery ParseAddressQuery(const Value& param)
+{
+    CAddressQuery query;
+    if (param.type() == str_type) {
+        AddQueryAddress(query, param.get_str());
+        return query;
+    }
+    if (param.type() != obj_type)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object");
+
+    const Object& obj = param.get_obj();
+    const Value& addresses = find_value(obj, "addresses");
+    if (addresses.type() != array_type)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+    BOOST_FOREACH (const Value& address, addresses.get_array())
+        AddQueryAddress(query, address.get_str());
+
+    const Value& start = find_value(obj, "start");
+    const Value& end = find_value(obj, "end");
+    const Value& skip = find_value(obj, "skip");
+    const Value& limit = find_value(obj, "limit");
+    if (start.type() == int_type)
+        query.nStart = start.get_int();
+    if (end.type() == int_type)
+        query.nEnd = end.get_int();
+    if (query.nStart < 0 || query.nEnd < 0 || (query.nEnd > 0 && query.nEnd < query.nStart))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+    if (skip.type() == int_type)
+        query.nSkip = std::max(0, skip.get_int());
+    if (limit.type() == int_type)
+        query.nLimit = std::max(0, limit.get_int());
+    return query;
+}
+
+static bool HeightLess(const std::pair<CAddressIndexKey, CAmount>& a, const std::pair<CAddressIndexKey, CAmount>& b)
+{
+    return a.first.nHeight < b.first.nHeight;
+}
+
+/**
+ * Index entries of the addresses of a query in height order, with the page
+ * asked for applied across all of them. Each address is read up to the end
+ * of the page only, so paging through a busy address stays cheap.
+ */
+void GetAddressQueryEntries(const Value& param, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries, bool fPaged = true)
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, start with -addressindex and -reindex");
+
+    CAddressQuery query = ParseAddressQuery(param);
+    size_t nRead = fPaged && query.nLimit > 0 ? query.nSkip + query.nLimit : 0;
+    for (size_t i = 0; i < query.vAddresses.size(); i++) {
+        size_t nSkip = fPaged && query.vAddresses.size() == 1 ? query.nSkip : 0;
+        if (!GetAddressIndex(query.vAddresses[i].first, query.vAddresses[i].second, vEntries, query.nStart, query.nEnd,
+                nSkip, nRead > 0 ? nRead - nSkip : 0))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+    }
+    if (query.vAddresses.size() > 1) {
+        std::stable_sort(vEntries.begin(), vEntries.end(), HeightLess);
+        if (fPaged) {
+            vEntries.erase(vEntries.begin(), vEntries.begin() + std::min(query.nSkip, vEntries.size()));
+            if (query.nLimit > 0 && vEntries.size() > query.nLimit)
+                vEntries.resize(query.nLimit);
+        }
+    }
+}
+
+static std::string IndexAddressToString(int type, const uint160& hashBytes)
+{
+    if (type == ADDRESS_P2SH)
+        return CBitcoinAddress(CScriptID(hashBytes)).ToString();
+    return CBitcoinAddress(CKeyID(hashBytes)).ToString();
+}
+
+Array AddressDeltasToJSON(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries)
+{
+    Array result;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vEntries.begin(); it != vEntries.end(); ++it) {
+        Object delta;
+        delta.push_back(Pair("satoshis", it->second));
+        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)it->first.nIndex));
+        delta.push_back(Pair("height", it->first.nHeight));
+        delta.push_back(Pair("address", IndexAddressToString(it->first.type, it->first.hashBytes)));
+        result.push_back(delta);
+    }
+    return result;
+}
+
+static const std::string strAddressQueryHelp =
+    "1. query    (string or object, required) An address, or\n"
+    "{\n"
+    "  \"addresses\": [\"address\", ...],  (array of string) The addresses\n"
+    "  \"start\": n,  (numeric, optional) The first height to include\n"
+    "  \"end\": n,    (numeric, optional) The last height to include\n"
+    "  \"skip\": n,   (numeric, optional) The number of index entries to pass over\n"
+    "  \"limit\": n   (numeric, optional) The maximum number of index entries to return\n"
+    "}\n";
+
+Value getaddressdeltas(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressdeltas query\n"
+            "\nReturns the outputs paying to and inputs spending from addresses, in height order (requires -addressindex).\n"
+            "\nArguments:\n" +
+            strAddressQueryHelp +
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"satoshis\": n,   (numeric) The amount received, or spent if negative\n"
+            "    \"txid\": \"hash\",  (string) The transaction id\n"
+            "    \"index\": n,      (numeric) The output index, or the input index if spent\n"
+            "    \"height\": n,     (numeric) The block height\n"
+            "    \"address\": \"address\"  (string) The address\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"skip\": 100, \"limit\": 100}'") +
+            HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"skip\": 100, \"limit\": 100}"));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+    GetAddressQueryEntries(params[0], vEntries);
+    return AddressDeltasToJSON(vEntries);
+}
+
+Value getaddresstxids(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddresstxids query\n"
+            "\nReturns the ids of the transactions involving addresses, in height order (requires -addressindex).\n"
+            "Paging counts index entries, as in getaddressdeltas.\n"
+            "\nArguments:\n" +
+            strAddressQueryHelp +
+            "\nResult:\n"
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'") +
+            HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}"));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+    GetAddressQueryEntries(params[0], vEntries);
+
+    Array result;
+    std::set<uint256> setSeen;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vEntries.begin(); it != vEntries.end(); ++it) {
+        if (setSeen.insert(it->first.txhash).second)
+            result.push_back(it->first.txhash.GetHex());
+    }
+    return result;
+}
+
+Value getaddressbalance(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance query\n"
+            "\nReturns the balance of addresses (requires -addressindex). Paging is ignored.\n"
+            "\nArguments:\n" +
+            strAddressQueryHelp +
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": n,   (numeric) The current balance in satoshis\n"
+            "  \"received\": n   (numeric) The total number of satoshis received, including change\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"") +
+            HelpExampleRpc("getaddressbalance", "\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\""));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+    GetAddressQueryEntries(params[0], vEntries, false);
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vEntries.begin(); it != vEntries.end(); ++it) {
+        if (it->second > 0)
+            nReceived += it->second;
+        nBalance += it->second;
+    }
+
+    Object result;
+    result.push_back(Pair("balance", nBalance));
+    result.push_back(Pair("received", nReceived));
+    return result;
+}
+
 #ifdef ENABLE_WALLET
 Value getstakingstatus(const Array & params, bool fHelp)
 {
@@ -9,6 +9,7 @@
 
 #include "clientversion.h"
 #include "main.h"
+#include "messageexecutor.h"
 #include "net.h"
 #include "netbase.h"
 #include "protocol.h"
@@ -345,6 +346,69 @@ Value getnettotals(const Array& params, bool fHelp)
     return obj;
 }
 
+static Object MessageStatsToJSON(const MessageStatsMap& mapStats)
+{
+    Object commands;
+    BOOST_FOREACH (const PAIRTYPE(std::string, CMessageCommandStats) & item, mapStats) {
+        const CMessageCommandStats& stats = item.second;
+        Object obj;
+        obj.push_back(Pair("count", stats.nCount));
+        obj.push_back(Pair("avgwaitms", stats.nCount ? 0.001 * stats.nTotalWaitMicros / stats.nCount : 0.0));
+        obj.push_back(Pair("avgms", stats.nCount ? 0.001 * stats.nTotalMicros / stats.nCount : 0.0));
+        obj.push_back(Pair("maxms", 0.001 * stats.nMaxMicros));
+        commands.push_back(Pair(item.first, obj));
+    }
+    return commands;
+}
+
+Value getmessagestats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getmessagestats\n"
+            "\nReturns per-command processing statistics of the P2P message handlers.\n"
+            "Servicenode, budget, SwiftTX and XBridge messages are handled by executors\n"
+            "with bounded queues, all other messages by the peer message threads.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"peer\": {                     (object) messages handled by the peer message threads\n"
+            "    \"threads\": n,               (numeric) number of peer message threads\n"
+            "    \"commands\": {...}           (object) per-command statistics, see below\n"
+            "  },\n"
+            "  \"name\": {                     (object) one entry per executor\n"
+            "    \"running\": true|false,      (boolean) whether the executor thread is running\n"
+            "    \"queued\": n,                (numeric) messages waiting in the queue\n"
+            "    \"maxqueued\": n,             (numeric) queue capacity\n"
+            "    \"commands\": {\n"
+            "      \"command\": {\n"
+            "        \"count\": n,             (numeric) messages handled\n"
+            "        \"avgwaitms\": x.xxx,     (numeric) average time spent queued, in milliseconds\n"
+            "        \"avgms\": x.xxx,         (numeric) average handler time, in milliseconds\n"
+            "        \"maxms\": x.xxx          (numeric) longest handler time, in milliseconds\n"
+            "      }, ...\n"
+            "    }\n"
+            "  }, ...\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getmessagestats", "") + HelpExampleRpc("getmessagestats", ""));
+
+    Object ret;
+    Object peer;
+    peer.push_back(Pair("threads", max(1, min((int)GetArg("-msghandlerthreads", DEFAULT_MESSAGE_HANDLER_THREADS), MAX_MESSAGE_HANDLER_THREADS))));
+    peer.push_back(Pair("commands", MessageStatsToJSON(GetPeerMessageStats().Get())));
+    ret.push_back(Pair("peer", peer));
+
+    BOOST_FOREACH (CMessageExecutor* pexecutor, GetMessageExecutors()) {
+        Object obj;
+        obj.push_back(Pair("running", pexecutor->IsRunning()));
+        obj.push_back(Pair("queued", (uint64_t)pexecutor->GetQueueSize()));
+        obj.push_back(Pair("maxqueued", (uint64_t)pexecutor->GetMaxQueue()));
+        obj.push_back(Pair("commands", MessageStatsToJSON(pexecutor->GetStats().Get())));
+        ret.push_back(Pair(pexecutor->GetName(), obj));
+    }
+    return ret;
+}
+
 static Array GetNetworksInfo()
 {
     Array networks;
@@ -395,7 +459,16 @@ Value getnetworkinfo(const Array& params, bool fHelp)
             "    \"score\": xxx                         (numeric) relative score\n"
             "  }\n"
             "  ,...\n"
-            "  ]\n"
+            "  ],\n"
+            "  \"sockethandler\": {                     (object) socket handler loop statistics\n"
+            "    \"backend\": \"xxx\",                  (string) epoll or select\n"
+            "    \"iterations\": xxxxx,                 (numeric) number of loop iterations\n"
+            "    \"readysockets\": xxx,                 (numeric) sockets ready in the last iteration\n"
+            "    \"avgreadysockets\": x.xxx,            (numeric) average ready sockets per iteration\n"
+            "    \"lastiterationus\": xxx,              (numeric) time servicing sockets in the last iteration, in microseconds\n"
+            "    \"avgiterationus\": x.xxx,             (numeric) average servicing time per iteration, in microseconds\n"
+            "    \"maxiterationus\": xxx                (numeric) longest servicing time of an iteration, in microseconds\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getnetworkinfo", "") + HelpExampleRpc("getnetworkinfo", ""));
@@ -422,5 +495,17 @@ Value getnetworkinfo(const Array& params, bool fHelp)
         }
     }
     obj.push_back(Pair("localaddresses", localAddresses));
+
+    CSocketHandlerStats stats;
+    GetSocketHandlerStats(stats);
+    Object handler;
+    handler.push_back(Pair("backend", stats.strBackend));
+    handler.push_back(Pair("iterations", stats.nIterations));
+    handler.push_back(Pair("readysockets", stats.nLastReady));
+    handler.push_back(Pair("avgreadysockets", stats.nIterations ? (double)stats.nTotalReady / stats.nIterations : 0.0));
+    handler.push_back(Pair("lastiterationus", stats.nLastMicros));
+    handler.push_back(Pair("avgiterationus", stats.nIterations ? (double)stats.nTotalMicros / stats.nIterations : 0.0));
+    handler.push_back(Pair("maxiterationus", stats.nMaxMicros));
+    obj.push_back(Pair("sockethandler", handler));
     return obj;
 }
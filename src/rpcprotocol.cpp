@@ -79,6 +79,8 @@ static const char* httpStatusDescription(int nStatus)
         return "Not Found";
     case HTTP_INTERNAL_SERVER_ERROR:
         return "Internal Server Error";
+    case HTTP_SERVICE_UNAVAILABLE:
+        return "Service Unavailable";
     default:
         return "";
     }
@@ -137,11 +139,32 @@ string HTTPReply(int nStatus, const string& strMsg, bool keepalive, bool headers
     }
 }
 
-bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int& proto, string& http_method, string& http_uri)
+string HTTPReplyHeaderChunked(int nStatus, bool keepalive, const char* contentType)
 {
-    string str;
-    getline(stream, str);
+    return strprintf(
+        "HTTP/1.1 %d %s\r\n"
+        "Date: %s\r\n"
+        "Connection: %s\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Content-Type: %s\r\n"
+        "Server: blocknetdx-json-rpc/%s\r\n"
+        "\r\n",
+        nStatus,
+        httpStatusDescription(nStatus),
+        rfc1123Time(),
+        keepalive ? "keep-alive" : "close",
+        contentType,
+        FormatFullVersion());
+}
 
+string HTTPChunk(const string& strData)
+{
+    return strprintf("%x\r\n", strData.size()) + strData + "\r\n";
+}
+
+/** Parse an HTTP request line, such as "POST / HTTP/1.1" */
+static bool ParseHTTPRequestLine(const string& str, int& proto, string& http_method, string& http_uri)
+{
     // HTTP request line is space-delimited
     vector<string> vWords;
     boost::split(vWords, str, boost::is_any_of(" "));
@@ -187,6 +210,35 @@ int ReadHTTPStatus(std::basic_istream<char>& stream, int& proto)
     return atoi(vWords[1].c_str());
 }
 
+/** Add a "Name: value" header line to mapHeadersRet, keyed by the lower case name */
+static void ParseHTTPHeaderLine(const string& str, map<string, string>& mapHeadersRet, int& nLen)
+{
+    string::size_type nColon = str.find(":");
+    if (nColon != string::npos) {
+        string strHeader = str.substr(0, nColon);
+        boost::trim(strHeader);
+        boost::to_lower(strHeader);
+        string strValue = str.substr(nColon + 1);
+        boost::trim(strValue);
+        mapHeadersRet[strHeader] = strValue;
+        if (strHeader == "content-length")
+            nLen = atoi(strValue.c_str());
+    }
+}
+
+/** Without a Connection header, HTTP/1.1 connections are persistent and HTTP/1.0 ones are not */
+static void SetDefaultConnectionHeader(map<string, string>& mapHeadersRet, int nProto)
+{
+    string sConHdr = mapHeadersRet["connection"];
+
+    if ((sConHdr != "close") && (sConHdr != "keep-alive")) {
+        if (nProto >= 1)
+            mapHeadersRet["connection"] = "keep-alive";
+        else
+            mapHeadersRet["connection"] = "close";
+    }
+}
+
 int ReadHTTPHeaders(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet)
 {
     int nLen = 0;
@@ -195,17 +247,7 @@ int ReadHTTPHeaders(std::basic_istream<char>& stream, map<string, string>& mapHe
         std::getline(stream, str);
         if (str.empty() || str == "\r")
             break;
-        string::size_type nColon = str.find(":");
-        if (nColon != string::npos) {
-            string strHeader = str.substr(0, nColon);
-            boost::trim(strHeader);
-            boost::to_lower(strHeader);
-            string strValue = str.substr(nColon + 1);
-            boost::trim(strValue);
-            mapHeadersRet[strHeader] = strValue;
-            if (strHeader == "content-length")
-                nLen = atoi(strValue.c_str());
-        }
+        ParseHTTPHeaderLine(str, mapHeadersRet, nLen);
     }
     return nLen;
 }
@@ -222,7 +264,27 @@ int ReadHTTPMessage(std::basic_istream<char>& stream, map<string, string>& mapHe
         return HTTP_INTERNAL_SERVER_ERROR;
 
     // Read message
-    if (nLen > 0) {
+    if (mapHeadersRet["transfer-encoding"] == "chunked") {
+        // Chunk sizes in hex, each on a line before its data; the empty chunk ends it
+        while (true) {
+            string str;
+            std::getline(stream, str);
+            char* pend = NULL;
+            uint64_t nChunk = strtoull(str.c_str(), &pend, 16);
+            if (!stream || pend == str.c_str() || nChunk > max_size - strMessageRet.size())
+                return HTTP_INTERNAL_SERVER_ERROR;
+            if (nChunk == 0)
+                break;
+            size_t nOldSize = strMessageRet.size();
+            strMessageRet.resize(nOldSize + nChunk);
+            stream.read(&strMessageRet[nOldSize], nChunk);
+            std::getline(stream, str);
+            if (!stream) // Connection lost while reading
+                return HTTP_INTERNAL_SERVER_ERROR;
+        }
+        // Skip any trailer up to the empty line
+        ReadHTTPHeaders(stream, mapHeadersRet);
+    } else if (nLen > 0) {
         vector<char> vch;
         size_t ptr = 0;
         while (ptr < (size_t)nLen) {
@@ -236,16 +298,57 @@ int ReadHTTPMessage(std::basic_istream<char>& stream, map<string, string>& mapHe
         strMessageRet = string(vch.begin(), vch.end());
     }
 
-    string sConHdr = mapHeadersRet["connection"];
+    SetDefaultConnectionHeader(mapHeadersRet, nProto);
 
-    if ((sConHdr != "close") && (sConHdr != "keep-alive")) {
-        if (nProto >= 1)
-            mapHeadersRet["connection"] = "keep-alive";
-        else
-            mapHeadersRet["connection"] = "close";
+    return HTTP_OK;
+}
+
+void HTTPRequestParser::Feed(const char* pch, size_t nSize)
+{
+    strBuffer.append(pch, nSize);
+}
+
+HTTPRequestParser::Result HTTPRequestParser::Parse(HTTPRequest& req)
+{
+    // Find the end of the request line and headers, which is an empty line
+    size_t nLineStart = 0;
+    bool fRequestLine = true;
+    int nLen = 0;
+    req = HTTPRequest();
+    while (true) {
+        size_t nLineEnd = strBuffer.find('\n', nLineStart);
+        if (nLineEnd == string::npos)
+            return strBuffer.size() > MAX_HTTP_HEADERS_SIZE ? INVALID : NEED_MORE;
+        if (nLineEnd > MAX_HTTP_HEADERS_SIZE)
+            return INVALID;
+        string str(strBuffer, nLineStart, nLineEnd - nLineStart);
+        if (!str.empty() && str[str.size() - 1] == '\r')
+            str.erase(str.size() - 1);
+        nLineStart = nLineEnd + 1;
+
+        if (fRequestLine) {
+            // Empty lines ahead of a request are skipped, as RFC 7230 asks
+            if (str.empty())
+                continue;
+            if (!ParseHTTPRequestLine(str, req.nProto, req.strMethod, req.strURI))
+                return INVALID;
+            fRequestLine = false;
+        } else if (str.empty()) {
+            break;
+        } else {
+            ParseHTTPHeaderLine(str, req.mapHeaders, nLen);
+        }
     }
 
-    return HTTP_OK;
+    if (nLen < 0 || (size_t)nLen > nMaxBodySize)
+        return INVALID;
+    if (strBuffer.size() - nLineStart < (size_t)nLen)
+        return NEED_MORE;
+
+    req.strBody.assign(strBuffer, nLineStart, nLen);
+    strBuffer.erase(0, nLineStart + nLen);
+    SetDefaultConnectionHeader(req.mapHeaders, req.nProto);
+    return COMPLETE;
 }
 
 /**
@@ -285,6 +388,69 @@ string JSONRPCReply(const Value& result, const Value& error, const Value& id)
     return write_string(Value(reply), json_spirit::none, 8) + "\n";
 }
 
+void JSONStreamWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    assert(vInObject.empty() || !vInObject.back());
+    if (!vEmpty.empty()) {
+        if (!vEmpty.back())
+            stream << ',';
+        vEmpty.back() = false;
+    }
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separate();
+    stream << '{';
+    vInObject.push_back(true);
+    vEmpty.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vInObject.empty() && vInObject.back() && !fAfterKey);
+    stream << '}';
+    vInObject.pop_back();
+    vEmpty.pop_back();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separate();
+    stream << '[';
+    vInObject.push_back(false);
+    vEmpty.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vInObject.empty() && !vInObject.back());
+    stream << ']';
+    vInObject.pop_back();
+    vEmpty.pop_back();
+}
+
+void JSONStreamWriter::Key(const string& strKey)
+{
+    assert(!vInObject.empty() && vInObject.back() && !fAfterKey);
+    if (!vEmpty.back())
+        stream << ',';
+    vEmpty.back() = false;
+    write_stream(Value(strKey), stream);
+    stream << ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::WriteValue(const Value& value)
+{
+    Separate();
+    write_stream(value, stream, json_spirit::none, nPrecision);
+}
+
 Object JSONRPCError(int code, const string& message)
 {
     Object error;
@@ -12,6 +12,7 @@
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "json/json_spirit_reader_template.h"
 #include "json/json_spirit_utils.h"
@@ -78,10 +79,87 @@ std::string HTTPPost(const std::string& strMsg, const std::map<std::string, std:
 std::string HTTPError(int nStatus, bool keepalive, bool headerOnly = false);
 std::string HTTPReplyHeader(int nStatus, bool keepalive, size_t contentLength, const char* contentType = "application/json");
 std::string HTTPReply(int nStatus, const std::string& strMsg, bool keepalive, bool headerOnly = false, const char* contentType = "application/json");
-bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int& proto, std::string& http_method, std::string& http_uri);
+/** Header of a reply whose body follows with chunked transfer encoding, as HTTPChunk()s */
+std::string HTTPReplyHeaderChunked(int nStatus, bool keepalive, const char* contentType = "application/json");
+/** One chunk of a chunked body; the empty chunk ends the body */
+std::string HTTPChunk(const std::string& strData);
 int ReadHTTPStatus(std::basic_istream<char>& stream, int& proto);
 int ReadHTTPHeaders(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet);
 int ReadHTTPMessage(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet, std::string& strMessageRet, int nProto, size_t max_size);
+//! Longest request line and headers accepted from a client
+static const size_t MAX_HTTP_HEADERS_SIZE = 64 * 1024;
+
+/** An HTTP request received by the RPC server */
+struct HTTPRequest {
+    std::string strMethod;
+    std::string strURI;
+    int nProto; //!< minor version of HTTP/1.x
+    std::map<std::string, std::string> mapHeaders; //!< by lower case name
+    std::string strBody;
+
+    HTTPRequest() : nProto(0) {}
+};
+
+/**
+ * Incremental parser for HTTP/1.x requests. Bytes are fed as they arrive
+ * from a connection and complete requests are taken off the front of the
+ * buffer, so pipelined requests are returned one after the other.
+ */
+class HTTPRequestParser
+{
+public:
+    enum Result {
+        NEED_MORE, //!< no complete request buffered yet
+        COMPLETE,  //!< a request was returned and removed from the buffer
+        INVALID,   //!< not an acceptable request; the connection should be closed
+    };
+
+    explicit HTTPRequestParser(size_t nMaxBodySizeIn) : nMaxBodySize(nMaxBodySizeIn) {}
+
+    void Feed(const char* pch, size_t nSize);
+    Result Parse(HTTPRequest& req);
+    size_t BufferedSize() const { return strBuffer.size(); }
+
+private:
+    std::string strBuffer;
+    size_t nMaxBodySize;
+};
+
+/**
+ * Writes JSON to a stream as it is produced, so a large result need not be
+ * built as one json_spirit::Value and then serialized into one string.
+ * Objects and arrays are opened and closed by the caller; the values in
+ * them are written as json_spirit values, which may be containers too.
+ */
+class JSONStreamWriter
+{
+public:
+    explicit JSONStreamWriter(std::ostream& streamIn, unsigned int nPrecisionIn = 8)
+        : stream(streamIn), nPrecision(nPrecisionIn), fAfterKey(false) {}
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** Name the next value, inside an object */
+    void Key(const std::string& strKey);
+    void WriteValue(const json_spirit::Value& value);
+    void WritePair(const std::string& strKey, const json_spirit::Value& value)
+    {
+        Key(strKey);
+        WriteValue(value);
+    }
+
+private:
+    void Separate();
+
+    std::ostream& stream;
+    unsigned int nPrecision;      //!< digits of doubles, as for write_string
+    std::vector<bool> vInObject;  //!< the open containers, innermost last
+    std::vector<bool> vEmpty;     //!< whether each open container has no member yet
+    bool fAfterKey;
+};
+
 std::string JSONRPCRequest(const std::string& strMethod, const json_spirit::Array& params, const json_spirit::Value& id);
 json_spirit::Object JSONRPCReplyObj(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
 std::string JSONRPCReply(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
@@ -545,6 +545,47 @@ Value createrawtransaction(const Array& params, bool fHelp)
     return EncodeHexTx(rawTx);
 }
 
+Value getspentinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1 || params[0].type() != obj_type)
+        throw runtime_error(
+            "getspentinfo {\"txid\": \"id\", \"index\": n}\n"
+            "\nReturns the input spending an output (requires -spentindex).\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"txid\": \"id\",  (string) The id of the transaction of the output\n"
+            "  \"index\": n     (numeric) The output index\n"
+            "}\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"id\",  (string) The id of the spending transaction\n"
+            "  \"index\": n,    (numeric) The input index in the spending transaction\n"
+            "  \"height\": n    (numeric) The height of the block of the spending transaction\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'") +
+            HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}"));
+
+    if (!fSpentIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled, start with -spentindex and -reindex");
+
+    const Object& obj = params[0].get_obj();
+    uint256 txid = ParseHashO(obj, "txid");
+    const Value& index = find_value(obj, "index");
+    if (index.type() != int_type || index.get_int() < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid index");
+
+    CSpentIndexValue value;
+    if (!GetSpentIndex(CSpentIndexKey(txid, index.get_int()), value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    Object result;
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.nInputIndex));
+    result.push_back(Pair("height", value.nHeight));
+    return result;
+}
+
 Value decoderawtransaction(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
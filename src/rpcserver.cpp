@@ -18,10 +18,15 @@
 #endif
 
 #include "json/json_spirit_writer_template.h"
+#include <deque>
+#include <sstream>
+
 #include <boost/algorithm/string.hpp>
+#include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include <boost/iostreams/concepts.hpp>
@@ -236,154 +241,186 @@ Value stop(const Array& params, bool fHelp)
  */
 static const CRPCCommand vRPCCommands[] =
     {
-        //  category              name                      actor (function)         okSafeMode threadSafe reqWallet
-        //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
+        //  category              name                      actor (function)         okSafeMode locks                reqWallet
+        //  --------------------- ------------------------  -----------------------  ---------- -------------------- ---------
         /* Overall control/query calls */
-        {"control", "getinfo", &getinfo, true, false, false}, /* uses wallet if enabled */
-        {"control", "help", &help, true, true, false},
-        {"control", "stop", &stop, true, true, false},
+        {"control", "getinfo", &getinfo, true, RPC_LOCK_MAIN_WALLET, false}, /* uses wallet if enabled */
+        {"control", "getmemoryinfo", &getmemoryinfo, true, RPC_LOCK_NONE, false},
+        {"control", "getrpcinfo", &getrpcinfo, true, RPC_LOCK_NONE, false},
+        {"control", "help", &help, true, RPC_LOCK_NONE, false},
+        {"control", "stop", &stop, true, RPC_LOCK_NONE, false},
 
         /* P2P networking */
-        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false},
-        {"network", "addnode", &addnode, true, true, false},
-        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false},
-        {"network", "getconnectioncount", &getconnectioncount, true, false, false},
-        {"network", "getnettotals", &getnettotals, true, true, false},
-        {"network", "getpeerinfo", &getpeerinfo, true, false, false},
-        {"network", "ping", &ping, true, false, false},
-        {"network", "sendserviceping", &sendserviceping, true, false, false},
+        {"network", "getnetworkinfo", &getnetworkinfo, true, RPC_LOCK_MAIN, false},
+        {"network", "addnode", &addnode, true, RPC_LOCK_NONE, false},
+        {"network", "getaddednodeinfo", &getaddednodeinfo, true, RPC_LOCK_NONE, false},
+        {"network", "getconnectioncount", &getconnectioncount, true, RPC_LOCK_NONE, false},
+        {"network", "getnettotals", &getnettotals, true, RPC_LOCK_NONE, false},
+        {"network", "getmessagestats", &getmessagestats, true, RPC_LOCK_NONE, false},
+        {"network", "getpeerinfo", &getpeerinfo, true, RPC_LOCK_MAIN, false},
+        {"network", "ping", &ping, true, RPC_LOCK_MAIN, false},
+        {"network", "sendserviceping", &sendserviceping, true, RPC_LOCK_MAIN, false},
 
         /* Block chain and UTXO */
-        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false},
-        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false},
-        {"blockchain", "getblockcount", &getblockcount, true, false, false},
-        {"blockchain", "getblock", &getblock, true, false, false},
-        {"blockchain", "getblockhash", &getblockhash, true, false, false},
-        {"blockchain", "getblockheader", &getblockheader, false, false, false},
-        {"blockchain", "getchaintips", &getchaintips, true, false, false},
-        {"blockchain", "getdifficulty", &getdifficulty, true, false, false},
-        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false},
-        {"blockchain", "getrawmempool", &getrawmempool, true, false, false},
-        {"blockchain", "gettxout", &gettxout, true, false, false},
-        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
-        {"blockchain", "verifychain", &verifychain, true, false, false},
-        {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
-        {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
+        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, RPC_LOCK_MAIN, false},
+        {"blockchain", "getbestblockhash", &getbestblockhash, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getblockcount", &getblockcount, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getblock", &getblock, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getblockhash", &getblockhash, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getblockfilter", &getblockfilter, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getblockheader", &getblockheader, false, RPC_LOCK_NONE, false},
+        {"blockchain", "getchaintips", &getchaintips, true, RPC_LOCK_MAIN, false},
+        {"blockchain", "getdifficulty", &getdifficulty, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getrawmempool", &getrawmempool, true, RPC_LOCK_NONE, false},
+        {"blockchain", "gettxout", &gettxout, true, RPC_LOCK_MAIN, false},
+        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, RPC_LOCK_MAIN, false},
+        {"blockchain", "verifychain", &verifychain, true, RPC_LOCK_MAIN, false},
+        {"blockchain", "invalidateblock", &invalidateblock, true, RPC_LOCK_NONE, false},
+        {"blockchain", "reconsiderblock", &reconsiderblock, true, RPC_LOCK_NONE, false},
+        {"blockchain", "getspentinfo", &getspentinfo, true, RPC_LOCK_NONE, false},
+
+        /* Address index */
+        {"addressindex", "getaddressdeltas", &getaddressdeltas, true, RPC_LOCK_NONE, false},
+        {"addressindex", "getaddresstxids", &getaddresstxids, true, RPC_LOCK_NONE, false},
+        {"addressindex", "getaddressbalance", &getaddressbalance, true, RPC_LOCK_NONE, false},
 
         /* Mining */
-        {"mining", "getblocktemplate", &getblocktemplate, true, false, false},
-        {"mining", "getmininginfo", &getmininginfo, true, false, false},
-        {"mining", "getnetworkhashps", &getnetworkhashps, true, false, false},
-        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false},
-        {"mining", "submitblock", &submitblock, true, true, false},
-        {"mining", "reservebalance", &reservebalance, true, true, false},
+        {"mining", "getblocktemplate", &getblocktemplate, true, RPC_LOCK_MAIN_WALLET, false},
+        {"mining", "getmininginfo", &getmininginfo, true, RPC_LOCK_MAIN_WALLET, false},
+        {"mining", "getnetworkhashps", &getnetworkhashps, true, RPC_LOCK_MAIN, false},
+        {"mining", "prioritisetransaction", &prioritisetransaction, true, RPC_LOCK_MAIN, false},
+        {"mining", "submitblock", &submitblock, true, RPC_LOCK_NONE, false},
+        {"mining", "reservebalance", &reservebalance, true, RPC_LOCK_NONE, false},
 
 #ifdef ENABLE_WALLET
         /* Coin generation */
-        {"generating", "getgenerate", &getgenerate, true, false, false},
-        {"generating", "gethashespersec", &gethashespersec, true, false, false},
-        {"generating", "setgenerate", &setgenerate, true, true, false},
+        {"generating", "getgenerate", &getgenerate, true, RPC_LOCK_MAIN_WALLET, false},
+        {"generating", "gethashespersec", &gethashespersec, true, RPC_LOCK_MAIN_WALLET, false},
+        {"generating", "setgenerate", &setgenerate, true, RPC_LOCK_NONE, false},
 #endif
 
         /* Raw transactions */
-        {"rawtransactions", "createrawtransaction", &createrawtransaction, true,  false, false},
-        {"rawtransactions", "fundrawtransaction",   &fundrawtransaction,   false, false, false },
-        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true,  false, false},
-        {"rawtransactions", "decodescript",         &decodescript,         true,  false, false},
-        {"rawtransactions", "getrawtransaction",    &getrawtransaction,    true,  false, false},
-        {"rawtransactions", "sendrawtransaction",   &sendrawtransaction,   false, false, false},
-        {"rawtransactions", "signrawtransaction",   &signrawtransaction,   false, false, false}, /* uses wallet if enabled */
+        {"rawtransactions", "createrawtransaction", &createrawtransaction, true,  RPC_LOCK_MAIN, false},
+        {"rawtransactions", "fundrawtransaction",   &fundrawtransaction,   false, RPC_LOCK_MAIN_WALLET, false },
+        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true,  RPC_LOCK_MAIN, false},
+        {"rawtransactions", "decodescript",         &decodescript,         true,  RPC_LOCK_MAIN, false},
+        {"rawtransactions", "getrawtransaction",    &getrawtransaction,    true,  RPC_LOCK_MAIN, false},
+        {"rawtransactions", "sendrawtransaction",   &sendrawtransaction,   false, RPC_LOCK_MAIN, false},
+        {"rawtransactions", "signrawtransaction",   &signrawtransaction,   false, RPC_LOCK_MAIN_WALLET, false}, /* uses wallet if enabled */
 
         /* Utility functions */
-        {"util", "createmultisig", &createmultisig, true, true, false},
-        {"util", "validateaddress", &validateaddress, true, false, false}, /* uses wallet if enabled */
-        {"util", "verifymessage", &verifymessage, true, false, false},
-        {"util", "estimatefee", &estimatefee, true, true, false},
-        {"util", "estimatepriority", &estimatepriority, true, true, false},
+        {"util", "createmultisig", &createmultisig, true, RPC_LOCK_NONE, false},
+        {"util", "validateaddress", &validateaddress, true, RPC_LOCK_MAIN_WALLET, false}, /* uses wallet if enabled */
+        {"util", "verifymessage", &verifymessage, true, RPC_LOCK_MAIN, false},
+        {"util", "estimatefee", &estimatefee, true, RPC_LOCK_NONE, false},
+        {"util", "estimatepriority", &estimatepriority, true, RPC_LOCK_NONE, false},
 
         /* Not shown in help */
-        {"hidden", "invalidateblock", &invalidateblock, true, true, false},
-        {"hidden", "reconsiderblock", &reconsiderblock, true, true, false},
-        {"hidden", "setmocktime", &setmocktime, true, false, false},
+        {"hidden", "invalidateblock", &invalidateblock, true, RPC_LOCK_NONE, false},
+        {"hidden", "reconsiderblock", &reconsiderblock, true, RPC_LOCK_NONE, false},
+        {"hidden", "setmocktime", &setmocktime, true, RPC_LOCK_MAIN, false},
 
         /* Blocknetdx features */
-        {"blocknetdx", "servicenode", &servicenode, true, true, false},
-        {"blocknetdx", "servicenodelist", &servicenodelist, true, true, false},
-        {"blocknetdx", "mnbudget", &mnbudget, true, true, false},
-        {"blocknetdx", "mnbudgetvoteraw", &mnbudgetvoteraw, true, true, false},
-        {"blocknetdx", "mnfinalbudget", &mnfinalbudget, true, true, false},
-        {"blocknetdx", "mnsync", &mnsync, true, true, false},
-        {"blocknetdx", "spork", &spork, true, true, false},
+        {"blocknetdx", "servicenode", &servicenode, true, RPC_LOCK_NONE, false},
+        {"blocknetdx", "servicenodelist", &servicenodelist, true, RPC_LOCK_NONE, false},
+        {"blocknetdx", "mnbudget", &mnbudget, true, RPC_LOCK_NONE, false},
+        {"blocknetdx", "mnbudgetvoteraw", &mnbudgetvoteraw, true, RPC_LOCK_NONE, false},
+        {"blocknetdx", "mnfinalbudget", &mnfinalbudget, true, RPC_LOCK_NONE, false},
+        {"blocknetdx", "mnsync", &mnsync, true, RPC_LOCK_NONE, false},
+        {"blocknetdx", "spork", &spork, true, RPC_LOCK_NONE, false},
+        {"blocknetdx", "getswifttxinfo", &getswifttxinfo, true, RPC_LOCK_NONE, false},
 #ifdef ENABLE_WALLET
-        {"blocknetdx", "obfuscation", &obfuscation, false, false, true}, /* not threadSafe because of SendMoney */
+        {"blocknetdx", "obfuscation", &obfuscation, false, RPC_LOCK_MAIN_WALLET, true}, /* holds the wallet because of SendMoney */
 
         /* Wallet */
-        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true},
-        {"wallet", "autocombinerewards", &autocombinerewards, false, false, true},
-        {"wallet", "backupwallet", &backupwallet, true, false, true},
-        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true},
-        {"wallet", "dumpwallet", &dumpwallet, true, false, true},
-        {"wallet", "bip38encrypt", &bip38encrypt, true, false, true},
-        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true},
-        {"wallet", "encryptwallet", &encryptwallet, true, false, true},
-        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true},
-        {"wallet", "getaccount", &getaccount, true, false, true},
-        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true},
-        {"wallet", "getbalance", &getbalance, false, false, true},
-        {"wallet", "getnewaddress", &getnewaddress, true, false, true},
-        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true},
-        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true},
-        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true},
-        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true},
-        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, false, true},
-        {"wallet", "gettransaction", &gettransaction, false, false, true},
-        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true},
-        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true},
-        {"wallet", "importprivkey", &importprivkey, true, false, true},
-        {"wallet", "importwallet", &importwallet, true, false, true},
-        {"wallet", "importaddress", &importaddress, true, false, true},
-        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true},
-        {"wallet", "listaccounts", &listaccounts, false, false, true},
-        {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true},
-        {"wallet", "listlockunspent", &listlockunspent, false, false, true},
-        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true},
-        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true},
-        {"wallet", "listsinceblock", &listsinceblock, false, false, true},
-        {"wallet", "listtransactions", &listtransactions, false, false, true},
-        {"wallet", "listunspent", &listunspent, false, false, true},
-        {"wallet", "lockunspent", &lockunspent, true, false, true},
-        {"wallet", "move", &movecmd, false, false, true},
-        {"wallet", "multisend", &multisend, false, false, true},
-        {"wallet", "sendfrom", &sendfrom, false, false, true},
-        {"wallet", "sendmany", &sendmany, false, false, true},
-        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true},
-        {"wallet", "sendtoaddressix", &sendtoaddressix, false, false, true},
-        {"wallet", "setaccount", &setaccount, true, false, true},
-        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, false, true},
-        {"wallet", "settxfee", &settxfee, true, false, true},
-        {"wallet", "signmessage", &signmessage, true, false, true},
-        {"wallet", "walletlock", &walletlock, true, false, true},
-        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true},
-        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true},
-
-        {"xbridge", "dxGetOrderFills",                      &dxGetOrderFills,            true, true, true},
-        {"xbridge", "dxGetOrders",                          &dxGetOrders,                true, true, true},
-        {"xbridge", "dxGetOrder",                           &dxGetOrder,                 true, true, true},
-        {"xbridge", "dxGetLocalTokens",                     &dxGetLocalTokens,           true, true, true},
-        {"xbridge", "dxGetNetworkTokens",                   &dxGetNetworkTokens,         true, true, true},
-        {"xbridge", "dxMakeOrder",                          &dxMakeOrder,                true, true, true},
-        {"xbridge", "dxTakeOrder",                          &dxTakeOrder,                true, true, true},
-        {"xbridge", "dxCancelOrder",                        &dxCancelOrder,              true, true, true},
-        {"xbridge", "dxGetOrderHistory",                    &dxGetOrderHistory,          true, true, true},
-        {"xbridge", "dxGetOrderBook",                       &dxGetOrderBook,             true, true, true},
-        {"xbridge", "dxGetTokenBalances",                   &dxGetTokenBalances,         true, true, true},
-        {"xbridge", "dxGetMyOrders",                        &dxGetMyOrders,              true, true, true},
-        {"xbridge", "dxGetLockedUtxos",                     &dxGetLockedUtxos,           true, true, true},
-        {"xbridge", "dxFlushCancelledOrders",               &dxFlushCancelledOrders,     true, true, true},
-        {"xbridge", "gettradingdata",                       &gettradingdata,             true, true, true},
+        {"wallet", "addmultisigaddress", &addmultisigaddress, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "autocombinerewards", &autocombinerewards, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "backupwallet", &backupwallet, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "dumpprivkey", &dumpprivkey, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "dumpwallet", &dumpwallet, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "bip38encrypt", &bip38encrypt, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "bip38decrypt", &bip38decrypt, true, RPC_LOCK_NONE, true}, /* rescans without holding cs_main */
+        {"wallet", "encryptwallet", &encryptwallet, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getaccountaddress", &getaccountaddress, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getaccount", &getaccount, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getbalance", &getbalance, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getnewaddress", &getnewaddress, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getstakingstatus", &getstakingstatus, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "gettransaction", &gettransaction, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "getwalletinfo", &getwalletinfo, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "importprivkey", &importprivkey, true, RPC_LOCK_NONE, true}, /* rescans without holding cs_main */
+        {"wallet", "importwallet", &importwallet, true, RPC_LOCK_NONE, true}, /* rescans without holding cs_main */
+        {"wallet", "importaddress", &importaddress, true, RPC_LOCK_NONE, true}, /* rescans without holding cs_main */
+        {"wallet", "keypoolrefill", &keypoolrefill, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "listaccounts", &listaccounts, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "listaddressgroupings", &listaddressgroupings, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "listlockunspent", &listlockunspent, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "listsinceblock", &listsinceblock, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "listtransactions", &listtransactions, false, RPC_LOCK_NONE, true},
+        {"wallet", "listunspent", &listunspent, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "lockunspent", &lockunspent, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "move", &movecmd, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "multisend", &multisend, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "sendfrom", &sendfrom, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "sendmany", &sendmany, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "sendtoaddress", &sendtoaddress, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "sendtoaddressix", &sendtoaddressix, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "setaccount", &setaccount, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "settxfee", &settxfee, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "signmessage", &signmessage, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "walletlock", &walletlock, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, RPC_LOCK_MAIN_WALLET, true},
+        {"wallet", "walletpassphrase", &walletpassphrase, true, RPC_LOCK_MAIN_WALLET, true},
+
+        {"xbridge", "dxGetOrderFills",                      &dxGetOrderFills,            true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetOrders",                          &dxGetOrders,                true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetOrder",                           &dxGetOrder,                 true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetLocalTokens",                     &dxGetLocalTokens,           true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetNetworkTokens",                   &dxGetNetworkTokens,         true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxMakeOrder",                          &dxMakeOrder,                true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxTakeOrder",                          &dxTakeOrder,                true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxCancelOrder",                        &dxCancelOrder,              true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetOrderHistory",                    &dxGetOrderHistory,          true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetOrderBook",                       &dxGetOrderBook,             true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetTokenBalances",                   &dxGetTokenBalances,         true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetMyOrders",                        &dxGetMyOrders,              true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxGetLockedUtxos",                     &dxGetLockedUtxos,           true, RPC_LOCK_NONE, true},
+        {"xbridge", "dxFlushCancelledOrders",               &dxFlushCancelledOrders,     true, RPC_LOCK_NONE, true},
+        {"xbridge", "gettradingdata",                       &gettradingdata,             true, RPC_LOCK_NONE, true},
     #endif // ENABLE_WALLET
 };
 
+/**
+ * Commands that can also write their result while they produce it, for
+ * results too large to build as one Value first. Each writes what its
+ * actor in vRPCCommands returns. They run with RPC_LOCK_NONE, and hold no
+ * lock while they write, as writing waits while the client is behind.
+ */
+static const struct {
+    const char* name;
+    rpcstreamfn_type actor;
+} vRPCStreamCommands[] = {
+    {"getblock", &getblock_stream},
+    {"getrawmempool", &getrawmempool_stream},
+    {"servicenode", &servicenode_stream},
+    {"servicenodelist", &servicenodelist_stream},
+    {"mnbudget", &mnbudget_stream},
+#ifdef ENABLE_WALLET
+    {"listtransactions", &listtransactions_stream},
+    {"dxGetOrderHistory", &dxGetOrderHistory_stream},
+#endif // ENABLE_WALLET
+};
+
 CRPCTable::CRPCTable()
 {
     unsigned int vcidx;
@@ -393,6 +430,8 @@ CRPCTable::CRPCTable()
         pcmd = &vRPCCommands[vcidx];
         mapCommands[pcmd->name] = pcmd;
     }
+    for (vcidx = 0; vcidx < ARRAYLEN(vRPCStreamCommands); vcidx++)
+        mapStreamCommands[vRPCStreamCommands[vcidx].name] = vRPCStreamCommands[vcidx].actor;
 }
 
 const CRPCCommand* CRPCTable::operator[](string name) const
@@ -454,18 +493,26 @@ bool ClientAllowed(const boost::asio::ip::address& address)
     return false;
 }
 
-template <typename Protocol>
-class AcceptedConnectionImpl : public AcceptedConnection
+static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
+    string& strRequest,
+    map<string, string>& mapHeaders,
+    bool fRun);
+
+/**
+ * Collects what a request handler writes to its connection, so the worker
+ * thread running the handler never blocks on the client. The connection
+ * sends it once the handler returns, except for the chunks of a long reply
+ * begun with BeginReply, which are passed on through sendPart as they fill.
+ * sendPart blocks while the client is behind, and fails once it is gone,
+ * after which the rest of the reply is dropped.
+ */
+class HTTPReplyBuffer : public AcceptedConnection, private std::streambuf
 {
 public:
-    AcceptedConnectionImpl(
-        asio::io_service& io_service,
-        ssl::context& context,
-        bool fUseSSL) : sslStream(io_service, context),
-                        _d(sslStream, fUseSSL),
-                        _stream(_d)
-    {
-    }
+    typedef boost::function<bool(const std::string&)> SendFunc;
+
+    HTTPReplyBuffer(const std::string& strPeerIn, bool fChunkedIn, const SendFunc& sendPartIn)
+        : strPeer(strPeerIn), fChunked(fChunkedIn), sendPart(sendPartIn), _stream(this), state(REPLY_WHOLE), nStatus(HTTP_OK), fKeepAlive(false) {}
 
     virtual std::iostream& stream()
     {
@@ -474,47 +521,490 @@ public:
 
     virtual std::string peer_address_to_string() const
     {
-        return peer.address().to_string();
+        return strPeer;
     }
 
     virtual void close()
     {
-        _stream.close();
     }
 
-    typename Protocol::endpoint peer;
-    asio::ssl::stream<typename Protocol::socket> sslStream;
+    virtual void BeginReply(int nStatusIn, bool fKeepAliveIn, const char* contentType)
+    {
+        strBuffer.clear();
+        state = REPLY_BUFFERED;
+        nStatus = nStatusIn;
+        fKeepAlive = fKeepAliveIn;
+        strContentType = contentType;
+    }
+
+    virtual void EndReply()
+    {
+        if (state == REPLY_BUFFERED)
+            strBuffer = HTTPReplyHeader(nStatus, fKeepAlive, strBuffer.size(), strContentType.c_str()) + strBuffer;
+        else if (state == REPLY_CHUNKED)
+            strBuffer = (strBuffer.empty() ? "" : HTTPChunk(strBuffer)) + HTTPChunk("");
+        if (state != REPLY_FAILED)
+            state = REPLY_WHOLE;
+    }
+
+    virtual bool CancelReply()
+    {
+        strBuffer.clear();
+        if (state == REPLY_CHUNKED || state == REPLY_FAILED) {
+            state = REPLY_FAILED;
+            return false;
+        }
+        state = REPLY_WHOLE;
+        return true;
+    }
+
+    /** What is left to send, or false if the client has to be cut off mid-reply */
+    bool TakeRemaining(std::string& strRemaining)
+    {
+        if (state == REPLY_BUFFERED || state == REPLY_CHUNKED)
+            CancelReply();
+        strRemaining.swap(strBuffer);
+        return state != REPLY_FAILED;
+    }
+
+private:
+    enum ReplyState {
+        REPLY_WHOLE,    //!< the buffer is sent whole once the handler returns
+        REPLY_BUFFERED, //!< a reply is begun and none of it is sent yet
+        REPLY_CHUNKED,  //!< its header and first chunks are sent
+        REPLY_FAILED,   //!< it was cancelled after that; anything more is dropped
+    };
+
+    virtual std::streamsize xsputn(const char* pch, std::streamsize n)
+    {
+        if (state == REPLY_FAILED)
+            return n;
+        strBuffer.append(pch, n);
+        if (strBuffer.size() >= HTTP_REPLY_CHUNK_SIZE) {
+            bool fSent = true;
+            if (state == REPLY_BUFFERED && fChunked) {
+                fSent = sendPart(HTTPReplyHeaderChunked(nStatus, fKeepAlive, strContentType.c_str()) + HTTPChunk(strBuffer));
+                strBuffer.clear();
+                state = REPLY_CHUNKED;
+            } else if (state == REPLY_CHUNKED) {
+                fSent = sendPart(HTTPChunk(strBuffer));
+                strBuffer.clear();
+            }
+            if (!fSent)
+                state = REPLY_FAILED;
+        }
+        return n;
+    }
+
+    virtual int_type overflow(int_type c)
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            char ch = traits_type::to_char_type(c);
+            xsputn(&ch, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::string strPeer;
+    bool fChunked; //!< the client can take chunked transfer encoding
+    SendFunc sendPart;
+    std::iostream _stream;
+    std::string strBuffer;
+    ReplyState state;
+    int nStatus;
+    bool fKeepAlive;
+    std::string strContentType;
+};
+
+/**
+ * Bounded queue of parsed requests, served by the -rpcthreads worker
+ * threads. Requests beyond -rpcworkqueue are refused rather than queued,
+ * so a flood of slow calls cannot pile up without limit.
+ */
+class HTTPWorkQueue
+{
+public:
+    explicit HTTPWorkQueue(size_t nCapacityIn) : nCapacity(nCapacityIn), fRunning(true), nPeakDepth(0), nRejected(0), nServed(0), nTotalWaitMicros(0) {}
+
+    bool Enqueue(const boost::function<void(void)>& func)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (queue.size() >= nCapacity) {
+            nRejected++;
+            return false;
+        }
+        queue.push_back(std::make_pair(GetTimeMicros(), func));
+        nPeakDepth = std::max(nPeakDepth, queue.size());
+        cond.notify_one();
+        return true;
+    }
+
+    void Run()
+    {
+        while (true) {
+            boost::function<void(void)> func;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (fRunning && queue.empty())
+                    cond.wait(lock);
+                if (!fRunning)
+                    return;
+                nServed++;
+                nTotalWaitMicros += GetTimeMicros() - queue.front().first;
+                func = queue.front().second;
+                queue.pop_front();
+            }
+            func();
+        }
+    }
+
+    void Interrupt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fRunning = false;
+        queue.clear();
+        cond.notify_all();
+    }
+
+    Object GetInfo()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        Object obj;
+        obj.push_back(Pair("depth", (int64_t)queue.size()));
+        obj.push_back(Pair("peakdepth", (int64_t)nPeakDepth));
+        obj.push_back(Pair("capacity", (int64_t)nCapacity));
+        obj.push_back(Pair("served", (int64_t)nServed));
+        obj.push_back(Pair("rejected", (int64_t)nRejected));
+        obj.push_back(Pair("averagewait", nServed ? nTotalWaitMicros / 1000.0 / nServed : 0.0));
+        return obj;
+    }
 
 private:
-    SSLIOStreamDevice<Protocol> _d;
-    iostreams::stream<SSLIOStreamDevice<Protocol> > _stream;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<std::pair<int64_t, boost::function<void(void)> > > queue; //!< with the time each was queued
+    size_t nCapacity;
+    bool fRunning;
+    size_t nPeakDepth;
+    uint64_t nRejected;
+    uint64_t nServed;
+    int64_t nTotalWaitMicros;
+};
+
+static HTTPWorkQueue* rpc_work_queue = NULL;
+
+//! Timings of each RPC method and REST endpoint since startup
+struct RPCCallStats {
+    uint64_t nCalls;
+    uint64_t nErrors;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+
+    RPCCallStats() : nCalls(0), nErrors(0), nTotalMicros(0), nMaxMicros(0) {}
 };
 
-void ServiceConnection(AcceptedConnection* conn);
+static CCriticalSection cs_rpcStats;
+static std::map<std::string, RPCCallStats> mapRPCCallStats;
+static int nHTTPConnections = 0;
+
+void RPCRecordCall(const std::string& strName, int64_t nMicros, bool fError)
+{
+    LOCK(cs_rpcStats);
+    RPCCallStats& stats = mapRPCCallStats[strName];
+    stats.nCalls++;
+    if (fError)
+        stats.nErrors++;
+    stats.nTotalMicros += nMicros;
+    stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+}
+
+/**
+ * One client connection. All of its I/O runs on the RPC network thread
+ * and never blocks: requests are read and parsed as bytes arrive, and each
+ * complete request goes to the work queue. The next request of a pipelined
+ * connection is only taken once the reply to the previous one is written,
+ * so replies go out in order. An idle connection costs nothing but its
+ * socket and a pending read. A worker streaming a long reply waits while
+ * more than HTTP_REPLY_MAX_PENDING bytes of it are not yet written.
+ */
+class HTTPConnection : public boost::enable_shared_from_this<HTTPConnection>
+{
+public:
+    HTTPConnection(asio::io_service& io_service, ssl::context& context, bool fUseSSLIn)
+        : sslStream(io_service, context), timer(io_service), fUseSSL(fUseSSLIn), parser(MAX_SIZE), fBusy(false), fClosed(false), fReplied(false), fKeepAliveAfterReply(false), nPendingBytes(0), fPendingAborted(false)
+    {
+        LOCK(cs_rpcStats);
+        nHTTPConnections++;
+    }
+
+    ~HTTPConnection()
+    {
+        LOCK(cs_rpcStats);
+        nHTTPConnections--;
+    }
+
+    ip::tcp::socket::lowest_layer_type& socket() { return sslStream.lowest_layer(); }
+
+    void Start()
+    {
+        strPeer = peer.address().to_string();
+        if (fUseSSL) {
+            StartTimer();
+            sslStream.async_handshake(ssl::stream_base::server,
+                boost::bind(&HTTPConnection::HandleHandshake, shared_from_this(), asio::placeholders::error));
+        } else {
+            ReadMore();
+        }
+    }
+
+    /** Refuse a client that is not allowed to connect */
+    void Refuse()
+    {
+        // Only send a 403 if we're not using SSL to prevent a DoS during the SSL handshake.
+        if (!fUseSSL)
+            Write(HTTPError(HTTP_FORBIDDEN, false), false);
+        else
+            Close();
+    }
+
+    ip::tcp::endpoint peer;
+
+private:
+    void StartTimer()
+    {
+        timer.expires_from_now(posix_time::seconds(GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT)));
+        timer.async_wait(boost::bind(&HTTPConnection::HandleTimeout, shared_from_this(), asio::placeholders::error));
+    }
+
+    void HandleTimeout(const boost::system::error_code& error)
+    {
+        // Idle clients, and clients not taking their reply, are dropped; a
+        // request still running is not timed out, nor are cancelled waits
+        if (error != asio::error::operation_aborted && (!fBusy || !queueWrite.empty()))
+            Close();
+    }
+
+    void HandleHandshake(const boost::system::error_code& error)
+    {
+        if (error) {
+            LogPrint("rpc", "%s: SSL handshake with %s failed: %s\n", __func__, strPeer, error.message());
+            Close();
+            return;
+        }
+        ReadMore();
+    }
+
+    void ReadMore()
+    {
+        if (fClosed)
+            return;
+        StartTimer();
+        if (fUseSSL)
+            sslStream.async_read_some(asio::buffer(vReadBuffer),
+                boost::bind(&HTTPConnection::HandleRead, shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred));
+        else
+            sslStream.next_layer().async_read_some(asio::buffer(vReadBuffer),
+                boost::bind(&HTTPConnection::HandleRead, shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred));
+    }
+
+    void HandleRead(const boost::system::error_code& error, size_t nBytes)
+    {
+        if (error) {
+            Close();
+            return;
+        }
+        parser.Feed(vReadBuffer.data(), nBytes);
+        ProcessBuffered();
+    }
+
+    /** Hand the next buffered request to the work queue, or read until there is one */
+    void ProcessBuffered()
+    {
+        if (fBusy || fClosed)
+            return;
+
+        HTTPRequest req;
+        switch (parser.Parse(req)) {
+        case HTTPRequestParser::NEED_MORE:
+            ReadMore();
+            return;
+        case HTTPRequestParser::INVALID:
+            Write(HTTPError(HTTP_BAD_REQUEST, false), false);
+            return;
+        case HTTPRequestParser::COMPLETE:
+            break;
+        }
+
+        fBusy = true;
+        timer.cancel();
+        if (!rpc_work_queue->Enqueue(boost::bind(&HTTPConnection::Execute, shared_from_this(), req))) {
+            LogPrint("rpc", "%s: work queue depth exceeded, refusing request from %s\n", __func__, strPeer);
+            Write(HTTPReply(HTTP_SERVICE_UNAVAILABLE, "Work queue depth exceeded\r\n", true, false, "text/plain"), true);
+        }
+    }
+
+    /** Run a request on a worker thread, then send the reply from the network thread */
+    void Execute(HTTPRequest req)
+    {
+        bool fKeepAlive = req.mapHeaders["connection"] != "close" && GetBoolArg("-rpckeepalive", true) && !ShutdownRequested();
+        HTTPReplyBuffer reply(strPeer, req.nProto >= 1, boost::bind(&HTTPConnection::PostPart, shared_from_this(), _1));
+        bool fOk = false;
+
+        // Process via JSON-RPC API
+        if (req.strURI == "/") {
+            fOk = HTTPReq_JSONRPC(&reply, req.strBody, req.mapHeaders, fKeepAlive);
+
+            // Process via HTTP REST API
+        } else if (req.strURI.substr(0, 6) == "/rest/" && GetBoolArg("-rest", false)) {
+            fOk = HTTPReq_REST(&reply, req.strURI, req.mapHeaders, fKeepAlive);
+
+        } else {
+            reply.stream() << HTTPError(HTTP_NOT_FOUND, false) << std::flush;
+        }
+
+        // A reply cut off mid-way ends with the connection, as its length was not told
+        std::string strRemaining;
+        if (!reply.TakeRemaining(strRemaining)) {
+            LogPrint("rpc", "%s: reply to %s failed after it was partly sent\n", __func__, strPeer);
+            fOk = false;
+        }
+        rpc_io_service->post(boost::bind(&HTTPConnection::Write, shared_from_this(), strRemaining, fOk && fKeepAlive));
+    }
+
+    /**
+     * Send part of a reply still being written on a worker thread, once the
+     * client has taken enough of the parts before. False if it never will.
+     */
+    bool PostPart(const std::string& strPart)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(csPending);
+            while (nPendingBytes >= HTTP_REPLY_MAX_PENDING && !fPendingAborted && fRPCRunning)
+                condPending.timed_wait(lock, posix_time::milliseconds(100));
+            if (fPendingAborted || !fRPCRunning)
+                return false;
+            nPendingBytes += strPart.size();
+        }
+        rpc_io_service->post(boost::bind(&HTTPConnection::Send, shared_from_this(), strPart));
+        return true;
+    }
+
+    /** Send the rest of a reply, then take the next request or close */
+    void Write(const std::string& strReply, bool fKeepAlive)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(csPending);
+            nPendingBytes += strReply.size();
+        }
+        fReplied = true;
+        fKeepAliveAfterReply = fKeepAlive;
+        Send(strReply);
+    }
+
+    void Send(const std::string& str)
+    {
+        if (fClosed)
+            return;
+        fBusy = true;
+        queueWrite.push_back(str);
+        if (queueWrite.size() == 1)
+            WriteFront();
+    }
+
+    void WriteFront()
+    {
+        StartTimer();
+        if (fUseSSL)
+            asio::async_write(sslStream, asio::buffer(queueWrite.front()),
+                boost::bind(&HTTPConnection::HandleWrite, shared_from_this(), asio::placeholders::error));
+        else
+            asio::async_write(sslStream.next_layer(), asio::buffer(queueWrite.front()),
+                boost::bind(&HTTPConnection::HandleWrite, shared_from_this(), asio::placeholders::error));
+    }
+
+    void HandleWrite(const boost::system::error_code& error)
+    {
+        if (error) {
+            Close();
+            return;
+        }
+        {
+            boost::unique_lock<boost::mutex> lock(csPending);
+            nPendingBytes -= queueWrite.front().size();
+            condPending.notify_all();
+        }
+        queueWrite.pop_front();
+        if (!queueWrite.empty()) {
+            WriteFront();
+            return;
+        }
+        if (!fReplied)
+            return;
+        fReplied = false;
+        if (!fKeepAliveAfterReply) {
+            Close();
+            return;
+        }
+        fBusy = false;
+        ProcessBuffered();
+    }
+
+    void Close()
+    {
+        if (fClosed)
+            return;
+        fClosed = true;
+        {
+            boost::unique_lock<boost::mutex> lock(csPending);
+            fPendingAborted = true;
+            condPending.notify_all();
+        }
+        boost::system::error_code ec;
+        timer.cancel(ec);
+        socket().shutdown(ip::tcp::socket::shutdown_both, ec);
+        socket().close(ec);
+    }
+
+    asio::ssl::stream<ip::tcp::socket> sslStream;
+    deadline_timer timer;
+    bool fUseSSL;
+    std::string strPeer;
+    boost::array<char, 16 * 1024> vReadBuffer;
+    HTTPRequestParser parser;
+    bool fBusy;   //!< a request of this connection is queued, running or being replied to
+    bool fClosed;
+    std::deque<std::string> queueWrite; //!< parts of the reply not yet written, the first one being written
+    bool fReplied;                      //!< the last part of the reply is queued
+    bool fKeepAliveAfterReply;
+
+    // Shared with the worker thread streaming a reply
+    boost::mutex csPending;
+    boost::condition_variable condPending;
+    size_t nPendingBytes;  //!< bytes posted or queued and not yet written
+    bool fPendingAborted;  //!< the connection is closed, so nothing more will be written
+};
 
 //! Forward declaration required for RPCListen
-template <typename Protocol, typename SocketAcceptorService>
-static void RPCAcceptHandler(boost::shared_ptr<basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
+static void RPCAcceptHandler(boost::shared_ptr<ip::tcp::acceptor> acceptor,
     ssl::context& context,
     bool fUseSSL,
-    boost::shared_ptr<AcceptedConnection> conn,
+    boost::shared_ptr<HTTPConnection> conn,
     const boost::system::error_code& error);
 
 /**
  * Sets up I/O resources to accept and handle a new connection.
  */
-template <typename Protocol, typename SocketAcceptorService>
-static void RPCListen(boost::shared_ptr<basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
+static void RPCListen(boost::shared_ptr<ip::tcp::acceptor> acceptor,
     ssl::context& context,
     const bool fUseSSL)
 {
     // Accept connection
-    boost::shared_ptr<AcceptedConnectionImpl<Protocol> > conn(new AcceptedConnectionImpl<Protocol>(acceptor->get_io_service(), context, fUseSSL));
+    boost::shared_ptr<HTTPConnection> conn(new HTTPConnection(*rpc_io_service, context, fUseSSL));
 
     acceptor->async_accept(
-        conn->sslStream.lowest_layer(),
+        conn->socket(),
         conn->peer,
-        boost::bind(&RPCAcceptHandler<Protocol, SocketAcceptorService>,
+        boost::bind(&RPCAcceptHandler,
             acceptor,
             boost::ref(context),
             fUseSSL,
@@ -526,35 +1016,78 @@ static void RPCListen(boost::shared_ptr<basic_socket_acceptor<Protocol, SocketAc
 /**
  * Accept and handle incoming connection.
  */
-template <typename Protocol, typename SocketAcceptorService>
-static void RPCAcceptHandler(boost::shared_ptr<basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
+static void RPCAcceptHandler(boost::shared_ptr<ip::tcp::acceptor> acceptor,
     ssl::context& context,
     const bool fUseSSL,
-    boost::shared_ptr<AcceptedConnection> conn,
+    boost::shared_ptr<HTTPConnection> conn,
     const boost::system::error_code& error)
 {
     // Immediately start accepting new connections, except when we're cancelled or our socket is closed.
     if (error != asio::error::operation_aborted && acceptor->is_open())
         RPCListen(acceptor, context, fUseSSL);
 
-    AcceptedConnectionImpl<ip::tcp>* tcp_conn = dynamic_cast<AcceptedConnectionImpl<ip::tcp>*>(conn.get());
-
     if (error) {
-        // TODO: Actually handle errors
-        LogPrintf("%s: Error: %s\n", __func__, error.message());
+        if (error != asio::error::operation_aborted)
+            LogPrintf("%s: Error: %s\n", __func__, error.message());
     }
     // Restrict callers by IP.  It is important to
-    // do this before starting client thread, to filter out
+    // do this before reading any request, to filter out
     // certain DoS and misbehaving clients.
-    else if (tcp_conn && !ClientAllowed(tcp_conn->peer.address())) {
-        // Only send a 403 if we're not using SSL to prevent a DoS during the SSL handshake.
-        if (!fUseSSL)
-            conn->stream() << HTTPError(HTTP_FORBIDDEN, false) << std::flush;
-        conn->close();
+    else if (!ClientAllowed(conn->peer.address())) {
+        conn->Refuse();
     } else {
-        ServiceConnection(conn.get());
-        conn->close();
+        conn->Start();
+    }
+}
+
+Value getrpcinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcinfo\n"
+            "\nReturns statistics of the RPC server since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"connections\": n,       (numeric) Open HTTP connections, idle ones included\n"
+            "  \"workqueue\": {          (object) Requests waiting for a worker thread\n"
+            "    \"depth\": n,           (numeric) Requests queued now\n"
+            "    \"peakdepth\": n,       (numeric) Most requests ever queued at once\n"
+            "    \"capacity\": n,        (numeric) Queue depth limit, from -rpcworkqueue\n"
+            "    \"served\": n,          (numeric) Requests taken by a worker\n"
+            "    \"rejected\": n,        (numeric) Requests refused because the queue was full\n"
+            "    \"averagewait\": x.xxx  (numeric) Average time in the queue, in milliseconds\n"
+            "  },\n"
+            "  \"calls\": {              (object) By RPC method, and by REST endpoint as \"/rest/...\"\n"
+            "    \"name\": {\n"
+            "      \"calls\": n,         (numeric) Completed calls\n"
+            "      \"errors\": n,        (numeric) Calls that failed\n"
+            "      \"averagetime\": x.xxx, (numeric) Average run time, in milliseconds\n"
+            "      \"maxtime\": x.xxx    (numeric) Longest run time, in milliseconds\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getrpcinfo", "") + HelpExampleRpc("getrpcinfo", ""));
+
+    Object obj;
+    Object calls;
+    {
+        LOCK(cs_rpcStats);
+        obj.push_back(Pair("connections", nHTTPConnections));
+        BOOST_FOREACH (const PAIRTYPE(std::string, RPCCallStats) & item, mapRPCCallStats) {
+            const RPCCallStats& stats = item.second;
+            Object entry;
+            entry.push_back(Pair("calls", (int64_t)stats.nCalls));
+            entry.push_back(Pair("errors", (int64_t)stats.nErrors));
+            entry.push_back(Pair("averagetime", stats.nCalls ? stats.nTotalMicros / 1000.0 / stats.nCalls : 0.0));
+            entry.push_back(Pair("maxtime", stats.nMaxMicros / 1000.0));
+            calls.push_back(Pair(item.first, entry));
+        }
     }
+    if (rpc_work_queue != NULL)
+        obj.push_back(Pair("workqueue", rpc_work_queue->GetInfo()));
+    obj.push_back(Pair("calls", calls));
+    return obj;
 }
 
 static ip::tcp::endpoint ParseEndpoint(const std::string& strEndpoint, int defaultPort)
@@ -565,6 +1098,19 @@ static ip::tcp::endpoint ParseEndpoint(const std::string& strEndpoint, int defau
     return ip::tcp::endpoint(asio::ip::address::from_string(addr), port);
 }
 
+/** Runs all connections, accepting, reading and writing without blocking */
+static void ThreadRPCNetwork()
+{
+    RenameThread("blocknetdx-rpcnet");
+    rpc_io_service->run();
+}
+
+static void ThreadRPCWorker()
+{
+    RenameThread("blocknetdx-rpcwork");
+    rpc_work_queue->Run();
+}
+
 void StartRPCThreads()
 {
     rpc_allow_subnets.clear();
@@ -713,9 +1259,14 @@ void StartRPCThreads()
         return;
     }
 
+    int nWorkQueue = std::max((int)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1);
+    int nWorkers = std::max((int)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1);
+    LogPrintf("RPC server: %d worker threads, work queue depth %d\n", nWorkers, nWorkQueue);
+    rpc_work_queue = new HTTPWorkQueue(nWorkQueue);
     rpc_worker_group = new boost::thread_group();
-    for (int i = 0; i < GetArg("-rpcthreads", 4); i++)
-        rpc_worker_group->create_thread(boost::bind(&asio::io_service::run, rpc_io_service));
+    rpc_worker_group->create_thread(&ThreadRPCNetwork);
+    for (int i = 0; i < nWorkers; i++)
+        rpc_worker_group->create_thread(&ThreadRPCWorker);
     fRPCRunning = true;
 }
 
@@ -755,10 +1306,14 @@ void StopRPCThreads()
     }
     deadlineTimers.clear();
 
+    if (rpc_work_queue != NULL)
+        rpc_work_queue->Interrupt();
     rpc_io_service->stop();
     cvBlockChange.notify_all();
     if (rpc_worker_group != NULL)
         rpc_worker_group->join_all();
+    delete rpc_work_queue;
+    rpc_work_queue = NULL;
     delete rpc_dummy_work;
     rpc_dummy_work = NULL;
     delete rpc_worker_group;
@@ -920,71 +1475,42 @@ static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
                 throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
         }
 
-        string strReply;
-
         // singleton request
         if (valRequest.type() == obj_type) {
             jreq.parse(valRequest);
 
-            Value result = tableRPC.execute(jreq.strMethod, jreq.params);
-
-            // Send reply
-            strReply = JSONRPCReply(result, Value::null, jreq.id);
+            // The reply is written to the connection as the result is
+            // produced, laid out as JSONRPCReply() would
+            conn->BeginReply(HTTP_OK, fRun);
+            JSONStreamWriter writer(conn->stream());
+            writer.BeginObject();
+            writer.Key("result");
+            tableRPC.execute(jreq.strMethod, jreq.params, writer);
+            writer.WritePair("error", Value::null);
+            writer.WritePair("id", jreq.id);
+            writer.EndObject();
+            conn->stream() << "\n";
+            conn->EndReply();
 
             // array of requests
-        } else if (valRequest.type() == array_type)
-            strReply = JSONRPCExecBatch(valRequest.get_array());
-        else
+        } else if (valRequest.type() == array_type) {
+            string strReply = JSONRPCExecBatch(valRequest.get_array());
+            conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, strReply.size()) << strReply << std::flush;
+        } else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
-
-        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, strReply.size()) << strReply << std::flush;
     } catch (Object& objError) {
-        ErrorReply(conn->stream(), objError, jreq.id);
+        if (conn->CancelReply())
+            ErrorReply(conn->stream(), objError, jreq.id);
         return false;
     } catch (std::exception& e) {
-        ErrorReply(conn->stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        if (conn->CancelReply())
+            ErrorReply(conn->stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
     return true;
 }
 
-void ServiceConnection(AcceptedConnection* conn)
-{
-    bool fRun = true;
-    while (fRun && !ShutdownRequested()) {
-        int nProto = 0;
-        map<string, string> mapHeaders;
-        string strRequest, strMethod, strURI;
-
-        // Read HTTP request line
-        if (!ReadHTTPRequestLine(conn->stream(), nProto, strMethod, strURI))
-            break;
-
-        // Read HTTP message headers and body
-        ReadHTTPMessage(conn->stream(), mapHeaders, strRequest, nProto, MAX_SIZE);
-
-        // HTTP Keep-Alive is false; close connection immediately
-        if ((mapHeaders["connection"] == "close") || (!GetBoolArg("-rpckeepalive", true)))
-            fRun = false;
-
-        // Process via JSON-RPC API
-        if (strURI == "/") {
-            if (!HTTPReq_JSONRPC(conn, strRequest, mapHeaders, fRun))
-                break;
-
-            // Process via HTTP REST API
-        } else if (strURI.substr(0, 6) == "/rest/" && GetBoolArg("-rest", false)) {
-            if (!HTTPReq_REST(conn, strURI, mapHeaders, fRun))
-                break;
-
-        } else {
-            conn->stream() << HTTPError(HTTP_NOT_FOUND, false) << std::flush;
-            break;
-        }
-    }
-}
-
-json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params) const
+const CRPCCommand* CRPCTable::prepare(const std::string& strMethod) const
 {
     // Find method
     const CRPCCommand* pcmd = tableRPC[strMethod];
@@ -1001,46 +1527,60 @@ json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_s
         !pcmd->okSafeMode)
         throw JSONRPCError(RPC_FORBIDDEN_BY_SAFE_MODE, string("Safe mode: ") + strWarning);
 
+    return pcmd;
+}
+
+/** Run a command under the locks it asks for, and record how long it took */
+static void RunCommand(const CRPCCommand* pcmd, const boost::function<void(void)>& func)
+{
+    int64_t nStart = GetTimeMicros();
     try {
-        // Execute
-        Value result;
-        {
-            if (pcmd->threadSafe)
-                result = pcmd->actor(params, false);
+        // Wait on the locks rather than poll them, which added up to 50ms
+        // a try whenever validation held cs_main
+        if (pcmd->lockMode == RPC_LOCK_NONE)
+            func();
 #ifdef ENABLE_WALLET
-            else if (!pwalletMain) {
-                LOCK(cs_main);
-                result = pcmd->actor(params, false);
-            } else {
-                while (true) {
-                    TRY_LOCK(cs_main, lockMain);
-                    if (!lockMain) {
-                        MilliSleep(50);
-                        continue;
-                    }
-                    while (true) {
-                        TRY_LOCK(pwalletMain->cs_wallet, lockWallet);
-                        if (!lockMain) {
-                            MilliSleep(50);
-                            continue;
-                        }
-                        result = pcmd->actor(params, false);
-                        break;
-                    }
-                    break;
-                }
-            }
-#else  // ENABLE_WALLET
-            else {
-                LOCK(cs_main);
-                result = pcmd->actor(params, false);
-            }
-#endif // !ENABLE_WALLET
+        else if (pcmd->lockMode == RPC_LOCK_MAIN_WALLET && pwalletMain) {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            func();
+        }
+#endif // ENABLE_WALLET
+        else {
+            LOCK(cs_main);
+            func();
         }
-        return result;
+        RPCRecordCall(pcmd->name, GetTimeMicros() - nStart, false);
     } catch (std::exception& e) {
+        RPCRecordCall(pcmd->name, GetTimeMicros() - nStart, true);
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    } catch (...) {
+        RPCRecordCall(pcmd->name, GetTimeMicros() - nStart, true);
+        throw;
+    }
+}
+
+static void CallActor(const CRPCCommand* pcmd, const Array& params, Value& result)
+{
+    result = pcmd->actor(params, false);
+}
+
+json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params) const
+{
+    const CRPCCommand* pcmd = prepare(strMethod);
+    Value result;
+    RunCommand(pcmd, boost::bind(&CallActor, pcmd, boost::cref(params), boost::ref(result)));
+    return result;
+}
+
+void CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params, JSONStreamWriter& writer) const
+{
+    map<string, rpcstreamfn_type>::const_iterator it = mapStreamCommands.find(strMethod);
+    if (it == mapStreamCommands.end()) {
+        writer.WriteValue(execute(strMethod, params));
+        return;
     }
+    const CRPCCommand* pcmd = prepare(strMethod);
+    RunCommand(pcmd, boost::bind(it->second, boost::cref(params), boost::ref(writer)));
 }
 
 std::string HelpExampleCli(string methodname, string args)
@@ -34,8 +34,34 @@ public:
     virtual std::iostream& stream() = 0;
     virtual std::string peer_address_to_string() const = 0;
     virtual void close() = 0;
+
+    /**
+     * Begin a reply whose body is what is written to stream() up to
+     * EndReply(). A body longer than HTTP_REPLY_CHUNK_SIZE goes out in
+     * chunks while it is written, if the client speaks HTTP/1.1; a shorter
+     * one is sent whole, with its length.
+     */
+    virtual void BeginReply(int nStatus, bool fKeepAlive, const char* contentType = "application/json") = 0;
+    virtual void EndReply() = 0;
+    /**
+     * Drop the reply begun, so an error can be sent instead. Returns false
+     * if part of it went out already, and the connection has to be closed.
+     */
+    virtual bool CancelReply() = 0;
 };
 
+//! Bytes of a reply body collected before they are sent as one chunk
+static const size_t HTTP_REPLY_CHUNK_SIZE = 64 * 1024;
+//! Bytes of a reply left for the client to take before its handler is held up
+static const size_t HTTP_REPLY_MAX_PENDING = 4 * HTTP_REPLY_CHUNK_SIZE;
+
+//! Default for -rpcthreads, the number of threads running RPC and REST requests
+static const int DEFAULT_HTTP_THREADS = 4;
+//! Default for -rpcworkqueue, the number of requests allowed to wait for a thread
+static const int DEFAULT_HTTP_WORKQUEUE = 16;
+//! Default for -rpcservertimeout, in seconds
+static const int DEFAULT_HTTP_SERVER_TIMEOUT = 30;
+
 /** Start RPC threads */
 void StartRPCThreads();
 /**
@@ -82,11 +108,21 @@ void RPCTypeCheck(const json_spirit::Object& o,
  */
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
+/** Account one call of an RPC method or REST endpoint for getrpcinfo */
+void RPCRecordCall(const std::string& strName, int64_t nMicros, bool fError);
+
 //! Convert boost::asio address to CNetAddr
 extern CNetAddr BoostAsioToCNetAddr(boost::asio::ip::address address);
 
 typedef json_spirit::Value (*rpcfn_type)(const json_spirit::Array& params, bool fHelp);
 
+/** The locks CRPCTable::execute holds while a command runs */
+enum RPCLockMode {
+    RPC_LOCK_NONE,        //!< the command takes what it needs itself, or reads GetChainTipSnapshot()
+    RPC_LOCK_MAIN,        //!< cs_main
+    RPC_LOCK_MAIN_WALLET, //!< cs_main, and the wallet's cs_wallet if there is a wallet
+};
+
 class CRPCCommand
 {
 public:
@@ -94,10 +130,13 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
-    bool threadSafe;
+    RPCLockMode lockMode;
     bool reqWallet;
 };
 
+/** A command writing its result as it produces it, instead of returning it */
+typedef void (*rpcstreamfn_type)(const json_spirit::Array& params, JSONStreamWriter& writer);
+
 /**
  * BlocknetDX RPC command dispatcher.
  */
@@ -105,6 +144,9 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, rpcstreamfn_type> mapStreamCommands;
+
+    const CRPCCommand* prepare(const std::string& method) const;
 
 public:
     CRPCTable();
@@ -119,6 +161,12 @@ public:
      * @throws an exception (json_spirit::Value) when an error happens.
      */
     json_spirit::Value execute(const std::string& method, const json_spirit::Array& params) const;
+
+    /**
+     * Execute a method, writing its result to writer. Methods that can
+     * stream their result write it as they go, the others once they return.
+     */
+    void execute(const std::string& method, const json_spirit::Array& params, JSONStreamWriter& writer) const;
 };
 
 extern const CRPCTable tableRPC;
@@ -151,6 +199,7 @@ extern json_spirit::Value ping(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value addnode(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getaddednodeinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getnettotals(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getmessagestats(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value sendserviceping(const json_spirit::Array& params, bool fHelp);
 
 extern json_spirit::Value dumpprivkey(const json_spirit::Array& params, bool fHelp); // in rpcdump.cpp
@@ -196,6 +245,7 @@ extern json_spirit::Value createmultisig(const json_spirit::Array& params, bool
 extern json_spirit::Value listreceivedbyaddress(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listreceivedbyaccount(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listtransactions(const json_spirit::Array& params, bool fHelp);
+extern void listtransactions_stream(const json_spirit::Array& params, JSONStreamWriter& writer);
 extern json_spirit::Value listaddressgroupings(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listaccounts(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listsinceblock(const json_spirit::Array& params, bool fHelp);
@@ -208,6 +258,11 @@ extern json_spirit::Value walletlock(const json_spirit::Array& params, bool fHel
 extern json_spirit::Value encryptwallet(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value validateaddress(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getmemoryinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getrpcinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressdeltas(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddresstxids(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressbalance(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getwalletinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockchaininfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getnetworkinfo(const json_spirit::Array& params, bool fHelp);
@@ -225,6 +280,7 @@ extern json_spirit::Value createrawtransaction(const json_spirit::Array& params,
 extern json_spirit::Value fundrawtransaction(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value decoderawtransaction(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value decodescript(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getspentinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value signrawtransaction(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value sendrawtransaction(const json_spirit::Array& params, bool fHelp);
 
@@ -234,9 +290,12 @@ extern json_spirit::Value getdifficulty(const json_spirit::Array& params, bool f
 extern json_spirit::Value settxfee(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getmempoolinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getrawmempool(const json_spirit::Array& params, bool fHelp);
+extern void getrawmempool_stream(const json_spirit::Array& params, JSONStreamWriter& writer);
 extern json_spirit::Value getblockhash(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp);
+extern void getblock_stream(const json_spirit::Array& params, JSONStreamWriter& writer);
 extern json_spirit::Value getblockheader(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getblockfilter(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value gettxoutsetinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value gettxout(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value verifychain(const json_spirit::Array& params, bool fHelp);
@@ -245,9 +304,13 @@ extern json_spirit::Value invalidateblock(const json_spirit::Array& params, bool
 extern json_spirit::Value reconsiderblock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value obfuscation(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value spork(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getswifttxinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value servicenode(const json_spirit::Array& params, bool fHelp);
+extern void servicenode_stream(const json_spirit::Array& params, JSONStreamWriter& writer);
 extern json_spirit::Value servicenodelist(const json_spirit::Array& params, bool fHelp);
+extern void servicenodelist_stream(const json_spirit::Array& params, JSONStreamWriter& writer);
 extern json_spirit::Value mnbudget(const json_spirit::Array& params, bool fHelp);
+extern void mnbudget_stream(const json_spirit::Array& params, JSONStreamWriter& writer);
 extern json_spirit::Value mnbudgetvoteraw(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value mnfinalbudget(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value mnsync(const json_spirit::Array& params, bool fHelp);
@@ -506,6 +569,7 @@ extern json_spirit::Value dxCancelOrder(const json_spirit::Array& params, bool f
  * \endverbatim
  */
 extern json_spirit::Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp);
+extern void dxGetOrderHistory_stream(const json_spirit::Array& params, JSONStreamWriter& writer);
 
 /**
  * @brief Returns transactions list in a form of 'order book'
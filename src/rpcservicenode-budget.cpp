@@ -19,6 +19,54 @@
 using namespace json_spirit;
 using namespace std;
 
+/** The proposals 'mnbudget show' lists, latest start first */
+static std::vector<CBudgetProposal*> GetProposalsToShow()
+{
+    std::vector<CBudgetProposal*> vProposals;
+    BOOST_FOREACH (CBudgetProposal* pbudgetProposal, budget.GetAllProposals()) {
+        if (pbudgetProposal->fValid)
+            vProposals.push_back(pbudgetProposal);
+    }
+    // Sort descending
+    sort(vProposals.begin(), vProposals.end(), [](CBudgetProposal *a, CBudgetProposal *b) -> bool {
+        return a->GetBlockStart() > b->GetBlockStart();
+    });
+    return vProposals;
+}
+
+/** One proposal of 'mnbudget show' */
+static Object ProposalToJSON(CBudgetProposal* pbudgetProposal)
+{
+    CTxDestination address1;
+    ExtractDestination(pbudgetProposal->GetPayee(), address1);
+    CBitcoinAddress address2(address1);
+
+    Object bObj;
+    bObj.push_back(Pair("Name", pbudgetProposal->GetName()));
+    bObj.push_back(Pair("URL", pbudgetProposal->GetURL()));
+    bObj.push_back(Pair("Hash", pbudgetProposal->GetHash().ToString()));
+    bObj.push_back(Pair("FeeHash", pbudgetProposal->nFeeTXHash.ToString()));
+    bObj.push_back(Pair("BlockStart", (int64_t)pbudgetProposal->GetBlockStart()));
+    bObj.push_back(Pair("BlockEnd", (int64_t)pbudgetProposal->GetBlockEnd()));
+    bObj.push_back(Pair("TotalPaymentCount", (int64_t)pbudgetProposal->GetTotalPaymentCount()));
+    bObj.push_back(Pair("RemainingPaymentCount", (int64_t)pbudgetProposal->GetRemainingPaymentCount()));
+    bObj.push_back(Pair("PaymentAddress", address2.ToString()));
+    bObj.push_back(Pair("Ratio", pbudgetProposal->GetRatio()));
+    bObj.push_back(Pair("Yeas", (int64_t)pbudgetProposal->GetYeas()));
+    bObj.push_back(Pair("Nays", (int64_t)pbudgetProposal->GetNays()));
+    bObj.push_back(Pair("Abstains", (int64_t)pbudgetProposal->GetAbstains()));
+    bObj.push_back(Pair("TotalPayment", ValueFromAmount(pbudgetProposal->GetAmount() * pbudgetProposal->GetTotalPaymentCount())));
+    bObj.push_back(Pair("MonthlyPayment", ValueFromAmount(pbudgetProposal->GetAmount())));
+
+    bObj.push_back(Pair("IsEstablished", pbudgetProposal->IsEstablished()));
+
+    std::string strError = "";
+    bObj.push_back(Pair("IsValid", pbudgetProposal->IsValid(strError)));
+    bObj.push_back(Pair("IsValidReason", strError.c_str()));
+    bObj.push_back(Pair("fValid", pbudgetProposal->fValid));
+    return bObj;
+}
+
 Value mnbudget(const Array& params, bool fHelp)
 {
     string strCommand;
@@ -189,7 +237,7 @@ Value mnbudget(const Array& params, bool fHelp)
         //     return "Proposal is not valid - " + budgetProposalBroadcast.GetHash().ToString() + " - " + strError;
         // }
 
-        budget.mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+        budget.AddSeen(budget.mapSeenServicenodeBudgetProposals, budgetProposalBroadcast);
         budgetProposalBroadcast.Relay();
         if(budget.AddProposal(budgetProposalBroadcast)) {
             return budgetProposalBroadcast.GetHash().ToString();
@@ -256,7 +304,7 @@ Value mnbudget(const Array& params, bool fHelp)
 
             std::string strError = "";
             if (budget.UpdateProposal(vote, NULL, strError)) {
-                budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                budget.AddSeen(budget.mapSeenServicenodeBudgetVotes, vote);
                 vote.Relay();
                 success++;
                 statusObj.push_back(Pair("result", "success"));
@@ -345,7 +393,7 @@ if(strCommand == "vote-alias")
 
             std::string strError = "";
             if(budget.UpdateProposal(vote, NULL, strError)) {
-                budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                budget.AddSeen(budget.mapSeenServicenodeBudgetVotes, vote);
                 vote.Relay();
                 success++;
                 statusObj.push_back(Pair("result", "success"));
@@ -395,7 +443,7 @@ if(strCommand == "vote-alias")
 
         std::string strError = "";
         if (budget.UpdateProposal(vote, NULL, strError)) {
-            budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+            budget.AddSeen(budget.mapSeenServicenodeBudgetVotes, vote);
             vote.Relay();
             return "Voted successfully";
         } else {
@@ -444,55 +492,9 @@ if(strCommand == "vote-alias")
     }
 
     if (strCommand == "show") {
-        std::string strShow = "valid";
-        if (params.size() == 2)
-            std::string strProposalName = params[1].get_str();
-
         Array resultObj;
-        int64_t nTotalAllotted = 0;
-
-        std::vector<CBudgetProposal*> winningProps = budget.GetAllProposals();
-        // Sort descending
-        sort(winningProps.begin(), winningProps.end(), [](CBudgetProposal *a, CBudgetProposal *b) -> bool {
-            return a->GetBlockStart() > b->GetBlockStart();
-        });
-
-        for (CBudgetProposal* pbudgetProposal : winningProps) {
-            if (strShow == "valid" && !pbudgetProposal->fValid) continue;
-
-            nTotalAllotted += pbudgetProposal->GetAllotted();
-
-            CTxDestination address1;
-            ExtractDestination(pbudgetProposal->GetPayee(), address1);
-            CBitcoinAddress address2(address1);
-
-            Object bObj;
-            bObj.push_back(Pair("Name", pbudgetProposal->GetName()));
-            bObj.push_back(Pair("URL", pbudgetProposal->GetURL()));
-            bObj.push_back(Pair("Hash", pbudgetProposal->GetHash().ToString()));
-            bObj.push_back(Pair("FeeHash", pbudgetProposal->nFeeTXHash.ToString()));
-            bObj.push_back(Pair("BlockStart", (int64_t)pbudgetProposal->GetBlockStart()));
-            bObj.push_back(Pair("BlockEnd", (int64_t)pbudgetProposal->GetBlockEnd()));
-            bObj.push_back(Pair("TotalPaymentCount", (int64_t)pbudgetProposal->GetTotalPaymentCount()));
-            bObj.push_back(Pair("RemainingPaymentCount", (int64_t)pbudgetProposal->GetRemainingPaymentCount()));
-            bObj.push_back(Pair("PaymentAddress", address2.ToString()));
-            bObj.push_back(Pair("Ratio", pbudgetProposal->GetRatio()));
-            bObj.push_back(Pair("Yeas", (int64_t)pbudgetProposal->GetYeas()));
-            bObj.push_back(Pair("Nays", (int64_t)pbudgetProposal->GetNays()));
-            bObj.push_back(Pair("Abstains", (int64_t)pbudgetProposal->GetAbstains()));
-            bObj.push_back(Pair("TotalPayment", ValueFromAmount(pbudgetProposal->GetAmount() * pbudgetProposal->GetTotalPaymentCount())));
-            bObj.push_back(Pair("MonthlyPayment", ValueFromAmount(pbudgetProposal->GetAmount())));
-
-            bObj.push_back(Pair("IsEstablished", pbudgetProposal->IsEstablished()));
-
-            std::string strError = "";
-            bObj.push_back(Pair("IsValid", pbudgetProposal->IsValid(strError)));
-            bObj.push_back(Pair("IsValidReason", strError.c_str()));
-            bObj.push_back(Pair("fValid", pbudgetProposal->fValid));
-
-            resultObj.push_back(bObj);
-        }
-
+        BOOST_FOREACH (CBudgetProposal* pbudgetProposal, GetProposalsToShow())
+            resultObj.push_back(ProposalToJSON(pbudgetProposal));
         return resultObj;
     }
 
@@ -575,6 +577,19 @@ if(strCommand == "vote-alias")
     return Value::null;
 }
 
+void mnbudget_stream(const Array& params, JSONStreamWriter& writer)
+{
+    if (params.size() < 1 || params[0].get_str() != "show") {
+        writer.WriteValue(mnbudget(params, false));
+        return;
+    }
+
+    writer.BeginArray();
+    BOOST_FOREACH (CBudgetProposal* pbudgetProposal, GetProposalsToShow())
+        writer.WriteValue(ProposalToJSON(pbudgetProposal));
+    writer.EndArray();
+}
+
 Value mnbudgetvoteraw(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 6)
@@ -617,7 +632,7 @@ Value mnbudgetvoteraw(const Array& params, bool fHelp)
 
     std::string strError = "";
     if (budget.UpdateProposal(vote, NULL, strError)) {
-        budget.mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        budget.AddSeen(budget.mapSeenServicenodeBudgetVotes, vote);
         vote.Relay();
         return "Voted successfully";
     } else {
@@ -695,7 +710,7 @@ Value mnfinalbudget(const Array& params, bool fHelp)
 
             std::string strError = "";
             if (budget.UpdateFinalizedBudget(vote, NULL, strError)) {
-                budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+                budget.AddSeen(budget.mapSeenFinalizedBudgetVotes, vote);
                 vote.Relay();
                 success++;
                 statusObj.push_back(Pair("result", "success"));
@@ -740,7 +755,7 @@ Value mnfinalbudget(const Array& params, bool fHelp)
 
         std::string strError = "";
         if (budget.UpdateFinalizedBudget(vote, NULL, strError)) {
-            budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+            budget.AddSeen(budget.mapSeenFinalizedBudgetVotes, vote);
             vote.Relay();
             return "success";
         } else {
@@ -190,8 +190,9 @@ Value servicenode(const Array& params, bool fHelp)
             Object obj;
             int nCount = 0;
 
-            if (chainActive.Tip())
-                mnodeman.GetNextServicenodeInQueueForPayment(chainActive.Tip()->nHeight, true, nCount);
+            const CBlockIndex* pindexTip = GetChainTipSnapshot();
+            if (pindexTip)
+                mnodeman.GetNextServicenodeInQueueForPayment(pindexTip->nHeight, true, nCount);
 
             obj.push_back(Pair("total", mnodeman.size()));
             //obj.push_back(Pair("stable", mnodeman.stable_size()));
@@ -633,6 +634,43 @@ Value servicenode(const Array& params, bool fHelp)
     return Value::null;
 }
 
+/** Height the servicenodes of servicenodelist are ranked at; false before the first block */
+static bool GetServicenodeListHeight(int& nHeight)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindex = chainActive.Tip();
+    if (!pindex) return false;
+    nHeight = pindex->nHeight;
+    return true;
+}
+
+/** One servicenode of servicenodelist; false if strFilter leaves it out */
+static bool ServicenodeToJSON(const pair<int, CServicenode>& s, const std::string& strFilter, Object& obj)
+{
+    std::string strTxHash = s.second.vin.prevout.hash.ToString();
+    uint32_t oIdx = s.second.vin.prevout.n;
+
+    CServicenode* mn = mnodeman.Find(s.second.vin);
+
+    if (strFilter != "" && strTxHash.find(strFilter) == string::npos &&
+        mn->Status().find(strFilter) == string::npos &&
+        CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString().find(strFilter) == string::npos) return false;
+
+    std::string strStatus = mn->Status();
+
+    obj.push_back(Pair("rank", (strStatus == "ENABLED" ? s.first : 0)));
+    obj.push_back(Pair("txhash", strTxHash));
+    obj.push_back(Pair("outidx", (uint64_t)oIdx));
+    obj.push_back(Pair("status", strStatus));
+    obj.push_back(Pair("addr", CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString()));
+    obj.push_back(Pair("version", mn->protocolVersion));
+    obj.push_back(Pair("lastseen", (int64_t)mn->lastPing.sigTime));
+    obj.push_back(Pair("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime)));
+    obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid()));
+    obj.push_back(Pair("xwallets", mn->GetServices()));
+    return true;
+}
+
 Value servicenodelist(const Array& params, bool fHelp)
 {
     std::string strFilter = "";
@@ -669,40 +707,44 @@ Value servicenodelist(const Array& params, bool fHelp)
 
     Array ret;
     int nHeight;
-    {
-        LOCK(cs_main);
-        CBlockIndex* pindex = chainActive.Tip();
-        if(!pindex) return 0;
-        nHeight = pindex->nHeight;
-    }
+    if (!GetServicenodeListHeight(nHeight))
+        return 0;
     std::vector<pair<int, CServicenode> > vServicenodeRanks = mnodeman.GetServicenodeRanks(nHeight);
     BOOST_FOREACH (PAIRTYPE(int, CServicenode) & s, vServicenodeRanks) {
         Object obj;
-        std::string strVin = s.second.vin.prevout.ToStringShort();
-        std::string strTxHash = s.second.vin.prevout.hash.ToString();
-        uint32_t oIdx = s.second.vin.prevout.n;
-
-        CServicenode* mn = mnodeman.Find(s.second.vin);
-
-        if (strFilter != "" && strTxHash.find(strFilter) == string::npos &&
-            mn->Status().find(strFilter) == string::npos &&
-            CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString().find(strFilter) == string::npos) continue;
-
-        std::string strStatus = mn->Status();
-
-        obj.push_back(Pair("rank", (strStatus == "ENABLED" ? s.first : 0)));
-        obj.push_back(Pair("txhash", strTxHash));
-        obj.push_back(Pair("outidx", (uint64_t)oIdx));
-        obj.push_back(Pair("status", strStatus));
-        obj.push_back(Pair("addr", CBitcoinAddress(mn->pubKeyCollateralAddress.GetID()).ToString()));
-        obj.push_back(Pair("version", mn->protocolVersion));
-        obj.push_back(Pair("lastseen", (int64_t)mn->lastPing.sigTime));
-        obj.push_back(Pair("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime)));
-        obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid()));
-        obj.push_back(Pair("xwallets", mn->GetServices()));
-
-        ret.push_back(obj);
+        if (ServicenodeToJSON(s, strFilter, obj))
+            ret.push_back(obj);
     }
 
     return ret;
 }
+
+void servicenodelist_stream(const Array& params, JSONStreamWriter& writer)
+{
+    int nHeight;
+    if (params.size() > 1 || !GetServicenodeListHeight(nHeight)) {
+        writer.WriteValue(servicenodelist(params, false));
+        return;
+    }
+    std::string strFilter = "";
+    if (params.size() == 1) strFilter = params[0].get_str();
+
+    std::vector<pair<int, CServicenode> > vServicenodeRanks = mnodeman.GetServicenodeRanks(nHeight);
+    writer.BeginArray();
+    BOOST_FOREACH (PAIRTYPE(int, CServicenode) & s, vServicenodeRanks) {
+        Object obj;
+        if (ServicenodeToJSON(s, strFilter, obj))
+            writer.WriteValue(obj);
+    }
+    writer.EndArray();
+}
+
+void servicenode_stream(const Array& params, JSONStreamWriter& writer)
+{
+    if (params.size() < 1 || params[0].get_str() != "list") {
+        writer.WriteValue(servicenode(params, false));
+        return;
+    }
+    Array newParams(params.begin() + 1, params.end());
+    servicenodelist_stream(newParams, writer);
+}
@@ -1206,6 +1206,78 @@ void AcentryToJSON(const CAccountingEntry& acentry, const string& strAccount, Ar
     }
 }
 
+/**
+ * A wallet transaction or accounting entry in the result of
+ * listtransactions, with the range of its entries (in the order
+ * ListTransactions() and AcentryToJSON() give them) that falls in the
+ * window asked for
+ */
+struct ListTransactionsItem {
+    uint256 hashTx;
+    const CAccountingEntry* pacentry; //!< NULL for a wallet transaction
+    int nBegin;
+    int nEnd;
+};
+
+/** The entries of one wallet transaction or accounting entry */
+static void ListTransactionsItemEntries(const uint256& hashTx, const CAccountingEntry* pacentry, const string& strAccount, const isminefilter& filter, Array& entries)
+{
+    if (pacentry) {
+        AcentryToJSON(*pacentry, strAccount, entries);
+        return;
+    }
+    std::map<uint256, CWalletTx>::const_iterator mi = pwalletMain->mapWallet.find(hashTx);
+    if (mi != pwalletMain->mapWallet.end())
+        ListTransactions(mi->second, strAccount, 0, true, entries, filter);
+}
+
+/**
+ * Pick the items of listtransactions: counting entries newest first, skip
+ * nFrom of them and take nCount. vItems is newest first; the entries of
+ * accounting entries point into acentries.
+ */
+static void SelectListTransactions(const string& strAccount, int nCount, int nFrom, const isminefilter& filter,
+    std::list<CAccountingEntry>& acentries, std::vector<ListTransactionsItem>& vItems)
+{
+    AssertLockHeld(pwalletMain->cs_wallet);
+    CWallet::TxItems txOrdered = pwalletMain->OrderedTxItems(acentries, strAccount);
+
+    int nEntries = 0;
+    auto addItem = [&](const uint256& hashTx, const CAccountingEntry* pacentry) {
+        Array entries;
+        ListTransactionsItemEntries(hashTx, pacentry, strAccount, filter, entries);
+        ListTransactionsItem item;
+        item.hashTx = hashTx;
+        item.pacentry = pacentry;
+        item.nBegin = std::max(0, nFrom - nEntries);
+        item.nEnd = std::min((int)entries.size(), nFrom + nCount - nEntries);
+        if (item.nBegin < item.nEnd)
+            vItems.push_back(item);
+        nEntries += entries.size();
+    };
+
+    // iterate backwards until we have nCount items to return:
+    for (CWallet::TxItems::reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
+        CWalletTx* const pwtx = (*it).second.first;
+        if (pwtx != 0)
+            addItem(pwtx->GetHash(), NULL);
+        CAccountingEntry* const pacentry = (*it).second.second;
+        if (pacentry != 0)
+            addItem(uint256(), pacentry);
+
+        if (nEntries >= (nCount + nFrom)) break;
+    }
+}
+
+/** Append the entries of item that are in the window, oldest to newest as listtransactions returns them */
+static void ListTransactionsItemToJSON(const ListTransactionsItem& item, const string& strAccount, const isminefilter& filter, Array& ret)
+{
+    Array entries;
+    ListTransactionsItemEntries(item.hashTx, item.pacentry, strAccount, filter, entries);
+    for (int i = std::min(item.nEnd, (int)entries.size()) - 1; i >= item.nBegin; i--)
+        ret.push_back(entries[i]);
+}
+
 Value listtransactions(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() > 4)
@@ -1280,39 +1352,65 @@ Value listtransactions(const Array& params, bool fHelp)
     if (nFrom < 0)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
 
-    Array ret;
-
+    LOCK2(cs_main, pwalletMain->cs_wallet);
     std::list<CAccountingEntry> acentries;
-    CWallet::TxItems txOrdered = pwalletMain->OrderedTxItems(acentries, strAccount);
+    std::vector<ListTransactionsItem> vItems;
+    SelectListTransactions(strAccount, nCount, nFrom, filter, acentries, vItems);
 
-    // iterate backwards until we have nCount items to return:
-    for (CWallet::TxItems::reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
-        CWalletTx* const pwtx = (*it).second.first;
-        if (pwtx != 0)
-            ListTransactions(*pwtx, strAccount, 0, true, ret, filter);
-        CAccountingEntry* const pacentry = (*it).second.second;
-        if (pacentry != 0)
-            AcentryToJSON(*pacentry, strAccount, ret);
+    Array ret;
+    for (std::vector<ListTransactionsItem>::reverse_iterator it = vItems.rbegin(); it != vItems.rend(); ++it)
+        ListTransactionsItemToJSON(*it, strAccount, filter, ret);
+    return ret;
+}
 
-        if ((int)ret.size() >= (nCount + nFrom)) break;
+void listtransactions_stream(const Array& params, JSONStreamWriter& writer)
+{
+    if (params.size() > 4) {
+        writer.WriteValue(listtransactions(params, false));
+        return;
     }
-    // ret is newest to oldest
 
-    if (nFrom > (int)ret.size())
-        nFrom = ret.size();
-    if ((nFrom + nCount) > (int)ret.size())
-        nCount = ret.size() - nFrom;
-    Array::iterator first = ret.begin();
-    std::advance(first, nFrom);
-    Array::iterator last = ret.begin();
-    std::advance(last, nFrom + nCount);
+    string strAccount = "*";
+    if (params.size() > 0)
+        strAccount = params[0].get_str();
+    int nCount = 10;
+    if (params.size() > 1)
+        nCount = params[1].get_int();
+    int nFrom = 0;
+    if (params.size() > 2)
+        nFrom = params[2].get_int();
+    isminefilter filter = ISMINE_SPENDABLE;
+    if (params.size() > 3)
+        if (params[3].get_bool())
+            filter = filter | ISMINE_WATCH_ONLY;
 
-    if (last != ret.end()) ret.erase(last, ret.end());
-    if (first != ret.begin()) ret.erase(ret.begin(), first);
+    if (nCount < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+    if (nFrom < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
 
-    std::reverse(ret.begin(), ret.end()); // Return oldest to newest
+    std::list<CAccountingEntry> acentries;
+    std::vector<ListTransactionsItem> vItems;
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        SelectListTransactions(strAccount, nCount, nFrom, filter, acentries, vItems);
+    }
 
-    return ret;
+    // Taken a batch at a time, and written without the locks, as writing
+    // waits for a slow client
+    writer.BeginArray();
+    std::vector<ListTransactionsItem>::reverse_iterator it = vItems.rbegin();
+    while (it != vItems.rend()) {
+        Array batch;
+        {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            for (int i = 0; i < 100 && it != vItems.rend(); i++, ++it)
+                ListTransactionsItemToJSON(*it, strAccount, filter, batch);
+        }
+        BOOST_FOREACH (const Value& entry, batch)
+            writer.WriteValue(entry);
+    }
+    writer.EndArray();
 }
 
 Value listaccounts(const Array& params, bool fHelp)
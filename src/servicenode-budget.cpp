@@ -10,6 +10,7 @@
 #include "addrman.h"
 #include "servicenode-budget.h"
 #include "servicenode-sync.h"
+#include "servicenodedb.h"
 #include "servicenode.h"
 #include "servicenodeman.h"
 #include "obfuscation.h"
@@ -124,6 +125,7 @@ void CBudgetManager::CheckOrphanVotes()
     while (it1 != mapOrphanServicenodeBudgetVotes.end()) {
         if (budget.UpdateProposal(((*it1).second), NULL, strError)) {
             LogPrintf("CBudgetManager::CheckOrphanVotes - Proposal/Budget is known, activating and removing orphan vote\n");
+            dirtyOrphanProposalVotes.Mark((*it1).first);
             mapOrphanServicenodeBudgetVotes.erase(it1++);
         } else {
             ++it1;
@@ -133,6 +135,7 @@ void CBudgetManager::CheckOrphanVotes()
     while (it2 != mapOrphanFinalizedBudgetVotes.end()) {
         if (budget.UpdateFinalizedBudget(((*it2).second), NULL, strError)) {
             LogPrintf("CBudgetManager::CheckOrphanVotes - Proposal/Budget is known, activating and removing orphan vote\n");
+            dirtyOrphanFinalizedBudgetVotes.Mark((*it2).first);
             mapOrphanFinalizedBudgetVotes.erase(it2++);
         } else {
             ++it2;
@@ -180,7 +183,7 @@ void CBudgetManager::SubmitFinalBudget()
     CFinalizedBudgetBroadcast tempBudget(strBudgetName, nBlockStart, vecTxBudgetPayments, 0);
     {
         LOCK(cs);
-        if (mapSeenFinalizedBudgets.count(tempBudget.GetHash())) {
+        if (HaveSeen(mapSeenFinalizedBudgets, tempBudget.GetHash())) {
             LogPrintf("CBudgetManager::SubmitFinalBudget - Budget already exists - %s\n", tempBudget.GetHash().ToString());
             nSubmittedHeight = nCurrentHeight;
             return; //already exists
@@ -249,168 +252,13 @@ void CBudgetManager::SubmitFinalBudget()
     }
 
     LOCK(cs);
-    mapSeenFinalizedBudgets.insert(make_pair(finalizedBudgetBroadcast.GetHash(), finalizedBudgetBroadcast));
+    AddSeen(mapSeenFinalizedBudgets, finalizedBudgetBroadcast);
     finalizedBudgetBroadcast.Relay();
     budget.AddFinalizedBudget(finalizedBudgetBroadcast);
     nSubmittedHeight = nCurrentHeight;
     LogPrintf("CBudgetManager::SubmitFinalBudget - Done! %s\n", finalizedBudgetBroadcast.GetHash().ToString());
 }
 
-//
-// CBudgetDB
-//
-
-CBudgetDB::CBudgetDB()
-{
-    pathDB = GetDataDir() / "budget.dat";
-    strMagicMessage = "ServicenodeBudget";
-}
-
-bool CBudgetDB::Write(const CBudgetManager& objToSave)
-{
-    LOCK(objToSave.cs);
-
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // servicenode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
-
-    LogPrintf("Written info to budget.dat  %dms\n", GetTimeMillis() - nStart);
-
-    return true;
-}
-
-CBudgetDB::ReadResult CBudgetDB::Read(CBudgetManager& objToLoad, bool fDryRun)
-{
-    LOCK(objToLoad.cs);
-
-    int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathDB.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathDB);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
-
-
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
-    try {
-        // de-serialize file header (servicenode cache file specific magic message) and ..
-        ssObj >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid servicenode cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-
-        // de-serialize file header (network specific magic number) and ..
-        ssObj >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-
-        // de-serialize data into CBudgetManager object
-        ssObj >> objToLoad;
-    } catch (std::exception& e) {
-        objToLoad.Clear();
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return IncorrectFormat;
-    }
-
-    LogPrintf("Loaded info from budget.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", objToLoad.ToString());
-    if (!fDryRun) {
-        LogPrintf("Budget manager - cleaning....\n");
-        objToLoad.CheckAndRemove();
-        LogPrintf("Budget manager - result:\n");
-        LogPrintf("  %s\n", objToLoad.ToString());
-    }
-
-    return Ok;
-}
-
-void DumpBudgets()
-{
-    int64_t nStart = GetTimeMillis();
-
-    CBudgetDB budgetdb;
-    CBudgetManager tempBudget;
-
-    LogPrintf("Verifying budget.dat format...\n");
-    CBudgetDB::ReadResult readResult = budgetdb.Read(tempBudget, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CBudgetDB::FileError)
-        LogPrintf("Missing budgets file - budget.dat, will try to recreate\n");
-    else if (readResult != CBudgetDB::Ok) {
-        LogPrintf("Error reading budget.dat: ");
-        if (readResult == CBudgetDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrintf("Writting info to budget.dat...\n");
-    budgetdb.Write(budget);
-
-    LogPrintf("Budget dump finished  %dms\n", GetTimeMillis() - nStart);
-}
-
 bool CBudgetManager::AddFinalizedBudget(CFinalizedBudget& finalizedBudget)
 {
     LOCK(cs);
@@ -421,7 +269,12 @@ bool CBudgetManager::AddFinalizedBudget(CFinalizedBudget& finalizedBudget)
         return false;
     }
 
-    mapFinalizedBudgets.insert(make_pair(finalizedBudget.GetHash(), finalizedBudget));
+    uint256 hash = finalizedBudget.GetHash();
+    mapFinalizedBudgets.insert(make_pair(hash, finalizedBudget));
+    dirtyFinalizedBudgets.Mark(hash);
+    for (std::map<uint256, CFinalizedBudgetVote>::const_iterator it = finalizedBudget.mapVotes.begin(); it != finalizedBudget.mapVotes.end(); ++it)
+        dirtyFinalizedBudgetVotes.Mark(make_pair(hash, it->first));
+    nBudgetGeneration++;
     return true;
 }
 
@@ -438,7 +291,12 @@ bool CBudgetManager::AddProposal(CBudgetProposal& budgetProposal)
         return false;
     }
 
-    mapProposals.insert(make_pair(budgetProposal.GetHash(), budgetProposal));
+    uint256 hash = budgetProposal.GetHash();
+    mapProposals.insert(make_pair(hash, budgetProposal));
+    dirtyProposals.Mark(hash);
+    for (std::map<uint256, CBudgetVote>::const_iterator it = budgetProposal.mapVotes.begin(); it != budgetProposal.mapVotes.end(); ++it)
+        dirtyProposalVotes.Mark(make_pair(hash, it->first));
+    nBudgetGeneration++;
     LogPrintf("CBudgetManager::AddProposal - proposal %s added\n", budgetProposal.GetName ().c_str ());
     return true;
 }
@@ -455,10 +313,15 @@ void CBudgetManager::CheckAndRemove()
     while (it != mapFinalizedBudgets.end()) {
         CFinalizedBudget* pfinalizedBudget = &((*it).second);
 
-        pfinalizedBudget->fValid = pfinalizedBudget->IsValid(strError);
+        bool fValid = pfinalizedBudget->IsValid(strError);
+        if (pfinalizedBudget->fValid != fValid) nBudgetGeneration++;
+        pfinalizedBudget->fValid = fValid;
         LogPrintf("CBudgetManager::CheckAndRemove - pfinalizedBudget->IsValid - strError: %s\n", strError);
         if (pfinalizedBudget->fValid) {
+            bool fAutoChecked = pfinalizedBudget->IsAutoChecked();
             pfinalizedBudget->AutoCheck();
+            if (pfinalizedBudget->IsAutoChecked() != fAutoChecked)
+                dirtyFinalizedBudgets.Mark((*it).first);
         }
 
         ++it;
@@ -468,7 +331,9 @@ void CBudgetManager::CheckAndRemove()
     std::map<uint256, CBudgetProposal>::iterator it2 = mapProposals.begin();
     while (it2 != mapProposals.end()) {
         CBudgetProposal* pbudgetProposal = &((*it2).second);
-        pbudgetProposal->fValid = pbudgetProposal->IsValid(strError);
+        bool fValid = pbudgetProposal->IsValid(strError);
+        if (pbudgetProposal->fValid != fValid) nBudgetGeneration++;
+        pbudgetProposal->fValid = fValid;
         if (!strError.empty ()) {
             LogPrint("mnbudget", "CBudgetManager::CheckAndRemove - invalid budget proposal %s - %s\n", pbudgetProposal->GetName().c_str (), strError);
             strError = "";
@@ -524,10 +389,21 @@ bool CBudgetManager::FillBlockPayees(CMutableTransaction &txNew, int superblock)
  * @return
  */
 bool CBudgetManager::allValidFinalPayees(std::vector<CTxBudgetPayment> &approvedPayees, int superblock) {
+    AssertLockHeld(cs);
+
     // If not superblock do not proceed
     if (superblock > 0 && superblock % GetBudgetPaymentCycleBlocks() != 0)
         return false;
 
+    // Block validation and block creation ask for the same superblock over and over,
+    // the answer only changes with the votes or the servicenode count
+    int nEnabled = mnodeman.CountEnabled(ActiveProtocol());
+    if (fPayeesCacheValid && nPayeesCacheGeneration == nBudgetGeneration &&
+        nPayeesCacheBlock == superblock && nPayeesCacheEnabled == nEnabled) {
+        approvedPayees = vPayeesCache;
+        return !approvedPayees.empty();
+    }
+
     // We want to ensure highest voted budgets make it in the superblock (sort them descending by votes)
     std::vector<CFinalizedBudget*> sorted;
     for (auto &item : mapFinalizedBudgets) {
@@ -550,7 +426,7 @@ bool CBudgetManager::allValidFinalPayees(std::vector<CTxBudgetPayment> &approved
     for (auto finalizedBudget : sorted) {
         // Must have votes and valid start and end blocks and have enough votes (10% consensus)
         if (finalizedBudget->GetVoteCount() > 0 &&
-            finalizedBudget->GetVoteCount() > (double)mnodeman.CountEnabled(ActiveProtocol()) / 10 &&
+            finalizedBudget->GetVoteCount() > (double)nEnabled / 10 &&
             superblock >= finalizedBudget->GetBlockStart() &&
             superblock <= finalizedBudget->GetBlockEnd()) {
             // Get finalized budget payees (these are sorted by highest votes first)
@@ -575,6 +451,12 @@ bool CBudgetManager::allValidFinalPayees(std::vector<CTxBudgetPayment> &approved
     for (const auto &payee : uniquePayees)
         approvedPayees.push_back(payee);
 
+    vPayeesCache = approvedPayees;
+    fPayeesCacheValid = true;
+    nPayeesCacheGeneration = nBudgetGeneration;
+    nPayeesCacheBlock = superblock;
+    nPayeesCacheEnabled = nEnabled;
+
     // Must have payees to succeed
     return !approvedPayees.empty();
 }
@@ -697,10 +579,9 @@ std::vector<CBudgetProposal*> CBudgetManager::GetAllProposals()
 
     std::vector<CBudgetProposal*> vBudgetProposalRet;
 
+    // The votes are rechecked by NewBlock and GetBudget, their tallies are current
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove(false);
-
         CBudgetProposal* pbudgetProposal = &((*it).second);
         vBudgetProposalRet.push_back(pbudgetProposal);
 
@@ -724,7 +605,8 @@ struct sortProposalsByVotes {
 
 /**
  * Returns the budget proposals that meet the requirements for the next superblock. This method locks cs_main
- * critical section as it accesses chainActive.Tip
+ * critical section as it accesses chainActive.Tip. The result is cached, it is only recomputed when the chain
+ * height, the enabled servicenode count or any proposal and its counted votes change.
  * @return
  */
 std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
@@ -743,14 +625,25 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
     }
     if (chainHeight <= 0)
         return vBudgetProposalsRet;
-    
+
+    return GetBudget(chainHeight);
+}
+
+std::vector<CBudgetProposal*> CBudgetManager::GetBudget(int chainHeight) {
+    std::vector<CBudgetProposal*> vBudgetProposalsRet;
+    int nEnabled = mnodeman.CountEnabled(ActiveProtocol());
+
     LOCK(cs);
-    
+
+    if (nBudgetCacheGeneration == nBudgetGeneration && nBudgetCacheHeight == chainHeight && nBudgetCacheEnabled == nEnabled)
+        return vBudgetCache;
+
     // Sort budgets by votes
     std::vector<std::pair<CBudgetProposal*, int>> vBudgetProposalsSort;
     for (auto &item : mapProposals) {
         CBudgetProposal *proposal = &(item.second);
-        proposal->CleanAndRemove(false);
+        if (proposal->CleanAndRemove(false))
+            nBudgetGeneration++;
         vBudgetProposalsSort.emplace_back(proposal, proposal->Votes());
     }
     std::sort(vBudgetProposalsSort.begin(), vBudgetProposalsSort.end(), sortProposalsByVotes());
@@ -769,7 +662,7 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
         if (pbudgetProposal->fValid &&                                      // valid proposal
             pbudgetProposal->nBlockStart <= nBlockStart &&                  // valid start
             pbudgetProposal->nBlockEnd >= nNextSuperblock &&                // valid end must be at some point after the next superblock
-            pbudgetProposal->Votes() > (double)mnodeman.CountEnabled(ActiveProtocol()) / 10 && // at least 10% consensus
+            pbudgetProposal->Votes() > (double)nEnabled / 10 &&             // at least 10% consensus
             pbudgetProposal->IsEstablished()) {
             // If the proposal amount fits in the superblock budget proceed
             if (pbudgetProposal->GetAmount() + nBudgetAllocated <= nTotalBudget) {
@@ -782,6 +675,10 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
         }
     }
 
+    vBudgetCache = vBudgetProposalsRet;
+    nBudgetCacheGeneration = nBudgetGeneration;
+    nBudgetCacheHeight = chainHeight;
+    nBudgetCacheEnabled = nEnabled;
     return vBudgetProposalsRet;
 }
 
@@ -956,14 +853,16 @@ void CBudgetManager::NewBlock()
     LogPrint("mnbudget", "CBudgetManager::NewBlock - mapProposals cleanup - size: %d\n", mapProposals.size());
     std::map<uint256, CBudgetProposal>::iterator it2 = mapProposals.begin();
     while (it2 != mapProposals.end()) {
-        (*it2).second.CleanAndRemove(false);
+        if ((*it2).second.CleanAndRemove(false))
+            nBudgetGeneration++;
         ++it2;
     }
 
     LogPrint("mnbudget", "CBudgetManager::NewBlock - mapFinalizedBudgets cleanup - size: %d\n", mapFinalizedBudgets.size());
     std::map<uint256, CFinalizedBudget>::iterator it3 = mapFinalizedBudgets.begin();
     while (it3 != mapFinalizedBudgets.end()) {
-        (*it3).second.CleanAndRemove(false);
+        if ((*it3).second.CleanAndRemove(false))
+            nBudgetGeneration++;
         ++it3;
     }
 
@@ -1051,7 +950,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         CBudgetProposalBroadcast budgetProposalBroadcast;
         vRecv >> budgetProposalBroadcast;
 
-        if (mapSeenServicenodeBudgetProposals.count(budgetProposalBroadcast.GetHash())) {
+        if (HaveSeen(mapSeenServicenodeBudgetProposals, budgetProposalBroadcast.GetHash())) {
             servicenodeSync.AddedBudgetItem(budgetProposalBroadcast.GetHash());
             return;
         }
@@ -1064,7 +963,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             return;
         }
 
-        mapSeenServicenodeBudgetProposals.insert(make_pair(budgetProposalBroadcast.GetHash(), budgetProposalBroadcast));
+        AddSeen(mapSeenServicenodeBudgetProposals, budgetProposalBroadcast);
 
         if (!budgetProposalBroadcast.IsValid(strError)) {
             LogPrintf("mprop - invalid budget proposal - %s\n", strError);
@@ -1088,7 +987,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         vRecv >> vote;
         vote.fValid = true;
 
-        if (mapSeenServicenodeBudgetVotes.count(vote.GetHash())) {
+        if (HaveSeen(mapSeenServicenodeBudgetVotes, vote.GetHash())) {
             servicenodeSync.AddedBudgetItem(vote.GetHash());
             return;
         }
@@ -1101,7 +1000,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         }
 
 
-        mapSeenServicenodeBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        AddSeen(mapSeenServicenodeBudgetVotes, vote);
         if (!vote.SignatureValid(true)) {
             LogPrintf("mvote - signature invalid\n");
             if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
@@ -1123,7 +1022,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         CFinalizedBudgetBroadcast finalizedBudgetBroadcast;
         vRecv >> finalizedBudgetBroadcast;
 
-        if (mapSeenFinalizedBudgets.count(finalizedBudgetBroadcast.GetHash())) {
+        if (HaveSeen(mapSeenFinalizedBudgets, finalizedBudgetBroadcast.GetHash())) {
             servicenodeSync.AddedBudgetItem(finalizedBudgetBroadcast.GetHash());
             return;
         }
@@ -1137,7 +1036,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             return;
         }
 
-        mapSeenFinalizedBudgets.insert(make_pair(finalizedBudgetBroadcast.GetHash(), finalizedBudgetBroadcast));
+        AddSeen(mapSeenFinalizedBudgets, finalizedBudgetBroadcast);
 
         if (!finalizedBudgetBroadcast.IsValid(strError)) {
             LogPrintf("fbs - invalid finalized budget - %s\n", strError);
@@ -1161,7 +1060,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         vRecv >> vote;
         vote.fValid = true;
 
-        if (mapSeenFinalizedBudgetVotes.count(vote.GetHash())) {
+        if (HaveSeen(mapSeenFinalizedBudgetVotes, vote.GetHash())) {
             servicenodeSync.AddedBudgetItem(vote.GetHash());
             return;
         }
@@ -1173,7 +1072,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             return;
         }
 
-        mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        AddSeen(mapSeenFinalizedBudgetVotes, vote);
         if (!vote.SignatureValid(true)) {
             LogPrintf("fbvote - signature invalid\n");
             if (servicenodeSync.IsSynced()) Misbehaving(pfrom->GetId(), 20);
@@ -1200,15 +1099,27 @@ bool CBudgetManager::PropExists(uint256 nHash)
     return false;
 }
 
+void CBudgetManager::GetSeenHashes(std::vector<uint256>& vProposalsRet, std::vector<uint256>& vFinalizedBudgetsRet) const
+{
+    LOCK(cs_seen);
+    vProposalsRet.reserve(mapSeenServicenodeBudgetProposals.size());
+    for (std::map<uint256, CBudgetProposalBroadcast>::const_iterator it = mapSeenServicenodeBudgetProposals.begin(); it != mapSeenServicenodeBudgetProposals.end(); ++it)
+        vProposalsRet.push_back(it->first);
+    vFinalizedBudgetsRet.reserve(mapSeenFinalizedBudgets.size());
+    for (std::map<uint256, CFinalizedBudgetBroadcast>::const_iterator it = mapSeenFinalizedBudgets.begin(); it != mapSeenFinalizedBudgets.end(); ++it)
+        vFinalizedBudgetsRet.push_back(it->first);
+}
+
 //mark that a full sync is needed
 void CBudgetManager::ResetSync()
 {
     LOCK(cs);
 
+    std::vector<uint256> vProposals, vFinalizedBudgets;
+    GetSeenHashes(vProposals, vFinalizedBudgets);
 
-    std::map<uint256, CBudgetProposalBroadcast>::iterator it1 = mapSeenServicenodeBudgetProposals.begin();
-    while (it1 != mapSeenServicenodeBudgetProposals.end()) {
-        CBudgetProposal* pbudgetProposal = FindProposal((*it1).first);
+    BOOST_FOREACH (const uint256& hash, vProposals) {
+        CBudgetProposal* pbudgetProposal = FindProposal(hash);
         if (pbudgetProposal && pbudgetProposal->fValid) {
             //mark votes
             std::map<uint256, CBudgetVote>::iterator it2 = pbudgetProposal->mapVotes.begin();
@@ -1217,12 +1128,10 @@ void CBudgetManager::ResetSync()
                 ++it2;
             }
         }
-        ++it1;
     }
 
-    std::map<uint256, CFinalizedBudgetBroadcast>::iterator it3 = mapSeenFinalizedBudgets.begin();
-    while (it3 != mapSeenFinalizedBudgets.end()) {
-        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget((*it3).first);
+    BOOST_FOREACH (const uint256& hash, vFinalizedBudgets) {
+        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget(hash);
         if (pfinalizedBudget && pfinalizedBudget->fValid) {
             //send votes
             std::map<uint256, CFinalizedBudgetVote>::iterator it4 = pfinalizedBudget->mapVotes.begin();
@@ -1231,7 +1140,6 @@ void CBudgetManager::ResetSync()
                 ++it4;
             }
         }
-        ++it3;
     }
 }
 
@@ -1243,9 +1151,11 @@ void CBudgetManager::MarkSynced()
         Mark that we've sent all valid items
     */
 
-    std::map<uint256, CBudgetProposalBroadcast>::iterator it1 = mapSeenServicenodeBudgetProposals.begin();
-    while (it1 != mapSeenServicenodeBudgetProposals.end()) {
-        CBudgetProposal* pbudgetProposal = FindProposal((*it1).first);
+    std::vector<uint256> vProposals, vFinalizedBudgets;
+    GetSeenHashes(vProposals, vFinalizedBudgets);
+
+    BOOST_FOREACH (const uint256& hash, vProposals) {
+        CBudgetProposal* pbudgetProposal = FindProposal(hash);
         if (pbudgetProposal && pbudgetProposal->fValid) {
             //mark votes
             std::map<uint256, CBudgetVote>::iterator it2 = pbudgetProposal->mapVotes.begin();
@@ -1255,12 +1165,10 @@ void CBudgetManager::MarkSynced()
                 ++it2;
             }
         }
-        ++it1;
     }
 
-    std::map<uint256, CFinalizedBudgetBroadcast>::iterator it3 = mapSeenFinalizedBudgets.begin();
-    while (it3 != mapSeenFinalizedBudgets.end()) {
-        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget((*it3).first);
+    BOOST_FOREACH (const uint256& hash, vFinalizedBudgets) {
+        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget(hash);
         if (pfinalizedBudget && pfinalizedBudget->fValid) {
             //mark votes
             std::map<uint256, CFinalizedBudgetVote>::iterator it4 = pfinalizedBudget->mapVotes.begin();
@@ -1270,7 +1178,6 @@ void CBudgetManager::MarkSynced()
                 ++it4;
             }
         }
-        ++it3;
     }
 }
 
@@ -1291,11 +1198,13 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
 
     int nInvCount = 0;
 
-    std::map<uint256, CBudgetProposalBroadcast>::iterator it1 = mapSeenServicenodeBudgetProposals.begin();
-    while (it1 != mapSeenServicenodeBudgetProposals.end()) {
-        CBudgetProposal* pbudgetProposal = FindProposal((*it1).first);
-        if (pbudgetProposal && pbudgetProposal->fValid && (nProp == 0 || (*it1).first == nProp)) {
-            pfrom->PushInventory(CInv(MSG_BUDGET_PROPOSAL, (*it1).second.GetHash()));
+    std::vector<uint256> vProposals, vFinalizedBudgets;
+    GetSeenHashes(vProposals, vFinalizedBudgets);
+
+    BOOST_FOREACH (const uint256& hash, vProposals) {
+        CBudgetProposal* pbudgetProposal = FindProposal(hash);
+        if (pbudgetProposal && pbudgetProposal->fValid && (nProp == 0 || hash == nProp)) {
+            pfrom->PushInventory(CInv(MSG_BUDGET_PROPOSAL, hash));
             nInvCount++;
 
             //send votes
@@ -1310,7 +1219,6 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
                 ++it2;
             }
         }
-        ++it1;
     }
 
     pfrom->PushMessage("ssc", SERVICENODE_SYNC_BUDGET_PROP, nInvCount);
@@ -1319,11 +1227,10 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
 
     nInvCount = 0;
 
-    std::map<uint256, CFinalizedBudgetBroadcast>::iterator it3 = mapSeenFinalizedBudgets.begin();
-    while (it3 != mapSeenFinalizedBudgets.end()) {
-        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget((*it3).first);
-        if (pfinalizedBudget && pfinalizedBudget->fValid && (nProp == 0 || (*it3).first == nProp)) {
-            pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED, (*it3).second.GetHash()));
+    BOOST_FOREACH (const uint256& hash, vFinalizedBudgets) {
+        CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget(hash);
+        if (pfinalizedBudget && pfinalizedBudget->fValid && (nProp == 0 || hash == nProp)) {
+            pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED, hash));
             nInvCount++;
 
             //send votes
@@ -1338,7 +1245,6 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
                 ++it4;
             }
         }
-        ++it3;
     }
 
     pfrom->PushMessage("ssc", SERVICENODE_SYNC_BUDGET_FIN, nInvCount);
@@ -1357,6 +1263,7 @@ bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string
 
             LogPrintf("CBudgetManager::UpdateProposal - Unknown proposal %s, asking for source proposal\n", vote.nProposalHash.ToString());
             mapOrphanServicenodeBudgetVotes[vote.nProposalHash] = vote;
+            dirtyOrphanProposalVotes.Mark(vote.nProposalHash);
 
             if (!askedForSourceProposalOrBudget.count(vote.nProposalHash)) {
                 pfrom->PushMessage("mnvs", vote.nProposalHash);
@@ -1368,7 +1275,12 @@ bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string
         return false;
     }
 
-    return mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError);
+    if (!mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError))
+        return false;
+
+    dirtyProposalVotes.Mark(make_pair(vote.nProposalHash, vote.vin.prevout.GetHash()));
+    nBudgetGeneration++;
+    return true;
 }
 
 bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError)
@@ -1383,6 +1295,7 @@ bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pf
 
             LogPrintf("CBudgetManager::UpdateFinalizedBudget - Unknown Finalized Proposal %s, asking for source budget\n", vote.nBudgetHash.ToString());
             mapOrphanFinalizedBudgetVotes[vote.nBudgetHash] = vote;
+            dirtyOrphanFinalizedBudgetVotes.Mark(vote.nBudgetHash);
 
             if (!askedForSourceProposalOrBudget.count(vote.nBudgetHash)) {
                 pfrom->PushMessage("mnvs", vote.nBudgetHash);
@@ -1394,7 +1307,12 @@ bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pf
         return false;
     }
 
-    return mapFinalizedBudgets[vote.nBudgetHash].AddOrUpdateVote(vote, strError);
+    if (!mapFinalizedBudgets[vote.nBudgetHash].AddOrUpdateVote(vote, strError))
+        return false;
+
+    dirtyFinalizedBudgetVotes.Mark(make_pair(vote.nBudgetHash, vote.vin.prevout.GetHash()));
+    nBudgetGeneration++;
+    return true;
 }
 
 CBudgetProposal::CBudgetProposal()
@@ -1405,6 +1323,7 @@ CBudgetProposal::CBudgetProposal()
     nAmount = 0;
     nTime = 0;
     fValid = true;
+    nYeas = nNays = nAbstains = nRatioYeas = nRatioNays = 0;
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1417,6 +1336,7 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nAmount = nAmountIn;
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
+    nYeas = nNays = nAbstains = nRatioYeas = nRatioNays = 0;
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1431,6 +1351,11 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
     fValid = true;
+    nYeas = other.nYeas;
+    nNays = other.nNays;
+    nAbstains = other.nAbstains;
+    nRatioYeas = other.nRatioYeas;
+    nRatioNays = other.nRatioNays;
 }
 
 bool CBudgetProposal::IsValid(std::string& strError, bool fCheckCollateral)
@@ -1512,76 +1437,99 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
         return false;
     }
 
-    mapVotes[hash] = vote;
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it != mapVotes.end()) {
+        TallyVote(it->second, -1);
+        it->second = vote;
+    } else {
+        it = mapVotes.insert(std::make_pair(hash, vote)).first;
+    }
+    TallyVote(it->second, 1);
     return true;
 }
 
-// If servicenode voted for a proposal, but is now invalid -- remove the vote
-void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
+void CBudgetProposal::TallyVote(const CBudgetVote& vote, int nDelta)
 {
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
+    AssertLockHeld(cs);
+    if (vote.nVote == VOTE_YES) {
+        nRatioYeas += nDelta;
+        if (vote.fValid) nYeas += nDelta;
+    } else if (vote.nVote == VOTE_NO) {
+        nRatioNays += nDelta;
+        if (vote.fValid) nNays += nDelta;
+    } else if (vote.nVote == VOTE_ABSTAIN) {
+        if (vote.fValid) nAbstains += nDelta;
+    }
+}
 
+void CBudgetProposal::RecountVotes()
+{
+    LOCK(cs);
+    nYeas = nNays = nAbstains = nRatioYeas = nRatioNays = 0;
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
     while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        TallyVote((*it).second, 1);
         ++it;
     }
 }
 
-double CBudgetProposal::GetRatio()
+void CBudgetProposal::LoadVote(const uint256& hash, const CBudgetVote& vote)
 {
-    int yeas = 0;
-    int nays = 0;
+    LOCK(cs);
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it != mapVotes.end()) {
+        TallyVote(it->second, -1);
+        it->second = vote;
+    } else {
+        it = mapVotes.insert(std::make_pair(hash, vote)).first;
+    }
+    TallyVote(it->second, 1);
+}
 
+// If servicenode voted for a proposal, but is now invalid -- remove the vote
+bool CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
+{
+    LOCK(cs);
+    bool fChanged = false;
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES) yeas++;
-        if ((*it).second.nVote == VOTE_NO) nays++;
+        bool fValidVote = (*it).second.SignatureValid(fSignatureCheck);
+        if ((*it).second.fValid != fValidVote) {
+            TallyVote((*it).second, -1);
+            (*it).second.fValid = fValidVote;
+            TallyVote((*it).second, 1);
+            fChanged = true;
+        }
         ++it;
     }
+    return fChanged;
+}
 
-    if (yeas + nays == 0) return 0.0f;
+double CBudgetProposal::GetRatio()
+{
+    LOCK(cs);
+    if (nRatioYeas + nRatioNays == 0) return 0.0f;
 
-    return ((double)(yeas) / (double)(yeas + nays));
+    return ((double)(nRatioYeas) / (double)(nRatioYeas + nRatioNays));
 }
 
 int CBudgetProposal::GetYeas()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    LOCK(cs);
+    return nYeas;
 }
 
 int CBudgetProposal::GetNays()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_NO && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    LOCK(cs);
+    return nNays;
 }
 
 int CBudgetProposal::GetAbstains()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_ABSTAIN && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    LOCK(cs);
+    return nAbstains;
 }
 
 int CBudgetProposal::GetBlockStartCycle()
@@ -1686,7 +1634,7 @@ bool CBudgetVote::Sign(CKey& keyServicenode, CPubKey& pubKeyServicenode)
     CKey keyCollateralAddress;
 
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyServicenode)) {
         LogPrintf("CBudgetVote::Sign - Error upon calling SignMessage");
@@ -1701,10 +1649,15 @@ bool CBudgetVote::Sign(CKey& keyServicenode, CPubKey& pubKeyServicenode)
     return true;
 }
 
+std::string CBudgetVote::GetSignatureMessage() const
+{
+    return vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+}
+
 bool CBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     CServicenode* pmn = mnodeman.Find(vin);
 
@@ -1845,15 +1798,21 @@ void CFinalizedBudget::AutoCheck()
 }
 
 // If servicenode voted for a proposal, but is now invalid -- remove the vote
-void CFinalizedBudget::CleanAndRemove(bool fSignatureCheck)
+bool CFinalizedBudget::CleanAndRemove(bool fSignatureCheck)
 {
     LOCK(cs);
+    bool fChanged = false;
     std::map<uint256, CFinalizedBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        bool fValidVote = (*it).second.SignatureValid(fSignatureCheck);
+        if ((*it).second.fValid != fValidVote) {
+            (*it).second.fValid = fValidVote;
+            fChanged = true;
+        }
         ++it;
     }
+    return fChanged;
 }
 
 
@@ -2034,7 +1993,7 @@ void CFinalizedBudget::SubmitVote()
     if (budget.UpdateFinalizedBudget(vote, NULL, strError)) {
         LogPrintf("CFinalizedBudget::SubmitVote  - new finalized budget vote - %s\n", vote.GetHash().ToString());
 
-        budget.mapSeenFinalizedBudgetVotes.insert(make_pair(vote.GetHash(), vote));
+        budget.AddSeen(budget.mapSeenFinalizedBudgetVotes, vote);
         vote.Relay();
     } else {
         LogPrintf("CFinalizedBudget::SubmitVote : Error submitting vote - %s\n", strError);
@@ -2122,7 +2081,7 @@ bool CFinalizedBudgetVote::Sign(CKey& keyServicenode, CPubKey& pubKeyServicenode
     CKey keyCollateralAddress;
 
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyServicenode)) {
         LogPrintf("CFinalizedBudgetVote::Sign - Error upon calling SignMessage");
@@ -2137,11 +2096,16 @@ bool CFinalizedBudgetVote::Sign(CKey& keyServicenode, CPubKey& pubKeyServicenode
     return true;
 }
 
+std::string CFinalizedBudgetVote::GetSignatureMessage() const
+{
+    return vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+}
+
 bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string errorMessage;
 
-    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     CServicenode* pmn = mnodeman.Find(vin);
 
@@ -2169,3 +2133,189 @@ std::string CBudgetManager::ToString() const
 
     return info.str();
 }
+
+/** A proposal as kept in the state database, without its votes */
+class CBudgetProposalState
+{
+public:
+    CBudgetProposal& proposal;
+
+    explicit CBudgetProposalState(const CBudgetProposal& proposalIn) : proposal(const_cast<CBudgetProposal&>(proposalIn)) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(LIMITED_STRING(proposal.strProposalName, 20));
+        READWRITE(LIMITED_STRING(proposal.strURL, 64));
+        READWRITE(proposal.nTime);
+        READWRITE(proposal.nBlockStart);
+        READWRITE(proposal.nBlockEnd);
+        READWRITE(proposal.nAmount);
+        READWRITE(proposal.address);
+        READWRITE(proposal.nFeeTXHash);
+    }
+};
+
+/** A finalized budget as kept in the state database, without its votes */
+class CFinalizedBudgetState
+{
+public:
+    CFinalizedBudget& finalizedBudget;
+
+    explicit CFinalizedBudgetState(const CFinalizedBudget& finalizedBudgetIn) : finalizedBudget(const_cast<CFinalizedBudget&>(finalizedBudgetIn)) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(LIMITED_STRING(finalizedBudget.strBudgetName, 20));
+        READWRITE(finalizedBudget.nFeeTXHash);
+        READWRITE(finalizedBudget.nTime);
+        READWRITE(finalizedBudget.nBlockStart);
+        READWRITE(finalizedBudget.vecBudgetPayments);
+        READWRITE(finalizedBudget.fAutoChecked);
+    }
+};
+
+/** Write the marked proposals or finalized budgets of mapIn, each as an S; all of them on a full flush */
+template <typename S, typename T>
+static void WriteBudgetRecords(CServicenodeStateDB& db, char chType, const std::map<uint256, T>& mapIn, CServicenodeStateDirty<uint256>& dirty)
+{
+    std::set<uint256> setKeys;
+    dirty.Take(setKeys);
+    if (db.IsFullFlush()) {
+        for (typename std::map<uint256, T>::const_iterator it = mapIn.begin(); it != mapIn.end(); ++it)
+            db.WriteRecord(chType, it->first, S(it->second));
+        return;
+    }
+    BOOST_FOREACH (const uint256& hash, setKeys) {
+        typename std::map<uint256, T>::const_iterator it = mapIn.find(hash);
+        if (it != mapIn.end())
+            db.WriteRecord(chType, it->first, S(it->second));
+        else
+            db.EraseRecord(chType, hash);
+    }
+}
+
+/** Write the marked votes of the proposals or finalized budgets in mapIn, one record each; all of them on a full flush */
+template <typename T>
+static void WriteBudgetVoteRecords(CServicenodeStateDB& db, char chType, const std::map<uint256, T>& mapIn, CServicenodeStateDirty<std::pair<uint256, uint256> >& dirty)
+{
+    std::set<std::pair<uint256, uint256> > setKeys;
+    dirty.Take(setKeys);
+    if (db.IsFullFlush()) {
+        for (typename std::map<uint256, T>::const_iterator it = mapIn.begin(); it != mapIn.end(); ++it) {
+            for (auto itVote = it->second.mapVotes.begin(); itVote != it->second.mapVotes.end(); ++itVote)
+                db.WriteRecord(chType, std::make_pair(it->first, itVote->first), itVote->second);
+        }
+        return;
+    }
+    for (std::set<std::pair<uint256, uint256> >::const_iterator itKey = setKeys.begin(); itKey != setKeys.end(); ++itKey) {
+        typename std::map<uint256, T>::const_iterator it = mapIn.find(itKey->first);
+        if (it != mapIn.end()) {
+            auto itVote = it->second.mapVotes.find(itKey->second);
+            if (itVote != it->second.mapVotes.end()) {
+                db.WriteRecord(chType, *itKey, itVote->second);
+                continue;
+            }
+        }
+        db.EraseRecord(chType, *itKey);
+    }
+}
+
+void CBudgetManager::MarkAllDirty()
+{
+    AssertLockHeld(cs);
+    for (std::map<uint256, CBudgetProposal>::const_iterator it = mapProposals.begin(); it != mapProposals.end(); ++it) {
+        dirtyProposals.Mark(it->first);
+        for (std::map<uint256, CBudgetVote>::const_iterator itVote = it->second.mapVotes.begin(); itVote != it->second.mapVotes.end(); ++itVote)
+            dirtyProposalVotes.Mark(std::make_pair(it->first, itVote->first));
+    }
+    for (std::map<uint256, CFinalizedBudget>::const_iterator it = mapFinalizedBudgets.begin(); it != mapFinalizedBudgets.end(); ++it) {
+        dirtyFinalizedBudgets.Mark(it->first);
+        for (std::map<uint256, CFinalizedBudgetVote>::const_iterator itVote = it->second.mapVotes.begin(); itVote != it->second.mapVotes.end(); ++itVote)
+            dirtyFinalizedBudgetVotes.Mark(std::make_pair(it->first, itVote->first));
+    }
+    for (std::map<uint256, CBudgetVote>::const_iterator it = mapOrphanServicenodeBudgetVotes.begin(); it != mapOrphanServicenodeBudgetVotes.end(); ++it)
+        dirtyOrphanProposalVotes.Mark(it->first);
+    for (std::map<uint256, CFinalizedBudgetVote>::const_iterator it = mapOrphanFinalizedBudgetVotes.begin(); it != mapOrphanFinalizedBudgetVotes.end(); ++it)
+        dirtyOrphanFinalizedBudgetVotes.Mark(it->first);
+}
+
+void CBudgetManager::WriteState(CServicenodeStateDB& db)
+{
+    LOCK(cs);
+    // The seen proposals and votes are cleared on startup, they are not kept.
+    // A vote is a record of its own, so one coming in rewrites only itself.
+    WriteBudgetRecords<CBudgetProposalState>(db, 'q', mapProposals, dirtyProposals);
+    WriteBudgetVoteRecords(db, 'v', mapProposals, dirtyProposalVotes);
+    WriteBudgetRecords<CFinalizedBudgetState>(db, 'g', mapFinalizedBudgets, dirtyFinalizedBudgets);
+    WriteBudgetVoteRecords(db, 'h', mapFinalizedBudgets, dirtyFinalizedBudgetVotes);
+    db.WriteRecords('o', mapOrphanServicenodeBudgetVotes, dirtyOrphanProposalVotes);
+    db.WriteRecords('O', mapOrphanFinalizedBudgetVotes, dirtyOrphanFinalizedBudgetVotes);
+}
+
+bool CBudgetManager::LoadState(char chType, CDataStream& ssKey, CDataStream& ssValue)
+{
+    // The records come sorted by type, so a proposal ('q') or finalized
+    // budget ('g') is back before its votes ('v', 'h')
+    LOCK(cs);
+    uint256 hash;
+    nBudgetGeneration++;
+    switch (chType) {
+    case 'q': {
+        ssKey >> hash;
+        CBudgetProposal proposal;
+        CBudgetProposalState state(proposal);
+        ssValue >> state;
+        mapProposals.insert(make_pair(hash, proposal));
+        return true;
+    }
+    case 'v': {
+        uint256 hashVote;
+        ssKey >> hash >> hashVote;
+        std::map<uint256, CBudgetProposal>::iterator it = mapProposals.find(hash);
+        if (it == mapProposals.end())
+            return false;
+        CBudgetVote vote;
+        ssValue >> vote;
+        it->second.LoadVote(hashVote, vote);
+        return true;
+    }
+    case 'g': {
+        ssKey >> hash;
+        CFinalizedBudget& finalizedBudget = mapFinalizedBudgets[hash];
+        CFinalizedBudgetState state(finalizedBudget);
+        try {
+            ssValue >> state;
+        } catch (...) {
+            mapFinalizedBudgets.erase(hash);
+            throw;
+        }
+        return true;
+    }
+    case 'h': {
+        uint256 hashVote;
+        ssKey >> hash >> hashVote;
+        std::map<uint256, CFinalizedBudget>::iterator it = mapFinalizedBudgets.find(hash);
+        if (it == mapFinalizedBudgets.end())
+            return false;
+        CFinalizedBudgetVote vote;
+        ssValue >> vote;
+        it->second.mapVotes[hashVote] = vote;
+        return true;
+    }
+    case 'o':
+        ssKey >> hash;
+        ssValue >> mapOrphanServicenodeBudgetVotes[hash];
+        return true;
+    case 'O':
+        ssKey >> hash;
+        ssValue >> mapOrphanFinalizedBudgetVotes[hash];
+        return true;
+    }
+    return false;
+}
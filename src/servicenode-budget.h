@@ -11,6 +11,7 @@
 #include "key.h"
 #include "main.h"
 #include "servicenode.h"
+#include "servicenodedb.h"
 #include "net.h"
 #include "sync.h"
 #include "util.h"
@@ -38,7 +39,6 @@ extern std::vector<CBudgetProposalBroadcast> vecImmatureBudgetProposals;
 extern std::vector<CFinalizedBudgetBroadcast> vecImmatureFinalizedBudgets;
 
 extern CBudgetManager budget;
-void DumpBudgets();
 
 // Define amount of blocks in budget payment cycle
 int GetBudgetPaymentCycleBlocks();
@@ -71,6 +71,7 @@ public:
 
     bool Sign(CKey& keyServicenode, CPubKey& pubKeyServicenode);
     bool SignatureValid(bool fSignatureCheck);
+    std::string GetSignatureMessage() const;
     void Relay();
 
     std::string GetVoteString()
@@ -81,7 +82,7 @@ public:
         return ret;
     }
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << vin;
@@ -123,9 +124,10 @@ public:
 
     bool Sign(CKey& keyServicenode, CPubKey& pubKeyServicenode);
     bool SignatureValid(bool fSignatureCheck);
+    std::string GetSignatureMessage() const;
     void Relay();
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << vin;
@@ -146,30 +148,6 @@ public:
     }
 };
 
-/** Save Budget Manager (budget.dat)
- */
-class CBudgetDB
-{
-private:
-    boost::filesystem::path pathDB;
-    std::string strMagicMessage;
-
-public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
-    CBudgetDB();
-    bool Write(const CBudgetManager& objToSave);
-    ReadResult Read(CBudgetManager& objToLoad, bool fDryRun = false);
-};
-
 
 //
 // Budget Manager : Contains all proposals for the budget
@@ -182,6 +160,35 @@ private:
     map<uint256, uint256> mapCollateralTxids;
     bool allValidFinalPayees(std::vector<CTxBudgetPayment> &approvedPayees, int superblock);
 
+    // bumped whenever proposals, finalized budgets or the votes that count for them change
+    unsigned int nBudgetGeneration;
+    // the last GetBudget result, good while the generation, height and enabled servicenode count hold
+    std::vector<CBudgetProposal*> vBudgetCache;
+    unsigned int nBudgetCacheGeneration;
+    int nBudgetCacheHeight;
+    int nBudgetCacheEnabled;
+    // the last allValidFinalPayees result, on the same terms for its superblock
+    std::vector<CTxBudgetPayment> vPayeesCache;
+    bool fPayeesCacheValid;
+    unsigned int nPayeesCacheGeneration;
+    int nPayeesCacheBlock;
+    int nPayeesCacheEnabled;
+
+    // changed since the last flush to the state database, under cs; votes
+    // are keyed by their proposal or finalized budget and servicenode
+    CServicenodeStateDirty<uint256> dirtyProposals;
+    CServicenodeStateDirty<std::pair<uint256, uint256> > dirtyProposalVotes;
+    CServicenodeStateDirty<uint256> dirtyFinalizedBudgets;
+    CServicenodeStateDirty<std::pair<uint256, uint256> > dirtyFinalizedBudgetVotes;
+    CServicenodeStateDirty<uint256> dirtyOrphanProposalVotes;
+    CServicenodeStateDirty<uint256> dirtyOrphanFinalizedBudgetVotes;
+
+    /** Mark everything as changed, for Clear */
+    void MarkAllDirty();
+
+    /** Snapshot of the seen proposal and finalized budget hashes, taken under cs_seen */
+    void GetSeenHashes(std::vector<uint256>& vProposalsRet, std::vector<uint256>& vFinalizedBudgetsRet) const;
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -190,6 +197,11 @@ public:
     map<uint256, CBudgetProposal> mapProposals;
     map<uint256, CFinalizedBudget> mapFinalizedBudgets;
 
+    // critical section to protect the four mapSeen* maps; the peer message
+    // threads look them up alongside the budget executor, so nothing else is
+    // locked while it is held. Use HaveSeen/GetSeen/AddSeen.
+    mutable CCriticalSection cs_seen;
+
     std::map<uint256, CBudgetProposalBroadcast> mapSeenServicenodeBudgetProposals;
     std::map<uint256, CBudgetVote> mapSeenServicenodeBudgetVotes;
     std::map<uint256, CBudgetVote> mapOrphanServicenodeBudgetVotes;
@@ -201,10 +213,53 @@ public:
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
+        nBudgetGeneration = 0;
+        nBudgetCacheGeneration = 0;
+        nBudgetCacheHeight = -1;
+        nBudgetCacheEnabled = -1;
+        fPayeesCacheValid = false;
+        nPayeesCacheGeneration = 0;
+        nPayeesCacheBlock = -1;
+        nPayeesCacheEnabled = -1;
+    }
+
+    template <typename T>
+    bool HaveSeen(const std::map<uint256, T>& mapSeen, const uint256& hash) const
+    {
+        LOCK(cs_seen);
+        return mapSeen.count(hash);
+    }
+
+    template <typename T>
+    bool GetSeen(const std::map<uint256, T>& mapSeen, const uint256& hash, T& itemRet) const
+    {
+        LOCK(cs_seen);
+        typename std::map<uint256, T>::const_iterator it = mapSeen.find(hash);
+        if (it == mapSeen.end())
+            return false;
+        itemRet = it->second;
+        return true;
+    }
+
+    /** Remember item in one of the mapSeen* maps; false if it was seen already */
+    template <typename T>
+    bool AddSeen(std::map<uint256, T>& mapSeen, const T& item)
+    {
+        LOCK(cs_seen);
+        return mapSeen.insert(std::make_pair(item.GetHash(), item)).second;
+    }
+
+    /** Whether hash is any seen proposal, finalized budget or vote */
+    bool HaveSeenItem(const uint256& hash) const
+    {
+        LOCK(cs_seen);
+        return mapSeenServicenodeBudgetProposals.count(hash) || mapSeenServicenodeBudgetVotes.count(hash) ||
+               mapSeenFinalizedBudgets.count(hash) || mapSeenFinalizedBudgetVotes.count(hash);
     }
 
     void ClearSeen()
     {
+        LOCK(cs_seen);
         mapSeenServicenodeBudgetProposals.clear();
         mapSeenServicenodeBudgetVotes.clear();
         mapSeenFinalizedBudgets.clear();
@@ -226,6 +281,8 @@ public:
 
     static CAmount GetTotalBudget(int nHeight);
     std::vector<CBudgetProposal*> GetBudget();
+    /** The proposals paid by the superblock after nChainHeight, cached until votes or the height change */
+    std::vector<CBudgetProposal*> GetBudget(int nChainHeight);
     std::vector<CBudgetProposal*> GetAllProposals();
     std::vector<CFinalizedBudget*> GetFinalizedBudgets();
     bool IsBudgetPaymentBlock(int nBlockHeight);
@@ -246,24 +303,30 @@ public:
         LOCK(cs);
 
         LogPrintf("Budget object cleared\n");
+        nBudgetGeneration++;
+        vBudgetCache.clear();
+        MarkAllDirty();
         mapProposals.clear();
         mapFinalizedBudgets.clear();
-        mapSeenServicenodeBudgetProposals.clear();
-        mapSeenServicenodeBudgetVotes.clear();
-        mapSeenFinalizedBudgets.clear();
-        mapSeenFinalizedBudgetVotes.clear();
+        ClearSeen();
         mapOrphanServicenodeBudgetVotes.clear();
         mapOrphanFinalizedBudgetVotes.clear();
     }
     void CheckAndRemove();
     std::string ToString() const;
 
+    /** Add the state worth keeping across restarts that changed since the last flush to db, see CServicenodeStateDB */
+    void WriteState(CServicenodeStateDB& db);
+    /** Take back one record written by WriteState; false if it is not one of ours */
+    bool LoadState(char chType, CDataStream& ssKey, CDataStream& ssValue);
+
 
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
+        LOCK(cs_seen);
         READWRITE(mapSeenServicenodeBudgetProposals);
         READWRITE(mapSeenServicenodeBudgetVotes);
         READWRITE(mapSeenFinalizedBudgets);
@@ -314,6 +377,8 @@ public:
 class CFinalizedBudget
 {
 private:
+    friend class CFinalizedBudgetState;
+
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
     bool fAutoChecked; //If it matches what we see, we'll auto vote for it (servicenode only)
@@ -330,7 +395,8 @@ public:
     CFinalizedBudget();
     CFinalizedBudget(const CFinalizedBudget& other);
 
-    void CleanAndRemove(bool fSignatureCheck);
+    /** Recheck which votes count, returns true if any of them changed */
+    bool CleanAndRemove(bool fSignatureCheck);
     bool AddOrUpdateVote(CFinalizedBudgetVote& vote, std::string& strError);
     double GetScore();
 
@@ -346,6 +412,11 @@ public:
 
     //check to see if we should vote on this
     void AutoCheck();
+    bool IsAutoChecked()
+    {
+        LOCK(cs);
+        return fAutoChecked;
+    }
     //total blocknetdx paid out by this budget
     CAmount GetTotalPayout();
     //vote on this finalized budget as a servicenode
@@ -354,7 +425,7 @@ public:
     //checks the hashes to make sure we know about them
     string GetStatus();
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << strBudgetName;
@@ -442,6 +513,15 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+    // running tallies of mapVotes, kept up to date by AddOrUpdateVote and CleanAndRemove
+    int nYeas;      // valid votes only
+    int nNays;
+    int nAbstains;
+    int nRatioYeas; // valid or not, as GetRatio has always counted them
+    int nRatioNays;
+
+    void TallyVote(const CBudgetVote& vote, int nDelta);
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -500,9 +580,14 @@ public:
         return GetYeas() - GetNays();
     }
 
-    void CleanAndRemove(bool fSignatureCheck);
+    /** Recheck which votes count, returns true if any of them changed */
+    bool CleanAndRemove(bool fSignatureCheck);
+    /** Recompute the tallies from mapVotes after it was replaced wholesale */
+    void RecountVotes();
+    /** Put back a vote kept in the state database */
+    void LoadVote(const uint256& hash, const CBudgetVote& vote);
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << strProposalName;
@@ -534,6 +619,8 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -562,6 +649,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecountVotes();
+        second.RecountVotes();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
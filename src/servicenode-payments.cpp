@@ -8,6 +8,7 @@
 #include "addrman.h"
 #include "servicenode-budget.h"
 #include "servicenode-sync.h"
+#include "servicenodedb.h"
 #include "servicenodeman.h"
 #include "obfuscation.h"
 #include "spork.h"
@@ -24,156 +25,6 @@ CCriticalSection cs_vecPayments;
 CCriticalSection cs_mapServicenodeBlocks;
 CCriticalSection cs_mapServicenodePayeeVotes;
 
-//
-// CServicenodePaymentDB
-//
-
-CServicenodePaymentDB::CServicenodePaymentDB()
-{
-    pathDB = GetDataDir() / "mnpayments.dat";
-    strMagicMessage = "ServicenodePayments";
-}
-
-bool CServicenodePaymentDB::Write(const CServicenodePayments& objToSave)
-{
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // servicenode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
-
-    LogPrintf("Written info to mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
-
-    return true;
-}
-
-CServicenodePaymentDB::ReadResult CServicenodePaymentDB::Read(CServicenodePayments& objToLoad, bool fDryRun)
-{
-    int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathDB.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathDB);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
-
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
-    try {
-        // de-serialize file header (servicenode cache file specific magic message) and ..
-        ssObj >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid servicenode payement cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-
-        // de-serialize file header (network specific magic number) and ..
-        ssObj >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-
-        // de-serialize data into CServicenodePayments object
-        ssObj >> objToLoad;
-    } catch (std::exception& e) {
-        objToLoad.Clear();
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return IncorrectFormat;
-    }
-
-    LogPrintf("Loaded info from mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", objToLoad.ToString());
-    if (!fDryRun) {
-        LogPrintf("Servicenode payments manager - cleaning....\n");
-        objToLoad.CleanPaymentList();
-        LogPrintf("Servicenode payments manager - result:\n");
-        LogPrintf("  %s\n", objToLoad.ToString());
-    }
-
-    return Ok;
-}
-
-void DumpServicenodePayments()
-{
-    int64_t nStart = GetTimeMillis();
-
-    CServicenodePaymentDB paymentdb;
-    CServicenodePayments tempPayments;
-
-    LogPrintf("Verifying mnpayments.dat format...\n");
-    CServicenodePaymentDB::ReadResult readResult = paymentdb.Read(tempPayments, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CServicenodePaymentDB::FileError)
-        LogPrintf("Missing budgets file - mnpayments.dat, will try to recreate\n");
-    else if (readResult != CServicenodePaymentDB::Ok) {
-        LogPrintf("Error reading mnpayments.dat: ");
-        if (readResult == CServicenodePaymentDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrintf("Writting info to mnpayments.dat...\n");
-    paymentdb.Write(servicenodePayments);
-
-    LogPrintf("Budget dump finished  %dms\n", GetTimeMillis() - nStart);
-}
-
 bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMinted)
 {
     CBlockIndex* pindexPrev = chainActive.Tip();
@@ -372,7 +223,7 @@ void CServicenodePayments::ProcessMessageServicenodePayments(CNode* pfrom, std::
             nHeight = chainActive.Tip()->nHeight;
         }
 
-        if (servicenodePayments.mapServicenodePayeeVotes.count(winner.GetHash())) {
+        if (servicenodePayments.HavePayeeVote(winner.GetHash())) {
             LogPrint("mnpayments", "mnw - Already seen - %s bestHeight %d\n", winner.GetHash().ToString().c_str(), nHeight);
             servicenodeSync.AddedServicenodeWinner(winner.GetHash());
             return;
@@ -421,9 +272,7 @@ bool CServicenodePaymentWinner::Sign(CKey& keyServicenode, CPubKey& pubKeyServic
     std::string errorMessage;
     std::string strServiceNodeSignMessage;
 
-    std::string strMessage = vinServicenode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             payee.ToString();
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyServicenode)) {
         LogPrintf("CServicenodePing::Sign() - Error: %s\n", errorMessage.c_str());
@@ -493,14 +342,16 @@ bool CServicenodePayments::AddWinningServicenode(CServicenodePaymentWinner& winn
         }
 
         mapServicenodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+        dirtyPayeeVotes.Mark(winnerIn.GetHash());
 
         if (!mapServicenodeBlocks.count(winnerIn.nBlockHeight)) {
             CServicenodeBlockPayees blockPayees(winnerIn.nBlockHeight);
             mapServicenodeBlocks[winnerIn.nBlockHeight] = blockPayees;
         }
-    }
 
-    mapServicenodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+        mapServicenodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+        dirtyBlocks.Mark(winnerIn.nBlockHeight);
+    }
 
     return true;
 }
@@ -600,6 +451,22 @@ bool CServicenodePayments::IsTransactionValid(const CTransaction& txNew, int nBl
     return true;
 }
 
+bool CServicenodePayments::HavePayeeVote(const uint256& hash) const
+{
+    LOCK(cs_mapServicenodePayeeVotes);
+    return mapServicenodePayeeVotes.count(hash);
+}
+
+bool CServicenodePayments::GetPayeeVote(const uint256& hash, CServicenodePaymentWinner& winnerRet) const
+{
+    LOCK(cs_mapServicenodePayeeVotes);
+    std::map<uint256, CServicenodePaymentWinner>::const_iterator it = mapServicenodePayeeVotes.find(hash);
+    if (it == mapServicenodePayeeVotes.end())
+        return false;
+    winnerRet = it->second;
+    return true;
+}
+
 void CServicenodePayments::CleanPaymentList()
 {
     LOCK2(cs_mapServicenodePayeeVotes, cs_mapServicenodeBlocks);
@@ -620,7 +487,9 @@ void CServicenodePayments::CleanPaymentList()
 
         if (nHeight - winner.nBlockHeight > nLimit) {
             LogPrint("mnpayments", "CServicenodePayments::CleanPaymentList - Removing old Servicenode payment - block %d\n", winner.nBlockHeight);
-            servicenodeSync.mapSeenSyncMNW.erase((*it).first);
+            servicenodeSync.RemovedServicenodeWinner((*it).first);
+            dirtyPayeeVotes.Mark((*it).first);
+            dirtyBlocks.Mark(winner.nBlockHeight);
             mapServicenodePayeeVotes.erase(it++);
             mapServicenodeBlocks.erase(winner.nBlockHeight);
         } else {
@@ -740,14 +609,19 @@ void CServicenodePaymentWinner::Relay()
     RelayInv(inv);
 }
 
+std::string CServicenodePaymentWinner::GetSignatureMessage() const
+{
+    return vinServicenode.prevout.ToStringShort() +
+           boost::lexical_cast<std::string>(nBlockHeight) +
+           payee.ToString();
+}
+
 bool CServicenodePaymentWinner::SignatureValid()
 {
     CServicenode* pmn = mnodeman.Find(vinServicenode);
 
     if (pmn != NULL) {
-        std::string strMessage = vinServicenode.prevout.ToStringShort() +
-                                 boost::lexical_cast<std::string>(nBlockHeight) +
-                                 payee.ToString();
+        std::string strMessage = GetSignatureMessage();
 
         std::string errorMessage = "";
         if (!obfuScationSigner.VerifyMessage(pmn->pubKeyServicenode, vchSig, strMessage, errorMessage)) {
@@ -796,6 +670,33 @@ std::string CServicenodePayments::ToString() const
     return info.str();
 }
 
+void CServicenodePayments::WriteState(CServicenodeStateDB& db)
+{
+    LOCK2(cs_mapServicenodeBlocks, cs_mapServicenodePayeeVotes);
+    db.WriteRecords('y', mapServicenodePayeeVotes, dirtyPayeeVotes);
+    db.WriteRecords('k', mapServicenodeBlocks, dirtyBlocks);
+}
+
+bool CServicenodePayments::LoadState(char chType, CDataStream& ssKey, CDataStream& ssValue)
+{
+    LOCK2(cs_mapServicenodeBlocks, cs_mapServicenodePayeeVotes);
+    switch (chType) {
+    case 'y': {
+        uint256 hash;
+        ssKey >> hash;
+        ssValue >> mapServicenodePayeeVotes[hash];
+        return true;
+    }
+    case 'k': {
+        int nBlockHeight;
+        ssKey >> nBlockHeight;
+        ssValue >> mapServicenodeBlocks[nBlockHeight];
+        return true;
+    }
+    }
+    return false;
+}
+
 
 int CServicenodePayments::GetOldestBlock()
 {
@@ -9,6 +9,7 @@
 #include "key.h"
 #include "main.h"
 #include "servicenode.h"
+#include "servicenodedb.h"
 #include <boost/lexical_cast.hpp>
 
 using namespace std;
@@ -32,32 +33,6 @@ std::string GetRequiredPaymentsString(int nBlockHeight);
 bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMinted);
 void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool fProofOfStake);
 
-void DumpServicenodePayments();
-
-/** Save Servicenode Payment Data (mnpayments.dat)
- */
-class CServicenodePaymentDB
-{
-private:
-    boost::filesystem::path pathDB;
-    std::string strMagicMessage;
-
-public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
-    CServicenodePaymentDB();
-    bool Write(const CServicenodePayments& objToSave);
-    ReadResult Read(CServicenodePayments& objToLoad, bool fDryRun = false);
-};
-
 class CServicenodePayee
 {
 public:
@@ -182,7 +157,7 @@ public:
         payee = CScript();
     }
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << payee;
@@ -195,6 +170,7 @@ public:
     bool Sign(CKey& keyServicenode, CPubKey& pubKeyServicenode);
     bool IsValid(CNode* pnode, std::string& strError);
     bool SignatureValid();
+    std::string GetSignatureMessage() const;
     void Relay();
 
     void AddPayee(CScript payeeIn)
@@ -239,6 +215,9 @@ private:
 public:
     std::map<uint256, CServicenodePaymentWinner> mapServicenodePayeeVotes;
     std::map<int, CServicenodeBlockPayees> mapServicenodeBlocks;
+    // what changed since the last flush to the state database, under the maps' locks
+    CServicenodeStateDirty<uint256> dirtyPayeeVotes;
+    CServicenodeStateDirty<int> dirtyBlocks;
     std::map<uint256, int> mapServicenodesLastVote; //prevout.hash + prevout.n, nBlockHeight
 
     CServicenodePayments()
@@ -250,11 +229,18 @@ public:
     void Clear()
     {
         LOCK2(cs_mapServicenodeBlocks, cs_mapServicenodePayeeVotes);
+        for (std::map<int, CServicenodeBlockPayees>::const_iterator it = mapServicenodeBlocks.begin(); it != mapServicenodeBlocks.end(); ++it)
+            dirtyBlocks.Mark(it->first);
+        for (std::map<uint256, CServicenodePaymentWinner>::const_iterator it = mapServicenodePayeeVotes.begin(); it != mapServicenodePayeeVotes.end(); ++it)
+            dirtyPayeeVotes.Mark(it->first);
         mapServicenodeBlocks.clear();
         mapServicenodePayeeVotes.clear();
     }
 
     bool AddWinningServicenode(CServicenodePaymentWinner& winner);
+    /// Look up a payment vote by hash, taking cs_mapServicenodePayeeVotes
+    bool HavePayeeVote(const uint256& hash) const;
+    bool GetPayeeVote(const uint256& hash, CServicenodePaymentWinner& winnerRet) const;
     bool ProcessBlock(int nBlockHeight);
 
     void Sync(CNode* node, int nCountNeeded);
@@ -285,6 +271,11 @@ public:
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool fProofOfStake);
     std::string ToString() const;
+
+    /** Add the state worth keeping across restarts that changed since the last flush to db, see CServicenodeStateDB */
+    void WriteState(CServicenodeStateDB& db);
+    /** Take back one record written by WriteState; false if it is not one of ours */
+    bool LoadState(char chType, CDataStream& ssKey, CDataStream& ssValue);
     int GetOldestBlock();
     int GetNewestBlock();
 
@@ -15,8 +15,12 @@
 #include "spork.h"
 #include "util.h"
 #include "addrman.h"
+#include "checkqueue.h"
+#include "obfuscation.h"
 // clang-format on
 
+#include <set>
+
 class CServicenodeSync;
 CServicenodeSync servicenodeSync;
 
@@ -66,9 +70,12 @@ void CServicenodeSync::Reset()
     lastServicenodeList = 0;
     lastServicenodeWinner = 0;
     lastBudgetItem = 0;
-    mapSeenSyncMNB.clear();
-    mapSeenSyncMNW.clear();
-    mapSeenSyncBudget.clear();
+    {
+        LOCK(cs_seen);
+        mapSeenSyncMNB.clear();
+        mapSeenSyncMNW.clear();
+        mapSeenSyncBudget.clear();
+    }
     lastFailure = 0;
     nCountFailures = 0;
     sumServicenodeList = 0;
@@ -82,11 +89,18 @@ void CServicenodeSync::Reset()
     RequestedServicenodeAssets = SERVICENODE_SYNC_INITIAL;
     RequestedServicenodeAttempt = 0;
     nAssetSyncStarted = GetTime();
+    for (int i = 0; i <= SERVICENODE_SYNC_BUDGET; i++)
+        nAssetSyncMillis[i] = 0;
+    nAssetSyncStartedMillis = GetTimeMillis();
+    nSyncStartedMillis = nAssetSyncStartedMillis;
+    nSyncFinishedMillis = 0;
 }
 
 void CServicenodeSync::AddedServicenodeList(uint256 hash)
 {
-    if (mnodeman.mapSeenServicenodeBroadcast.count(hash)) {
+    bool fSeen = mnodeman.HaveSeenBroadcast(hash);
+    LOCK(cs_seen);
+    if (fSeen) {
         if (mapSeenSyncMNB[hash] < SERVICENODE_SYNC_THRESHOLD) {
             lastServicenodeList = GetTime();
             mapSeenSyncMNB[hash]++;
@@ -99,7 +113,9 @@ void CServicenodeSync::AddedServicenodeList(uint256 hash)
 
 void CServicenodeSync::AddedServicenodeWinner(uint256 hash)
 {
-    if (servicenodePayments.mapServicenodePayeeVotes.count(hash)) {
+    bool fSeen = servicenodePayments.HavePayeeVote(hash);
+    LOCK(cs_seen);
+    if (fSeen) {
         if (mapSeenSyncMNW[hash] < SERVICENODE_SYNC_THRESHOLD) {
             lastServicenodeWinner = GetTime();
             mapSeenSyncMNW[hash]++;
@@ -112,8 +128,9 @@ void CServicenodeSync::AddedServicenodeWinner(uint256 hash)
 
 void CServicenodeSync::AddedBudgetItem(uint256 hash)
 {
-    if (budget.mapSeenServicenodeBudgetProposals.count(hash) || budget.mapSeenServicenodeBudgetVotes.count(hash) ||
-        budget.mapSeenFinalizedBudgets.count(hash) || budget.mapSeenFinalizedBudgetVotes.count(hash)) {
+    bool fSeen = budget.HaveSeenItem(hash);
+    LOCK(cs_seen);
+    if (fSeen) {
         if (mapSeenSyncBudget[hash] < SERVICENODE_SYNC_THRESHOLD) {
             lastBudgetItem = GetTime();
             mapSeenSyncBudget[hash]++;
@@ -124,6 +141,18 @@ void CServicenodeSync::AddedBudgetItem(uint256 hash)
     }
 }
 
+void CServicenodeSync::RemovedServicenodeList(const uint256& hash)
+{
+    LOCK(cs_seen);
+    mapSeenSyncMNB.erase(hash);
+}
+
+void CServicenodeSync::RemovedServicenodeWinner(const uint256& hash)
+{
+    LOCK(cs_seen);
+    mapSeenSyncMNW.erase(hash);
+}
+
 bool CServicenodeSync::IsBudgetPropEmpty()
 {
     return sumBudgetItemProp == 0 && countBudgetItemProp > 0;
@@ -136,6 +165,10 @@ bool CServicenodeSync::IsBudgetFinEmpty()
 
 void CServicenodeSync::GetNextAsset()
 {
+    int64_t nNow = GetTimeMillis();
+    if (RequestedServicenodeAssets >= SERVICENODE_SYNC_SPORKS && RequestedServicenodeAssets <= SERVICENODE_SYNC_BUDGET)
+        nAssetSyncMillis[RequestedServicenodeAssets] = nNow - nAssetSyncStartedMillis;
+
     switch (RequestedServicenodeAssets) {
     case (SERVICENODE_SYNC_INITIAL):
     case (SERVICENODE_SYNC_FAILED): // should never be used here actually, use Reset() instead
@@ -152,12 +185,14 @@ void CServicenodeSync::GetNextAsset()
         RequestedServicenodeAssets = SERVICENODE_SYNC_BUDGET;
         break;
     case (SERVICENODE_SYNC_BUDGET):
-        LogPrintf("CServicenodeSync::GetNextAsset - Sync has finished\n");
+        LogPrintf("CServicenodeSync::GetNextAsset - Sync has finished in %dms\n", nNow - nSyncStartedMillis);
         RequestedServicenodeAssets = SERVICENODE_SYNC_FINISHED;
+        nSyncFinishedMillis = nNow;
         break;
     }
     RequestedServicenodeAttempt = 0;
     nAssetSyncStarted = GetTime();
+    nAssetSyncStartedMillis = nNow;
 }
 
 std::string CServicenodeSync::GetSyncStatus()
@@ -278,6 +313,7 @@ void CServicenodeSync::Process()
                 pnode->PushMessage("mnvs", n); //sync servicenode votes
             } else {
                 RequestedServicenodeAssets = SERVICENODE_SYNC_FINISHED;
+                nSyncFinishedMillis = GetTimeMillis();
             }
             RequestedServicenodeAttempt++;
             return;
@@ -406,3 +442,126 @@ void CServicenodeSync::Process()
         }
     }
 }
+
+/** A message signature verified ahead of its message being handled */
+class CServicenodeSigCheck
+{
+public:
+    CServicenodeSigCheck() {}
+    CServicenodeSigCheck(const CPubKey& pubkeyIn, const std::vector<unsigned char>& vchSigIn, const std::string& strMessageIn)
+        : pubkey(pubkeyIn), vchSig(vchSigIn), strMessage(strMessageIn) {}
+
+    bool operator()()
+    {
+        // A bad signature is left to the handler to report
+        std::string strError;
+        obfuScationSigner.VerifyMessage(pubkey, vchSig, strMessage, strError);
+        return true;
+    }
+
+    void swap(CServicenodeSigCheck& check)
+    {
+        std::swap(pubkey, check.pubkey);
+        vchSig.swap(check.vchSig);
+        strMessage.swap(check.strMessage);
+    }
+
+private:
+    CPubKey pubkey;
+    std::vector<unsigned char> vchSig;
+    std::string strMessage;
+};
+
+static CCheckQueue<CServicenodeSigCheck> servicenodeSigCheckQueue(128);
+// The servicenode and budget executors take turns on the queue
+static CCriticalSection cs_servicenodeSigCheck;
+
+static CCriticalSection cs_servicenodeSigCheckStats;
+static uint64_t nSigCheckBatches = 0;
+static uint64_t nSigChecks = 0;
+static int64_t nSigCheckMicros = 0;
+
+void ThreadServicenodeSigCheck()
+{
+    RenameThread("blocknetdx-snsigch");
+    servicenodeSigCheckQueue.Thread();
+}
+
+static void AddSigCheck(std::vector<CServicenodeSigCheck>& vChecks, const CTxIn& vin, const std::vector<unsigned char>& vchSig, const std::string& strMessage)
+{
+    CPubKey pubkey;
+    if (mnodeman.GetServicenodePubKey(vin, pubkey))
+        vChecks.push_back(CServicenodeSigCheck(pubkey, vchSig, strMessage));
+}
+
+void PrecheckServicenodeMessages(const CMessageExecutor::MessageBatch& vBatch)
+{
+    // Without check threads the handlers verifying one at a time is as fast
+    if (nScriptCheckThreads == 0 || vBatch.size() < 2)
+        return;
+
+    std::vector<CServicenodeSigCheck> vChecks;
+    std::set<uint256> setSeen;
+    BOOST_FOREACH (const PAIRTYPE(std::string, const CDataStream*) & msg, vBatch) {
+        const std::string& strCommand = msg.first;
+        if (strCommand != "mnb" && strCommand != "mnp" && strCommand != "mnw" && strCommand != "mvote" && strCommand != "fbvote")
+            continue;
+        // Sync answers from several peers carry the same items
+        if (!setSeen.insert(Hash(msg.second->begin(), msg.second->end())).second)
+            continue;
+
+        CDataStream vRecv(*msg.second);
+        try {
+            if (strCommand == "mnb") {
+                CServicenodeBroadcast mnb;
+                vRecv >> mnb;
+                vChecks.push_back(CServicenodeSigCheck(mnb.pubKeyCollateralAddress, mnb.sig, mnb.GetSignatureMessage()));
+                vChecks.push_back(CServicenodeSigCheck(mnb.pubKeyServicenode, mnb.lastPing.vchSig, mnb.lastPing.GetSignatureMessage()));
+            } else if (strCommand == "mnp") {
+                CServicenodePing mnp;
+                vRecv >> mnp;
+                AddSigCheck(vChecks, mnp.vin, mnp.vchSig, mnp.GetSignatureMessage());
+            } else if (strCommand == "mnw") {
+                CServicenodePaymentWinner winner;
+                vRecv >> winner;
+                AddSigCheck(vChecks, winner.vinServicenode, winner.vchSig, winner.GetSignatureMessage());
+            } else if (strCommand == "mvote") {
+                CBudgetVote vote;
+                vRecv >> vote;
+                AddSigCheck(vChecks, vote.vin, vote.vchSig, vote.GetSignatureMessage());
+            } else {
+                CFinalizedBudgetVote vote;
+                vRecv >> vote;
+                AddSigCheck(vChecks, vote.vin, vote.vchSig, vote.GetSignatureMessage());
+            }
+        } catch (const std::exception&) {
+            // Malformed, the handler rejects it
+        }
+    }
+    if (vChecks.empty())
+        return;
+
+    size_t nChecks = vChecks.size();
+    int64_t nStart = GetTimeMicros();
+    {
+        LOCK(cs_servicenodeSigCheck);
+        CCheckQueueControl<CServicenodeSigCheck> control(&servicenodeSigCheckQueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    int64_t nMicros = GetTimeMicros() - nStart;
+    LogPrint("servicenode", "PrecheckServicenodeMessages - verified %u signatures of %u messages in %.2fms\n", nChecks, vBatch.size(), nMicros * 0.001);
+
+    LOCK(cs_servicenodeSigCheckStats);
+    nSigCheckBatches++;
+    nSigChecks += nChecks;
+    nSigCheckMicros += nMicros;
+}
+
+void GetServicenodeSigCheckStats(uint64_t& nBatchesOut, uint64_t& nChecksOut, int64_t& nMicrosOut)
+{
+    LOCK(cs_servicenodeSigCheckStats);
+    nBatchesOut = nSigCheckBatches;
+    nChecksOut = nSigChecks;
+    nMicrosOut = nSigCheckMicros;
+}
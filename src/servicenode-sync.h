@@ -6,6 +6,8 @@
 #ifndef SERVICENODE_SYNC_H
 #define SERVICENODE_SYNC_H
 
+#include "messageexecutor.h"
+
 #define SERVICENODE_SYNC_INITIAL 0
 #define SERVICENODE_SYNC_SPORKS 1
 #define SERVICENODE_SYNC_LIST 2
@@ -28,11 +30,17 @@ extern CServicenodeSync servicenodeSync;
 
 class CServicenodeSync
 {
-public:
+private:
+    // critical section to protect the seen maps below; the peer message
+    // threads update them from AlreadyHave, so nothing else is locked while
+    // it is held
+    mutable CCriticalSection cs_seen;
     std::map<uint256, int> mapSeenSyncMNB;
     std::map<uint256, int> mapSeenSyncMNW;
     std::map<uint256, int> mapSeenSyncBudget;
 
+public:
+
     int64_t lastServicenodeList;
     int64_t lastServicenodeWinner;
     int64_t lastBudgetItem;
@@ -57,11 +65,19 @@ public:
     // Time when current servicenode asset sync started
     int64_t nAssetSyncStarted;
 
+    // Milliseconds spent on each asset, from SERVICENODE_SYNC_SPORKS to SERVICENODE_SYNC_BUDGET
+    int64_t nAssetSyncMillis[SERVICENODE_SYNC_BUDGET + 1];
+    int64_t nAssetSyncStartedMillis;
+    int64_t nSyncStartedMillis;
+    int64_t nSyncFinishedMillis;
+
     CServicenodeSync();
 
     void AddedServicenodeList(uint256 hash);
     void AddedServicenodeWinner(uint256 hash);
     void AddedBudgetItem(uint256 hash);
+    void RemovedServicenodeList(const uint256& hash);
+    void RemovedServicenodeWinner(const uint256& hash);
     void GetNextAsset();
     std::string GetSyncStatus();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
@@ -76,4 +92,15 @@ public:
     void ClearFulfilledRequest();
 };
 
+/**
+ * Verify the signatures of a batch of queued servicenode, payment and
+ * budget messages on the signature check threads, before the executor
+ * handles them in order. Results only go to the message signature cache,
+ * so the handlers still decide what is valid.
+ */
+void PrecheckServicenodeMessages(const CMessageExecutor::MessageBatch& vBatch);
+void ThreadServicenodeSigCheck();
+/** Signatures verified ahead so far, in how many batches and how long that took */
+void GetServicenodeSigCheckStats(uint64_t& nBatchesOut, uint64_t& nChecksOut, int64_t& nMicrosOut);
+
 #endif
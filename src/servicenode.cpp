@@ -86,6 +86,7 @@ CServicenode::CServicenode()
     lastTimeChecked               = 0;
     nLastDsee                     = 0; // temporary, do not save. Remove after migration to v12
     nLastDseep                    = 0; // temporary, do not save. Remove after migration to v12
+    fDirty                        = true;
 }
 
 CServicenode::CServicenode(const CServicenode& other)
@@ -113,6 +114,7 @@ CServicenode::CServicenode(const CServicenode& other)
     nLastDsee                     = other.nLastDsee;  // temporary, do not save. Remove after migration to v12
     nLastDseep                    = other.nLastDseep; // temporary, do not save. Remove after migration to v12
     connectedWallets              = other.connectedWallets;
+    fDirty                        = other.fDirty;
 }
 
 CServicenode::CServicenode(const CServicenodeBroadcast& mnb)
@@ -140,6 +142,7 @@ CServicenode::CServicenode(const CServicenodeBroadcast& mnb)
     nLastDsee                     = 0; // temporary, do not save. Remove after migration to v12
     nLastDseep                    = 0; // temporary, do not save. Remove after migration to v12
     connectedWallets              = mnb.connectedWallets;
+    fDirty                        = true;
 }
 
 //
@@ -156,12 +159,13 @@ bool CServicenode::UpdateFromNewBroadcast(CServicenodeBroadcast& mnb)
         addr                    = mnb.addr;
         lastTimeChecked         = 0;
         connectedWallets        = mnb.connectedWallets;
+        fDirty                  = true;
         int nDoS                = 0;
         if (mnb.lastPing == CServicenodePing() ||
             (mnb.lastPing != CServicenodePing() && mnb.lastPing.CheckAndUpdate(nDoS, false)))
         {
             lastPing = mnb.lastPing;
-            mnodeman.mapSeenServicenodePing.insert(make_pair(lastPing.GetHash(), lastPing));
+            mnodeman.AddSeenPing(lastPing);
         }
         return true;
     }
@@ -212,12 +216,12 @@ void CServicenode::Check(bool forceCheck)
 
 
     if (!IsPingedWithin(SERVICENODE_REMOVAL_SECONDS)) {
-        activeState = SERVICENODE_REMOVE;
+        SetActiveState(SERVICENODE_REMOVE);
         return;
     }
 
     if (!IsPingedWithin(SERVICENODE_EXPIRATION_SECONDS)) {
-        activeState = SERVICENODE_EXPIRED;
+        SetActiveState(SERVICENODE_EXPIRED);
         return;
     }
 
@@ -233,13 +237,13 @@ void CServicenode::Check(bool forceCheck)
             if (!lockMain) return;
 
             if (!AcceptableInputs(mempool, state, CTransaction(tx), false, NULL)) {
-                activeState = SERVICENODE_VIN_SPENT;
+                SetActiveState(SERVICENODE_VIN_SPENT);
                 return;
             }
         }
     }
 
-    activeState = SERVICENODE_ENABLED; // OK
+    SetActiveState(SERVICENODE_ENABLED); // OK
 }
 
 int64_t CServicenode::SecondsSincePayment()
@@ -538,9 +542,7 @@ bool CServicenodeBroadcast::CheckAndUpdate(int& nDos)
         return false;
     }
 
-    std::string vchPubKey(pubKeyCollateralAddress.begin(), pubKeyCollateralAddress.end());
-    std::string vchPubKey2(pubKeyServicenode.begin(), pubKeyServicenode.end());
-    std::string strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
+    std::string strMessage = GetSignatureMessage();
 
     if (protocolVersion < servicenodePayments.GetMinServicenodePaymentsProto()) {
         LogPrintf("mnb - ignoring outdated Servicenode %s protocol version %d\n", vin.prevout.hash.ToString(), protocolVersion);
@@ -642,8 +644,7 @@ bool CServicenodeBroadcast::CheckInputsAndAdd(int& nDoS)
         TRY_LOCK(cs_main, lockMain);
         if (!lockMain) {
             // not mnb fault, let it to be checked again later
-            mnodeman.mapSeenServicenodeBroadcast.erase(GetHash());
-            servicenodeSync.mapSeenSyncMNB.erase(GetHash());
+            mnodeman.RemoveSeenBroadcast(GetHash());
             return false;
         }
 
@@ -659,8 +660,7 @@ bool CServicenodeBroadcast::CheckInputsAndAdd(int& nDoS)
     if (GetInputAge(vin) < SERVICENODE_MIN_CONFIRMATIONS) {
         LogPrintf("mnb - Input must have at least %d confirmations\n", SERVICENODE_MIN_CONFIRMATIONS);
         // maybe we miss few blocks, let this mnb to be checked again later
-        mnodeman.mapSeenServicenodeBroadcast.erase(GetHash());
-        servicenodeSync.mapSeenSyncMNB.erase(GetHash());
+        mnodeman.RemoveSeenBroadcast(GetHash());
         return false;
     }
 
@@ -707,12 +707,9 @@ bool CServicenodeBroadcast::Sign(const CKey & keyCollateralAddress)
 {
     std::string errorMessage;
 
-    std::string vchPubKey(pubKeyCollateralAddress.begin(), pubKeyCollateralAddress.end());
-    std::string vchPubKey2(pubKeyServicenode.begin(), pubKeyServicenode.end());
-
     sigTime = GetAdjustedTime();
 
-    std::string strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, sig, keyCollateralAddress)) {
         LogPrintf("CServicenodeBroadcast::Sign() - Error: %s\n", errorMessage);
@@ -727,6 +724,14 @@ bool CServicenodeBroadcast::Sign(const CKey & keyCollateralAddress)
     return true;
 }
 
+std::string CServicenodeBroadcast::GetSignatureMessage() const
+{
+    std::string vchPubKey(pubKeyCollateralAddress.begin(), pubKeyCollateralAddress.end());
+    std::string vchPubKey2(pubKeyServicenode.begin(), pubKeyServicenode.end());
+
+    return addr.ToString() + boost::lexical_cast<std::string>(sigTime) + vchPubKey + vchPubKey2 + boost::lexical_cast<std::string>(protocolVersion);
+}
+
 CServicenodePing::CServicenodePing() : sigTime(0)
 {
 }
@@ -746,7 +751,7 @@ bool CServicenodePing::Sign(const CKey& keyServicenode, const CPubKey & pubKeySe
     // std::string strServiceNodeSignMessage;
 
     sigTime = GetAdjustedTime();
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyServicenode)) {
         LogPrintf("CServicenodePing::Sign() - Error: %s\n", errorMessage);
@@ -761,6 +766,11 @@ bool CServicenodePing::Sign(const CKey& keyServicenode, const CPubKey & pubKeySe
     return true;
 }
 
+std::string CServicenodePing::GetSignatureMessage() const
+{
+    return vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
 bool CServicenodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled)
 {
     if (sigTime > GetAdjustedTime() + 60 * 60) {
@@ -786,7 +796,7 @@ bool CServicenodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled)
         // update only if there is no known ping for this servicenode or
         // last ping was more then SERVICENODE_MIN_MNP_SECONDS-60 ago comparing to this one
         if (!pmn->IsPingedWithin(SERVICENODE_MIN_MNP_SECONDS - 60, sigTime)) {
-            std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+            std::string strMessage = GetSignatureMessage();
 
             std::string errorMessage = "";
             if (!obfuScationSigner.VerifyMessage(pmn->pubKeyServicenode, vchSig, strMessage, errorMessage)) {
@@ -813,13 +823,11 @@ bool CServicenodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled)
             }
 
             pmn->lastPing = *this;
+            pmn->fDirty = true;
 
             //mnodeman.mapSeenServicenodeBroadcast.lastPing is probably outdated, so we'll update it
             CServicenodeBroadcast mnb(*pmn);
-            uint256 hash = mnb.GetHash();
-            if (mnodeman.mapSeenServicenodeBroadcast.count(hash)) {
-                mnodeman.mapSeenServicenodeBroadcast[hash].lastPing = *this;
-            }
+            mnodeman.UpdateSeenBroadcastPing(mnb.GetHash(), *this);
 
             pmn->Check(true);
             if (!pmn->IsEnabled()) return false;
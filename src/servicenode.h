@@ -62,9 +62,11 @@ public:
 
     bool CheckAndUpdate(int& nDos, bool fRequireEnabled = true);
     bool Sign(const CKey & keyServicenode, const CPubKey & pubKeyServicenode);
+    /// The message the servicenode key signs
+    std::string GetSignatureMessage() const;
     void Relay();
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << vin;
@@ -128,6 +130,12 @@ private:
     mutable CCriticalSection cs;
     int64_t lastTimeChecked;
 
+    void SetActiveState(int nState)
+    {
+        if (activeState != nState) fDirty = true;
+        activeState = nState;
+    }
+
 public:
     enum state {
         SERVICENODE_PRE_ENABLED,
@@ -167,6 +175,9 @@ public:
     int64_t nLastDsee;  // temporary, do not save. Remove after migration to v12
     int64_t nLastDseep; // temporary, do not save. Remove after migration to v12
 
+    // changed since the last flush to the state database, do not save
+    bool fDirty;
+
     CServicenode();
     CServicenode(const CServicenode& other);
     CServicenode(const CServicenodeBroadcast& mnb);
@@ -196,6 +207,7 @@ public:
         swap(first.nScanningErrorCount, second.nScanningErrorCount);
         swap(first.nLastScanningErrorBlockHeight, second.nLastScanningErrorBlockHeight);
         swap(first.connectedWallets, second.connectedWallets);
+        swap(first.fDirty, second.fDirty);
     }
 
     CServicenode& operator=(CServicenode from)
@@ -268,6 +280,7 @@ public:
     {
         sigTime = 0;
         lastPing = CServicenodePing();
+        fDirty = true;
     }
 
     bool IsEnabled()
@@ -282,6 +295,7 @@ public:
         if (cacheInputAge == 0) {
             cacheInputAge = GetInputAge(vin);
             cacheInputAgeBlock = chainActive.Tip()->nHeight;
+            fDirty = true;
         }
 
         return cacheInputAge + (chainActive.Tip()->nHeight - cacheInputAgeBlock);
@@ -336,6 +350,8 @@ public:
     bool CheckAndUpdate(int& nDoS);
     bool CheckInputsAndAdd(int& nDos);
     bool Sign(const CKey & keyCollateralAddress);
+    /// The message the collateral key signs
+    std::string GetSignatureMessage() const;
     void Relay();
 
     ADD_SERIALIZE_METHODS;
@@ -362,7 +378,7 @@ public:
         }
     }
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << sigTime;
@@ -0,0 +1,178 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "servicenodedb.h"
+
+#include "servicenode-budget.h"
+#include "servicenode-payments.h"
+#include "servicenodeman.h"
+#include "util.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+/** Stored under 'V'; records of another version are dropped on load */
+static const int SERVICENODE_STATE_VERSION = 2;
+
+CServicenodeStateDB* pservicenodedb = NULL;
+
+CServicenodeStateDB::CServicenodeStateDB(size_t nCacheSize, bool fMemory, bool fWipe)
+    : CLevelDBWrapper(GetDataDir() / "servicenodes", nCacheSize, fMemory, fWipe), pbatch(NULL), fResync(false), fFullFlush(false),
+      nFlushWrites(0), nFlushErases(0), nFlushMillis(0)
+{
+}
+
+static std::string RecordKey(char chType)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << chType;
+    return ssKey.str();
+}
+
+bool CServicenodeStateDB::Load(CServicenodeMan& mnodemanIn, CBudgetManager& budgetIn, CServicenodePayments& paymentsIn)
+{
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+
+    int nVersion = SERVICENODE_STATE_VERSION;
+    Read('V', nVersion);
+    if (nVersion != SERVICENODE_STATE_VERSION)
+        LogPrintf("Servicenode state database version %d is not supported, will try to recreate\n", nVersion);
+    std::string strVersionKey = RecordKey('V');
+
+    CLevelDBBatch batch;
+    size_t nLoaded = 0, nDropped = 0;
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        leveldb::Slice slKey = pcursor->key();
+        leveldb::Slice slValue = pcursor->value();
+        std::string strKey(slKey.data(), slKey.size());
+        if (strKey == strVersionKey)
+            continue;
+
+        bool fLoaded = false;
+        if (nVersion == SERVICENODE_STATE_VERSION) {
+            try {
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                char chType;
+                ssKey >> chType;
+                fLoaded = mnodemanIn.LoadState(chType, ssKey, ssValue) ||
+                          budgetIn.LoadState(chType, ssKey, ssValue) ||
+                          paymentsIn.LoadState(chType, ssKey, ssValue);
+            } catch (const std::exception& e) {
+                LogPrint("servicenode", "CServicenodeStateDB::Load - %s\n", e.what());
+            }
+        }
+
+        if (fLoaded) {
+            nLoaded++;
+        } else {
+            batch.Erase(CFlatData(&strKey[0], &strKey[0] + strKey.size()));
+            nDropped++;
+        }
+    }
+    batch.Write('V', SERVICENODE_STATE_VERSION);
+    WriteBatch(batch, true);
+
+    LogPrintf("Loaded %u servicenode state records, dropped %u  %dms\n", nLoaded, nDropped, GetTimeMillis() - nStart);
+    return true;
+}
+
+void CServicenodeStateDB::WriteRecord(const std::string& strKey, const std::string& strValue)
+{
+    AssertLockHeld(cs);
+    assert(pbatch != NULL);
+    if (fFullFlush)
+        setFullFlushKeys.insert(strKey);
+
+    std::string strKeyTmp(strKey), strValueTmp(strValue);
+    pbatch->Write(CFlatData(&strKeyTmp[0], &strKeyTmp[0] + strKeyTmp.size()),
+        CFlatData(&strValueTmp[0], &strValueTmp[0] + strValueTmp.size()));
+    nFlushWrites++;
+}
+
+void CServicenodeStateDB::EraseRecord(const std::string& strKey)
+{
+    AssertLockHeld(cs);
+    assert(pbatch != NULL);
+    std::string strKeyTmp(strKey);
+    pbatch->Erase(CFlatData(&strKeyTmp[0], &strKeyTmp[0] + strKeyTmp.size()));
+    nFlushErases++;
+}
+
+bool CServicenodeStateDB::Flush(CServicenodeMan& mnodemanIn, CBudgetManager& budgetIn, CServicenodePayments& paymentsIn)
+{
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+    nFlushWrites = nFlushErases = 0;
+
+    // A failed write left the database unknown, and the managers have
+    // forgotten what they marked for it: rewrite everything and erase
+    // whatever else is stored
+    fFullFlush = fResync;
+    fResync = false;
+    try {
+        CLevelDBBatch batch;
+        pbatch = &batch;
+        mnodemanIn.WriteState(*this);
+        budgetIn.WriteState(*this);
+        paymentsIn.WriteState(*this);
+
+        if (fFullFlush) {
+            std::string strVersionKey = RecordKey('V');
+            boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+            for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+                std::string strKey(pcursor->key().data(), pcursor->key().size());
+                if (strKey != strVersionKey && !setFullFlushKeys.count(strKey))
+                    EraseRecord(strKey);
+            }
+        }
+        pbatch = NULL;
+
+        if (nFlushWrites > 0 || nFlushErases > 0)
+            WriteBatch(batch, true);
+    } catch (const std::exception& e) {
+        pbatch = NULL;
+        fResync = true;
+        fFullFlush = false;
+        setFullFlushKeys.clear();
+        return error("%s : %s", __func__, e.what());
+    }
+    fFullFlush = false;
+    setFullFlushKeys.clear();
+
+    nFlushMillis = GetTimeMillis() - nStart;
+    LogPrint("servicenode", "Flushed servicenode state: %u records written, %u erased  %dms\n",
+        nFlushWrites, nFlushErases, nFlushMillis);
+    return true;
+}
+
+size_t CServicenodeStateDB::GetRecordCount()
+{
+    LOCK(cs);
+    size_t nRecords = 0;
+    std::string strVersionKey = RecordKey('V');
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+        if (std::string(pcursor->key().data(), pcursor->key().size()) != strVersionKey)
+            nRecords++;
+    }
+    return nRecords;
+}
+
+void CServicenodeStateDB::GetLastFlush(size_t& nWritesRet, size_t& nErasesRet, int64_t& nMillisRet)
+{
+    LOCK(cs);
+    nWritesRet = nFlushWrites;
+    nErasesRet = nFlushErases;
+    nMillisRet = nFlushMillis;
+}
+
+void FlushServicenodeState()
+{
+    if (pservicenodedb != NULL)
+        pservicenodedb->Flush(mnodeman, budget, servicenodePayments);
+}
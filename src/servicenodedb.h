@@ -0,0 +1,131 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SERVICENODEDB_H
+#define BITCOIN_SERVICENODEDB_H
+
+#include "leveldbwrapper.h"
+#include "sync.h"
+
+#include <map>
+#include <set>
+#include <string>
+
+class CBudgetManager;
+class CServicenodeMan;
+class CServicenodePayments;
+
+/** How often the servicenode, budget and payment state is flushed while running, in seconds */
+static const int SERVICENODE_STATE_FLUSH_SECONDS = 60;
+
+/**
+ * The keys of one kind of state record that changed since the last flush.
+ * The manager owning the entries marks a key, under its own lock, wherever
+ * an entry is added, changed or removed.
+ */
+template <typename K>
+class CServicenodeStateDirty
+{
+public:
+    typedef std::set<K> KeySet;
+
+    void Mark(const K& key) { setKeys.insert(key); }
+    /** Hand the marked keys to a flush and start over */
+    void Take(KeySet& setKeysRet)
+    {
+        setKeysRet.clear();
+        setKeysRet.swap(setKeys);
+    }
+
+private:
+    KeySet setKeys;
+};
+
+/**
+ * The servicenode list, budgets and payment votes, stored one record per
+ * entry in servicenodes/ in the data directory. Flushing writes the records
+ * the managers marked as changed since the last flush and erases the ones
+ * they marked as gone, as one synced batch, so the store always holds the
+ * state of some flush and an interrupted one leaves the previous intact.
+ * A flush that fails makes the next one write every record.
+ *
+ * The managers add their records with WriteRecord, EraseRecord and
+ * WriteRecords from WriteState, and take them back one at a time in
+ * LoadState.
+ */
+class CServicenodeStateDB : public CLevelDBWrapper
+{
+public:
+    CServicenodeStateDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /** Load the stored records into the managers */
+    bool Load(CServicenodeMan& mnodemanIn, CBudgetManager& budgetIn, CServicenodePayments& paymentsIn);
+    /** Write what the managers marked as changed since the last flush */
+    bool Flush(CServicenodeMan& mnodemanIn, CBudgetManager& budgetIn, CServicenodePayments& paymentsIn);
+
+    /** Whether the flush in progress writes every record, not just the changed ones */
+    bool IsFullFlush() const { return fFullFlush; }
+
+    template <typename K, typename V>
+    void WriteRecord(char chType, const K& key, const V& value)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << chType << key;
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue << value;
+        WriteRecord(ssKey.str(), ssValue.str());
+    }
+
+    template <typename K>
+    void EraseRecord(char chType, const K& key)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << chType << key;
+        EraseRecord(ssKey.str());
+    }
+
+    /** Write the marked entries of mapIn and erase the marked ones it no longer has; all of mapIn on a full flush */
+    template <typename K, typename V>
+    void WriteRecords(char chType, const std::map<K, V>& mapIn, CServicenodeStateDirty<K>& dirty)
+    {
+        typename CServicenodeStateDirty<K>::KeySet setKeys;
+        dirty.Take(setKeys);
+        if (fFullFlush) {
+            for (typename std::map<K, V>::const_iterator it = mapIn.begin(); it != mapIn.end(); ++it)
+                WriteRecord(chType, it->first, it->second);
+            return;
+        }
+        for (typename std::set<K>::const_iterator itKey = setKeys.begin(); itKey != setKeys.end(); ++itKey) {
+            typename std::map<K, V>::const_iterator it = mapIn.find(*itKey);
+            if (it != mapIn.end())
+                WriteRecord(chType, it->first, it->second);
+            else
+                EraseRecord(chType, *itKey);
+        }
+    }
+
+    size_t GetRecordCount();
+    /** Records written and erased by the last flush, and how long it took */
+    void GetLastFlush(size_t& nWritesRet, size_t& nErasesRet, int64_t& nMillisRet);
+
+private:
+    void WriteRecord(const std::string& strKey, const std::string& strValue);
+    void EraseRecord(const std::string& strKey);
+
+    CCriticalSection cs;
+    CLevelDBBatch* pbatch; // of the flush in progress
+    bool fResync;          // a flush failed, the next one rewrites everything
+    bool fFullFlush;       // the flush in progress rewrites everything
+    std::set<std::string> setFullFlushKeys; // written by the full flush in progress
+    size_t nFlushWrites;
+    size_t nFlushErases;
+    int64_t nFlushMillis;
+};
+
+extern CServicenodeStateDB* pservicenodedb;
+
+/** Flush mnodeman, budget and servicenodePayments to pservicenodedb, if it is open */
+void FlushServicenodeState();
+
+#endif // BITCOIN_SERVICENODEDB_H
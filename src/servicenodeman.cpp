@@ -8,6 +8,7 @@
 #include "activeservicenode.h"
 #include "addrman.h"
 #include "servicenode.h"
+#include "servicenodedb.h"
 #include "obfuscation.h"
 #include "spork.h"
 #include "util.h"
@@ -41,160 +42,10 @@ struct CompareScoreMN {
     }
 };
 
-//
-// CServicenodeDB
-//
-
-CServicenodeDB::CServicenodeDB()
-{
-    pathMN = GetDataDir() / "mncache.dat";
-    strMagicMessage = "ServicenodeCache";
-}
-
-bool CServicenodeDB::Write(const CServicenodeMan& mnodemanToSave)
-{
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssServicenodes(SER_DISK, CLIENT_VERSION);
-    ssServicenodes << strMagicMessage;                   // servicenode cache file specific magic message
-    ssServicenodes << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssServicenodes << mnodemanToSave;
-    uint256 hash = Hash(ssServicenodes.begin(), ssServicenodes.end());
-    ssServicenodes << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathMN.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssServicenodes;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    //    FileCommit(fileout);
-    fileout.fclose();
-
-    LogPrintf("Written info to mncache.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", mnodemanToSave.ToString());
-
-    return true;
-}
-
-CServicenodeDB::ReadResult CServicenodeDB::Read(CServicenodeMan& mnodemanToLoad, bool fDryRun)
-{
-    int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathMN.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathMN);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssServicenodes(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssServicenodes.begin(), ssServicenodes.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
-
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
-    try {
-        // de-serialize file header (servicenode cache file specific magic message) and ..
-
-        ssServicenodes >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid servicenode cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-        // de-serialize file header (network specific magic number) and ..
-        ssServicenodes >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-        // de-serialize data into CServicenodeMan object
-        ssServicenodes >> mnodemanToLoad;
-    } catch (std::exception& e) {
-        mnodemanToLoad.Clear();
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return IncorrectFormat;
-    }
-
-    LogPrintf("Loaded info from mncache.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", mnodemanToLoad.ToString());
-    if (!fDryRun) {
-        LogPrintf("Servicenode manager - cleaning....\n");
-        mnodemanToLoad.CheckAndRemove(true);
-        LogPrintf("Servicenode manager - result:\n");
-        LogPrintf("  %s\n", mnodemanToLoad.ToString());
-    }
-
-    return Ok;
-}
-
-void DumpServicenodes()
-{
-    int64_t nStart = GetTimeMillis();
-
-    CServicenodeDB mndb;
-    CServicenodeMan tempMnodeman;
-
-    LogPrintf("Verifying mncache.dat format...\n");
-    CServicenodeDB::ReadResult readResult = mndb.Read(tempMnodeman, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CServicenodeDB::FileError)
-        LogPrintf("Missing servicenode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CServicenodeDB::Ok) {
-        LogPrintf("Error reading mncache.dat: ");
-        if (readResult == CServicenodeDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
-    }
-    LogPrintf("Writting info to mncache.dat...\n");
-    mndb.Write(mnodeman);
-
-    LogPrintf("Servicenode dump finished  %dms\n", GetTimeMillis() - nStart);
-}
-
 CServicenodeMan::CServicenodeMan()
 {
     nDsqCount = 0;
+    nDsqCountFlushed = -1;
 }
 
 bool CServicenodeMan::Add(CServicenode& mn)
@@ -208,6 +59,7 @@ bool CServicenodeMan::Add(CServicenode& mn)
     if (pmn == NULL) {
         LogPrint("servicenode", "CServicenodeMan: Adding new Servicenode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vServicenodes.push_back(mn);
+        vServicenodes.back().fDirty = true;
         return true;
     }
 
@@ -216,6 +68,8 @@ bool CServicenodeMan::Add(CServicenode& mn)
 
 void CServicenodeMan::AskForMN(CNode* pnode, CTxIn& vin)
 {
+    LOCK(cs);
+
     std::map<COutPoint, int64_t>::iterator i = mWeAskedForServicenodeListEntry.find(vin.prevout);
     if (i != mWeAskedForServicenodeListEntry.end()) {
         int64_t t = (*i).second;
@@ -228,6 +82,7 @@ void CServicenodeMan::AskForMN(CNode* pnode, CTxIn& vin)
     pnode->PushMessage("dseg", vin);
     int64_t askAgain = GetTime() + SERVICENODE_MIN_MNP_SECONDS;
     mWeAskedForServicenodeListEntry[vin.prevout] = askAgain;
+    dirtyWeAskedEntry.Mark(vin.prevout);
 }
 
 void CServicenodeMan::Check()
@@ -257,26 +112,35 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
             //erase all of the broadcasts we've seen from this vin
             // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //    sending a brand new mnb
-            map<uint256, CServicenodeBroadcast>::iterator it3 = mapSeenServicenodeBroadcast.begin();
-            while (it3 != mapSeenServicenodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
-                    servicenodeSync.mapSeenSyncMNB.erase((*it3).first);
-                    mapSeenServicenodeBroadcast.erase(it3++);
-                } else {
-                    ++it3;
+            vector<uint256> vErased;
+            {
+                LOCK(cs_seen);
+                map<uint256, CServicenodeBroadcast>::iterator it3 = mapSeenServicenodeBroadcast.begin();
+                while (it3 != mapSeenServicenodeBroadcast.end()) {
+                    if ((*it3).second.vin == (*it).vin) {
+                        vErased.push_back((*it3).first);
+                        dirtySeenBroadcasts.Mark((*it3).first);
+                        mapSeenServicenodeBroadcast.erase(it3++);
+                    } else {
+                        ++it3;
+                    }
                 }
             }
+            BOOST_FOREACH (const uint256& hash, vErased)
+                servicenodeSync.RemovedServicenodeList(hash);
 
             // allow us to ask for this servicenode again if we see another ping
             map<COutPoint, int64_t>::iterator it2 = mWeAskedForServicenodeListEntry.begin();
             while (it2 != mWeAskedForServicenodeListEntry.end()) {
                 if ((*it2).first == (*it).vin.prevout) {
+                    dirtyWeAskedEntry.Mark((*it2).first);
                     mWeAskedForServicenodeListEntry.erase(it2++);
                 } else {
                     ++it2;
                 }
             }
 
+            dirtyServicenodes.Mark((*it).vin.prevout);
             it = vServicenodes.erase(it);
         } else {
             ++it;
@@ -287,6 +151,7 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
     map<CNetAddr, int64_t>::iterator it1 = mAskedUsForServicenodeList.begin();
     while (it1 != mAskedUsForServicenodeList.end()) {
         if ((*it1).second < GetTime()) {
+            dirtyAskedUs.Mark((*it1).first);
             mAskedUsForServicenodeList.erase(it1++);
         } else {
             ++it1;
@@ -297,6 +162,7 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
     it1 = mWeAskedForServicenodeList.begin();
     while (it1 != mWeAskedForServicenodeList.end()) {
         if ((*it1).second < GetTime()) {
+            dirtyWeAsked.Mark((*it1).first);
             mWeAskedForServicenodeList.erase(it1++);
         } else {
             ++it1;
@@ -307,6 +173,7 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
     map<COutPoint, int64_t>::iterator it2 = mWeAskedForServicenodeListEntry.begin();
     while (it2 != mWeAskedForServicenodeListEntry.end()) {
         if ((*it2).second < GetTime()) {
+            dirtyWeAskedEntry.Mark((*it2).first);
             mWeAskedForServicenodeListEntry.erase(it2++);
         } else {
             ++it2;
@@ -314,30 +181,122 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
     }
 
     // remove expired mapSeenServicenodeBroadcast
-    map<uint256, CServicenodeBroadcast>::iterator it3 = mapSeenServicenodeBroadcast.begin();
-    while (it3 != mapSeenServicenodeBroadcast.end()) {
-        if ((*it3).second.lastPing.sigTime < GetTime() - (SERVICENODE_REMOVAL_SECONDS * 2)) {
-            mapSeenServicenodeBroadcast.erase(it3++);
-            servicenodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
-        } else {
-            ++it3;
+    vector<uint256> vExpired;
+    {
+        LOCK(cs_seen);
+        map<uint256, CServicenodeBroadcast>::iterator it3 = mapSeenServicenodeBroadcast.begin();
+        while (it3 != mapSeenServicenodeBroadcast.end()) {
+            if ((*it3).second.lastPing.sigTime < GetTime() - (SERVICENODE_REMOVAL_SECONDS * 2)) {
+                vExpired.push_back((*it3).first);
+                dirtySeenBroadcasts.Mark((*it3).first);
+                mapSeenServicenodeBroadcast.erase(it3++);
+            } else {
+                ++it3;
+            }
         }
-    }
 
-    // remove expired mapSeenServicenodePing
-    map<uint256, CServicenodePing>::iterator it4 = mapSeenServicenodePing.begin();
-    while (it4 != mapSeenServicenodePing.end()) {
-        if ((*it4).second.sigTime < GetTime() - (SERVICENODE_REMOVAL_SECONDS * 2)) {
-            mapSeenServicenodePing.erase(it4++);
-        } else {
-            ++it4;
+        // remove expired mapSeenServicenodePing
+        map<uint256, CServicenodePing>::iterator it4 = mapSeenServicenodePing.begin();
+        while (it4 != mapSeenServicenodePing.end()) {
+            if ((*it4).second.sigTime < GetTime() - (SERVICENODE_REMOVAL_SECONDS * 2)) {
+                dirtySeenPings.Mark((*it4).first);
+                mapSeenServicenodePing.erase(it4++);
+            } else {
+                ++it4;
+            }
         }
     }
+    BOOST_FOREACH (const uint256& hash, vExpired)
+        servicenodeSync.RemovedServicenodeList(hash);
+}
+
+bool CServicenodeMan::HaveSeenBroadcast(const uint256& hash) const
+{
+    LOCK(cs_seen);
+    return mapSeenServicenodeBroadcast.count(hash);
+}
+
+bool CServicenodeMan::GetSeenBroadcast(const uint256& hash, CServicenodeBroadcast& mnbRet) const
+{
+    LOCK(cs_seen);
+    map<uint256, CServicenodeBroadcast>::const_iterator it = mapSeenServicenodeBroadcast.find(hash);
+    if (it == mapSeenServicenodeBroadcast.end())
+        return false;
+    mnbRet = it->second;
+    return true;
+}
+
+bool CServicenodeMan::AddSeenBroadcast(const CServicenodeBroadcast& mnb)
+{
+    LOCK(cs_seen);
+    uint256 hash = mnb.GetHash();
+    if (!mapSeenServicenodeBroadcast.insert(make_pair(hash, mnb)).second)
+        return false;
+    dirtySeenBroadcasts.Mark(hash);
+    return true;
+}
+
+void CServicenodeMan::RemoveSeenBroadcast(const uint256& hash)
+{
+    {
+        LOCK(cs_seen);
+        if (mapSeenServicenodeBroadcast.erase(hash))
+            dirtySeenBroadcasts.Mark(hash);
+    }
+    servicenodeSync.RemovedServicenodeList(hash);
+}
+
+void CServicenodeMan::UpdateSeenBroadcastPing(const uint256& hash, const CServicenodePing& mnp)
+{
+    LOCK(cs_seen);
+    map<uint256, CServicenodeBroadcast>::iterator it = mapSeenServicenodeBroadcast.find(hash);
+    if (it != mapSeenServicenodeBroadcast.end()) {
+        it->second.lastPing = mnp;
+        dirtySeenBroadcasts.Mark(hash);
+    }
+}
+
+bool CServicenodeMan::HaveSeenPing(const uint256& hash) const
+{
+    LOCK(cs_seen);
+    return mapSeenServicenodePing.count(hash);
+}
+
+bool CServicenodeMan::GetSeenPing(const uint256& hash, CServicenodePing& mnpRet) const
+{
+    LOCK(cs_seen);
+    map<uint256, CServicenodePing>::const_iterator it = mapSeenServicenodePing.find(hash);
+    if (it == mapSeenServicenodePing.end())
+        return false;
+    mnpRet = it->second;
+    return true;
+}
+
+bool CServicenodeMan::AddSeenPing(const CServicenodePing& mnp)
+{
+    LOCK(cs_seen);
+    uint256 hash = mnp.GetHash();
+    if (!mapSeenServicenodePing.insert(make_pair(hash, mnp)).second)
+        return false;
+    dirtySeenPings.Mark(hash);
+    return true;
 }
 
 void CServicenodeMan::Clear()
 {
-    LOCK(cs);
+    LOCK2(cs, cs_seen);
+    BOOST_FOREACH (const CServicenode& mn, vServicenodes)
+        dirtyServicenodes.Mark(mn.vin.prevout);
+    for (std::map<CNetAddr, int64_t>::const_iterator it = mAskedUsForServicenodeList.begin(); it != mAskedUsForServicenodeList.end(); ++it)
+        dirtyAskedUs.Mark(it->first);
+    for (std::map<CNetAddr, int64_t>::const_iterator it = mWeAskedForServicenodeList.begin(); it != mWeAskedForServicenodeList.end(); ++it)
+        dirtyWeAsked.Mark(it->first);
+    for (std::map<COutPoint, int64_t>::const_iterator it = mWeAskedForServicenodeListEntry.begin(); it != mWeAskedForServicenodeListEntry.end(); ++it)
+        dirtyWeAskedEntry.Mark(it->first);
+    for (std::map<uint256, CServicenodeBroadcast>::const_iterator it = mapSeenServicenodeBroadcast.begin(); it != mapSeenServicenodeBroadcast.end(); ++it)
+        dirtySeenBroadcasts.Mark(it->first);
+    for (std::map<uint256, CServicenodePing>::const_iterator it = mapSeenServicenodePing.begin(); it != mapSeenServicenodePing.end(); ++it)
+        dirtySeenPings.Mark(it->first);
     vServicenodes.clear();
     mAskedUsForServicenodeList.clear();
     mWeAskedForServicenodeList.clear();
@@ -380,6 +339,7 @@ void CServicenodeMan::DsegUpdate(CNode* pnode)
     pnode->PushMessage("dseg", CTxIn());
     int64_t askAgain = GetTime() + SERVICENODES_DSEG_SECONDS;
     mWeAskedForServicenodeList[pnode->addr] = askAgain;
+    dirtyWeAsked.Mark(pnode->addr);
 }
 
 CServicenode* CServicenodeMan::Find(const CScript& payee)
@@ -407,6 +367,19 @@ CServicenode* CServicenodeMan::Find(const CTxIn& vin)
 }
 
 
+bool CServicenodeMan::GetServicenodePubKey(const CTxIn& vin, CPubKey& pubKeyServicenodeRet)
+{
+    LOCK(cs);
+
+    BOOST_FOREACH (const CServicenode& mn, vServicenodes) {
+        if (mn.vin.prevout == vin.prevout) {
+            pubKeyServicenodeRet = mn.pubKeyServicenode;
+            return true;
+        }
+    }
+    return false;
+}
+
 CServicenode* CServicenodeMan::Find(const CPubKey& pubKeyServicenode)
 {
     LOCK(cs);
@@ -667,11 +640,10 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
         CServicenodeBroadcast mnb;
         vRecv >> mnb;
 
-        if (mapSeenServicenodeBroadcast.count(mnb.GetHash())) { //seen
+        if (!AddSeenBroadcast(mnb)) { //seen
             servicenodeSync.AddedServicenodeList(mnb.GetHash());
             return;
         }
-        mapSeenServicenodeBroadcast.insert(make_pair(mnb.GetHash(), mnb));
 
         int nDoS = 0;
         if (!mnb.CheckAndUpdate(nDoS)) {
@@ -710,8 +682,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
 
         LogPrint("servicenode", "mnp - Servicenode ping, vin: %s\n", mnp.vin.prevout.hash.ToString());
 
-        if (mapSeenServicenodePing.count(mnp.GetHash())) return; //seen
-        mapSeenServicenodePing.insert(make_pair(mnp.GetHash(), mnp));
+        if (!AddSeenPing(mnp)) return; //seen
 
         int nDoS = 0;
         if (mnp.CheckAndUpdate(nDoS)) return;
@@ -735,6 +706,8 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
         CTxIn vin;
         vRecv >> vin;
 
+        LOCK(cs);
+
         if (vin == CTxIn()) { //only should ask for this once
             //local network
             bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
@@ -751,6 +724,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
                 }
                 int64_t askAgain = GetTime() + SERVICENODES_DSEG_SECONDS;
                 mAskedUsForServicenodeList[pfrom->addr] = askAgain;
+                dirtyAskedUs.Mark(pfrom->addr);
             }
         } //else, asking for a specific node which is ok
 
@@ -768,7 +742,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
                     pfrom->PushInventory(CInv(MSG_SERVICENODE_ANNOUNCE, hash));
                     nInvCount++;
 
-                    if (!mapSeenServicenodeBroadcast.count(hash)) mapSeenServicenodeBroadcast.insert(make_pair(hash, mnb));
+                    AddSeenBroadcast(mnb);
 
                     if (vin == mn.vin) {
                         LogPrint("servicenode", "dseg - Sent 1 Servicenode entry to peer %i\n", pfrom->GetId());
@@ -882,6 +856,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
                         pmn->addr = addr;
                         //fake ping
                         pmn->lastPing = CServicenodePing(vin);
+                        pmn->fDirty = true;
                     }
                     pmn->nLastDsee = sigTime;
                     pmn->Check();
@@ -1040,7 +1015,10 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
                 }
 
                 // fake ping for v11 servicenodes, ignore for v12
-                if (pmn->protocolVersion < GETHEADERS_VERSION) pmn->lastPing = CServicenodePing(vin);
+                if (pmn->protocolVersion < GETHEADERS_VERSION) {
+                    pmn->lastPing = CServicenodePing(vin);
+                    pmn->fDirty = true;
+                }
                 pmn->nLastDseep = sigTime;
                 pmn->Check();
                 if (pmn->IsEnabled()) {
@@ -1073,6 +1051,7 @@ void CServicenodeMan::Remove(CTxIn vin)
     while (it != vServicenodes.end()) {
         if ((*it).vin == vin) {
             LogPrint("servicenode", "CServicenodeMan: Removing Servicenode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+            dirtyServicenodes.Mark((*it).vin.prevout);
             vServicenodes.erase(it);
             break;
         }
@@ -1083,8 +1062,8 @@ void CServicenodeMan::Remove(CTxIn vin)
 void CServicenodeMan::UpdateServicenodeList(CServicenodeBroadcast mnb)
 {
     LOCK(cs);
-    mapSeenServicenodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
-    mapSeenServicenodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
+    AddSeenPing(mnb.lastPing);
+    AddSeenBroadcast(mnb);
 
     LogPrintf("CServicenodeMan::UpdateServicenodeList -- servicenode=%s\n", mnb.vin.prevout.ToStringShort());
 
@@ -1107,3 +1086,79 @@ std::string CServicenodeMan::ToString() const
 
     return info.str();
 }
+
+void CServicenodeMan::WriteState(CServicenodeStateDB& db)
+{
+    LOCK2(cs, cs_seen);
+    std::set<COutPoint> setRemoved;
+    dirtyServicenodes.Take(setRemoved);
+    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+        // a removed servicenode that came back is written, not erased
+        setRemoved.erase(mn.vin.prevout);
+        if (mn.fDirty || db.IsFullFlush())
+            db.WriteRecord('n', mn.vin.prevout, mn);
+        mn.fDirty = false;
+    }
+    if (!db.IsFullFlush()) {
+        BOOST_FOREACH (const COutPoint& outpoint, setRemoved)
+            db.EraseRecord('n', outpoint);
+    }
+    db.WriteRecords('u', mAskedUsForServicenodeList, dirtyAskedUs);
+    db.WriteRecords('w', mWeAskedForServicenodeList, dirtyWeAsked);
+    db.WriteRecords('e', mWeAskedForServicenodeListEntry, dirtyWeAskedEntry);
+    if (nDsqCount != nDsqCountFlushed || db.IsFullFlush()) {
+        db.WriteRecord('d', 0, nDsqCount);
+        nDsqCountFlushed = nDsqCount;
+    }
+    db.WriteRecords('b', mapSeenServicenodeBroadcast, dirtySeenBroadcasts);
+    db.WriteRecords('p', mapSeenServicenodePing, dirtySeenPings);
+}
+
+bool CServicenodeMan::LoadState(char chType, CDataStream& ssKey, CDataStream& ssValue)
+{
+    LOCK2(cs, cs_seen);
+    switch (chType) {
+    case 'n': {
+        CServicenode mn;
+        ssValue >> mn;
+        mn.fDirty = false;
+        vServicenodes.push_back(mn);
+        return true;
+    }
+    case 'u': {
+        CNetAddr addr;
+        ssKey >> addr;
+        ssValue >> mAskedUsForServicenodeList[addr];
+        return true;
+    }
+    case 'w': {
+        CNetAddr addr;
+        ssKey >> addr;
+        ssValue >> mWeAskedForServicenodeList[addr];
+        return true;
+    }
+    case 'e': {
+        COutPoint outpoint;
+        ssKey >> outpoint;
+        ssValue >> mWeAskedForServicenodeListEntry[outpoint];
+        return true;
+    }
+    case 'd':
+        ssValue >> nDsqCount;
+        nDsqCountFlushed = nDsqCount;
+        return true;
+    case 'b': {
+        uint256 hash;
+        ssKey >> hash;
+        ssValue >> mapSeenServicenodeBroadcast[hash];
+        return true;
+    }
+    case 'p': {
+        uint256 hash;
+        ssKey >> hash;
+        ssValue >> mapSeenServicenodePing[hash];
+        return true;
+    }
+    }
+    return false;
+}
@@ -11,11 +11,11 @@
 #include "key.h"
 #include "main.h"
 #include "servicenode.h"
+#include "servicenodedb.h"
 #include "net.h"
 #include "sync.h"
 #include "util.h"
 
-#define SERVICENODES_DUMP_SECONDS (15 * 60)
 #define SERVICENODES_DSEG_SECONDS (3 * 60 * 60)
 
 using namespace std;
@@ -23,31 +23,6 @@ using namespace std;
 class CServicenodeMan;
 
 extern CServicenodeMan mnodeman;
-void DumpServicenodes();
-
-/** Access to the MN database (mncache.dat)
- */
-class CServicenodeDB
-{
-private:
-    boost::filesystem::path pathMN;
-    std::string strMagicMessage;
-
-public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
-    CServicenodeDB();
-    bool Write(const CServicenodeMan& mnodemanToSave);
-    ReadResult Read(CServicenodeMan& mnodemanToLoad, bool fDryRun = false);
-};
 
 class CServicenodeMan
 {
@@ -67,11 +42,26 @@ private:
     // which Servicenodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForServicenodeListEntry;
 
-public:
+    // changed since the last flush to the state database; the servicenodes
+    // themselves carry fDirty, removing one marks its outpoint here
+    CServicenodeStateDirty<COutPoint> dirtyServicenodes;
+    CServicenodeStateDirty<CNetAddr> dirtyAskedUs;
+    CServicenodeStateDirty<CNetAddr> dirtyWeAsked;
+    CServicenodeStateDirty<COutPoint> dirtyWeAskedEntry;
+    int64_t nDsqCountFlushed;
+
+    // critical section to protect the seen maps below; the peer message
+    // threads look them up alongside the servicenode executor, so nothing
+    // else is locked while it is held
+    mutable CCriticalSection cs_seen;
     // Keep track of all broadcasts I've seen
     map<uint256, CServicenodeBroadcast> mapSeenServicenodeBroadcast;
     // Keep track of all pings I've seen
     map<uint256, CServicenodePing> mapSeenServicenodePing;
+    CServicenodeStateDirty<uint256> dirtySeenBroadcasts;
+    CServicenodeStateDirty<uint256> dirtySeenPings;
+
+public:
 
     // keep track of dsq count to prevent servicenodes from gaming obfuscation queue
     int64_t nDsqCount;
@@ -81,7 +71,7 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
-        LOCK(cs);
+        LOCK2(cs, cs_seen);
         READWRITE(vServicenodes);
         READWRITE(mAskedUsForServicenodeList);
         READWRITE(mWeAskedForServicenodeList);
@@ -104,6 +94,19 @@ public:
     /// Check all Servicenodes
     void Check();
 
+    /// Seen broadcasts and pings, by hash
+    bool HaveSeenBroadcast(const uint256& hash) const;
+    bool GetSeenBroadcast(const uint256& hash, CServicenodeBroadcast& mnbRet) const;
+    /// Remember a broadcast; false if it was seen already
+    bool AddSeenBroadcast(const CServicenodeBroadcast& mnb);
+    /// Forget a broadcast so that it is checked again when it comes back
+    void RemoveSeenBroadcast(const uint256& hash);
+    void UpdateSeenBroadcastPing(const uint256& hash, const CServicenodePing& mnp);
+    bool HaveSeenPing(const uint256& hash) const;
+    bool GetSeenPing(const uint256& hash, CServicenodePing& mnpRet) const;
+    /// Remember a ping; false if it was seen already
+    bool AddSeenPing(const CServicenodePing& mnp);
+
     /// Check all Servicenodes and remove inactive
     void CheckAndRemove(bool forceExpiredRemoval = false);
 
@@ -118,6 +121,8 @@ public:
     CServicenode* Find(const CScript& payee);
     CServicenode* Find(const CTxIn& vin);
     CServicenode* Find(const CPubKey& pubKeyServicenode);
+    /// Copy the key of an entry, for threads other than the message handlers
+    bool GetServicenodePubKey(const CTxIn& vin, CPubKey& pubKeyServicenodeRet);
 
     /// Find an entry in the servicenode list that is next to be paid
     CServicenode* GetNextServicenodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
@@ -147,6 +152,11 @@ public:
 
     std::string ToString() const;
 
+    /** Add the state worth keeping across restarts that changed since the last flush to db, see CServicenodeStateDB */
+    void WriteState(CServicenodeStateDB& db);
+    /** Take back one record written by WriteState; false if it is not one of ours */
+    bool LoadState(char chType, CDataStream& ssKey, CDataStream& ssValue);
+
     void Remove(CTxIn vin);
 
     /// Update servicenode list and maps using provided CServicenodeBroadcast
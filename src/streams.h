@@ -288,6 +288,60 @@ public:
     }
 };
 
+/** Deserializes from a range of bytes owned by someone else, without copying them.
+ *
+ * The bytes must outlive the reader.
+ */
+class CMemoryReader
+{
+private:
+    const char* pcur;
+    const char* pend;
+
+    int nType;
+    int nVersion;
+
+public:
+    CMemoryReader(const char* pbegin, const char* pendIn, int nTypeIn, int nVersionIn)
+        : pcur(pbegin), pend(pendIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    //
+    // Stream subset
+    //
+    void SetType(int n) { nType = n; }
+    int GetType() { return nType; }
+    void SetVersion(int n) { nVersion = n; }
+    int GetVersion() { return nVersion; }
+
+    bool empty() const { return pcur == pend; }
+    size_t size() const { return pend - pcur; }
+
+    CMemoryReader& read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMemoryReader::read : end of data");
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+        return (*this);
+    }
+
+    CMemoryReader& ignore(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMemoryReader::ignore : end of data");
+        pcur += nSize;
+        return (*this);
+    }
+
+    template <typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
 
 /** Non-refcounted RAII wrapper for FILE*
  *
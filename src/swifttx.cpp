@@ -5,6 +5,7 @@
 #include "activeservicenode.h"
 #include "base58.h"
 #include "key.h"
+#include "memusage.h"
 #include "servicenodeman.h"
 #include "net.h"
 #include "obfuscation.h"
@@ -17,12 +18,7 @@
 using namespace std;
 using namespace boost;
 
-std::map<uint256, CTransaction> mapTxLockReq;
-std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
-std::map<uint256, CTransactionLock> mapTxLocks;
-std::map<COutPoint, uint256> mapLockedInputs;
-std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
+CTxLockManager txLockManager(DEFAULT_MAX_SWIFTTX_MEMORY * 1000000);
 int nCompleteTXLocks;
 
 //txlock - Locks transaction
@@ -47,7 +43,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+        if (txLockManager.HaveRequest(tx.GetHash())) {
             return;
         }
 
@@ -79,7 +75,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddRequest(tx);
 
             LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -88,7 +84,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
             return;
 
         } else {
-            mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddRejectedRequest(tx);
 
             // can we get the conflicting transaction as proof?
 
@@ -96,24 +92,17 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
-            BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(make_pair(in.prevout, tx.GetHash()));
-                }
-            }
+            txLockManager.LockInputs(tx);
 
             // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
-                    }
+            //we only care if we have a complete tx lock
+            if (txLockManager.GetSignatures(tx.GetHash()) >= SWIFTTX_SIGNATURES_REQUIRED) {
+                if (!CheckForConflictingLocks(tx)) {
+                    LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
+
+                    //reprocess the last 15 blocks
+                    ReprocessBlocks(15);
+                    txLockManager.AddRequest(tx);
                 }
             }
 
@@ -127,12 +116,13 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
+        // Only votes that pass ProcessConsensusVote are remembered, so junk
+        // votes cannot push lock requests out of the memory budget
+        if (txLockManager.HaveVote(ctx.GetHash())) {
             return;
         }
 
-        mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
-
+        int64_t nTimeStart = GetTimeMicros();
         if (ProcessConsensusVote(pfrom, ctx)) {
             //Spam/Dos protection
             /*
@@ -140,23 +130,15 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinServicenode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinServicenode.prevout.hash] = GetTime() + (60 * 10);
-                }
-
-                if (mapUnknownVotes[ctx.vinServicenode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinServicenode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
-                    LogPrintf("ProcessMessageSwiftTX::ix - servicenode is spamming transaction votes: %s %s\n",
-                        ctx.vinServicenode.ToString().c_str(),
-                        ctx.txHash.ToString().c_str());
-                    return;
-                } else {
-                    mapUnknownVotes[ctx.vinServicenode.prevout.hash] = GetTime() + (60 * 10);
-                }
+            if (txLockManager.HaveRequest(ctx.txHash) || txLockManager.AllowUnknownVote(ctx.vinServicenode.prevout.hash)) {
+                RelayInv(inv);
+            } else {
+                LogPrintf("ProcessMessageSwiftTX::ix - servicenode is spamming transaction votes: %s %s\n",
+                    ctx.vinServicenode.ToString().c_str(),
+                    ctx.txHash.ToString().c_str());
             }
-            RelayInv(inv);
         }
+        txLockManager.RecordVoteTime(GetTimeMicros() - nTimeStart);
 
         return;
     }
@@ -211,6 +193,9 @@ bool IsIXTXValid(const CTransaction& txCollateral)
 
 int64_t CreateNewLock(CTransaction tx)
 {
+    // runs on the SwiftTX executor thread, which does not hold cs_main
+    LOCK(cs_main);
+
     int64_t nTxAge = 0;
     BOOST_REVERSE_FOREACH (CTxIn i, tx.vin) {
         nTxAge = GetInputAge(i);
@@ -228,20 +213,7 @@ int64_t CreateNewLock(CTransaction tx)
     */
     int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
 
-    if (!mapTxLocks.count(tx.GetHash())) {
-        LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = nBlockHeight;
-        newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = tx.GetHash();
-        mapTxLocks.insert(make_pair(tx.GetHash(), newLock));
-    } else {
-        mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
-        LogPrint("swifttx", "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
-    }
-
+    txLockManager.CreateLock(tx.GetHash(), nBlockHeight);
 
     return nBlockHeight;
 }
@@ -281,7 +253,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    txLockManager.AddVote(ctx);
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -315,136 +287,69 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return false;
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
-        LogPrintf("SwiftTX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(make_pair(ctx.txHash, newLock));
-    } else
-        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
+    if (!txLockManager.AddVote(ctx)) {
+        // another peer's copy of the vote got here first
+        return false;
+    }
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
-        (*i).second.AddSignature(ctx);
+    int nSignatures = txLockManager.AddSignature(ctx);
 
 #ifdef ENABLE_WALLET
-        if (pwalletMain) {
-            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
-        }
+    if (pwalletMain) {
+        //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
+        LOCK(pwalletMain->cs_wallet);
+        if (pwalletMain->mapRequestCount.count(ctx.txHash))
+            pwalletMain->mapRequestCount[ctx.txHash]++;
+    }
 #endif
 
-        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctx.GetHash().ToString().c_str());
+    LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", nSignatures, ctx.GetHash().ToString().c_str());
 
-        if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-            LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
+    if (nSignatures >= SWIFTTX_SIGNATURES_REQUIRED) {
+        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", ctx.txHash.ToString().c_str());
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx)) {
+        CTransaction tx;
+        bool fHaveRequest = txLockManager.GetRequest(ctx.txHash, tx);
+        if (!CheckForConflictingLocks(tx)) {
 #ifdef ENABLE_WALLET
-                if (pwalletMain) {
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash)) {
-                        nCompleteTXLocks++;
-                    }
+            if (pwalletMain) {
+                if (pwalletMain->UpdatedTransaction(ctx.txHash)) {
+                    nCompleteTXLocks++;
                 }
+            }
 #endif
 
-                if (mapTxLockReq.count(ctx.txHash)) {
-                    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                        if (!mapLockedInputs.count(in.prevout)) {
-                            mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
-                        }
-                    }
-                }
+            if (fHaveRequest)
+                txLockManager.LockInputs(tx);
 
-                // resolve conflicts
+            // resolve conflicts
 
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
-                }
+            //if this tx lock was rejected, we need to remove the conflicting blocks
+            if (txLockManager.IsRejected(ctx.txHash)) {
+                //reprocess the last 15 blocks
+                ReprocessBlocks(15);
             }
         }
-        return true;
     }
-
-
-    return false;
+    return true;
 }
 
-bool CheckForConflictingLocks(CTransaction& tx)
+bool CheckForConflictingLocks(const CTransaction& tx)
 {
-    /*
-        It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
-        In that case, they will cancel each other out.
-
-        Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
-        rescan the blocks and find they're acceptable and then take the chain with the most work.
-    */
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                LogPrintf("SwiftTX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
-                return true;
-            }
-        }
-    }
-
-    return false;
+    return txLockManager.CheckForConflictingLocks(tx);
 }
 
 int64_t GetAverageVoteTime()
 {
-    std::map<uint256, int64_t>::iterator it = mapUnknownVotes.begin();
-    int64_t total = 0;
-    int64_t count = 0;
-
-    while (it != mapUnknownVotes.end()) {
-        total += it->second;
-        count++;
-        it++;
-    }
-
-    return total / count;
+    return txLockManager.GetAverageVoteTime();
 }
 
 void CleanTransactionLocksList()
 {
     if (chainActive.Tip() == NULL) return;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
-
-    while (it != mapTxLocks.end()) {
-        if (GetTime() > it->second.nExpiration) { //keep them for an hour
-            LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
-
-            if (mapTxLockReq.count(it->second.txHash)) {
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
-
-                BOOST_FOREACH (const CTxIn& in, tx.vin)
-                    mapLockedInputs.erase(in.prevout);
-
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
-
-                BOOST_FOREACH (CConsensusVote& v, it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
-            }
-
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
-        }
-    }
+    txLockManager.Clean();
 }
 
 uint256 CConsensusVote::GetHash() const
@@ -527,12 +432,12 @@ bool CTransactionLock::SignaturesValid()
     return true;
 }
 
-void CTransactionLock::AddSignature(CConsensusVote& cv)
+void CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
     vecConsensusVotes.push_back(cv);
 }
 
-int CTransactionLock::CountSignatures()
+int CTransactionLock::CountSignatures() const
 {
     /*
         Only count signatures where the BlockHeight matches the transaction's blockheight.
@@ -542,10 +447,447 @@ int CTransactionLock::CountSignatures()
     if (nBlockHeight == 0) return -1;
 
     int n = 0;
-    BOOST_FOREACH (CConsensusVote v, vecConsensusVotes) {
+    BOOST_FOREACH (const CConsensusVote& v, vecConsensusVotes) {
         if (v.nBlockHeight == nBlockHeight) {
             n++;
         }
     }
     return n;
 }
+
+
+COutPointHasher::COutPointHasher() : salt(GetRandHash()) {}
+
+static size_t TxLockTxUsage(const CTransaction& tx)
+{
+    size_t nUsage = memusage::DynamicUsage(tx.vin) + memusage::DynamicUsage(tx.vout);
+    BOOST_FOREACH (const CTxIn& txin, tx.vin)
+        nUsage += memusage::DynamicUsage(*static_cast<const std::vector<unsigned char>*>(&txin.scriptSig));
+    BOOST_FOREACH (const CTxOut& txout, tx.vout)
+        nUsage += memusage::DynamicUsage(*static_cast<const std::vector<unsigned char>*>(&txout.scriptPubKey));
+    return nUsage;
+}
+
+static size_t TxLockVoteUsage(const CConsensusVote& vote)
+{
+    return memusage::DynamicUsage(vote.vchServiceNodeSignature) +
+           memusage::DynamicUsage(*static_cast<const std::vector<unsigned char>*>(&vote.vinServicenode.scriptSig));
+}
+
+CTxLockManager::CTxLockManager(size_t nMaxUsageIn) : nUnknownVoteTimeTotal(0), nLocks(0), nInnerUsage(0), nMaxUsage(nMaxUsageIn),
+                                                     nEvicted(0), nVotesProcessed(0), nTotalVoteMicros(0), nMaxVoteMicros(0)
+{
+}
+
+void CTxLockManager::SetMaxMemory(size_t nMaxUsageIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    LimitMemory();
+}
+
+void CTxLockManager::Clear()
+{
+    LOCK(cs);
+    mapEntries.clear();
+    mapVoteIndex.clear();
+    mapLockedInputs.clear();
+    heapExpiry = std::priority_queue<ExpiryItem, std::vector<ExpiryItem>, std::greater<ExpiryItem> >();
+    mapUnknownVotes.clear();
+    nUnknownVoteTimeTotal = 0;
+    nLocks = 0;
+    nInnerUsage = 0;
+}
+
+CTxLockEntry& CTxLockManager::GetOrCreate(const uint256& txHash)
+{
+    AssertLockHeld(cs);
+    std::pair<EntryMap::iterator, bool> ret = mapEntries.insert(std::make_pair(txHash, CTxLockEntry()));
+    CTxLockEntry& entry = ret.first->second;
+    if (ret.second) {
+        entry.lock.txHash = txHash;
+        entry.lock.nBlockHeight = 0;
+        entry.lock.nTimeout = GetTime() + (60 * 5);
+        entry.lock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
+        heapExpiry.push(std::make_pair(entry.lock.nExpiration, txHash));
+    }
+    return entry;
+}
+
+void CTxLockManager::SetExpiration(CTxLockEntry& entry, int64_t nExpiration)
+{
+    AssertLockHeld(cs);
+    if (entry.lock.nExpiration == nExpiration)
+        return;
+    entry.lock.nExpiration = nExpiration;
+    heapExpiry.push(std::make_pair(nExpiration, entry.lock.txHash));
+}
+
+void CTxLockManager::UpdateUsage(CTxLockEntry& entry)
+{
+    AssertLockHeld(cs);
+    size_t nUsage = TxLockTxUsage(entry.tx) + memusage::DynamicUsage(entry.lock.vecConsensusVotes) +
+                    memusage::DynamicUsage(entry.mapVotes) + memusage::DynamicUsage(entry.vLockedInputs);
+    BOOST_FOREACH (const CConsensusVote& vote, entry.lock.vecConsensusVotes)
+        nUsage += TxLockVoteUsage(vote);
+    BOOST_FOREACH (const PAIRTYPE(const uint256, CConsensusVote) & item, entry.mapVotes)
+        nUsage += TxLockVoteUsage(item.second);
+    nInnerUsage = nInnerUsage - entry.nUsage + nUsage;
+    entry.nUsage = nUsage;
+}
+
+void CTxLockManager::Remove(EntryMap::iterator it)
+{
+    AssertLockHeld(cs);
+    CTxLockEntry& entry = it->second;
+    BOOST_FOREACH (const PAIRTYPE(const uint256, CConsensusVote) & item, entry.mapVotes)
+        mapVoteIndex.erase(item.first);
+    BOOST_FOREACH (const COutPoint& outpoint, entry.vLockedInputs) {
+        InputIndex::iterator itInput = mapLockedInputs.find(outpoint);
+        if (itInput != mapLockedInputs.end() && itInput->second == it->first)
+            mapLockedInputs.erase(itInput);
+    }
+    if (entry.fLock)
+        nLocks--;
+    nInnerUsage -= entry.nUsage;
+    mapEntries.erase(it);
+}
+
+size_t CTxLockManager::DynamicMemoryUsage() const
+{
+    AssertLockHeld(cs);
+    return memusage::DynamicUsage(mapEntries) + memusage::DynamicUsage(mapVoteIndex) +
+           memusage::DynamicUsage(mapLockedInputs) + memusage::DynamicUsage(mapUnknownVotes) +
+           memusage::MallocUsage(sizeof(ExpiryItem) * heapExpiry.size()) + nInnerUsage;
+}
+
+void CTxLockManager::LimitMemory()
+{
+    AssertLockHeld(cs);
+    if (DynamicMemoryUsage() <= nMaxUsage)
+        return;
+
+    // Votes for transactions nobody asked to lock go first, then incomplete
+    // locks, complete locks only if they alone exceed the budget
+    std::vector<ExpiryItem> vKept;
+    for (int nPass = 0; nPass < 3 && DynamicMemoryUsage() > nMaxUsage; nPass++) {
+        while (!heapExpiry.empty() && DynamicMemoryUsage() > nMaxUsage) {
+            ExpiryItem item = heapExpiry.top();
+            heapExpiry.pop();
+            EntryMap::iterator it = mapEntries.find(item.second);
+            if (it == mapEntries.end() || it->second.lock.nExpiration != item.first)
+                continue;
+            const CTxLockEntry& entry = it->second;
+            bool fComplete = entry.IsComplete();
+            bool fRequested = entry.fAccepted || entry.fRejected;
+            if ((nPass == 0 && (fComplete || fRequested)) || (nPass == 1 && fComplete)) {
+                vKept.push_back(item);
+                continue;
+            }
+            LogPrint("swifttx", "CTxLockManager::LimitMemory - evicting transaction lock %s\n", item.second.ToString());
+            Remove(it);
+            nEvicted++;
+        }
+        BOOST_FOREACH (const ExpiryItem& item, vKept)
+            heapExpiry.push(item);
+        vKept.clear();
+    }
+    CompactExpiryHeap();
+}
+
+void CTxLockManager::CompactExpiryHeap()
+{
+    AssertLockHeld(cs);
+    // Evicted entries and changed expirations leave items behind
+    if (heapExpiry.size() <= 2 * mapEntries.size() + 1000)
+        return;
+    std::vector<ExpiryItem> vItems;
+    vItems.reserve(mapEntries.size());
+    for (EntryMap::const_iterator it = mapEntries.begin(); it != mapEntries.end(); ++it)
+        vItems.push_back(std::make_pair(it->second.lock.nExpiration, it->first));
+    heapExpiry = std::priority_queue<ExpiryItem, std::vector<ExpiryItem>, std::greater<ExpiryItem> >(
+        std::greater<ExpiryItem>(), vItems);
+}
+
+bool CTxLockManager::HaveRequest(const uint256& txHash) const
+{
+    LOCK(cs);
+    EntryMap::const_iterator it = mapEntries.find(txHash);
+    return it != mapEntries.end() && (it->second.fAccepted || it->second.fRejected);
+}
+
+bool CTxLockManager::GetRequest(const uint256& txHash, CTransaction& txRet) const
+{
+    LOCK(cs);
+    EntryMap::const_iterator it = mapEntries.find(txHash);
+    if (it == mapEntries.end() || !it->second.fAccepted)
+        return false;
+    txRet = it->second.tx;
+    return true;
+}
+
+bool CTxLockManager::IsRejected(const uint256& txHash) const
+{
+    LOCK(cs);
+    EntryMap::const_iterator it = mapEntries.find(txHash);
+    return it != mapEntries.end() && it->second.fRejected;
+}
+
+void CTxLockManager::AddRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    CTxLockEntry& entry = GetOrCreate(tx.GetHash());
+    entry.tx = tx;
+    entry.fAccepted = true;
+    UpdateUsage(entry);
+    LimitMemory();
+}
+
+void CTxLockManager::AddRejectedRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    CTxLockEntry& entry = GetOrCreate(tx.GetHash());
+    entry.tx = tx;
+    entry.fRejected = true;
+    UpdateUsage(entry);
+    LimitMemory();
+}
+
+bool CTxLockManager::HaveVote(const uint256& voteHash) const
+{
+    LOCK(cs);
+    return mapVoteIndex.count(voteHash);
+}
+
+bool CTxLockManager::GetVote(const uint256& voteHash, CConsensusVote& voteRet) const
+{
+    LOCK(cs);
+    VoteIndex::const_iterator itIndex = mapVoteIndex.find(voteHash);
+    if (itIndex == mapVoteIndex.end())
+        return false;
+    EntryMap::const_iterator it = mapEntries.find(itIndex->second);
+    if (it == mapEntries.end())
+        return false;
+    std::map<uint256, CConsensusVote>::const_iterator itVote = it->second.mapVotes.find(voteHash);
+    if (itVote == it->second.mapVotes.end())
+        return false;
+    voteRet = itVote->second;
+    return true;
+}
+
+bool CTxLockManager::AddVote(const CConsensusVote& vote)
+{
+    LOCK(cs);
+    uint256 voteHash = vote.GetHash();
+    if (!mapVoteIndex.insert(std::make_pair(voteHash, vote.txHash)).second)
+        return false;
+    CTxLockEntry& entry = GetOrCreate(vote.txHash);
+    entry.mapVotes.insert(std::make_pair(voteHash, vote));
+    UpdateUsage(entry);
+    LimitMemory();
+    return true;
+}
+
+int CTxLockManager::AddSignature(const CConsensusVote& vote)
+{
+    LOCK(cs);
+    CTxLockEntry& entry = GetOrCreate(vote.txHash);
+    if (!entry.fLock) {
+        LogPrintf("SwiftTX::ProcessConsensusVote - New Transaction Lock %s !\n", vote.txHash.ToString().c_str());
+        entry.fLock = true;
+        nLocks++;
+        entry.lock.nTimeout = GetTime() + (60 * 5);
+        SetExpiration(entry, GetTime() + (60 * 60));
+    } else
+        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Exists %s !\n", vote.txHash.ToString().c_str());
+    entry.lock.AddSignature(vote);
+    int nSignatures = entry.lock.CountSignatures();
+    UpdateUsage(entry);
+    LimitMemory();
+    return nSignatures;
+}
+
+bool CTxLockManager::AllowUnknownVote(const uint256& hashServicenode)
+{
+    LOCK(cs);
+    int64_t nNow = GetTime();
+    std::map<uint256, int64_t>::iterator it = mapUnknownVotes.find(hashServicenode);
+    if (it == mapUnknownVotes.end()) {
+        it = mapUnknownVotes.insert(std::make_pair(hashServicenode, nNow + (60 * 10))).first;
+        nUnknownVoteTimeTotal += it->second;
+    }
+
+    if (it->second > nNow && it->second - nUnknownVoteTimeTotal / (int64_t)mapUnknownVotes.size() > 60 * 10)
+        return false;
+
+    nUnknownVoteTimeTotal += nNow + (60 * 10) - it->second;
+    it->second = nNow + (60 * 10);
+    return true;
+}
+
+void CTxLockManager::RecordVoteTime(int64_t nMicros)
+{
+    LOCK(cs);
+    nVotesProcessed++;
+    nTotalVoteMicros += nMicros;
+    nMaxVoteMicros = std::max(nMaxVoteMicros, nMicros);
+}
+
+int64_t CTxLockManager::GetAverageVoteTime() const
+{
+    LOCK(cs);
+    if (mapUnknownVotes.empty())
+        return 0;
+    return nUnknownVoteTimeTotal / (int64_t)mapUnknownVotes.size();
+}
+
+void CTxLockManager::CreateLock(const uint256& txHash, int nBlockHeight)
+{
+    LOCK(cs);
+    CTxLockEntry& entry = GetOrCreate(txHash);
+    if (!entry.fLock) {
+        LogPrintf("CreateNewLock - New Transaction Lock %s !\n", txHash.ToString().c_str());
+        entry.fLock = true;
+        nLocks++;
+        entry.lock.nTimeout = GetTime() + (60 * 5);
+        SetExpiration(entry, GetTime() + (60 * 60));
+    } else
+        LogPrint("swifttx", "CreateNewLock - Transaction Lock Exists %s !\n", txHash.ToString().c_str());
+    entry.lock.nBlockHeight = nBlockHeight;
+    UpdateUsage(entry);
+    LimitMemory();
+}
+
+bool CTxLockManager::HaveLock(const uint256& txHash) const
+{
+    LOCK(cs);
+    EntryMap::const_iterator it = mapEntries.find(txHash);
+    return it != mapEntries.end() && it->second.fLock;
+}
+
+int CTxLockManager::GetSignatures(const uint256& txHash) const
+{
+    LOCK(cs);
+    EntryMap::const_iterator it = mapEntries.find(txHash);
+    if (it == mapEntries.end() || !it->second.fLock)
+        return -1;
+    return it->second.lock.CountSignatures();
+}
+
+bool CTxLockManager::IsTimedOut(const uint256& txHash) const
+{
+    LOCK(cs);
+    EntryMap::const_iterator it = mapEntries.find(txHash);
+    if (it == mapEntries.end() || !it->second.fLock)
+        return false;
+    return GetTime() > it->second.lock.nTimeout;
+}
+
+size_t CTxLockManager::GetLockCount() const
+{
+    LOCK(cs);
+    return nLocks;
+}
+
+void CTxLockManager::LockInputs(const CTransaction& tx)
+{
+    LOCK(cs);
+    CTxLockEntry& entry = GetOrCreate(tx.GetHash());
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        if (mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash())).second)
+            entry.vLockedInputs.push_back(in.prevout);
+    }
+    UpdateUsage(entry);
+    LimitMemory();
+}
+
+bool CTxLockManager::GetConflictingLock(const CTransaction& tx, uint256& hashLockRet) const
+{
+    LOCK(cs);
+    if (mapLockedInputs.empty())
+        return false;
+    uint256 txHash = tx.GetHash();
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        InputIndex::const_iterator it = mapLockedInputs.find(in.prevout);
+        if (it != mapLockedInputs.end() && it->second != txHash) {
+            hashLockRet = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CTxLockManager::CheckForConflictingLocks(const CTransaction& tx)
+{
+    /*
+        It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
+        In that case, they will cancel each other out.
+
+        Blocks could have been rejected during this time, which is OK. After they cancel out, the client will
+        rescan the blocks and find they're acceptable and then take the chain with the most work.
+    */
+    LOCK(cs);
+    uint256 hashLock;
+    if (!GetConflictingLock(tx, hashLock))
+        return false;
+
+    LogPrintf("SwiftTX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), hashLock.ToString().c_str());
+    EntryMap::iterator it = mapEntries.find(tx.GetHash());
+    if (it != mapEntries.end() && it->second.fLock) SetExpiration(it->second, GetTime());
+    it = mapEntries.find(hashLock);
+    if (it != mapEntries.end() && it->second.fLock) SetExpiration(it->second, GetTime());
+    return true;
+}
+
+void CTxLockManager::GetProtected(std::set<uint256>& setProtected) const
+{
+    LOCK(cs);
+    for (EntryMap::const_iterator it = mapEntries.begin(); it != mapEntries.end(); ++it) {
+        if (it->second.fAccepted || it->second.fLock)
+            setProtected.insert(it->first);
+    }
+}
+
+void CTxLockManager::Clean()
+{
+    LOCK(cs);
+    int64_t nNow = GetTime();
+    while (!heapExpiry.empty() && heapExpiry.top().first < nNow) { //keep them for an hour
+        ExpiryItem item = heapExpiry.top();
+        heapExpiry.pop();
+        EntryMap::iterator it = mapEntries.find(item.second);
+        if (it == mapEntries.end() || it->second.lock.nExpiration != item.first)
+            continue;
+        if (it->second.fLock)
+            LogPrintf("Removing old transaction lock %s\n", item.second.ToString().c_str());
+        Remove(it);
+    }
+
+    std::map<uint256, int64_t>::iterator it = mapUnknownVotes.begin();
+    while (it != mapUnknownVotes.end()) {
+        if (it->second < nNow) {
+            nUnknownVoteTimeTotal -= it->second;
+            mapUnknownVotes.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    CompactExpiryHeap();
+}
+
+CTxLockStats CTxLockManager::GetStats() const
+{
+    LOCK(cs);
+    CTxLockStats stats;
+    stats.nEntries = mapEntries.size();
+    stats.nLocks = nLocks;
+    stats.nVotes = mapVoteIndex.size();
+    stats.nLockedInputs = mapLockedInputs.size();
+    stats.nUsage = DynamicMemoryUsage();
+    stats.nMaxUsage = nMaxUsage;
+    stats.nEvicted = nEvicted;
+    stats.nVotesProcessed = nVotesProcessed;
+    stats.nTotalVoteMicros = nTotalVoteMicros;
+    stats.nMaxVoteMicros = nMaxVoteMicros;
+    return stats;
+}
@@ -8,6 +8,7 @@
 #define SWIFTTX_H
 
 #include "base58.h"
+#include "coins.h"
 #include "key.h"
 #include "main.h"
 #include "net.h"
@@ -15,6 +16,10 @@
 #include "sync.h"
 #include "util.h"
 
+#include <queue>
+
+#include <boost/unordered_map.hpp>
+
 /*
     At 15 signatures, 1/2 of the servicenode network can be owned by
     one party without comprimising the security of SwiftTX
@@ -34,13 +39,14 @@ class CConsensusVote;
 class CTransaction;
 class CTransactionLock;
 
+class CTxLockManager;
+
 static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
-extern map<uint256, CTransaction> mapTxLockReq;
-extern map<uint256, CTransaction> mapTxLockReqRejected;
-extern map<uint256, CConsensusVote> mapTxLockVote;
-extern map<uint256, CTransactionLock> mapTxLocks;
-extern std::map<COutPoint, uint256> mapLockedInputs;
+/** Default for -maxswifttxmem, the memory budget of the lock requests, votes and locks in megabytes */
+static const unsigned int DEFAULT_MAX_SWIFTTX_MEMORY = 32;
+
+extern CTxLockManager txLockManager;
 extern int nCompleteTXLocks;
 
 
@@ -49,7 +55,7 @@ int64_t CreateNewLock(CTransaction tx);
 bool IsIXTXValid(const CTransaction& txCollateral);
 
 // if two conflicting locks are approved by the network, they will cancel out
-bool CheckForConflictingLocks(CTransaction& tx);
+bool CheckForConflictingLocks(const CTransaction& tx);
 
 void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
@@ -99,14 +105,150 @@ public:
     int nTimeout;
 
     bool SignaturesValid();
-    int CountSignatures();
-    void AddSignature(CConsensusVote& cv);
+    int CountSignatures() const;
+    void AddSignature(const CConsensusVote& cv);
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         return txHash;
     }
 };
 
+/** What is known about the lock of one transaction */
+class CTxLockEntry
+{
+public:
+    CTransaction tx;
+    bool fAccepted;       // the lock request entered our memory pool and is relayed
+    bool fRejected;       // the lock request conflicted with our memory pool
+    bool fLock;           // votes for the transaction are counted
+    CTransactionLock lock;
+    std::map<uint256, CConsensusVote> mapVotes; // all votes seen for the transaction, counted or not
+    std::vector<COutPoint> vLockedInputs;       // the inputs this transaction holds in the locked input index
+    size_t nUsage;        // memory used by the above, see CTxLockManager::DynamicMemoryUsage
+
+    CTxLockEntry() : fAccepted(false), fRejected(false), fLock(false), nUsage(0) {}
+
+    bool IsComplete() const { return fLock && lock.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED; }
+};
+
+struct CTxLockStats {
+    size_t nEntries;
+    size_t nLocks;
+    size_t nVotes;
+    size_t nLockedInputs;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nEvicted;
+    uint64_t nVotesProcessed;
+    int64_t nTotalVoteMicros;
+    int64_t nMaxVoteMicros;
+};
+
+class COutPointHasher
+{
+private:
+    uint256 salt;
+
+public:
+    COutPointHasher();
+
+    size_t operator()(const COutPoint& outpoint) const
+    {
+        return outpoint.hash.GetHash(salt) ^ outpoint.n;
+    }
+};
+
+/**
+ * SwiftTX lock requests, votes and locks, kept in one entry per transaction.
+ * Votes and locked inputs are indexed to the entry they belong to, and
+ * entries expire in the order of a heap, so cleaning up does not walk
+ * everything. When the entries outgrow the memory budget the earliest
+ * expiring ones are dropped, complete locks last.
+ *
+ * Only the manager's own lock is taken inside; callers must not hold it
+ * while taking cs_main or the servicenode manager's.
+ */
+class CTxLockManager
+{
+private:
+    typedef boost::unordered_map<uint256, CTxLockEntry, CCoinsKeyHasher> EntryMap;
+    typedef boost::unordered_map<uint256, uint256, CCoinsKeyHasher> VoteIndex;
+    typedef boost::unordered_map<COutPoint, uint256, COutPointHasher> InputIndex;
+    typedef std::pair<int64_t, uint256> ExpiryItem;
+
+    mutable CCriticalSection cs;
+    EntryMap mapEntries;
+    VoteIndex mapVoteIndex;   // vote hash -> transaction hash
+    InputIndex mapLockedInputs; // locked input -> transaction hash
+    // earliest expiration on top; items outdated by a later expiration are skipped
+    std::priority_queue<ExpiryItem, std::vector<ExpiryItem>, std::greater<ExpiryItem> > heapExpiry;
+    // track votes with no transaction for DOS, by servicenode
+    std::map<uint256, int64_t> mapUnknownVotes;
+    int64_t nUnknownVoteTimeTotal;
+    size_t nLocks;
+    size_t nInnerUsage;
+    size_t nMaxUsage;
+    uint64_t nEvicted;
+    uint64_t nVotesProcessed;
+    int64_t nTotalVoteMicros;
+    int64_t nMaxVoteMicros;
+
+    CTxLockEntry& GetOrCreate(const uint256& txHash);
+    void SetExpiration(CTxLockEntry& entry, int64_t nExpiration);
+    void UpdateUsage(CTxLockEntry& entry);
+    void Remove(EntryMap::iterator it);
+    void LimitMemory();
+    void CompactExpiryHeap();
+    size_t DynamicMemoryUsage() const;
+
+public:
+    explicit CTxLockManager(size_t nMaxUsageIn);
+
+    void SetMaxMemory(size_t nMaxUsageIn);
+    void Clear();
+
+    /** Whether a lock request was seen, accepted or rejected */
+    bool HaveRequest(const uint256& txHash) const;
+    /** The lock request, if it was accepted */
+    bool GetRequest(const uint256& txHash, CTransaction& txRet) const;
+    bool IsRejected(const uint256& txHash) const;
+    void AddRequest(const CTransaction& tx);
+    void AddRejectedRequest(const CTransaction& tx);
+
+    bool HaveVote(const uint256& voteHash) const;
+    bool GetVote(const uint256& voteHash, CConsensusVote& voteRet) const;
+    /** Remember a vote whose servicenode and signature were checked; returns false if it was seen before */
+    bool AddVote(const CConsensusVote& vote);
+    /** Count a vote whose servicenode and signature were checked; returns the lock's signatures */
+    int AddSignature(const CConsensusVote& vote);
+    /** Whether a servicenode may vote for a transaction nobody asked to lock yet */
+    bool AllowUnknownVote(const uint256& hashServicenode);
+    void RecordVoteTime(int64_t nMicros);
+    int64_t GetAverageVoteTime() const;
+
+    /** Start counting votes for a transaction, or move its lock to nBlockHeight */
+    void CreateLock(const uint256& txHash, int nBlockHeight);
+    bool HaveLock(const uint256& txHash) const;
+    /** The lock's signatures, or -1 if there is no lock */
+    int GetSignatures(const uint256& txHash) const;
+    bool IsTimedOut(const uint256& txHash) const;
+    size_t GetLockCount() const;
+
+    /** Lock the inputs of tx that are not locked yet */
+    void LockInputs(const CTransaction& tx);
+    /** Whether an input of tx is locked by another transaction */
+    bool GetConflictingLock(const CTransaction& tx, uint256& hashLockRet) const;
+    /** Expire both locks if an input of tx is locked by another transaction */
+    bool CheckForConflictingLocks(const CTransaction& tx);
+
+    /** Add the transactions the memory pool must keep */
+    void GetProtected(std::set<uint256>& setProtected) const;
+    /** Remove the entries that expired */
+    void Clean();
+
+    CTxLockStats GetStats() const;
+};
+
 
 #endif
@@ -0,0 +1,76 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+#include "clientversion.h"
+#include "key.h"
+#include "main.h"
+#include "script/standard.h"
+#include "streams.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+static std::string SerializedKey(const CAddressIndexKey& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::make_pair('a', key);
+    return ss.str();
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_key_order)
+{
+    uint160 hashA(1), hashB(2);
+    uint256 txhash(3);
+
+    // The database order is the height order, across byte boundaries too
+    BOOST_CHECK(SerializedKey(CAddressIndexKey(ADDRESS_P2PKH, hashA, 255, txhash, 0, false)) <
+                SerializedKey(CAddressIndexKey(ADDRESS_P2PKH, hashA, 256, txhash, 0, false)));
+    BOOST_CHECK(SerializedKey(CAddressIndexKey(ADDRESS_P2PKH, hashA, 70000, txhash, 0, false)) <
+                SerializedKey(CAddressIndexKey(ADDRESS_P2PKH, hashB, 1, txhash, 0, false)));
+    BOOST_CHECK(SerializedKey(CAddressIndexKey(ADDRESS_P2PKH, hashA, 1, txhash, 255, false)) <
+                SerializedKey(CAddressIndexKey(ADDRESS_P2PKH, hashA, 1, txhash, 256, false)));
+
+    // A seek key is a prefix of the entries of its address and heights
+    CDataStream ssSeek(SER_DISK, CLIENT_VERSION);
+    ssSeek << std::make_pair('a', CAddressIndexIteratorKey(ADDRESS_P2PKH, hashA, 256));
+    std::string strEntry = SerializedKey(CAddressIndexKey(ADDRESS_P2PKH, hashA, 256, txhash, 7, true));
+    BOOST_CHECK(strEntry.compare(0, ssSeek.size(), ssSeek.str()) == 0);
+
+    // And it round trips
+    CAddressIndexKey key(ADDRESS_P2SH, hashB, 123456, txhash, 7, true), key2;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    BOOST_CHECK_EQUAL(ss.size(), key.GetSerializeSize(SER_DISK, CLIENT_VERSION));
+    ss >> key2;
+    BOOST_CHECK(key2.type == ADDRESS_P2SH && key2.hashBytes == hashB && key2.nHeight == 123456);
+    BOOST_CHECK(key2.txhash == txhash && key2.nIndex == 7 && key2.fSpending);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_extract)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    int type;
+    uint160 hashBytes;
+
+    BOOST_CHECK(ExtractIndexAddress(GetScriptForDestination(pubkey.GetID()), type, hashBytes));
+    BOOST_CHECK(type == ADDRESS_P2PKH && hashBytes == uint160(pubkey.GetID()));
+
+    // Pay to pubkey counts as the key's address
+    BOOST_CHECK(ExtractIndexAddress(CScript() << ToByteVector(pubkey) << OP_CHECKSIG, type, hashBytes));
+    BOOST_CHECK(type == ADDRESS_P2PKH && hashBytes == uint160(pubkey.GetID()));
+
+    CScript redeem = CScript() << OP_1 << ToByteVector(pubkey) << OP_1 << OP_CHECKMULTISIG;
+    BOOST_CHECK(ExtractIndexAddress(GetScriptForDestination(CScriptID(redeem)), type, hashBytes));
+    BOOST_CHECK(type == ADDRESS_P2SH && hashBytes == uint160(CScriptID(redeem)));
+
+    BOOST_CHECK(!ExtractIndexAddress(redeem, type, hashBytes));
+    BOOST_CHECK(!ExtractIndexAddress(CScript() << OP_RETURN << std::vector<unsigned char>(20, 1), type, hashBytes));
+    BOOST_CHECK(!ExtractIndexAddress(CScript(), type, hashBytes));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
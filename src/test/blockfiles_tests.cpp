@@ -0,0 +1,111 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfiles.h"
+#include "clientversion.h"
+#include "main.h"
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfiles_tests)
+
+// A proof of stake block, so reading it back does not check its work
+static CBlock MakeBlock(int nTxs)
+{
+    CBlock block;
+    block.hashPrevBlock = GetRandHash();
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), i);
+        tx.vout.resize(2);
+        tx.vout[1].nValue = COIN;
+        tx.vout[1].scriptPubKey = CScript() << OP_TRUE;
+        if (i == 0) {
+            tx.vin[0].prevout.SetNull();
+            tx.vout[0].SetEmpty();
+        } else if (i == 1) {
+            tx.vout[0].SetEmpty();
+        }
+        block.vtx.push_back(tx);
+    }
+    block.vchBlockSig = std::vector<unsigned char>(72, 1);
+    return block;
+}
+
+static std::string Serialized(const CBlock& block)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    return ss.str();
+}
+
+static void CheckRead(const CBlock& block, const CDiskBlockPos& pos)
+{
+    CBlock blockRead;
+    BOOST_CHECK(ReadBlockFromDisk(blockRead, pos));
+    BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    BOOST_CHECK(blockRead.IsProofOfStake() && blockRead.vchBlockSig == block.vchBlockSig);
+
+    CRawBlock raw;
+    BOOST_CHECK(ReadRawBlockFromDisk(raw, pos));
+    BOOST_CHECK(std::string(raw.begin(), raw.end()) == Serialized(block));
+
+    // Pushed to a stream it is the block as the block would serialize
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << raw;
+    BOOST_CHECK(ss.str() == Serialized(block));
+}
+
+BOOST_AUTO_TEST_CASE(blockfiles_mapped_reads)
+{
+    blockFileCache.Clear();
+    blockFileCache.SetMaxMappings(2);
+
+    CBlock block1 = MakeBlock(3);
+    CDiskBlockPos pos1(90, 0);
+    BOOST_CHECK(WriteBlockToDisk(block1, pos1));
+    CheckRead(block1, pos1);
+    BOOST_CHECK_EQUAL(blockFileCache.GetMappingCount(), 1U);
+
+    // A block appended after the file was mapped
+    CBlock block2 = MakeBlock(5);
+    CDiskBlockPos pos2(90, pos1.nPos + ::GetSerializeSize(block1, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(WriteBlockToDisk(block2, pos2));
+    CheckRead(block2, pos2);
+    CheckRead(block1, pos1);
+    BOOST_CHECK_EQUAL(blockFileCache.GetMappingCount(), 1U);
+
+    // Only the most recently read files stay mapped
+    CBlock block3 = MakeBlock(2), block4 = MakeBlock(2);
+    CDiskBlockPos pos3(91, 0), pos4(92, 0);
+    BOOST_CHECK(WriteBlockToDisk(block3, pos3));
+    BOOST_CHECK(WriteBlockToDisk(block4, pos4));
+    CRawBlock raw1;
+    BOOST_CHECK(ReadRawBlockFromDisk(raw1, pos1));
+    CheckRead(block3, pos3);
+    CheckRead(block4, pos4);
+    BOOST_CHECK_EQUAL(blockFileCache.GetMappingCount(), 2U);
+    // An evicted mapping stays usable while it is held
+    BOOST_CHECK(std::string(raw1.begin(), raw1.end()) == Serialized(block1));
+
+    // There is no block in the middle of one
+    CRawBlock raw;
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, CDiskBlockPos(90, pos1.nPos + 10)));
+
+    // Without mappings the same bytes come from the file system
+    blockFileCache.SetMaxMappings(0);
+    BOOST_CHECK_EQUAL(blockFileCache.GetMappingCount(), 0U);
+    CheckRead(block2, pos2);
+    CheckRead(block3, pos3);
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, CDiskBlockPos(90, pos1.nPos + 10)));
+    BOOST_CHECK_EQUAL(blockFileCache.GetMappingCount(), 0U);
+
+    blockFileCache.SetMaxMappings(DEFAULT_BLOCK_MAPPINGS);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
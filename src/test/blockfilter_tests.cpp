@@ -0,0 +1,125 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "hash.h"
+#include "main.h"
+#include "random.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+BOOST_AUTO_TEST_CASE(siphash)
+{
+    // Reference vectors from the SipHash paper
+    CSipHasher hasher(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(), 0x726fdb47dd0e0e31ULL);
+    static const unsigned char t0[1] = {0};
+    hasher.Write(t0, 1);
+    BOOST_CHECK_EQUAL(hasher.Finalize(), 0x74f839c593dc67fdULL);
+    static const unsigned char t1[7] = {1, 2, 3, 4, 5, 6, 7};
+    hasher.Write(t1, 7);
+    BOOST_CHECK_EQUAL(hasher.Finalize(), 0x93f5f5799a932462ULL);
+    hasher.Write(0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(), 0x3f2acc7f57c29bdbULL);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_match)
+{
+    GCSFilter::ElementSet included, excluded;
+    for (int i = 0; i < 100; i++) {
+        GCSFilter::Element element1(32, 0);
+        element1[0] = i;
+        element1[1] = 1;
+        included.insert(element1);
+
+        GCSFilter::Element element2(32, 0);
+        element2[0] = i;
+        element2[1] = 2;
+        excluded.insert(element2);
+    }
+
+    GCSFilter filter(0, 0, 10, 1 << 10, included);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100U);
+    for (GCSFilter::ElementSet::const_iterator it = included.begin(); it != included.end(); ++it) {
+        BOOST_CHECK(filter.Match(*it));
+        GCSFilter::ElementSet one;
+        one.insert(*it);
+        BOOST_CHECK(filter.MatchAny(one));
+    }
+    BOOST_CHECK(filter.MatchAny(included));
+
+    // A filter decoded from the encoding is the same set
+    GCSFilter decoded(0, 0, 10, 1 << 10, filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), 100U);
+    BOOST_CHECK(decoded.GetEncoded() == filter.GetEncoded());
+    for (GCSFilter::ElementSet::const_iterator it = included.begin(); it != included.end(); ++it)
+        BOOST_CHECK(decoded.Match(*it));
+
+    // About one false positive in 2^10
+    int nFalsePositives = 0;
+    for (GCSFilter::ElementSet::const_iterator it = excluded.begin(); it != excluded.end(); ++it)
+        nFalsePositives += filter.Match(*it);
+    BOOST_CHECK(nFalsePositives < 5);
+
+    // Truncated filters do not decode
+    std::vector<unsigned char> vTruncated(filter.GetEncoded().begin(), filter.GetEncoded().end() - 10);
+    BOOST_CHECK_THROW(GCSFilter(0, 0, 10, 1 << 10, vTruncated), std::ios_base::failure);
+
+    GCSFilter empty;
+    BOOST_CHECK_EQUAL(empty.GetN(), 0U);
+    BOOST_CHECK(!empty.Match(*included.begin()));
+    BOOST_CHECK(!empty.MatchAny(included));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic)
+{
+    CScript scriptIncluded1 = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CScript scriptIncluded2 = CScript() << OP_HASH160 << std::vector<unsigned char>(20, 2) << OP_EQUAL;
+    CScript scriptSpent = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 3) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CScript scriptOpReturn = CScript() << OP_RETURN << std::vector<unsigned char>(20, 4);
+    CScript scriptExcluded = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 5) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(2);
+    coinbase.vout[0].scriptPubKey = scriptIncluded1;
+    // PoS coinbases have an empty first output, which is left out
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx.vout.resize(2);
+    tx.vout[0].scriptPubKey = scriptIncluded2;
+    tx.vout[1].scriptPubKey = scriptOpReturn;
+
+    CBlock block;
+    block.vtx.push_back(coinbase);
+    block.vtx.push_back(tx);
+
+    CBlockUndo blockundo;
+    blockundo.vtxundo.resize(1);
+    blockundo.vtxundo[0].vprevout.push_back(CTxInUndo(CTxOut(COIN, scriptSpent)));
+
+    BlockFilter filter(block, blockundo);
+    BOOST_CHECK(filter.GetBlockHash() == block.GetHash());
+    const GCSFilter& gcs = filter.GetFilter();
+    BOOST_CHECK_EQUAL(gcs.GetN(), 3U);
+    BOOST_CHECK(gcs.Match(GCSFilter::Element(scriptIncluded1.begin(), scriptIncluded1.end())));
+    BOOST_CHECK(gcs.Match(GCSFilter::Element(scriptIncluded2.begin(), scriptIncluded2.end())));
+    BOOST_CHECK(gcs.Match(GCSFilter::Element(scriptSpent.begin(), scriptSpent.end())));
+    BOOST_CHECK(!gcs.Match(GCSFilter::Element(scriptOpReturn.begin(), scriptOpReturn.end())));
+    BOOST_CHECK(!gcs.Match(GCSFilter::Element(scriptExcluded.begin(), scriptExcluded.end())));
+
+    // The stored encoding gives the same filter back, and the header chains
+    BlockFilter stored(block.GetHash(), filter.GetEncodedFilter());
+    BOOST_CHECK(stored.GetHash() == filter.GetHash());
+    BOOST_CHECK(stored.GetFilter().Match(GCSFilter::Element(scriptSpent.begin(), scriptSpent.end())));
+    uint256 hashHeader = filter.ComputeHeader(uint256());
+    BOOST_CHECK(hashHeader != filter.GetHash());
+    BOOST_CHECK(filter.ComputeHeader(hashHeader) != hashHeader);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,8 +8,10 @@
 
 
 
+#include "blockprecheck.h"
 #include "clientversion.h"
 #include "main.h"
+#include "streams.h"
 #include "utiltime.h"
 
 #include <cstdio>
@@ -66,4 +68,85 @@ BOOST_AUTO_TEST_CASE(May15)
     SetMockTime(0);
 }
 
+static CBlock SmallBlock()
+{
+    CBlock block;
+    block.nVersion = 3;
+    block.nBits = 0x1e0ffff0;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 50 * COIN;
+    block.vtx.push_back(coinbase);
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(block.vtx[0].GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = COIN;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(tx);
+
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(precheck_memo)
+{
+    CBlock block = SmallBlock();
+    BOOST_CHECK(!block.fChecked && !block.fSignatureChecked);
+    BOOST_CHECK(PrecheckBlock(block));
+    BOOST_CHECK(block.fChecked && block.fSignatureChecked);
+
+    // Decoding into a checked block drops the memo
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    ss >> block;
+    BOOST_CHECK(!block.fChecked && !block.fSignatureChecked);
+
+    // CVE-2012-2459: a duplicated last transaction keeps the merkle root
+    CBlock mutated = SmallBlock();
+    mutated.vtx.push_back(mutated.vtx.back());
+    BOOST_CHECK(!PrecheckBlock(mutated));
+    BOOST_CHECK(!mutated.fChecked);
+
+    // A wrong merkle root
+    CBlock badroot = SmallBlock();
+    badroot.hashMerkleRoot = badroot.vtx[1].GetHash();
+    BOOST_CHECK(!PrecheckBlock(badroot));
+    BOOST_CHECK(!badroot.fChecked);
+}
+
+BOOST_AUTO_TEST_CASE(precheck_queue)
+{
+    // Without threads the work is done by Wait()
+    CBlockPrecheckQueue queue;
+    BOOST_CHECK(!queue.IsRunning());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << SmallBlock();
+    boost::shared_ptr<CBlockPrecheck> job(new CBlockPrecheck(ss));
+    queue.Push(job);
+    BOOST_CHECK_EQUAL(queue.GetQueueSize(), 0U);
+    boost::shared_ptr<CBlock> pblock = queue.Wait(job);
+    BOOST_REQUIRE(pblock);
+    BOOST_CHECK(pblock->GetHash() == SmallBlock().GetHash());
+    BOOST_CHECK(pblock->fChecked);
+
+    // Waiting again hands back the same block
+    BOOST_CHECK(queue.Wait(job) == pblock);
+
+    // A truncated message does not decode
+    CDataStream ssShort(ss.begin(), ss.begin() + 100, SER_NETWORK, PROTOCOL_VERSION);
+    boost::shared_ptr<CBlockPrecheck> jobShort(new CBlockPrecheck(ssShort));
+    BOOST_CHECK(!queue.Wait(jobShort));
+
+    uint64_t nChecked, nAhead;
+    queue.GetStats(nChecked, nAhead);
+    BOOST_CHECK_EQUAL(nChecked, 2U);
+    BOOST_CHECK_EQUAL(nAhead, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -58,6 +58,31 @@ public:
 
     bool GetStats(CCoinsStats& stats) const { return false; }
 };
+
+class CCoinsViewCacheTest : public CCoinsViewCache
+{
+public:
+    CCoinsViewCacheTest(CCoinsView* base) : CCoinsViewCache(base) {}
+
+    void SelfTest() const
+    {
+        // Manually recompute the dynamic usage of the whole data, and compare it.
+        size_t ret = memusage::DynamicUsage(cacheCoins);
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
+            ret += it->second.coins.DynamicMemoryUsage();
+        }
+        BOOST_CHECK_EQUAL(DynamicMemoryUsage(), ret);
+    }
+
+    unsigned int DirtyCount() const
+    {
+        unsigned int nDirty = 0;
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++)
+            if (it->second.flags & CCoinsCacheEntry::DIRTY)
+                nDirty++;
+        return nDirty;
+    }
+};
 }
 
 BOOST_AUTO_TEST_SUITE(coins_tests)
@@ -89,8 +114,8 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
 
     // The cache stack.
     CCoinsViewTest base; // A CCoinsViewTest at the bottom.
-    std::vector<CCoinsViewCache*> stack; // A stack of CCoinsViewCaches on top.
-    stack.push_back(new CCoinsViewCache(&base)); // Start with one cache.
+    std::vector<CCoinsViewCacheTest*> stack; // A stack of CCoinsViewCaches on top.
+    stack.push_back(new CCoinsViewCacheTest(&base)); // Start with one cache.
 
     // Use a limited set of random transaction ids, so we do test overwriting entries.
     std::vector<uint256> txids;
@@ -115,6 +140,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
                 coins.nVersion = insecure_rand();
                 coins.vout.resize(1);
                 coins.vout[0].nValue = insecure_rand();
+                coins.vout[0].scriptPubKey.assign(insecure_rand() & 0x3F, 0);
                 *entry = coins;
             } else {
                 coins.Clear();
@@ -135,6 +161,9 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
                     missed_an_entry = true;
                 }
             }
+            BOOST_FOREACH (const CCoinsViewCacheTest* test, stack) {
+                test->SelfTest();
+            }
         }
 
         if (insecure_rand() % 100 == 0) {
@@ -151,7 +180,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
                 } else {
                     removed_all_caches = true;
                 }
-                stack.push_back(new CCoinsViewCache(tip));
+                stack.push_back(new CCoinsViewCacheTest(tip));
                 if (stack.size() == 4) {
                     reached_4_caches = true;
                 }
@@ -175,4 +204,78 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+BOOST_AUTO_TEST_CASE(coins_cache_uncache_clean)
+{
+    CCoinsViewTest base;
+    std::vector<uint256> txids;
+    {
+        // Write 100 non-pruned entries to the base view
+        CCoinsViewCache writer(&base);
+        for (int i = 0; i < 100; i++) {
+            txids.push_back(GetRandHash());
+            CCoinsModifier entry = writer.ModifyCoins(txids.back());
+            entry->vout.resize(1);
+            entry->vout[0].nValue = 1;
+            entry->vout[0].scriptPubKey.assign(100, 0);
+        }
+        writer.Flush();
+    }
+
+    CCoinsViewCacheTest cache(&base);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(cache.AccessCoins(txids[i]));
+    for (int i = 0; i < 10; i++)
+        cache.ModifyCoins(txids[i])->vout[0].nValue = 2;
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 100U);
+    BOOST_CHECK_EQUAL(cache.DirtyCount(), 10U);
+
+    // A generous budget drops nothing
+    BOOST_CHECK_EQUAL(cache.UncacheClean(cache.DynamicMemoryUsage()), 0U);
+
+    // A zero budget drops every clean entry but keeps the modified ones
+    size_t nUsage = cache.DynamicMemoryUsage();
+    BOOST_CHECK_EQUAL(cache.UncacheClean(0), 90U);
+    BOOST_CHECK(cache.DynamicMemoryUsage() < nUsage);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 10U);
+    BOOST_CHECK_EQUAL(cache.DirtyCount(), 10U);
+    cache.SelfTest();
+
+    // Dropped entries are fetched again, modified ones are intact
+    BOOST_CHECK_EQUAL(cache.AccessCoins(txids[50])->vout[0].nValue, 1);
+    BOOST_CHECK_EQUAL(cache.AccessCoins(txids[5])->vout[0].nValue, 2);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(coins_cache_prefill)
+{
+    CCoinsViewTest base;
+    uint256 txid = GetRandHash();
+    {
+        CCoinsViewCache writer(&base);
+        CCoinsModifier entry = writer.ModifyCoins(txid);
+        entry->vout.resize(1);
+        entry->vout[0].nValue = 1;
+        writer.Flush();
+    }
+
+    // Read ahead from the base, the way the block prefetch does
+    CCoinsViewCacheTest cache(&base);
+    BOOST_CHECK(!cache.HaveCoinsInCache(txid));
+    CCoins coins;
+    BOOST_CHECK(cache.GetBackend()->GetCoins(txid, coins));
+    cache.Prefill(txid, coins);
+    BOOST_CHECK(cache.HaveCoinsInCache(txid));
+    BOOST_CHECK_EQUAL(cache.DirtyCount(), 0U);
+    BOOST_CHECK_EQUAL(cache.AccessCoins(txid)->vout[0].nValue, 1);
+    cache.SelfTest();
+
+    // A stale read never replaces what the cache already has
+    cache.ModifyCoins(txid)->vout[0].nValue = 2;
+    BOOST_CHECK(cache.GetBackend()->GetCoins(txid, coins));
+    cache.Prefill(txid, coins);
+    BOOST_CHECK_EQUAL(cache.AccessCoins(txid)->vout[0].nValue, 2);
+    cache.SelfTest();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
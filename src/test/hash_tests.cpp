@@ -2,7 +2,9 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/quark.h"
 #include "hash.h"
+#include "random.h"
 #include "utilstrencodings.h"
 
 #include <vector>
@@ -46,4 +48,25 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(quark)
+{
+    // Vectors computed with the original sph_* pipeline.
+    std::vector<unsigned char> zero(80, 0);
+    std::string fox = "The quick brown fox jumps over the lazy dog";
+    BOOST_CHECK_EQUAL(HashQuark(zero.begin(), zero.begin()).GetHex(), "9c7d513ab01c44694f7bc7c6a7e269a3eced7b2be24d8663835bf35a3bf10008");
+    BOOST_CHECK_EQUAL(HashQuark(zero.begin(), zero.end()).GetHex(), "02067fe51503a2f5ebb46b8a06f185fb8763a5d3d758eee11a3a0ea055823d63");
+    BOOST_CHECK_EQUAL(HashQuark(fox.begin(), fox.end()).GetHex(), "a51361c415e83def5c7c39e9ebc72913edb970a52403c91c04e2c9e96fceec70");
+
+    // Whatever stages were selected must agree with the reference.
+    QuarkAutoDetect();
+    unsigned char data[256], expected[QUARK_OUTPUT_SIZE], actual[QUARK_OUTPUT_SIZE];
+    for (int i = 0; i < 1000; i++) {
+        size_t len = insecure_rand() % sizeof(data);
+        GetRandBytes(data, len);
+        QuarkHashReference(data, len, expected);
+        QuarkHash(data, len, actual);
+        BOOST_CHECK(memcmp(expected, actual, QUARK_OUTPUT_SIZE) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
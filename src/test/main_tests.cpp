@@ -6,9 +6,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/transaction.h"
+#include "chainparams.h"
+#include "crypto/quark.h"
 #include "main.h"
 
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 BOOST_AUTO_TEST_SUITE(main_tests)
 
@@ -49,4 +52,64 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+BOOST_AUTO_TEST_CASE(block_hash_memo_test)
+{
+    // Rebuilt from the header fields, so nothing is memoised yet
+    CBlock block(Params().GenesisBlock().GetBlockHeader());
+    uint64_t nStart = QuarkHashCount();
+    uint256 hash = block.GetHash();
+    BOOST_CHECK(hash == Params().HashGenesisBlock());
+    block.GetHash();
+    BOOST_CHECK_EQUAL(QuarkHashCount() - nStart, 1U);
+
+    // Copies keep the memo
+    CBlock copy(block);
+    BOOST_CHECK(copy.GetHash() == hash);
+    BOOST_CHECK_EQUAL(QuarkHashCount() - nStart, 1U);
+
+    // Any header change is picked up
+    block.nNonce++;
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK_EQUAL(QuarkHashCount() - nStart, 2U);
+    block.nNonce--;
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK_EQUAL(QuarkHashCount() - nStart, 3U);
+
+    block.SetNull();
+    BOOST_CHECK(block.GetHash() == CBlockHeader().GetHash());
+
+    // CheckBlock hashes the header once, whatever it looks at
+    CBlock genesis(Params().GenesisBlock().GetBlockHeader());
+    genesis.vtx = Params().GenesisBlock().vtx;
+    CValidationState state;
+    nStart = QuarkHashCount();
+    CheckBlock(genesis, state, true, true, false);
+    BOOST_CHECK(QuarkHashCount() - nStart <= 1);
+}
+
+static void HashSharedBlock(const CBlock* pblock, const uint256* pexpected, bool* pfOk)
+{
+    for (int i = 0; i < 1000; i++) {
+        if (pblock->GetHash() != *pexpected)
+            *pfOk = false;
+        CBlockHeader copy(*pblock);
+        if (copy.GetHash() != *pexpected)
+            *pfOk = false;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_hash_memo_threads_test)
+{
+    // One shared block hashed and copied from several threads at once
+    CBlock block(Params().GenesisBlock().GetBlockHeader());
+    const uint256 expected = Params().HashGenesisBlock();
+    bool vfOk[4] = {true, true, true, true};
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&HashSharedBlock, &block, &expected, &vfOk[i]));
+    threads.join_all();
+    for (int i = 0; i < 4; i++)
+        BOOST_CHECK(vfOk[i]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -99,4 +99,147 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+/** A one-in one-out transaction spending prevout */
+static CMutableTransaction MempoolTestTx(const uint256& hashPrev, int n)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vin[0].prevout.hash = hashPrev;
+    tx.vin[0].prevout.n = n;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolDescendantStateTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    CMutableTransaction txParent = MempoolTestTx(GetRandHash(), 0);
+    CMutableTransaction txChild = MempoolTestTx(txParent.GetHash(), 0);
+    CMutableTransaction txGrandChild = MempoolTestTx(txChild.GetHash(), 0);
+    CTxMemPoolEntry parent(txParent, 1000, 0, 0.0, 1);
+    CTxMemPoolEntry child(txChild, 2000, 0, 0.0, 1);
+    CTxMemPoolEntry grandChild(txGrandChild, 3000, 0, 0.0, 1);
+    const uint64_t nSize = parent.GetTxSize();
+
+    pool.addUnchecked(txParent.GetHash(), parent);
+    pool.addUnchecked(txChild.GetHash(), child);
+    pool.addUnchecked(txGrandChild.GetHash(), grandChild);
+    BOOST_CHECK_EQUAL(pool.mapTx[txParent.GetHash()].GetCountWithDescendants(), 3U);
+    BOOST_CHECK_EQUAL(pool.mapTx[txParent.GetHash()].GetSizeWithDescendants(), 3 * nSize);
+    BOOST_CHECK_EQUAL(pool.mapTx[txParent.GetHash()].GetModFeesWithDescendants(), 6000);
+    BOOST_CHECK_EQUAL(pool.mapTx[txChild.GetHash()].GetModFeesWithDescendants(), 5000);
+    // The children pay for the parent
+    BOOST_CHECK(pool.mapTx[txParent.GetHash()].GetDescendantScore() > 1000.0 * 1000 / nSize);
+
+    // Confirming the parent leaves the descendants' own state alone
+    std::list<CTransaction> removed;
+    pool.remove(txParent, removed, false);
+    BOOST_CHECK_EQUAL(pool.mapTx[txChild.GetHash()].GetCountWithDescendants(), 2U);
+
+    // Back from a disconnected block, the parent picks up its descendants again
+    pool.addUnchecked(txParent.GetHash(), parent);
+    BOOST_CHECK_EQUAL(pool.mapTx[txParent.GetHash()].GetCountWithDescendants(), 3U);
+    BOOST_CHECK_EQUAL(pool.mapTx[txParent.GetHash()].GetModFeesWithDescendants(), 6000);
+
+    // Removing the grandchild updates both ancestors
+    pool.remove(txGrandChild, removed, true);
+    BOOST_CHECK_EQUAL(pool.mapTx[txParent.GetHash()].GetCountWithDescendants(), 2U);
+    BOOST_CHECK_EQUAL(pool.mapTx[txParent.GetHash()].GetModFeesWithDescendants(), 3000);
+    BOOST_CHECK_EQUAL(pool.mapTx[txChild.GetHash()].GetCountWithDescendants(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    std::set<uint256> setNoneProtected;
+
+    // A cheap parent with a well paying child, an average loner and a cheap loner
+    CMutableTransaction txParent = MempoolTestTx(GetRandHash(), 0);
+    CMutableTransaction txChild = MempoolTestTx(txParent.GetHash(), 0);
+    CMutableTransaction txAverage = MempoolTestTx(GetRandHash(), 0);
+    CMutableTransaction txCheap = MempoolTestTx(GetRandHash(), 0);
+    pool.addUnchecked(txParent.GetHash(), CTxMemPoolEntry(txParent, 100, 100, 0.0, 1));
+    pool.addUnchecked(txChild.GetHash(), CTxMemPoolEntry(txChild, 50000, 200, 0.0, 1));
+    pool.addUnchecked(txAverage.GetHash(), CTxMemPoolEntry(txAverage, 10000, 300, 0.0, 1));
+    pool.addUnchecked(txCheap.GetHash(), CTxMemPoolEntry(txCheap, 500, 400, 0.0, 1));
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), 1000);
+    // A transaction in the pool already is refused
+    BOOST_CHECK(!pool.addUnchecked(txCheap.GetHash(), CTxMemPoolEntry(txCheap, 500, 400, 0.0, 1)));
+    BOOST_CHECK_EQUAL(pool.size(), 4U);
+
+    // The cheap loner goes first; the parent is carried by its child
+    size_t nUsage = pool.DynamicMemoryUsage();
+    BOOST_CHECK_EQUAL(pool.TrimToSize(nUsage - 1, setNoneProtected), 1U);
+    BOOST_CHECK(!pool.exists(txCheap.GetHash()));
+    BOOST_CHECK(pool.exists(txParent.GetHash()));
+    BOOST_CHECK_EQUAL(pool.GetEvictedCount(), 1U);
+    // Anything new now has to beat the evicted package
+    BOOST_CHECK(pool.GetMinFee(nUsage).GetFeePerK() > 1000);
+
+    // A protected package stays, the next lowest goes instead
+    std::set<uint256> setProtected;
+    setProtected.insert(txChild.GetHash());
+    BOOST_CHECK_EQUAL(pool.TrimToSize(1, setProtected), 1U);
+    BOOST_CHECK(!pool.exists(txAverage.GetHash()));
+    BOOST_CHECK_EQUAL(pool.size(), 2U);
+    // ... until it isn't protected anymore, when it goes as a whole
+    BOOST_CHECK_EQUAL(pool.TrimToSize(1, setNoneProtected), 2U);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+    BOOST_CHECK_EQUAL(pool.DynamicMemoryUsage(), 0U);
+
+    // Expiry takes the old transactions and their descendants
+    pool.addUnchecked(txParent.GetHash(), CTxMemPoolEntry(txParent, 100, 100, 0.0, 1));
+    pool.addUnchecked(txChild.GetHash(), CTxMemPoolEntry(txChild, 50000, 300, 0.0, 1));
+    pool.addUnchecked(txAverage.GetHash(), CTxMemPoolEntry(txAverage, 10000, 200, 0.0, 1));
+    BOOST_CHECK(!pool.HasExpired(100));
+    BOOST_CHECK(pool.HasExpired(150));
+    BOOST_CHECK_EQUAL(pool.Expire(150, setNoneProtected), 2U);
+    BOOST_CHECK_EQUAL(pool.size(), 1U);
+    BOOST_CHECK(!pool.HasExpired(150));
+    BOOST_CHECK_EQUAL(pool.GetExpiredCount(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolBlockIndexTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    LOCK(pool.cs);
+
+    // Same size, so fee order is fee rate order; priority is set at entry
+    CMutableTransaction txLow = MempoolTestTx(GetRandHash(), 0);
+    CMutableTransaction txMid = MempoolTestTx(GetRandHash(), 0);
+    CMutableTransaction txHigh = MempoolTestTx(GetRandHash(), 0);
+    pool.addUnchecked(txLow.GetHash(), CTxMemPoolEntry(txLow, 1000, 0, 30.0, 1));
+    pool.addUnchecked(txMid.GetHash(), CTxMemPoolEntry(txMid, 2000, 0, 20.0, 1));
+    pool.addUnchecked(txHigh.GetHash(), CTxMemPoolEntry(txHigh, 3000, 0, 10.0, 1));
+
+    CTxMemPool::score_iterator it = pool.FeeRateBegin();
+    BOOST_CHECK(it->second == txHigh.GetHash());
+    BOOST_CHECK((++it)->second == txMid.GetHash());
+    BOOST_CHECK((++it)->second == txLow.GetHash());
+    BOOST_CHECK(++it == pool.FeeRateEnd());
+    BOOST_CHECK(pool.PriorityBegin(1)->second == txLow.GetHash());
+
+    // Deltas move entries already in the pool
+    pool.PrioritiseTransaction(txLow.GetHash(), txLow.GetHash().ToString(), 100.0, 5000);
+    BOOST_CHECK(pool.FeeRateBegin()->second == txLow.GetHash());
+    pool.PrioritiseTransaction(txHigh.GetHash(), txHigh.GetHash().ToString(), 1000.0, 0);
+    BOOST_CHECK(pool.PriorityBegin(1)->second == txHigh.GetHash());
+
+    // Arrivals are slotted in, removals taken out
+    CMutableTransaction txTop = MempoolTestTx(GetRandHash(), 0);
+    pool.addUnchecked(txTop.GetHash(), CTxMemPoolEntry(txTop, 100000, 0, 1e6, 1));
+    BOOST_CHECK(pool.FeeRateBegin()->second == txTop.GetHash());
+    BOOST_CHECK(pool.PriorityBegin(1)->second == txTop.GetHash());
+    std::list<CTransaction> removed;
+    pool.remove(txTop, removed, false);
+    BOOST_CHECK(pool.FeeRateBegin()->second == txLow.GetHash());
+    BOOST_CHECK(pool.PriorityBegin(1)->second == txHigh.GetHash());
+    // A new height rebuilds the priority index; take the end after that
+    CTxMemPool::score_iterator itPriority = pool.PriorityBegin(2);
+    BOOST_CHECK_EQUAL(std::distance(itPriority, pool.PriorityEnd()), 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "messageexecutor.h"
+#include "net.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+static int nHandled = 0;
+static std::vector<int> vHandled;
+
+static void CountingHandler(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    int n;
+    vRecv >> n;
+    vHandled.push_back(n);
+    nHandled++;
+}
+
+static std::vector<size_t> vBatchSizes;
+
+static void RecordingPrecheck(const CMessageExecutor::MessageBatch& vBatch)
+{
+    // Nothing of the batch is handled yet
+    BOOST_CHECK_EQUAL(nHandled, 0);
+    vBatchSizes.push_back(vBatch.size());
+}
+
+BOOST_AUTO_TEST_SUITE(messageexecutor_tests)
+
+BOOST_AUTO_TEST_CASE(executor_inline)
+{
+    CCriticalSection cs;
+    CMessageExecutor executor("test", 2, CountingHandler, &cs);
+    CNode dummyNode(INVALID_SOCKET, CAddress(CService("127.0.0.1", 0)), "", true);
+    nHandled = 0;
+
+    BOOST_CHECK(!executor.IsRunning());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << 7;
+    executor.Handle(&dummyNode, "cmd", ss, 0);
+    BOOST_CHECK_EQUAL(nHandled, 1);
+
+    // Malformed messages are caught and still accounted for
+    CDataStream ssEmpty(SER_NETWORK, PROTOCOL_VERSION);
+    executor.Handle(&dummyNode, "cmd", ssEmpty, 0);
+    BOOST_CHECK_EQUAL(nHandled, 1);
+    MessageStatsMap mapStats = executor.GetStats().Get();
+    BOOST_CHECK_EQUAL(mapStats["cmd"].nCount, 2U);
+
+    // Messages from disconnected peers are skipped
+    dummyNode.fDisconnect = true;
+    executor.Handle(&dummyNode, "cmd", ss, 0);
+    BOOST_CHECK_EQUAL(nHandled, 1);
+}
+
+BOOST_AUTO_TEST_CASE(executor_queue)
+{
+    CMessageExecutor executor("test", 2, CountingHandler, NULL);
+    CNode dummyNode(INVALID_SOCKET, CAddress(CService("127.0.0.1", 0)), "", true);
+    nHandled = 0;
+    vHandled.clear();
+
+    for (int i = 0; i < 2; i++) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << i;
+        BOOST_CHECK(executor.Post(&dummyNode, "cmd", ss));
+    }
+    BOOST_CHECK_EQUAL(executor.GetQueueSize(), 2U);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 2);
+
+    // A full queue refuses the message without blocking and drops its reference
+    CDataStream ssFull(SER_NETWORK, PROTOCOL_VERSION);
+    ssFull << 2;
+    BOOST_CHECK(!executor.Post(&dummyNode, "cmd", ssFull));
+    BOOST_CHECK_EQUAL(executor.GetQueueSize(), 2U);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 2);
+
+    boost::thread thread(boost::bind(&CMessageExecutor::Thread, &executor));
+    int64_t nStart = GetTimeMillis();
+    while (executor.GetQueueSize() > 0 && GetTimeMillis() - nStart < 5000)
+        MilliSleep(1);
+    while (dummyNode.GetRefCount() > 0 && GetTimeMillis() - nStart < 5000)
+        MilliSleep(1);
+    BOOST_CHECK(executor.IsRunning());
+    thread.interrupt();
+    thread.join();
+    BOOST_CHECK(!executor.IsRunning());
+
+    // Handled in order, references released
+    BOOST_CHECK_EQUAL(nHandled, 2);
+    BOOST_CHECK(vHandled.size() == 2 && vHandled[0] == 0 && vHandled[1] == 1);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+    BOOST_CHECK_EQUAL(executor.GetStats().Get()["cmd"].nCount, 2U);
+}
+
+BOOST_AUTO_TEST_CASE(executor_batch_precheck)
+{
+    CMessageExecutor executor("test", 10, CountingHandler, NULL, RecordingPrecheck);
+    CNode dummyNode(INVALID_SOCKET, CAddress(CService("127.0.0.1", 0)), "", true);
+    nHandled = 0;
+    vHandled.clear();
+    vBatchSizes.clear();
+
+    for (int i = 0; i < 5; i++) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << i;
+        executor.Post(&dummyNode, "cmd", ss);
+    }
+
+    boost::thread thread(boost::bind(&CMessageExecutor::Thread, &executor));
+    int64_t nStart = GetTimeMillis();
+    while (dummyNode.GetRefCount() > 0 && GetTimeMillis() - nStart < 5000)
+        MilliSleep(1);
+    thread.interrupt();
+    thread.join();
+
+    // One batch of everything queued, then handled in the order queued
+    BOOST_CHECK(vBatchSizes.size() == 1 && vBatchSizes[0] == 5);
+    BOOST_CHECK_EQUAL(nHandled, 5);
+    for (int i = 0; i < (int)vHandled.size(); i++)
+        BOOST_CHECK_EQUAL(vHandled[i], i);
+    BOOST_CHECK_EQUAL(dummyNode.GetRefCount(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "nodepool.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <map>
+#include <string.h>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace
+{
+struct KeyHasher {
+    size_t operator()(const uint256& key) const { return key.GetLow64(); }
+};
+}
+
+BOOST_AUTO_TEST_SUITE(nodepool_tests)
+
+BOOST_AUTO_TEST_CASE(nodepool_alloc_free)
+{
+    CNodePool pool;
+    std::vector<void*> vNodes;
+    // Enough nodes for a few chunks
+    for (int i = 0; i < 10000; i++) {
+        void* p = pool.Allocate(40);
+        BOOST_CHECK(((size_t)p & 15) == 0);
+        memset(p, i & 0xff, 40);
+        vNodes.push_back(p);
+    }
+    BOOST_CHECK_EQUAL(pool.GetNodeCount(), 10000U);
+    BOOST_CHECK_EQUAL(pool.GetNodeBytes(), 10000U * 48);
+    BOOST_CHECK(pool.GetChunkBytes() >= 10000U * 48);
+    const size_t nChunkBytes = pool.GetChunkBytes();
+
+    // Freed slots are reused before new chunks are taken
+    for (size_t i = 0; i < vNodes.size(); i += 2)
+        pool.Deallocate(vNodes[i], 40);
+    for (size_t i = 0; i < vNodes.size(); i += 2)
+        vNodes[i] = pool.Allocate(40);
+    BOOST_CHECK_EQUAL(pool.GetChunkBytes(), nChunkBytes);
+
+    // Another size class gets chunks of its own
+    void* pbig = pool.Allocate(300);
+    BOOST_CHECK_EQUAL(pool.GetChunkBytes(), nChunkBytes + CNodePool::CHUNK_SIZE);
+    pool.Deallocate(pbig, 300);
+
+    // Emptied chunks go back, except for the spare one per size class
+    for (size_t i = 0; i < vNodes.size(); i++)
+        pool.Deallocate(vNodes[i], 40);
+    BOOST_CHECK_EQUAL(pool.GetNodeCount(), 0U);
+    BOOST_CHECK_EQUAL(pool.GetNodeBytes(), 0U);
+    BOOST_CHECK_EQUAL(pool.GetChunkBytes(), 2 * CNodePool::CHUNK_SIZE);
+    pool.ReleaseSpare();
+    BOOST_CHECK_EQUAL(pool.GetChunkBytes(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(nodepool_containers)
+{
+    typedef boost::unordered_map<uint256, int, KeyHasher, std::equal_to<uint256>,
+        node_pool_allocator<std::pair<const uint256, int> > > PooledMap;
+    typedef std::map<uint256, int, std::less<uint256>, node_pool_allocator<std::pair<const uint256, int> > > PooledTree;
+
+    PooledMap map;
+    PooledTree tree;
+    std::map<uint256, int> reference;
+    for (int i = 0; i < 20000; i++) {
+        uint256 key = GetRandHash();
+        key &= uint256(0x3fff); // collide now and then
+        if (insecure_rand() % 3 == 0) {
+            map.erase(key);
+            tree.erase(key);
+            reference.erase(key);
+        } else {
+            map[key] = i;
+            tree[key] = i;
+            reference[key] = i;
+        }
+    }
+    BOOST_CHECK_EQUAL(map.size(), reference.size());
+    BOOST_CHECK_EQUAL(map.get_allocator().GetNodeCount(), reference.size());
+    BOOST_CHECK(tree.size() == reference.size() && std::equal(tree.begin(), tree.end(), reference.begin()));
+
+    // Containers of one thread share its pool, but count their own nodes
+    BOOST_CHECK(&map.get_allocator().GetPool() == &tree.get_allocator().GetPool());
+    BOOST_CHECK_EQUAL(tree.get_allocator().GetPool().GetNodeCount(), map.size() + tree.size());
+
+    // A copy counts its nodes apart, a swap takes them along
+    PooledTree copy(tree);
+    BOOST_CHECK(copy.get_allocator() != tree.get_allocator());
+    BOOST_CHECK_EQUAL(copy.get_allocator().GetNodeCount(), tree.size());
+    PooledTree swapped;
+    swapped.swap(copy);
+    BOOST_CHECK(copy.empty() && swapped.size() == tree.size());
+    BOOST_CHECK_EQUAL(swapped.get_allocator().GetNodeCount(), tree.size());
+    BOOST_CHECK_EQUAL(copy.get_allocator().GetNodeCount(), 0U);
+
+    // An owner's pool holds only the nodes of the containers placed there
+    boost::shared_ptr<CNodePool> pool(new CNodePool());
+    PooledTree owned((PooledTree::allocator_type(pool)));
+    owned.insert(tree.begin(), tree.end());
+    BOOST_CHECK(&owned.get_allocator().GetPool() == pool.get());
+    BOOST_CHECK_EQUAL(pool->GetNodeCount(), tree.size());
+    owned.clear();
+    pool->ReleaseSpare();
+    BOOST_CHECK_EQUAL(pool->GetChunkBytes(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
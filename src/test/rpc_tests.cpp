@@ -6,6 +6,7 @@
 #include "rpcclient.h"
 
 #include "base58.h"
+#include "main.h"
 #include "netbase.h"
 
 #include <boost/algorithm/string.hpp>
@@ -172,4 +173,143 @@ BOOST_AUTO_TEST_CASE(rpc_boostasiotocnetaddr)
     BOOST_CHECK_EQUAL(BoostAsioToCNetAddr(boost::asio::ip::address::from_string("::ffff:127.0.0.1")).ToString(), "127.0.0.1");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_chain_tip_snapshot)
+{
+    // The snapshot follows chainActive, and the commands reading it need no lock
+    const CBlockIndex* pindexTip = GetChainTipSnapshot();
+    BOOST_CHECK(pindexTip != NULL && pindexTip == chainActive.Tip());
+    BOOST_CHECK_EQUAL(tableRPC["getblockcount"]->lockMode, RPC_LOCK_NONE);
+    BOOST_CHECK_EQUAL(tableRPC["getblockhash"]->lockMode, RPC_LOCK_NONE);
+    // Streamed commands take their locks themselves, so as not to hold them while writing
+    BOOST_CHECK_EQUAL(tableRPC["getblock"]->lockMode, RPC_LOCK_NONE);
+    BOOST_CHECK_EQUAL(tableRPC["getrawmempool"]->lockMode, RPC_LOCK_NONE);
+
+    BOOST_CHECK_EQUAL(CallRPC("getblockcount").get_int(), chainActive.Height());
+    BOOST_CHECK_EQUAL(CallRPC("getbestblockhash").get_str(), chainActive.Tip()->GetBlockHash().GetHex());
+    BOOST_CHECK_EQUAL(CallRPC("getblockhash 0").get_str(), chainActive.Genesis()->GetBlockHash().GetHex());
+    BOOST_CHECK_THROW(CallRPC(strprintf("getblockhash %d", chainActive.Height() + 1)), runtime_error);
+
+    // The header comes from the block index
+    Value header = CallRPC("getblockheader " + chainActive.Genesis()->GetBlockHash().GetHex());
+    BOOST_CHECK_EQUAL(find_value(header.get_obj(), "merkleroot").get_str(), chainActive.Genesis()->hashMerkleRoot.GetHex());
+    BOOST_CHECK_THROW(CallRPC("getblockheader " + uint256(1).GetHex()), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_stream_writer)
+{
+    Object obj;
+    obj.push_back(Pair("a", 1));
+    obj.push_back(Pair("b", ValueFromAmount(123456789)));
+    Array arr;
+    arr.push_back("x\"y");
+    arr.push_back(Object());
+    arr.push_back(Array());
+    obj.push_back(Pair("c", arr));
+    obj.push_back(Pair("d", Value::null));
+
+    std::ostringstream ss;
+    JSONStreamWriter writer(ss);
+    writer.BeginObject();
+    writer.WritePair("a", 1);
+    writer.WritePair("b", ValueFromAmount(123456789));
+    writer.Key("c");
+    writer.BeginArray();
+    writer.WriteValue("x\"y");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.WriteValue(Array());
+    writer.EndArray();
+    writer.WritePair("d", Value::null);
+    writer.EndObject();
+    BOOST_CHECK_EQUAL(ss.str(), write_string(Value(obj), json_spirit::none, 8));
+
+    // A streamed command writes what it returns
+    Array params;
+    params.push_back(chainActive.Genesis()->GetBlockHash().GetHex());
+    std::ostringstream ssBlock;
+    JSONStreamWriter writerBlock(ssBlock);
+    tableRPC.execute("getblock", params, writerBlock);
+    BOOST_CHECK_EQUAL(ssBlock.str(), write_string(tableRPC.execute("getblock", params), json_spirit::none, 8));
+
+    Array paramsList;
+    paramsList.push_back("list");
+    std::ostringstream ssList;
+    JSONStreamWriter writerList(ssList);
+    tableRPC.execute("servicenode", paramsList, writerList);
+    BOOST_CHECK_EQUAL(ssList.str(), write_string(tableRPC.execute("servicenode", paramsList), json_spirit::none, 8));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_chunked_reply)
+{
+    std::string strBody(100000, 'x');
+    std::stringstream ss;
+    ss << HTTPReplyHeaderChunked(HTTP_OK, false).substr(strlen("HTTP/1.1 200 OK\r\n"));
+    ss << HTTPChunk(strBody.substr(0, 70000)) << HTTPChunk(strBody.substr(70000)) << HTTPChunk("");
+
+    map<string, string> mapHeaders;
+    string strMessage;
+    BOOST_CHECK_EQUAL(ReadHTTPMessage(ss, mapHeaders, strMessage, 1, MAX_SIZE), HTTP_OK);
+    BOOST_CHECK(strMessage == strBody);
+
+    // Bodies longer than allowed are refused
+    std::stringstream ssLong;
+    ssLong << HTTPReplyHeaderChunked(HTTP_OK, false).substr(strlen("HTTP/1.1 200 OK\r\n"));
+    ssLong << HTTPChunk(strBody) << HTTPChunk("");
+    BOOST_CHECK_EQUAL(ReadHTTPMessage(ssLong, mapHeaders, strMessage, 1, 1000), HTTP_INTERNAL_SERVER_ERROR);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_http_request_parser)
+{
+    HTTPRequestParser parser(1000);
+    HTTPRequest req;
+    BOOST_CHECK_EQUAL(parser.Parse(req), HTTPRequestParser::NEED_MORE);
+
+    // A request arriving in pieces, followed by a pipelined one
+    std::string strRequests = "POST / HTTP/1.1\r\nAuthorization: Basic abc\r\nContent-Length: 5\r\n\r\nhello"
+                              "GET /rest/tx/01.json HTTP/1.0\r\nConnection: keep-alive\r\n\r\n";
+    parser.Feed(strRequests.data(), 20);
+    BOOST_CHECK_EQUAL(parser.Parse(req), HTTPRequestParser::NEED_MORE);
+    parser.Feed(strRequests.data() + 20, 45);
+    BOOST_CHECK_EQUAL(parser.Parse(req), HTTPRequestParser::NEED_MORE);
+    parser.Feed(strRequests.data() + 65, strRequests.size() - 65);
+    BOOST_CHECK_EQUAL(parser.Parse(req), HTTPRequestParser::COMPLETE);
+    BOOST_CHECK_EQUAL(req.strMethod, "POST");
+    BOOST_CHECK_EQUAL(req.strURI, "/");
+    BOOST_CHECK_EQUAL(req.nProto, 1);
+    BOOST_CHECK_EQUAL(req.strBody, "hello");
+    BOOST_CHECK_EQUAL(req.mapHeaders["authorization"], "Basic abc");
+    BOOST_CHECK_EQUAL(req.mapHeaders["connection"], "keep-alive");
+
+    BOOST_CHECK_EQUAL(parser.Parse(req), HTTPRequestParser::COMPLETE);
+    BOOST_CHECK_EQUAL(req.strMethod, "GET");
+    BOOST_CHECK_EQUAL(req.strURI, "/rest/tx/01.json");
+    BOOST_CHECK_EQUAL(req.nProto, 0);
+    BOOST_CHECK(req.strBody.empty());
+    BOOST_CHECK_EQUAL(req.mapHeaders["connection"], "keep-alive");
+    BOOST_CHECK_EQUAL(parser.BufferedSize(), 0U);
+    BOOST_CHECK_EQUAL(parser.Parse(req), HTTPRequestParser::NEED_MORE);
+
+    // HTTP/1.0 closes by default, and bare newlines are accepted
+    std::string strBare = "\nPOST / HTTP/1.0\nContent-Length: 0\n\n";
+    parser.Feed(strBare.data(), strBare.size());
+    BOOST_CHECK_EQUAL(parser.Parse(req), HTTPRequestParser::COMPLETE);
+    BOOST_CHECK_EQUAL(req.mapHeaders["connection"], "close");
+
+    // Bodies over the limit, other methods and endless headers are refused
+    std::string strLarge = "POST / HTTP/1.1\r\nContent-Length: 1001\r\n\r\n";
+    HTTPRequestParser parserLarge(1000);
+    parserLarge.Feed(strLarge.data(), strLarge.size());
+    BOOST_CHECK_EQUAL(parserLarge.Parse(req), HTTPRequestParser::INVALID);
+
+    std::string strPut = "PUT / HTTP/1.1\r\n\r\n";
+    HTTPRequestParser parserPut(1000);
+    parserPut.Feed(strPut.data(), strPut.size());
+    BOOST_CHECK_EQUAL(parserPut.Parse(req), HTTPRequestParser::INVALID);
+
+    std::string strHeader = "POST / HTTP/1.1\r\nX: " + std::string(MAX_HTTP_HEADERS_SIZE, 'x');
+    HTTPRequestParser parserHeader(1000);
+    parserHeader.Feed(strHeader.data(), strHeader.size());
+    BOOST_CHECK_EQUAL(parserHeader.Parse(req), HTTPRequestParser::INVALID);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
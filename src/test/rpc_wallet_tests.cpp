@@ -179,5 +179,19 @@ BOOST_AUTO_TEST_CASE(rpc_wallet)
     BOOST_CHECK(CBitcoinAddress(arr[0].get_str()).Get() == demoAddress.Get());
 }
 
+BOOST_AUTO_TEST_CASE(rpc_listtransactions_stream)
+{
+    // Streamed, listtransactions takes its locks itself, and writes what it returns
+    BOOST_CHECK_EQUAL(tableRPC["listtransactions"]->lockMode, RPC_LOCK_NONE);
+
+    Array params;
+    params.push_back("*");
+    params.push_back(5);
+    std::ostringstream ss;
+    JSONStreamWriter writer(ss);
+    tableRPC.execute("listtransactions", params, writer);
+    BOOST_CHECK_EQUAL(ss.str(), write_string(tableRPC.execute("listtransactions", params), json_spirit::none, 8));
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
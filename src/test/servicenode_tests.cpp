@@ -0,0 +1,114 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "obfuscation.h"
+#include "random.h"
+#include "servicenode-budget.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(servicenode_tests)
+
+BOOST_AUTO_TEST_CASE(message_signature_cache)
+{
+    messageSignatureCache.Clear();
+
+    CKey key, key2;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    std::string strError;
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(obfuScationSigner.SignMessage("mnb", strError, vchSig, key));
+
+    // Verified once, then remembered
+    BOOST_CHECK(obfuScationSigner.VerifyMessage(key.GetPubKey(), vchSig, "mnb", strError));
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetSize(), 1U);
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetHits(), 0U);
+    BOOST_CHECK(obfuScationSigner.VerifyMessage(key.GetPubKey(), vchSig, "mnb", strError));
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetHits(), 1U);
+
+    // A hit needs the same message, signature and key
+    BOOST_CHECK(!obfuScationSigner.VerifyMessage(key.GetPubKey(), vchSig, "mnp", strError));
+    BOOST_CHECK(!obfuScationSigner.VerifyMessage(key2.GetPubKey(), vchSig, "mnb", strError));
+    std::vector<unsigned char> vchSigBad(vchSig);
+    vchSigBad[10] ^= 1;
+    BOOST_CHECK(!obfuScationSigner.VerifyMessage(key.GetPubKey(), vchSigBad, "mnb", strError));
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetSize(), 1U);
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetHits(), 1U);
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetMisses(), 4U);
+
+    // It stays within its size
+    messageSignatureCache.SetMaxSize(4);
+    for (int i = 0; i < 10; i++) {
+        std::string strMessage = strprintf("mnw%d", i);
+        BOOST_CHECK(obfuScationSigner.SignMessage(strMessage, strError, vchSig, key));
+        BOOST_CHECK(obfuScationSigner.VerifyMessage(key.GetPubKey(), vchSig, strMessage, strError));
+        BOOST_CHECK(messageSignatureCache.GetSize() <= 4);
+    }
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetSize(), 4U);
+
+    messageSignatureCache.SetMaxSize(0);
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetSize(), 0U);
+    BOOST_CHECK(obfuScationSigner.VerifyMessage(key.GetPubKey(), vchSig, "mnw9", strError));
+    BOOST_CHECK_EQUAL(messageSignatureCache.GetSize(), 0U);
+
+    messageSignatureCache.SetMaxSize(DEFAULT_MAX_MSG_SIG_CACHE_SIZE);
+    messageSignatureCache.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(budget_vote_tallies)
+{
+    int64_t nTime = GetTime();
+    SetMockTime(nTime);
+
+    CBudgetProposal proposal;
+    std::string strError;
+    std::vector<CTxIn> vVoters;
+    for (int i = 0; i < 6; i++) {
+        vVoters.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+        CBudgetVote vote(vVoters.back(), proposal.GetHash(), i < 3 ? VOTE_YES : (i < 5 ? VOTE_NO : VOTE_ABSTAIN));
+        BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+    }
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 3);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 2);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 1);
+    BOOST_CHECK_EQUAL(proposal.Votes(), 1);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 0.6, 0.0001);
+
+    // A servicenode changing its mind moves its vote, too soon it does nothing
+    CBudgetVote vote(vVoters[0], proposal.GetHash(), VOTE_NO);
+    BOOST_CHECK(!proposal.AddOrUpdateVote(vote, strError));
+    vote.nTime = nTime + BUDGET_VOTE_UPDATE_MIN;
+    SetMockTime(vote.nTime);
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 2);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 3);
+    BOOST_CHECK_EQUAL(proposal.Votes(), -1);
+
+    // Copies and deserialized proposals carry the same tallies
+    CBudgetProposal proposalCopy(proposal);
+    BOOST_CHECK_EQUAL(proposalCopy.GetNays(), 3);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << proposal;
+    CBudgetProposal proposalRead;
+    ss >> proposalRead;
+    BOOST_CHECK_EQUAL(proposalRead.GetYeas(), 2);
+    BOOST_CHECK_EQUAL(proposalRead.GetNays(), 3);
+    BOOST_CHECK_EQUAL(proposalRead.GetAbstains(), 1);
+
+    // None of the voters are known servicenodes, so none of the votes count anymore,
+    // but the ratio still covers them
+    BOOST_CHECK(proposal.CleanAndRemove(false));
+    BOOST_CHECK(!proposal.CleanAndRemove(false));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 0);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 0.4, 0.0001);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
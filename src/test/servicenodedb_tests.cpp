@@ -0,0 +1,76 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "servicenode-budget.h"
+#include "servicenode-payments.h"
+#include "servicenodedb.h"
+#include "servicenodeman.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(servicenodedb_tests)
+
+static CServicenodePaymentWinner MakeWinner(int nBlockHeight)
+{
+    CServicenodePaymentWinner winner(CTxIn(COutPoint(GetRandHash(), 0)));
+    winner.nBlockHeight = nBlockHeight;
+    winner.payee = CScript() << OP_TRUE;
+    return winner;
+}
+
+BOOST_AUTO_TEST_CASE(servicenodedb_flush_deltas)
+{
+    CServicenodeStateDB db(1 << 20, true);
+    CServicenodeMan mnodemanIn;
+    CBudgetManager budgetIn;
+    CServicenodePayments paymentsIn;
+
+    for (int i = 0; i < 10; i++) {
+        CServicenodePaymentWinner winner = MakeWinner(1000 + i);
+        paymentsIn.mapServicenodePayeeVotes[winner.GetHash()] = winner;
+        paymentsIn.dirtyPayeeVotes.Mark(winner.GetHash());
+    }
+
+    size_t nWrites, nErases;
+    int64_t nMillis;
+    BOOST_CHECK(db.Flush(mnodemanIn, budgetIn, paymentsIn));
+    db.GetLastFlush(nWrites, nErases, nMillis);
+    // the winners and the servicenode manager's dsq count
+    BOOST_CHECK_EQUAL(nWrites, 11U);
+    BOOST_CHECK_EQUAL(nErases, 0U);
+
+    // Nothing changed, nothing written
+    BOOST_CHECK(db.Flush(mnodemanIn, budgetIn, paymentsIn));
+    db.GetLastFlush(nWrites, nErases, nMillis);
+    BOOST_CHECK_EQUAL(nWrites, 0U);
+    BOOST_CHECK_EQUAL(nErases, 0U);
+
+    // One changed and one removed entry
+    std::map<uint256, CServicenodePaymentWinner>::iterator it = paymentsIn.mapServicenodePayeeVotes.begin();
+    it->second.vchSig = std::vector<unsigned char>(65, 1);
+    paymentsIn.dirtyPayeeVotes.Mark(it->first);
+    ++it;
+    paymentsIn.dirtyPayeeVotes.Mark(it->first);
+    paymentsIn.mapServicenodePayeeVotes.erase(it);
+    BOOST_CHECK(db.Flush(mnodemanIn, budgetIn, paymentsIn));
+    db.GetLastFlush(nWrites, nErases, nMillis);
+    BOOST_CHECK_EQUAL(nWrites, 1U);
+    BOOST_CHECK_EQUAL(nErases, 1U);
+    BOOST_CHECK_EQUAL(db.GetRecordCount(), 10U);
+
+    // Loading gives back what was flushed, and the next flush has nothing to do
+    CServicenodeMan mnodemanOut;
+    CBudgetManager budgetOut;
+    CServicenodePayments paymentsOut;
+    BOOST_CHECK(db.Load(mnodemanOut, budgetOut, paymentsOut));
+    BOOST_CHECK_EQUAL(paymentsOut.mapServicenodePayeeVotes.size(), 9U);
+    BOOST_CHECK(paymentsOut.mapServicenodePayeeVotes.begin()->second.vchSig == std::vector<unsigned char>(65, 1));
+    BOOST_CHECK(db.Flush(mnodemanOut, budgetOut, paymentsOut));
+    db.GetLastFlush(nWrites, nErases, nMillis);
+    BOOST_CHECK_EQUAL(nWrites, 0U);
+    BOOST_CHECK_EQUAL(nErases, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,178 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "swifttx.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(swifttx_tests)
+
+static CTransaction MakeTx(const COutPoint& prevout, CAmount nValue = COIN)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    return tx;
+}
+
+static CConsensusVote MakeVote(const uint256& txHash, int nBlockHeight)
+{
+    CConsensusVote vote;
+    vote.vinServicenode = CTxIn(COutPoint(GetRandHash(), 0));
+    vote.txHash = txHash;
+    vote.nBlockHeight = nBlockHeight;
+    vote.vchServiceNodeSignature = std::vector<unsigned char>(65, 1);
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(txlock_requests_votes_and_inputs)
+{
+    CTxLockManager manager(DEFAULT_MAX_SWIFTTX_MEMORY * 1000000);
+    COutPoint prevout(GetRandHash(), 1);
+    CTransaction tx = MakeTx(prevout), txConflict = MakeTx(prevout, 2 * COIN), txRet;
+
+    manager.AddRequest(tx);
+    BOOST_CHECK(manager.HaveRequest(tx.GetHash()));
+    BOOST_CHECK(manager.GetRequest(tx.GetHash(), txRet) && txRet.GetHash() == tx.GetHash());
+    BOOST_CHECK(!manager.HaveLock(tx.GetHash()));
+    BOOST_CHECK_EQUAL(manager.GetSignatures(tx.GetHash()), -1);
+
+    // A rejected request is known, but not served
+    CTransaction txRejected = MakeTx(COutPoint(GetRandHash(), 0));
+    manager.AddRejectedRequest(txRejected);
+    BOOST_CHECK(manager.HaveRequest(txRejected.GetHash()) && manager.IsRejected(txRejected.GetHash()));
+    BOOST_CHECK(!manager.GetRequest(txRejected.GetHash(), txRet));
+
+    // Votes are remembered once, counted once their lock has a height
+    manager.CreateLock(tx.GetHash(), 100);
+    BOOST_CHECK_EQUAL(manager.GetLockCount(), 1U);
+    BOOST_CHECK_EQUAL(manager.GetSignatures(tx.GetHash()), 0);
+    for (int i = 0; i < SWIFTTX_SIGNATURES_REQUIRED; i++) {
+        CConsensusVote vote = MakeVote(tx.GetHash(), 100), voteRet;
+        BOOST_CHECK(manager.AddVote(vote));
+        BOOST_CHECK(!manager.AddVote(vote));
+        BOOST_CHECK(manager.HaveVote(vote.GetHash()));
+        BOOST_CHECK(manager.GetVote(vote.GetHash(), voteRet) && voteRet.vchServiceNodeSignature == vote.vchServiceNodeSignature);
+        BOOST_CHECK_EQUAL(manager.AddSignature(vote), i + 1);
+    }
+    BOOST_CHECK_EQUAL(manager.AddSignature(MakeVote(tx.GetHash(), 99)), SWIFTTX_SIGNATURES_REQUIRED);
+
+    // Its inputs then conflict with other spends
+    uint256 hashLock;
+    manager.LockInputs(tx);
+    BOOST_CHECK(!manager.GetConflictingLock(tx, hashLock));
+    BOOST_CHECK(manager.GetConflictingLock(txConflict, hashLock) && hashLock == tx.GetHash());
+    BOOST_CHECK(!manager.GetConflictingLock(txRejected, hashLock));
+
+    std::set<uint256> setProtected;
+    manager.GetProtected(setProtected);
+    BOOST_CHECK(setProtected.count(tx.GetHash()) && !setProtected.count(txRejected.GetHash()));
+
+    CTxLockStats stats = manager.GetStats();
+    BOOST_CHECK_EQUAL(stats.nEntries, 2U);
+    BOOST_CHECK_EQUAL(stats.nVotes, (size_t)SWIFTTX_SIGNATURES_REQUIRED);
+    BOOST_CHECK_EQUAL(stats.nLockedInputs, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(txlock_expiry)
+{
+    int64_t nTime = GetTime();
+    SetMockTime(nTime);
+    CTxLockManager manager(DEFAULT_MAX_SWIFTTX_MEMORY * 1000000);
+
+    CTransaction tx = MakeTx(COutPoint(GetRandHash(), 0));
+    CTransaction tx2 = MakeTx(tx.vin[0].prevout, 2 * COIN);
+    manager.CreateLock(tx.GetHash(), 100);
+    manager.AddRequest(tx);
+    manager.LockInputs(tx);
+    CConsensusVote vote = MakeVote(tx.GetHash(), 100);
+    manager.AddVote(vote);
+    BOOST_CHECK(!manager.IsTimedOut(tx.GetHash()));
+
+    // Votes for a transaction nobody asked to lock expire as well
+    CConsensusVote voteUnknown = MakeVote(GetRandHash(), 100);
+    SetMockTime(nTime + 30 * 60);
+    manager.AddVote(voteUnknown);
+    BOOST_CHECK(manager.IsTimedOut(tx.GetHash()));
+
+    SetMockTime(nTime + 60 * 60 + 1);
+    manager.Clean();
+    BOOST_CHECK(!manager.HaveRequest(tx.GetHash()) && !manager.HaveVote(vote.GetHash()));
+    BOOST_CHECK(manager.HaveVote(voteUnknown.GetHash()));
+    uint256 hashLock;
+    BOOST_CHECK(!manager.GetConflictingLock(tx2, hashLock));
+    BOOST_CHECK_EQUAL(manager.GetLockCount(), 0U);
+
+    SetMockTime(nTime + 90 * 60 + 1);
+    manager.Clean();
+    BOOST_CHECK_EQUAL(manager.GetStats().nEntries, 0U);
+
+    // Conflicting complete locks expire both, right away
+    SetMockTime(nTime);
+    CTransaction txA = MakeTx(COutPoint(GetRandHash(), 0)), txB = MakeTx(txA.vin[0].prevout, 2 * COIN);
+    manager.AddRequest(txA);
+    manager.LockInputs(txA);
+    manager.CreateLock(txA.GetHash(), 100);
+    manager.CreateLock(txB.GetHash(), 100);
+    BOOST_CHECK(manager.CheckForConflictingLocks(txB));
+    SetMockTime(nTime + 1);
+    manager.Clean();
+    BOOST_CHECK(!manager.HaveLock(txA.GetHash()) && !manager.HaveLock(txB.GetHash()));
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(txlock_memory_budget)
+{
+    CTxLockManager manager(DEFAULT_MAX_SWIFTTX_MEMORY * 1000000);
+
+    CTransaction tx = MakeTx(COutPoint(GetRandHash(), 0));
+    manager.AddRequest(tx);
+    manager.CreateLock(tx.GetHash(), 100);
+    for (int i = 0; i < SWIFTTX_SIGNATURES_REQUIRED; i++) {
+        CConsensusVote vote = MakeVote(tx.GetHash(), 100);
+        manager.AddVote(vote);
+        manager.AddSignature(vote);
+    }
+
+    // A lock request still waiting for its votes, older than the storm below
+    CTransaction txPending = MakeTx(COutPoint(GetRandHash(), 0));
+    manager.AddRequest(txPending);
+    manager.CreateLock(txPending.GetHash(), 100);
+    CConsensusVote votePending = MakeVote(txPending.GetHash(), 100);
+    manager.AddVote(votePending);
+    manager.AddSignature(votePending);
+
+    // A storm of votes for unknown transactions stays within the budget
+    manager.SetMaxMemory(200000);
+    for (int i = 0; i < 5000; i++)
+        manager.AddVote(MakeVote(GetRandHash(), 100));
+
+    CTxLockStats stats = manager.GetStats();
+    BOOST_CHECK(stats.nUsage <= stats.nMaxUsage);
+    BOOST_CHECK(stats.nEvicted > 0);
+    BOOST_CHECK(stats.nEntries < 5000);
+    BOOST_CHECK_EQUAL(stats.nVotes, stats.nEntries - 2 + SWIFTTX_SIGNATURES_REQUIRED + 1);
+
+    // and evicts those votes before the complete lock and the pending request
+    BOOST_CHECK_EQUAL(manager.GetSignatures(tx.GetHash()), SWIFTTX_SIGNATURES_REQUIRED);
+    BOOST_CHECK(manager.HaveRequest(tx.GetHash()));
+    BOOST_CHECK(manager.HaveRequest(txPending.GetHash()));
+    BOOST_CHECK_EQUAL(manager.GetSignatures(txPending.GetHash()), 1);
+    std::set<uint256> setProtected;
+    manager.GetProtected(setProtected);
+    BOOST_CHECK(setProtected.count(txPending.GetHash()));
+
+    // Which only goes when it alone is over the budget
+    manager.SetMaxMemory(0);
+    BOOST_CHECK_EQUAL(manager.GetStats().nEntries, 0U);
+    BOOST_CHECK_EQUAL(manager.GetStats().nVotes, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
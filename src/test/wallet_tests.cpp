@@ -4,6 +4,14 @@
 
 #include "wallet.h"
 
+#include "blockfilter.h"
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "init.h"
+#include "main.h"
+#include "miner.h"
+#include "script/standard.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -11,6 +19,7 @@
 
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 // how many times to run all the tests to have a chance to catch errors that only show up with particular random shuffles
 #define RUN_TESTS 100
@@ -305,4 +314,89 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(wallet_balance_tests)
+{
+    CWallet wallet;
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+    LOCK2(cs_main, wallet.cs_wallet);
+    wallet.AddKeyPubKey(key, key.GetPubKey());
+
+    // Someone else pays us: unconfirmed
+    CMutableTransaction txIn;
+    txIn.vin.resize(1);
+    txIn.vout.resize(1);
+    txIn.vout[0].nValue = 10 * COIN;
+    txIn.vout[0].scriptPubKey = scriptMine;
+    wallet.AddToWallet(CWalletTx(&wallet, txIn), true);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 10 * COIN);
+
+    // We spend it with change back to us, which we trust
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(txIn.GetHash(), 0);
+    txSpend.vout.resize(2);
+    txSpend.vout[0].nValue = 6 * COIN;
+    txSpend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    txSpend.vout[1].nValue = 4 * COIN;
+    txSpend.vout[1].scriptPubKey = scriptMine;
+    wallet.AddToWallet(CWalletTx(&wallet, txSpend), true);
+    wallet.MarkDirty();
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 4 * COIN);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(wallet_rescan_bare_multisig)
+{
+    // A block paying a bare multisig of our key, which no block filter
+    // element of the wallet matches
+    CKey key;
+    key.MakeNewKey(true);
+    std::vector<CPubKey> vPubKeys(1, key.GetPubKey());
+    CScript scriptMultisig = GetScriptForMultisig(1, vPubKeys);
+    uint256 hashCoinbase;
+    {
+        LOCK(cs_main);
+        Checkpoints::fEnabled = false;
+        ModifiableParams()->setSkipProofOfWorkCheck(true);
+        CBlockTemplate* pblocktemplate = CreateNewBlock(scriptMultisig, pwalletMain, false);
+        BOOST_REQUIRE(pblocktemplate);
+        CBlock* pblock = &pblocktemplate->block;
+        unsigned int nExtraNonce = 0;
+        IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
+        hashCoinbase = pblock->vtx[0].GetHash();
+        CValidationState state;
+        BOOST_CHECK(ProcessNewBlock(state, NULL, pblock));
+        ModifiableParams()->setSkipProofOfWorkCheck(false);
+        delete pblocktemplate;
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == pblock->GetHash());
+    }
+
+    pblockfilterindex = new CBlockFilterIndex(1 << 20, true, true);
+    boost::thread threadIndex(&CBlockFilterIndex::Thread, pblockfilterindex);
+    for (int i = 0; i < 1000 && pblockfilterindex->GetBestHeight() < chainActive.Height(); i++)
+        MilliSleep(10);
+    threadIndex.interrupt();
+    threadIndex.join();
+    BOOST_CHECK_EQUAL(pblockfilterindex->GetBestHeight(), chainActive.Height());
+
+    // The rescan still reads the block, and finds the payment
+    CWallet wallet;
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(key, key.GetPubKey());
+        wallet.nTimeFirstKey = 1;
+    }
+    BOOST_CHECK_EQUAL(wallet.ScanForWalletTransactions(chainActive.Genesis(), true), 1);
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.mapWallet.count(hashCoinbase));
+    }
+
+    delete pblockfilterindex;
+    pblockfilterindex = NULL;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -181,6 +181,79 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vEntries.begin(); it != vEntries.end(); it++)
+        batch.Write(make_pair('a', it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vEntries.begin(); it != vEntries.end(); it++)
+        batch.Erase(make_pair('a', it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(int type, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries,
+    int nStart, int nEnd, size_t nSkip, size_t nLimit)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('a', CAddressIndexIteratorKey(type, hashBytes, nStart));
+    pcursor->Seek(ssKeySet.str());
+
+    size_t nSeen = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CAddressIndexKey key;
+            ssKey >> chType;
+            if (chType != 'a')
+                break;
+            ssKey >> key;
+            if (key.type != type || key.hashBytes != hashBytes || (nEnd > 0 && key.nHeight > nEnd))
+                break;
+            if (nSeen++ < nSkip)
+                continue;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vEntries.push_back(make_pair(key, nValue));
+            if (nLimit > 0 && vEntries.size() >= nLimit)
+                break;
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vEntries)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it = vEntries.begin(); it != vEntries.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair('p', it->first));
+        else
+            batch.Write(make_pair('p', it->first), it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return Read(make_pair('p', key), value);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -212,13 +285,18 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
             char chType;
             ssKey >> chType;
             if (chType == 'b') {
+                // The key carries the block hash, so the header does not have
+                // to be re-hashed for every entry.
+                uint256 hash;
+                ssKey >> hash;
+
                 leveldb::Slice slValue = pcursor->value();
                 CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
                 CDiskBlockIndex diskindex;
                 ssValue >> diskindex;
 
                 // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
+                CBlockIndex* pindexNew = InsertBlockIndex(hash);
                 pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
                 pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
                 pindexNew->nHeight = diskindex.nHeight;
@@ -243,7 +321,9 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
                 pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
 
                 if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
+                    if (diskindex.GetBlockHash() != hash)
+                        return error("LoadBlockIndex() : block hash mismatch: %s", pindexNew->ToString());
+                    if (!CheckProofOfWork(hash, pindexNew->nBits))
                         return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
                 }
                 // ppcoin: build setStakeSeen
@@ -261,3 +341,35 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
 
     return true;
 }
+
+CBlockFilterDB::CBlockFilterDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "filters", nCacheSize, fMemory, fWipe)
+{
+}
+
+bool CBlockFilterDB::ReadFilter(const uint256& hashBlock, std::vector<unsigned char>& vFilter, uint256& hashHeader) const
+{
+    std::pair<std::vector<unsigned char>, uint256> entry;
+    if (!Read(make_pair('f', hashBlock), entry))
+        return false;
+    vFilter.swap(entry.first);
+    hashHeader = entry.second;
+    return true;
+}
+
+bool CBlockFilterDB::WriteFilter(const uint256& hashBlock, const std::vector<unsigned char>& vFilter, const uint256& hashHeader)
+{
+    CLevelDBBatch batch;
+    batch.Write(make_pair('f', hashBlock), make_pair(vFilter, hashHeader));
+    batch.Write('B', hashBlock);
+    return WriteBatch(batch);
+}
+
+bool CBlockFilterDB::ReadBestBlock(uint256& hashBlock) const
+{
+    return Read('B', hashBlock);
+}
+
+bool CBlockFilterDB::WriteBestBlock(const uint256& hashBlock)
+{
+    return Write('B', hashBlock);
+}
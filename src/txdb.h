@@ -6,6 +6,7 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "leveldbwrapper.h"
 #include "main.h"
 
@@ -60,9 +61,39 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries);
+    /**
+     * Entries of an address, in height order, optionally within [nStart, nEnd]
+     * (0 for open ends); the first nSkip are passed over and at most nLimit
+     * returned (0 for all of them).
+     */
+    bool ReadAddressIndex(int type, const uint160& hashBytes, std::vector<std::pair<CAddressIndexKey, CAmount> >& vEntries,
+        int nStart = 0, int nEnd = 0, size_t nSkip = 0, size_t nLimit = 0);
+    /** Write or, for null values, erase spent index entries */
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vEntries);
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool LoadBlockIndexGuts();
 };
 
+/** Access to the block filter index database (blocks/filters/) */
+class CBlockFilterDB : public CLevelDBWrapper
+{
+public:
+    CBlockFilterDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CBlockFilterDB(const CBlockFilterDB&);
+    void operator=(const CBlockFilterDB&);
+
+public:
+    bool ReadFilter(const uint256& hashBlock, std::vector<unsigned char>& vFilter, uint256& hashHeader) const;
+    /** Store the filter of a block and make it the best block indexed */
+    bool WriteFilter(const uint256& hashBlock, const std::vector<unsigned char>& vFilter, const uint256& hashHeader);
+    bool ReadBestBlock(uint256& hashBlock) const;
+    bool WriteBestBlock(const uint256& hashBlock);
+};
+
 #endif // BITCOIN_TXDB_H
@@ -7,6 +7,7 @@
 
 #include "clientversion.h"
 #include "main.h"
+#include "memusage.h"
 #include "streams.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -16,7 +17,19 @@
 
 using namespace std;
 
-CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nTime(0), dPriority(0.0)
+/** Heap memory held by a transaction: its input and output vectors and their scripts */
+static size_t TxDynamicUsage(const CTransaction& tx)
+{
+    size_t nUsage = memusage::DynamicUsage(tx.vin) + memusage::DynamicUsage(tx.vout);
+    BOOST_FOREACH (const CTxIn& txin, tx.vin)
+        nUsage += memusage::DynamicUsage(*static_cast<const std::vector<unsigned char>*>(&txin.scriptSig));
+    BOOST_FOREACH (const CTxOut& txout, tx.vout)
+        nUsage += memusage::DynamicUsage(*static_cast<const std::vector<unsigned char>*>(&txout.scriptPubKey));
+    return nUsage;
+}
+
+CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0), nModFee(0), dPriorityDelta(0.0),
+                                     nCountWithDescendants(0), nSizeWithDescendants(0), nModFeesWithDescendants(0)
 {
     nHeight = MEMPOOL_HEIGHT;
 }
@@ -26,6 +39,13 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
 
     nModSize = tx.CalculateModifiedSize(nTxSize);
+    nUsageSize = TxDynamicUsage(tx);
+
+    nModFee = nFee;
+    dPriorityDelta = 0.0;
+    nCountWithDescendants = 1;
+    nSizeWithDescendants = nTxSize;
+    nModFeesWithDescendants = nFee;
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -33,6 +53,28 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
     *this = other;
 }
 
+void CTxMemPoolEntry::SetDeltas(double dPriorityDeltaIn, CAmount nFeeDelta)
+{
+    nModFeesWithDescendants += nFee + nFeeDelta - nModFee;
+    nModFee = nFee + nFeeDelta;
+    dPriorityDelta = dPriorityDeltaIn;
+}
+
+void CTxMemPoolEntry::UpdateDescendantState(int64_t nSizeDelta, CAmount nFeeDelta, int64_t nCountDelta)
+{
+    nSizeWithDescendants += nSizeDelta;
+    nModFeesWithDescendants += nFeeDelta;
+    nCountWithDescendants += nCountDelta;
+    assert(nCountWithDescendants > 0 && nSizeWithDescendants > 0);
+}
+
+double CTxMemPoolEntry::GetDescendantScore() const
+{
+    double dOwn = (double)nModFee * 1000 / nTxSize;
+    double dWithDescendants = (double)nModFeesWithDescendants * 1000 / nSizeWithDescendants;
+    return std::max(dOwn, dWithDescendants);
+}
+
 double
 CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
 {
@@ -355,7 +397,19 @@ public:
 
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) : nTransactionsUpdated(0),
-                                                       minRelayFee(_minRelayFee)
+                                                       minRelayFee(_minRelayFee),
+                                                       totalTxSize(0),
+                                                       cachedInnerUsage(0),
+                                                       lastRollingFeeUpdate(GetTime()),
+                                                       blockSinceLastRollingFeeBump(false),
+                                                       rollingMinimumFeeRate(0),
+                                                       nPriorityIndexHeight(-1),
+                                                       nEvicted(0),
+                                                       nExpired(0),
+                                                       nodePool(new CNodePool()),
+                                                       mapTx(TxMap::allocator_type(nodePool)),
+                                                       mapNextTx(NextTxMap::allocator_type(nodePool)),
+                                                       mapDeltas(DeltaMap::allocator_type(nodePool))
 {
     // Sanity checks off by default for performance, because otherwise
     // accepting transactions becomes O(N^2) where N is the number
@@ -379,7 +433,7 @@ void CTxMemPool::pruneSpent(const uint256& hashTx, CCoins& coins)
 {
     LOCK(cs);
 
-    std::map<COutPoint, CInPoint>::iterator it = mapNextTx.lower_bound(COutPoint(hashTx, 0));
+    NextTxMap::iterator it = mapNextTx.lower_bound(COutPoint(hashTx, 0));
 
     // iterate over all COutPoints in mapNextTx whose hash equals the provided hashTx
     while (it != mapNextTx.end() && it->first.hash == hashTx) {
@@ -401,23 +455,153 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
 }
 
 
+void CTxMemPool::CalculateAncestors(const CTransaction& tx, std::set<uint256>& setAncestors) const
+{
+    std::vector<const CTransaction*> vStack(1, &tx);
+    while (!vStack.empty()) {
+        const CTransaction* ptx = vStack.back();
+        vStack.pop_back();
+        BOOST_FOREACH (const CTxIn& txin, ptx->vin) {
+            TxMap::const_iterator it = mapTx.find(txin.prevout.hash);
+            if (it != mapTx.end() && setAncestors.insert(it->first).second)
+                vStack.push_back(&it->second.GetTx());
+        }
+    }
+}
+
+void CTxMemPool::CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const
+{
+    LOCK(cs);
+    std::vector<uint256> vStack(1, hash);
+    setDescendants.insert(hash);
+    while (!vStack.empty()) {
+        uint256 hashParent = vStack.back();
+        vStack.pop_back();
+        NextTxMap::const_iterator it = mapNextTx.lower_bound(COutPoint(hashParent, 0));
+        for (; it != mapNextTx.end() && it->first.hash == hashParent; it++) {
+            const uint256& hashChild = it->second.ptx->GetHash();
+            if (setDescendants.insert(hashChild).second)
+                vStack.push_back(hashChild);
+        }
+    }
+}
+
+void CTxMemPool::UpdateDescendantState(TxMap::iterator it, int64_t nSizeDelta, CAmount nFeeDelta, int64_t nCountDelta)
+{
+    setDescendantScore.erase(std::make_pair(it->second.GetDescendantScore(), it->first));
+    it->second.UpdateDescendantState(nSizeDelta, nFeeDelta, nCountDelta);
+    setDescendantScore.insert(std::make_pair(it->second.GetDescendantScore(), it->first));
+}
+
+void CTxMemPool::IndexEntry(const uint256& hash, const CTxMemPoolEntry& entry)
+{
+    setFeeRateIndex.insert(std::make_pair(entry.GetModifiedFeeRate(), hash));
+    if (nPriorityIndexHeight >= 0)
+        setPriorityIndex.insert(std::make_pair(entry.GetModifiedPriority(nPriorityIndexHeight), hash));
+}
+
+void CTxMemPool::UnindexEntry(const uint256& hash, const CTxMemPoolEntry& entry)
+{
+    setFeeRateIndex.erase(std::make_pair(entry.GetModifiedFeeRate(), hash));
+    if (nPriorityIndexHeight >= 0)
+        setPriorityIndex.erase(std::make_pair(entry.GetModifiedPriority(nPriorityIndexHeight), hash));
+}
+
+CTxMemPool::score_iterator CTxMemPool::PriorityBegin(unsigned int nHeight)
+{
+    AssertLockHeld(cs);
+    if (nPriorityIndexHeight != (int)nHeight) {
+        setPriorityIndex.clear();
+        nPriorityIndexHeight = nHeight;
+        for (TxMap::const_iterator it = mapTx.begin(); it != mapTx.end(); it++)
+            setPriorityIndex.insert(std::make_pair(it->second.GetModifiedPriority(nHeight), it->first));
+    }
+    return setPriorityIndex.rbegin();
+}
+
 bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry)
 {
     // Add to memory pool without checking anything.
     // Used by main.cpp AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     LOCK(cs);
-    {
-        mapTx[hash] = entry;
-        const CTransaction& tx = mapTx[hash].GetTx();
-        for (unsigned int i = 0; i < tx.vin.size(); i++)
-            mapNextTx[tx.vin[i].prevout] = CInPoint(&tx, i);
-        nTransactionsUpdated++;
-        totalTxSize += entry.GetTxSize();
+    if (mapTx.count(hash))
+        return error("CTxMemPool::addUnchecked() : %s is in the pool already", hash.ToString());
+
+    // A transaction coming back from a disconnected block can find its
+    // descendants in the pool already. Their ancestors have to be known
+    // before the new entry links them up.
+    std::set<uint256> setAncestors;
+    CalculateAncestors(entry.GetTx(), setAncestors);
+    std::set<uint256> setDescendants;
+    CalculateDescendants(hash, setDescendants);
+    setDescendants.erase(hash);
+    std::map<uint256, std::set<uint256> > mapDescendantAncestors;
+    BOOST_FOREACH (const uint256& hashDescendant, setDescendants)
+        CalculateAncestors(mapTx[hashDescendant].GetTx(), mapDescendantAncestors[hashDescendant]);
+
+    TxMap::iterator it = mapTx.insert(std::make_pair(hash, entry)).first;
+    CTxMemPoolEntry& newEntry = it->second;
+    double dPriorityDelta = 0;
+    CAmount nFeeDelta = 0;
+    ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+    newEntry.SetDeltas(dPriorityDelta, nFeeDelta);
+
+    const CTransaction& tx = newEntry.GetTx();
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+        mapNextTx[tx.vin[i].prevout] = CInPoint(&tx, i);
+
+    BOOST_FOREACH (const uint256& hashAncestor, setAncestors)
+        UpdateDescendantState(mapTx.find(hashAncestor), newEntry.GetTxSize(), newEntry.GetModifiedFee(), 1);
+    BOOST_FOREACH (const uint256& hashDescendant, setDescendants) {
+        const CTxMemPoolEntry& descendant = mapTx[hashDescendant];
+        newEntry.UpdateDescendantState(descendant.GetTxSize(), descendant.GetModifiedFee(), 1);
+        const std::set<uint256>& setOld = mapDescendantAncestors[hashDescendant];
+        BOOST_FOREACH (const uint256& hashAncestor, setAncestors) {
+            if (!setOld.count(hashAncestor))
+                UpdateDescendantState(mapTx.find(hashAncestor), descendant.GetTxSize(), descendant.GetModifiedFee(), 1);
+        }
     }
+    setDescendantScore.insert(std::make_pair(newEntry.GetDescendantScore(), hash));
+    setEntryTime.insert(std::make_pair(newEntry.GetTime(), hash));
+    IndexEntry(hash, newEntry);
+
+    nTransactionsUpdated++;
+    totalTxSize += newEntry.GetTxSize();
+    cachedInnerUsage += newEntry.DynamicMemoryUsage();
     return true;
 }
 
+void CTxMemPool::RemoveStaged(const std::vector<uint256>& vRemove, const std::set<uint256>& setRemove, std::list<CTransaction>& removed)
+{
+    // Take the transactions out of the descendant state of the ancestors
+    // that stay, while the links to them are still in place
+    BOOST_FOREACH (const uint256& hash, vRemove) {
+        const CTxMemPoolEntry& entry = mapTx[hash];
+        std::set<uint256> setAncestors;
+        CalculateAncestors(entry.GetTx(), setAncestors);
+        BOOST_FOREACH (const uint256& hashAncestor, setAncestors) {
+            if (!setRemove.count(hashAncestor))
+                UpdateDescendantState(mapTx.find(hashAncestor), -(int64_t)entry.GetTxSize(), -entry.GetModifiedFee(), -1);
+        }
+    }
+
+    BOOST_FOREACH (const uint256& hash, vRemove) {
+        TxMap::iterator it = mapTx.find(hash);
+        const CTransaction& tx = it->second.GetTx();
+        BOOST_FOREACH (const CTxIn& txin, tx.vin)
+            mapNextTx.erase(txin.prevout);
+
+        removed.push_back(tx);
+        totalTxSize -= it->second.GetTxSize();
+        cachedInnerUsage -= it->second.DynamicMemoryUsage();
+        setDescendantScore.erase(std::make_pair(it->second.GetDescendantScore(), hash));
+        setEntryTime.erase(std::make_pair(it->second.GetTime(), hash));
+        UnindexEntry(hash, it->second);
+        mapTx.erase(it);
+        nTransactionsUpdated++;
+    }
+}
 
 void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& removed, bool fRecursive)
 {
@@ -432,34 +616,31 @@ void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& rem
             // happen during chain re-orgs if origTx isn't re-accepted into
             // the mempool for any reason.
             for (unsigned int i = 0; i < origTx.vout.size(); i++) {
-                std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(origTx.GetHash(), i));
+                NextTxMap::iterator it = mapNextTx.find(COutPoint(origTx.GetHash(), i));
                 if (it == mapNextTx.end())
                     continue;
                 txToRemove.push_back(it->second.ptx->GetHash());
             }
         }
+        std::vector<uint256> vRemove;
+        std::set<uint256> setRemove;
         while (!txToRemove.empty()) {
             uint256 hash = txToRemove.front();
             txToRemove.pop_front();
-            if (!mapTx.count(hash))
+            if (!mapTx.count(hash) || !setRemove.insert(hash).second)
                 continue;
-            const CTransaction& tx = mapTx[hash].GetTx();
+            vRemove.push_back(hash);
             if (fRecursive) {
+                const CTransaction& tx = mapTx[hash].GetTx();
                 for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                    std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(hash, i));
+                    NextTxMap::iterator it = mapNextTx.find(COutPoint(hash, i));
                     if (it == mapNextTx.end())
                         continue;
                     txToRemove.push_back(it->second.ptx->GetHash());
                 }
             }
-            BOOST_FOREACH (const CTxIn& txin, tx.vin)
-                mapNextTx.erase(txin.prevout);
-
-            removed.push_back(tx);
-            totalTxSize -= mapTx[hash].GetTxSize();
-            mapTx.erase(hash);
-            nTransactionsUpdated++;
         }
+        RemoveStaged(vRemove, setRemove, removed);
     }
 }
 
@@ -468,10 +649,10 @@ void CTxMemPool::removeCoinbaseSpends(const CCoinsViewCache* pcoins, unsigned in
     // Remove transactions spending a coinbase which are now immature
     LOCK(cs);
     list<CTransaction> transactionsToRemove;
-    for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
+    for (TxMap::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         const CTransaction& tx = it->second.GetTx();
         BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-            std::map<uint256, CTxMemPoolEntry>::const_iterator it2 = mapTx.find(txin.prevout.hash);
+            TxMap::const_iterator it2 = mapTx.find(txin.prevout.hash);
             if (it2 != mapTx.end())
                 continue;
             const CCoins* coins = pcoins->AccessCoins(txin.prevout.hash);
@@ -497,7 +678,7 @@ void CTxMemPool::removeConflicts(const CTransaction& tx, std::list<CTransaction>
     list<CTransaction> result;
     LOCK(cs);
     BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-        std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(txin.prevout);
+        NextTxMap::iterator it = mapNextTx.find(txin.prevout);
         if (it != mapNextTx.end()) {
             const CTransaction& txConflict = *it->second.ptx;
             if (txConflict != tx) {
@@ -526,6 +707,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
         removeConflicts(tx, conflicts);
         ClearPrioritisation(tx.GetHash());
     }
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
 }
 
 
@@ -534,10 +717,168 @@ void CTxMemPool::clear()
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    setDescendantScore.clear();
+    setEntryTime.clear();
+    setFeeRateIndex.clear();
+    setPriorityIndex.clear();
+    nPriorityIndexHeight = -1;
+    nodePool->ReleaseSpare();
     totalTxSize = 0;
+    cachedInnerUsage = 0;
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
 }
 
+size_t CTxMemPool::GetPoolBytes() const
+{
+    LOCK(cs);
+    return nodePool->GetChunkBytes();
+}
+
+size_t CTxMemPool::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return memusage::DynamicUsage(mapTx) + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) +
+           memusage::DynamicUsage(setDescendantScore) + memusage::DynamicUsage(setEntryTime) +
+           memusage::DynamicUsage(setFeeRateIndex) + memusage::DynamicUsage(setPriorityIndex) + cachedInnerUsage;
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate)
+{
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate) {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const
+{
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return std::max(CFeeRate(rollingMinimumFeeRate), minRelayFee);
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < minRelayFee.GetFeePerK() / 2) {
+            rollingMinimumFeeRate = 0;
+            return minRelayFee;
+        }
+    }
+    return std::max(CFeeRate(rollingMinimumFeeRate), minRelayFee);
+}
+
+/** Whether any of the transactions is in setProtected */
+static bool AnyProtected(const std::set<uint256>& setTxs, const std::set<uint256>& setProtected)
+{
+    if (setProtected.empty())
+        return false;
+    BOOST_FOREACH (const uint256& hash, setTxs) {
+        if (setProtected.count(hash))
+            return true;
+    }
+    return false;
+}
+
+unsigned int CTxMemPool::TrimToSize(size_t sizelimit, const std::set<uint256>& setProtected)
+{
+    LOCK(cs);
+    unsigned int nRemoved = 0;
+    CFeeRate maxFeeRateRemoved(0);
+    std::set<std::pair<double, uint256> >::iterator itScore = setDescendantScore.begin();
+    while (itScore != setDescendantScore.end() && DynamicMemoryUsage() > sizelimit) {
+        std::set<uint256> setPackage;
+        CalculateDescendants(itScore->second, setPackage);
+        if (AnyProtected(setPackage, setProtected)) {
+            itScore++;
+            continue;
+        }
+
+        const CTxMemPoolEntry& entry = mapTx[itScore->second];
+        // Whatever replaces the package has to pay for relaying it as well
+        CFeeRate removed(entry.GetModFeesWithDescendants(), entry.GetSizeWithDescendants());
+        removed = CFeeRate(removed.GetFeePerK() + minRelayFee.GetFeePerK());
+        trackPackageRemoved(removed);
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+        // Removing the package lowers the scores of its ancestors; carry on
+        // from where it was, or from the lowest of them if one moved below
+        std::pair<double, uint256> resume = *itScore;
+        CTransaction tx = entry.GetTx();
+        std::set<uint256> setAncestors;
+        CalculateAncestors(tx, setAncestors);
+        std::list<CTransaction> removedTxs;
+        remove(tx, removedTxs, true);
+        nRemoved += removedTxs.size();
+        BOOST_FOREACH (const uint256& hashAncestor, setAncestors) {
+            TxMap::const_iterator it = mapTx.find(hashAncestor);
+            if (it != mapTx.end())
+                resume = std::min(resume, std::make_pair(it->second.GetDescendantScore(), it->first));
+        }
+        itScore = setDescendantScore.lower_bound(resume);
+    }
+    nEvicted += nRemoved;
+    if (nRemoved)
+        LogPrint("mempool", "Evicted %u transactions from the mempool, fee rate up to %s\n", nRemoved, maxFeeRateRemoved.ToString());
+    return nRemoved;
+}
+
+bool CTxMemPool::HasExpired(int64_t time) const
+{
+    LOCK(cs);
+    return !setEntryTime.empty() && setEntryTime.begin()->first < time;
+}
+
+unsigned int CTxMemPool::Expire(int64_t time, const std::set<uint256>& setProtected)
+{
+    LOCK(cs);
+    std::vector<uint256> vExpired;
+    std::set<std::pair<int64_t, uint256> >::iterator it = setEntryTime.begin();
+    for (; it != setEntryTime.end() && it->first < time; it++)
+        vExpired.push_back(it->second);
+
+    unsigned int nRemoved = 0;
+    BOOST_FOREACH (const uint256& hash, vExpired) {
+        if (!mapTx.count(hash))
+            continue; // went with an expired ancestor
+        std::set<uint256> setPackage;
+        CalculateDescendants(hash, setPackage);
+        if (AnyProtected(setPackage, setProtected))
+            continue;
+        CTransaction tx = mapTx[hash].GetTx();
+        std::list<CTransaction> removedTxs;
+        remove(tx, removedTxs, true);
+        nRemoved += removedTxs.size();
+    }
+    nExpired += nRemoved;
+    if (nRemoved)
+        LogPrint("mempool", "Expired %u transactions from the mempool\n", nRemoved);
+    return nRemoved;
+}
+
+uint64_t CTxMemPool::GetEvictedCount() const
+{
+    LOCK(cs);
+    return nEvicted;
+}
+
+uint64_t CTxMemPool::GetExpiredCount() const
+{
+    LOCK(cs);
+    return nExpired;
+}
+
 void CTxMemPool::check(const CCoinsViewCache* pcoins) const
 {
     if (!fSanityCheck)
@@ -551,14 +892,14 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
 
     LOCK(cs);
     list<const CTxMemPoolEntry*> waitingOnDependants;
-    for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
+    for (TxMap::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->second.GetTxSize();
         const CTransaction& tx = it->second.GetTx();
         bool fDependsWait = false;
         BOOST_FOREACH (const CTxIn& txin, tx.vin) {
             // Check that every mempool transaction's inputs refer to available coins, or other mempool tx's.
-            std::map<uint256, CTxMemPoolEntry>::const_iterator it2 = mapTx.find(txin.prevout.hash);
+            TxMap::const_iterator it2 = mapTx.find(txin.prevout.hash);
             if (it2 != mapTx.end()) {
                 const CTransaction& tx2 = it2->second.GetTx();
                 assert(tx2.vout.size() > txin.prevout.n && !tx2.vout[txin.prevout.n].IsNull());
@@ -568,12 +909,27 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
                 assert(coins && coins->IsAvailable(txin.prevout.n));
             }
             // Check whether its inputs are marked in mapNextTx.
-            std::map<COutPoint, CInPoint>::const_iterator it3 = mapNextTx.find(txin.prevout);
+            NextTxMap::const_iterator it3 = mapNextTx.find(txin.prevout);
             assert(it3 != mapNextTx.end());
             assert(it3->second.ptx == &tx);
             assert(it3->second.n == i);
             i++;
         }
+        // Check the descendant state against a fresh walk
+        std::set<uint256> setDescendants;
+        CalculateDescendants(it->first, setDescendants);
+        uint64_t nSizeCheck = 0;
+        CAmount nFeesCheck = 0;
+        BOOST_FOREACH (const uint256& hash, setDescendants) {
+            const CTxMemPoolEntry& descendant = mapTx.find(hash)->second;
+            nSizeCheck += descendant.GetTxSize();
+            nFeesCheck += descendant.GetModifiedFee();
+        }
+        assert(it->second.GetCountWithDescendants() == setDescendants.size());
+        assert(it->second.GetSizeWithDescendants() == nSizeCheck);
+        assert(it->second.GetModFeesWithDescendants() == nFeesCheck);
+        assert(setDescendantScore.count(std::make_pair(it->second.GetDescendantScore(), it->first)));
+
         if (fDependsWait)
             waitingOnDependants.push_back(&it->second);
         else {
@@ -599,9 +955,9 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
             stepsSinceLastRemove = 0;
         }
     }
-    for (std::map<COutPoint, CInPoint>::const_iterator it = mapNextTx.begin(); it != mapNextTx.end(); it++) {
+    for (NextTxMap::const_iterator it = mapNextTx.begin(); it != mapNextTx.end(); it++) {
         uint256 hash = it->second.ptx->GetHash();
-        map<uint256, CTxMemPoolEntry>::const_iterator it2 = mapTx.find(hash);
+        TxMap::const_iterator it2 = mapTx.find(hash);
         const CTransaction& tx = it2->second.GetTx();
         assert(it2 != mapTx.end());
         assert(&tx == it->second.ptx);
@@ -610,6 +966,10 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     }
 
     assert(totalTxSize == checkTotal);
+    assert(setDescendantScore.size() == mapTx.size());
+    assert(setEntryTime.size() == mapTx.size());
+    assert(setFeeRateIndex.size() == mapTx.size());
+    assert(nPriorityIndexHeight < 0 || setPriorityIndex.size() == mapTx.size());
 }
 
 void CTxMemPool::queryHashes(vector<uint256>& vtxid)
@@ -618,14 +978,14 @@ void CTxMemPool::queryHashes(vector<uint256>& vtxid)
 
     LOCK(cs);
     vtxid.reserve(mapTx.size());
-    for (map<uint256, CTxMemPoolEntry>::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi)
+    for (TxMap::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi)
         vtxid.push_back((*mi).first);
 }
 
 bool CTxMemPool::lookup(uint256 hash, CTransaction& result) const
 {
     LOCK(cs);
-    map<uint256, CTxMemPoolEntry>::const_iterator i = mapTx.find(hash);
+    TxMap::const_iterator i = mapTx.find(hash);
     if (i == mapTx.end()) return false;
     result = i->second.GetTx();
     return true;
@@ -680,6 +1040,20 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
         std::pair<double, CAmount>& deltas = mapDeltas[hash];
         deltas.first += dPriorityDelta;
         deltas.second += nFeeDelta;
+
+        // Re-score the entry, and its ancestors, which count its fee
+        TxMap::iterator it = mapTx.find(hash);
+        if (it != mapTx.end()) {
+            std::set<uint256> setAncestors;
+            CalculateAncestors(it->second.GetTx(), setAncestors);
+            BOOST_FOREACH (const uint256& hashAncestor, setAncestors)
+                UpdateDescendantState(mapTx.find(hashAncestor), 0, nFeeDelta, 0);
+            setDescendantScore.erase(std::make_pair(it->second.GetDescendantScore(), hash));
+            UnindexEntry(hash, it->second);
+            it->second.SetDeltas(deltas.first, deltas.second);
+            setDescendantScore.insert(std::make_pair(it->second.GetDescendantScore(), hash));
+            IndexEntry(hash, it->second);
+        }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
 }
@@ -687,7 +1061,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
 void CTxMemPool::ApplyDeltas(const uint256 hash, double& dPriorityDelta, CAmount& nFeeDelta)
 {
     LOCK(cs);
-    std::map<uint256, std::pair<double, CAmount> >::iterator pos = mapDeltas.find(hash);
+    DeltaMap::iterator pos = mapDeltas.find(hash);
     if (pos == mapDeltas.end())
         return;
     const std::pair<double, CAmount>& deltas = pos->second;
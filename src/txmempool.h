@@ -7,9 +7,11 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <list>
+#include <set>
 
 #include "amount.h"
 #include "coins.h"
+#include "nodepool.h"
 #include "primitives/transaction.h"
 #include "sync.h"
 
@@ -41,9 +43,18 @@ private:
     CAmount nFee;         //! Cached to avoid expensive parent-transaction lookups
     size_t nTxSize;       //! ... and avoid recomputing tx size
     size_t nModSize;      //! ... and modified size for priority
+    size_t nUsageSize;    //! ... and the memory held by tx
     int64_t nTime;        //! Local time when entering the mempool
     double dPriority;     //! Priority when entering the mempool
     unsigned int nHeight; //! Chain height when entering the mempool
+    CAmount nModFee;      //! Fee with the PrioritiseTransaction() delta
+    double dPriorityDelta; //! PrioritiseTransaction() priority delta
+
+    // Totals over this transaction and its descendants in the pool,
+    // maintained by CTxMemPool for size-limit eviction
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    CAmount nModFeesWithDescendants;
 
 public:
     CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee, int64_t _nTime, double _dPriority, unsigned int _nHeight);
@@ -56,6 +67,26 @@ public:
     size_t GetTxSize() const { return nTxSize; }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return nHeight; }
+    size_t DynamicMemoryUsage() const { return nUsageSize; }
+
+    CAmount GetModifiedFee() const { return nModFee; }
+    double GetModifiedPriority(unsigned int currentHeight) const { return GetPriority(currentHeight) + dPriorityDelta; }
+    double GetPriorityDelta() const { return dPriorityDelta; }
+    void SetDeltas(double dPriorityDeltaIn, CAmount nFeeDelta);
+    /** Modified fee per kB of the transaction alone */
+    double GetModifiedFeeRate() const { return (double)nModFee * 1000 / nTxSize; }
+    uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
+    uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
+    CAmount GetModFeesWithDescendants() const { return nModFeesWithDescendants; }
+    void UpdateDescendantState(int64_t nSizeDelta, CAmount nFeeDelta, int64_t nCountDelta);
+
+    /**
+     * Eviction score in satoshis per kB: the higher of the transaction's own
+     * fee rate and that of its package with all descendants, so a parent is
+     * not evicted ahead of the children paying for it, nor kept by them
+     * when they pay less.
+     */
+    double GetDescendantScore() const;
 };
 
 class CMinerPolicyEstimator;
@@ -93,6 +124,19 @@ public:
  */
 class CTxMemPool
 {
+public:
+    // The maps keep their nodes in a pool of the mempool's own (see
+    // nodepool.h), which holds on to at most one empty chunk per node size
+    // once transactions leave.
+    typedef std::map<uint256, CTxMemPoolEntry, std::less<uint256>,
+        node_pool_allocator<std::pair<const uint256, CTxMemPoolEntry> > > TxMap;
+    typedef std::map<COutPoint, CInPoint, std::less<COutPoint>,
+        node_pool_allocator<std::pair<const COutPoint, CInPoint> > > NextTxMap;
+    typedef std::map<uint256, std::pair<double, CAmount>, std::less<uint256>,
+        node_pool_allocator<std::pair<const uint256, std::pair<double, CAmount> > > > DeltaMap;
+
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // seconds
+
 private:
     bool fSanityCheck; //! Normally false, true if -checkmempool or -regtest
     unsigned int nTransactionsUpdated;
@@ -100,12 +144,39 @@ private:
 
     CFeeRate minRelayFee; //! Passed to constructor to avoid dependency on main
     uint64_t totalTxSize; //! sum of all mempool tx' byte sizes
+    uint64_t cachedInnerUsage; //! sum of the memory held by the entries' transactions
+
+    //! Entries by eviction score and by arrival time, lowest first
+    std::set<std::pair<double, uint256> > setDescendantScore;
+    std::set<std::pair<int64_t, uint256> > setEntryTime;
+
+    //! Entries by modified fee rate, and by modified priority at
+    //! nPriorityIndexHeight (-1 while not built), lowest first
+    std::set<std::pair<double, uint256> > setFeeRateIndex;
+    std::set<std::pair<double, uint256> > setPriorityIndex;
+    int nPriorityIndexHeight;
+
+    mutable int64_t lastRollingFeeUpdate;
+    mutable bool blockSinceLastRollingFeeBump;
+    mutable double rollingMinimumFeeRate; //! minimum fee rate to get into the pool, decays over time
+
+    uint64_t nEvicted; //! transactions removed by TrimToSize()
+    uint64_t nExpired; //! transactions removed by Expire()
+
+    boost::shared_ptr<CNodePool> nodePool; //! holds the nodes of the maps below
+
+    void CalculateAncestors(const CTransaction& tx, std::set<uint256>& setAncestors) const;
+    void UpdateDescendantState(TxMap::iterator it, int64_t nSizeDelta, CAmount nFeeDelta, int64_t nCountDelta);
+    void IndexEntry(const uint256& hash, const CTxMemPoolEntry& entry);
+    void UnindexEntry(const uint256& hash, const CTxMemPoolEntry& entry);
+    void RemoveStaged(const std::vector<uint256>& vRemove, const std::set<uint256>& setRemove, std::list<CTransaction>& removed);
+    void trackPackageRemoved(const CFeeRate& rate);
 
 public:
     mutable CCriticalSection cs;
-    std::map<uint256, CTxMemPoolEntry> mapTx;
-    std::map<COutPoint, CInPoint> mapNextTx;
-    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    TxMap mapTx;
+    NextTxMap mapNextTx;
+    DeltaMap mapDeltas;
 
     CTxMemPool(const CFeeRate& _minRelayFee);
     ~CTxMemPool();
@@ -135,6 +206,58 @@ public:
     void ApplyDeltas(const uint256 hash, double& dPriorityDelta, CAmount& nFeeDelta);
     void ClearPrioritisation(const uint256 hash);
 
+    /** Collect hash and the transactions in the pool spending its outputs, recursively */
+    void CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const;
+
+    /**
+     * Evict the packages with the lowest descendant score until the pool
+     * uses at most sizelimit bytes. Packages containing a transaction in
+     * setProtected are kept. Raises the rolling minimum fee above the
+     * evicted packages' fee rate, and returns the number of transactions
+     * removed.
+     */
+    unsigned int TrimToSize(size_t sizelimit, const std::set<uint256>& setProtected);
+
+    /** Whether any transaction entered before time */
+    bool HasExpired(int64_t time) const;
+    /** Remove transactions that entered before time, with their descendants, except for setProtected */
+    unsigned int Expire(int64_t time, const std::set<uint256>& setProtected);
+
+    /**
+     * The minimum fee rate to get into a pool limited to sizelimit bytes:
+     * minRelayFee, or more for a while after packages had to be evicted.
+     * The extra decays with a half-life of ROLLING_FEE_HALFLIFE, faster
+     * while the pool is less than half full, and only starts decaying once
+     * a block has come in since the last eviction.
+     */
+    CFeeRate GetMinFee(size_t sizelimit) const;
+
+    typedef std::set<std::pair<double, uint256> >::const_reverse_iterator score_iterator;
+
+    /**
+     * Block assembly order: entries by modified fee rate, highest first.
+     * Kept up to date as transactions come and go, so a template only
+     * visits what it selects.
+     */
+    score_iterator FeeRateBegin() const { return setFeeRateIndex.rbegin(); }
+    score_iterator FeeRateEnd() const { return setFeeRateIndex.rend(); }
+
+    /**
+     * Entries by modified priority for a block at nHeight, highest first.
+     * Priorities grow with the height at different rates, so the index is
+     * rebuilt when nHeight changes, once per block; in between, arriving
+     * transactions are slotted in. Requires cs to be held by the caller for
+     * as long as the iterators are used.
+     */
+    score_iterator PriorityBegin(unsigned int nHeight);
+    score_iterator PriorityEnd() const { return setPriorityIndex.rend(); }
+
+    /** Memory held by the pool: its maps, indexes and transactions */
+    size_t DynamicMemoryUsage() const;
+
+    uint64_t GetEvictedCount() const;
+    uint64_t GetExpiredCount() const;
+
     unsigned long size()
     {
         LOCK(cs);
@@ -146,6 +269,9 @@ public:
         return totalTxSize;
     }
 
+    /** Bytes of node pool chunks held for the maps */
+    size_t GetPoolBytes() const;
+
     bool exists(uint256 hash)
     {
         LOCK(cs);
@@ -9,8 +9,10 @@
 #include "wallet.h"
 
 #include "base58.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "coincontrol.h"
+#include "init.h"
 #include "kernel.h"
 #include "servicenode-budget.h"
 #include "net.h"
@@ -426,6 +428,56 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+void CWallet::MarkUnspent(const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+    setUnspentTx.insert(hash);
+    cachedBalances.fValid = false;
+}
+
+/**
+ * Every output of ours is spent by a transaction in the main chain, and
+ * the transaction is not an immature coinbase or coinstake:
+ */
+bool CWallet::IsSpentInMainChain(const CWalletTx& wtx) const
+{
+    if (wtx.GetBlocksToMaturity() > 0)
+        return false;
+
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (IsMine(wtx.vout[i]) == ISMINE_NO)
+            continue;
+        bool fSpent = false;
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hash, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSpent; ++it) {
+            std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+            fSpent = mit != mapWallet.end() && mit->second.GetDepthInMainChain(false) >= 1;
+        }
+        if (!fSpent)
+            return false;
+    }
+    return true;
+}
+
+void CWallet::GetUnspentTxs(std::vector<const CWalletTx*>& vpwtx) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    vpwtx.clear();
+    vpwtx.reserve(setUnspentTx.size());
+    std::set<uint256>::iterator it = setUnspentTx.begin();
+    while (it != setUnspentTx.end()) {
+        std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(*it);
+        if (mi == mapWallet.end() || IsSpentInMainChain(mi->second)) {
+            setUnspentTx.erase(it++);
+            continue;
+        }
+        vpwtx.push_back(&mi->second);
+        it++;
+    }
+}
+
 bool CWallet::GetServicenodeVinAndKeys(CTxIn& txinRet, CPubKey& pubKeyRet, CKey& keyRet, std::string strTxHash, std::string strOutputIndex)
 {
     // wait for reindex and/or import to finish
@@ -619,8 +671,11 @@ void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
-        BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
+        BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet) {
             item.second.MarkDirty();
+            // What is ours may have changed, too
+            MarkUnspent(item.first);
+        }
     }
 }
 
@@ -632,6 +687,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
         mapWallet[hash] = wtxIn;
         mapWallet[hash].BindWallet(this);
         AddToSpends(hash);
+        MarkUnspent(hash);
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -712,6 +768,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        MarkUnspent(hash);
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -759,8 +816,10 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     // available of the outputs it spends. So force those to be
     // recomputed, also:
     BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-        if (mapWallet.count(txin.prevout.hash))
+        if (mapWallet.count(txin.prevout.hash)) {
             mapWallet[txin.prevout.hash].MarkDirty();
+            MarkUnspent(txin.prevout.hash);
+        }
     }
 }
 
@@ -772,6 +831,8 @@ void CWallet::EraseFromWallet(const uint256& hash)
         LOCK(cs_wallet);
         if (mapWallet.erase(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
+        setUnspentTx.erase(hash);
+        cachedBalances.fValid = false;
     }
     return;
 }
@@ -1077,46 +1138,257 @@ bool CWalletTx::WriteToDisk()
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
+bool CWallet::GetWalletScripts(std::set<CScript>& setScripts) const
+{
+    LOCK(cs_KeyStore);
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    BOOST_FOREACH (const CKeyID& keyID, setKeys) {
+        setScripts.insert(GetScriptForDestination(keyID));
+        CPubKey pubkey;
+        if (GetPubKey(keyID, pubkey))
+            setScripts.insert(CScript() << ToByteVector(pubkey) << OP_CHECKSIG);
+    }
+    for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it)
+        setScripts.insert(GetScriptForDestination(it->first));
+    BOOST_FOREACH (const CScript& script, setWatchOnly)
+        setScripts.insert(script);
+    // A bare multisig of the wallet's keys, or a redeem script's, is ours too
+    return setKeys.empty() && mapScripts.empty();
+}
+
+/**
+ * A block of a rescan, read and screened ahead by a CRescanQueue thread:
+ * vfCandidate flags the transactions paying to one of the wallet's scripts,
+ * or to a bare multisig, which needs the full IsMine() to tell.
+ */
+struct CRescanBlock {
+    CBlock block;
+    std::vector<bool> vfCandidate;
+};
+
+/**
+ * Reads the blocks of a rescan on a few threads, at most nWindow blocks
+ * ahead of the one the wallet is taking in, and without cs_main: block
+ * files are only ever appended to. With -blockfilterindex, and fUseFilters
+ * for a wallet whose scripts are all listed (no keys that could make up a
+ * bare multisig), blocks whose filter matches none of them are not read.
+ */
+class CRescanQueue
+{
+public:
+    CRescanQueue(const std::vector<CBlockIndex*>& vBlocksIn, const std::set<CScript>& setScriptsIn, bool fUseFiltersIn, size_t nWindowIn)
+        : vBlocks(vBlocksIn), setScripts(setScriptsIn), fUseFilters(fUseFiltersIn), nWindow(nWindowIn), nNext(0), nWanted(0), nSkipped(0), fStop(false)
+    {
+        BOOST_FOREACH (const CScript& script, setScripts)
+            setElements.insert(GCSFilter::Element(script.begin(), script.end()));
+    }
+
+    void Thread()
+    {
+        while (true) {
+            size_t n;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fStop && nNext < vBlocks.size() && nNext >= nWanted + nWindow)
+                    condWork.wait(lock);
+                if (fStop || nNext >= vBlocks.size())
+                    return;
+                n = nNext++;
+            }
+
+            boost::shared_ptr<CRescanBlock> pblock(new CRescanBlock());
+            BlockFilter filter;
+            if (fUseFilters && pblockfilterindex && pblockfilterindex->LookupFilter(vBlocks[n], filter) && !filter.GetFilter().MatchAny(setElements)) {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                nSkipped++;
+                mapDone[n] = pblock;
+                condDone.notify_all();
+                continue;
+            }
+            if (!ReadBlockFromDisk(pblock->block, vBlocks[n]))
+                LogPrintf("CRescanQueue : cannot read block %s\n", vBlocks[n]->GetBlockHash().ToString());
+            pblock->vfCandidate.resize(pblock->block.vtx.size());
+            for (unsigned int i = 0; i < pblock->block.vtx.size(); i++) {
+                BOOST_FOREACH (const CTxOut& txout, pblock->block.vtx[i].vout) {
+                    const CScript& script = txout.scriptPubKey;
+                    if (setScripts.count(script) || (!script.empty() && script.back() == OP_CHECKMULTISIG)) {
+                        pblock->vfCandidate[i] = true;
+                        break;
+                    }
+                }
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            mapDone[n] = pblock;
+            condDone.notify_all();
+        }
+    }
+
+    /** Wait for block n, in order, and let the threads move on past it */
+    boost::shared_ptr<CRescanBlock> Get(size_t n)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nWanted = n;
+        condWork.notify_all();
+        while (!mapDone.count(n))
+            condDone.wait(lock);
+        boost::shared_ptr<CRescanBlock> pblock = mapDone[n];
+        mapDone.erase(n);
+        return pblock;
+    }
+
+    void Stop()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+        condWork.notify_all();
+    }
+
+    /** Blocks passed over thanks to their filter */
+    size_t GetSkipped()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return nSkipped;
+    }
+
+private:
+    const std::vector<CBlockIndex*>& vBlocks;
+    const std::set<CScript>& setScripts;
+    GCSFilter::ElementSet setElements;
+    const bool fUseFilters;
+    const size_t nWindow;
+
+    boost::mutex mutex;
+    boost::condition_variable condWork;
+    boost::condition_variable condDone;
+    size_t nNext;
+    size_t nWanted;
+    size_t nSkipped;
+    bool fStop;
+    std::map<size_t, boost::shared_ptr<CRescanBlock> > mapDone;
+};
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read and screened against the wallet's scripts on
+ * -rescanthreads threads; cs_main and cs_wallet are only taken per block
+ * to add what was found, so the node keeps running meanwhile. Progress is
+ * saved in the wallet every minute, and a rescan cut short by a shutdown
+ * resumes from there on the next start. Blocks connected while the scan
+ * runs are scanned once more at the end, under the locks, in case they
+ * spend outputs the scan found after they arrived.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     int ret = 0;
+    int64_t nStart = GetTimeMillis();
     int64_t nNow = GetTime();
 
-    CBlockIndex* pindex = pindexStart;
+    std::vector<CBlockIndex*> vBlocks;
+    std::set<CScript> setScripts;
+    bool fUseFilters;
     {
         LOCK2(cs_main, cs_wallet);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
+        CBlockIndex* pindex = pindexStart;
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
+        for (; pindex; pindex = chainActive.Next(pindex))
+            vBlocks.push_back(pindex);
+        fUseFilters = GetWalletScripts(setScripts);
+    }
+    if (vBlocks.empty())
+        return 0;
+
+    int nThreads = std::max(1, std::min(MAX_RESCAN_THREADS, (int)GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS)));
+    CRescanQueue queue(vBlocks, setScripts, fUseFilters, nThreads * 16);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&CRescanQueue::Thread, &queue));
+
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+    double dProgressStart = Checkpoints::GuessVerificationProgress(vBlocks.front(), false);
+    double dProgressTip = Checkpoints::GuessVerificationProgress(vBlocks.back(), false);
+    CBlockIndex* pindexLast = NULL;
+    bool fInterrupted = false;
+    for (size_t n = 0; n < vBlocks.size(); n++) {
+        CBlockIndex* pindex = vBlocks[n];
+        if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+            ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+        if (ShutdownRequested()) {
+            fInterrupted = true;
+            break;
+        }
+
+        boost::shared_ptr<CRescanBlock> pblock = queue.Get(n);
+        {
+            LOCK2(cs_main, cs_wallet);
+            // A block reorganized away meanwhile: the new branch is taken
+            // in by the final pass below
+            if (!chainActive.Contains(pindex))
+                continue;
+            for (unsigned int i = 0; i < pblock->block.vtx.size(); i++) {
+                const CTransaction& tx = pblock->block.vtx[i];
+                bool fCandidate = pblock->vfCandidate[i] || mapWallet.count(tx.GetHash());
+                for (unsigned int j = 0; j < tx.vin.size() && !fCandidate; j++)
+                    fCandidate = mapWallet.count(tx.vin[j].prevout.hash);
+                if (fCandidate && AddToWalletIfInvolvingMe(tx, &pblock->block, fUpdate))
+                    ret++;
+            }
+            pindexLast = pindex;
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+            if (GetTime() >= nNow + 60) {
+                nNow = GetTime();
+                LogPrintf("Still rescanning. At block %d. Progress=%f, %.1f blocks/s\n", pindex->nHeight,
+                    Checkpoints::GuessVerificationProgress(pindex), 1000.0 * (n + 1) / std::max((int64_t)1, GetTimeMillis() - nStart));
+                if (fFileBacked)
+                    CWalletDB(strWalletFile).WriteRescanBlock(chainActive.GetLocator(pindex));
+            }
+        }
+    }
+    queue.Stop();
+    threadGroup.join_all();
 
+    if (fInterrupted) {
+        // Cut short before the first block was taken in, the whole range is
+        // still to do; the wallet's best block may be past it already
+        CBlockIndex* pindexResume = pindexLast;
+        if (!pindexResume)
+            pindexResume = vBlocks.front()->pprev ? vBlocks.front()->pprev : pindexStart;
+        if (fFileBacked) {
+            LOCK2(cs_main, cs_wallet);
+            CWalletDB(strWalletFile).WriteRescanBlock(chainActive.GetLocator(pindexResume));
+        }
+        LogPrintf("Rescan interrupted at block %d, will resume on restart\n", pindexResume->nHeight);
+        ShowProgress(_("Rescanning..."), 100);
+        return ret;
+    }
+
+    {
+        LOCK2(cs_main, cs_wallet);
+        CBlockIndex* pindex = chainActive.Next(chainActive.FindFork(pindexLast ? pindexLast : vBlocks.front()));
+        for (; pindex; pindex = chainActive.Next(pindex)) {
             CBlock block;
             ReadBlockFromDisk(block, pindex);
             BOOST_FOREACH (CTransaction& tx, block.vtx) {
                 if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
                     ret++;
             }
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
-            }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+        if (fFileBacked)
+            CWalletDB(strWalletFile).EraseRescanBlock();
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+    int64_t nElapsed = std::max((int64_t)1, GetTimeMillis() - nStart);
+    LogPrintf("Rescanned %u blocks in %.2fs (%.1f blocks/s, %d threads, %u skipped by block filters), %d transactions found\n",
+        vBlocks.size(), nElapsed * 0.001, 1000.0 * vBlocks.size() / nElapsed, nThreads, queue.GetSkipped(), ret);
     return ret;
 }
 
@@ -1155,7 +1427,7 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(make_pair(hash, (CTransaction) * this));
+                txLockManager.AddRequest((CTransaction) * this);
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -1221,19 +1493,52 @@ void CWallet::ResendWalletTransactions()
  */
 
 
-CAmount CWallet::GetBalance() const
+const CWallet::CachedBalances& CWallet::GetCachedBalances() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    CachedBalances& cache = cachedBalances;
+    // Unconfirmed transactions enter and leave the memory pool without the
+    // wallet or the tip changing
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    if (cache.fValid && cache.pindexTip == chainActive.Tip() && cache.nMempoolUpdated == nMempoolUpdated &&
+        cache.nTXLocksComplete == nCompleteTXLocks && cache.nTXLocks == txLockManager.GetLockCount())
+        return cache;
+
+    cache.nTrusted = cache.nUnconfirmed = cache.nImmature = 0;
+    cache.nWatchOnlyTrusted = cache.nWatchOnlyUnconfirmed = cache.nWatchOnlyImmature = 0;
+    // Finality by lock time can change with the clock alone; keep
+    // recomputing while any such transaction is around
+    bool fAllFinal = true;
+    std::vector<const CWalletTx*> vpwtx;
+    GetUnspentTxs(vpwtx);
+    BOOST_FOREACH (const CWalletTx* pcoin, vpwtx) {
+        bool fFinal = IsFinalTx(*pcoin);
+        fAllFinal &= fFinal;
+        if (pcoin->IsTrusted()) {
+            cache.nTrusted += pcoin->GetAvailableCredit();
+            cache.nWatchOnlyTrusted += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        if (!fFinal || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0)) {
+            cache.nUnconfirmed += pcoin->GetAvailableCredit();
+            cache.nWatchOnlyUnconfirmed += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        cache.nImmature += pcoin->GetImmatureCredit();
+        cache.nWatchOnlyImmature += pcoin->GetImmatureWatchOnlyCredit();
+    }
+
+    cache.fValid = fAllFinal;
+    cache.pindexTip = chainActive.Tip();
+    cache.nMempoolUpdated = nMempoolUpdated;
+    cache.nTXLocksComplete = nCompleteTXLocks;
+    cache.nTXLocks = txLockManager.GetLockCount();
+    return cache;
+}
 
-    return nTotal;
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance() const
@@ -1243,8 +1548,9 @@ CAmount CWallet::GetAnonymizableBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vpwtx;
+        GetUnspentTxs(vpwtx);
+        BOOST_FOREACH (const CWalletTx* pcoin, vpwtx) {
 
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAnonymizableCredit();
@@ -1261,8 +1567,9 @@ CAmount CWallet::GetAnonymizedBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vpwtx;
+        GetUnspentTxs(vpwtx);
+        BOOST_FOREACH (const CWalletTx* pcoin, vpwtx) {
 
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAnonymizedCredit();
@@ -1283,10 +1590,11 @@ double CWallet::GetAverageAnonymizedRounds() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vpwtx;
+        GetUnspentTxs(vpwtx);
+        BOOST_FOREACH (const CWalletTx* pcoin, vpwtx) {
 
-            uint256 hash = (*it).first;
+            const uint256& hash = pcoin->GetHash();
 
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 CTxIn vin = CTxIn(hash, i);
@@ -1315,10 +1623,11 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vpwtx;
+        GetUnspentTxs(vpwtx);
+        BOOST_FOREACH (const CWalletTx* pcoin, vpwtx) {
 
-            uint256 hash = (*it).first;
+            const uint256& hash = pcoin->GetHash();
 
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 CTxIn vin = CTxIn(hash, i);
@@ -1342,8 +1651,9 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vpwtx;
+        GetUnspentTxs(vpwtx);
+        BOOST_FOREACH (const CWalletTx* pcoin, vpwtx) {
 
             nTotal += pcoin->GetDenominatedCredit(unconfirmed);
         }
@@ -1354,71 +1664,32 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nWatchOnlyTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nWatchOnlyUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nWatchOnlyImmature;
 }
 
 /**
@@ -1430,9 +1701,10 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vpwtx;
+        GetUnspentTxs(vpwtx);
+        BOOST_FOREACH (const CWalletTx* pcoin, vpwtx) {
+            const uint256& wtxid = pcoin->GetHash();
 
             if (!CheckFinalTx(*pcoin))
                 continue;
@@ -1472,9 +1744,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
                 isminetype mine = IsMine(pcoin->vout[i]);
                 if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_SERVICENODE_REQUIRED_AMOUNT) &&
+                    (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_SERVICENODE_REQUIRED_AMOUNT) &&
                     (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
+                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
                     vCoins.push_back(COutput(pcoin, i, nDepth,
                         ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
                             (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
@@ -3719,24 +3991,12 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!IsSporkActive(SPORK_2_SWIFTTX)) return -3;
     if (!fEnableSwiftTX) return -1;
 
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return (*i).second.CountSignatures();
-    }
-
-    return -1;
+    return txLockManager.GetSignatures(GetHash());
 }
 
 bool CMerkleTx::IsTransactionLockTimedOut() const
 {
     if (!fEnableSwiftTX) return 0;
 
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return GetTime() > (*i).second.nTimeout;
-    }
-
-    return false;
+    return txLockManager.IsTimedOut(GetHash());
 }
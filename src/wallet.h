@@ -53,6 +53,10 @@ static const CAmount DEFAULT_TRANSACTION_MAXFEE = 1 * COIN;
 static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWarning;
 //! Largest (in bytes) free transaction we're willing to create
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
+//! -rescanthreads default, threads reading blocks ahead of a rescan
+static const int DEFAULT_RESCAN_THREADS = 4;
+//! Most threads -rescanthreads may ask for
+static const int MAX_RESCAN_THREADS = 16;
 
 class CAccountingEntry;
 class CCoinControl;
@@ -162,6 +166,43 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Wallet transactions that may still have outputs of ours unspent, or
+     * immature ones: all that the balance and coin selection code has to
+     * look at. A transaction goes in whenever it, or one spending it,
+     * changes, and is dropped lazily once every output of ours is spent by
+     * a transaction in the main chain. Taking the spender out of the chain
+     * again goes through SyncTransaction(), which puts it back.
+     */
+    mutable std::set<uint256> setUnspentTx;
+    void MarkUnspent(const uint256& hash);
+    bool IsSpentInMainChain(const CWalletTx& wtx) const;
+    void GetUnspentTxs(std::vector<const CWalletTx*>& vpwtx) const;
+
+    //! Balances from one pass over setUnspentTx, good for as long as the
+    //! wallet, the chain tip, the memory pool and the SwiftTX locks stay the same
+    struct CachedBalances {
+        bool fValid;
+        const CBlockIndex* pindexTip;
+        unsigned int nMempoolUpdated;
+        int nTXLocksComplete;
+        size_t nTXLocks;
+        CAmount nTrusted;
+        CAmount nUnconfirmed;
+        CAmount nImmature;
+        CAmount nWatchOnlyTrusted;
+        CAmount nWatchOnlyUnconfirmed;
+        CAmount nWatchOnlyImmature;
+
+        CachedBalances() : fValid(false) {}
+    };
+    mutable CachedBalances cachedBalances;
+    const CachedBalances& GetCachedBalances() const;
+
+    //! Output scripts that IsMine() may accept without a multisig, see ScanForWalletTransactions();
+    //! false if it may accept others as well
+    bool GetWalletScripts(std::set<CScript>& setScripts) const;
+
 public:
     bool MintableCoins();
     bool SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, int64_t nTargetAmount) const;
@@ -141,6 +141,23 @@ bool CWalletDB::ReadBestBlock(CBlockLocator& locator)
     return Read(std::string("bestblock"), locator);
 }
 
+bool CWalletDB::WriteRescanBlock(const CBlockLocator& locator)
+{
+    nWalletDBUpdated++;
+    return Write(std::string("rescanblock"), locator);
+}
+
+bool CWalletDB::ReadRescanBlock(CBlockLocator& locator)
+{
+    return Read(std::string("rescanblock"), locator);
+}
+
+bool CWalletDB::EraseRescanBlock()
+{
+    nWalletDBUpdated++;
+    return Erase(std::string("rescanblock"));
+}
+
 bool CWalletDB::WriteOrderPosNext(int64_t nOrderPosNext)
 {
     nWalletDBUpdated++;
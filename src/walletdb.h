@@ -101,6 +101,11 @@ public:
     bool WriteBestBlock(const CBlockLocator& locator);
     bool ReadBestBlock(CBlockLocator& locator);
 
+    //! Where an unfinished rescan has got to, so that it resumes on startup
+    bool WriteRescanBlock(const CBlockLocator& locator);
+    bool ReadRescanBlock(CBlockLocator& locator);
+    bool EraseRescanBlock();
+
     bool WriteOrderPosNext(int64_t nOrderPosNext);
 
     // presstab
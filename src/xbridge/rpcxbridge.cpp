@@ -234,30 +234,16 @@ Value dxGetOrderFills(const Array & params, bool fHelp)
 //*****************************************************************************
 //*****************************************************************************
 
-Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
+/**
+ * Run the query of dxGetOrderHistory; the error object to return instead,
+ * or null, with the intervals found and how to lay them out
+ */
+static Value queryOrderHistory(const json_spirit::Array& params, std::vector<xAggregate>& result,
+                               time_duration& offset, bool& withTxids)
 {
-    if (fHelp) {
-        throw runtime_error("dxGetOrderHistory (maker) (taker) (start time) (end time)"
-                            " (granularity) (order_ids, default=false)[optional]\n"
-                            " (with_inverse, default=false)[optional]\n"
-                            " (limit, default="+std::to_string(xQuery::IntervalLimit{}.count())+")[optional]\n"
-                            "Returns the order history over a specified time interval."
-                            " [start_time] and [end_time] are \n"
-                            "in unix time seconds [granularity] in seconds of supported"
-                            " time interval lengths include: \n"
-                            + xQuery::supported_seconds_csv() + ". [order_ids] is a boolean,"
-                            " defaults to false (not showing ids).\n"
-                            "[with_inverse] is a boolean, defaults to false (not aggregating inverse currency pair).\n"
-                            "[limit] is the maximum number of intervals to return,"
-                            " default="+std::to_string(xQuery::IntervalLimit{}.count())+
-                            " maximum="+std::to_string(xQuery::IntervalLimit::max())+".\n"
-                            "[interval_timestamp] is one of [at_start | at_end], defaults to at_start (timestamp at start of the interval)[optional]\n"
-                            );
-    }
-
     //--Validate query parameters
     if (params.size() < 5 || params.size() > 8)
-        return util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
+        return util::makeError(xbridge::INVALID_PARAMETERS, "dxGetOrderHistory",
                                "(maker) (taker) (start time) (end time) (granularity) "
                                "(order_ids, default=false)[optional] "
                                "(with_inverse, default=false)[optional] "
@@ -285,36 +271,89 @@ Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
     };
 
     if (query.error())
-        return util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__, query.what() );
+        return util::makeError(xbridge::INVALID_PARAMETERS, "dxGetOrderHistory", query.what() );
     try {
         //--Process query, get result
         auto& xseries = xbridge::App::instance().getXSeriesCache();
-        std::vector<xAggregate> result = xseries.getXAggregateSeries(query);
-
-        //--Serialize result
-        Array arr{};
-        const time_duration offset = query.interval_timestamp.at_start()
-            ? query.granularity
-            : boost::posix_time::seconds{0};
-        for (const auto& x : result) {
-            double volume = x.toVolume.amount<double>();
-            Array ohlc{
-                ArrayIL{util::iso8601(x.timeEnd - offset), x.low, x.high, x.open, x.close, volume}
-            };
-            if (query.with_txids == xQuery::WithTxids::Included) {
-                Array orderIds{};
-                for (const auto& id : x.orderIds)
-                    orderIds.emplace_back(id);
-                ohlc.emplace_back(orderIds);
-            }
-            arr.emplace_back(ohlc);
-        }
-        return arr;
+        result = xseries.getXAggregateSeries(query);
     } catch(const std::exception& e) {
-        return util::makeError(xbridge::UNKNOWN_ERROR, __FUNCTION__, e.what() );
+        return util::makeError(xbridge::UNKNOWN_ERROR, "dxGetOrderHistory", e.what() );
     } catch( ... ) {
-        return util::makeError(xbridge::UNKNOWN_ERROR, __FUNCTION__, "unknown exception" );
+        return util::makeError(xbridge::UNKNOWN_ERROR, "dxGetOrderHistory", "unknown exception" );
     }
+    offset = query.interval_timestamp.at_start()
+        ? query.granularity
+        : boost::posix_time::seconds{0};
+    withTxids = query.with_txids == xQuery::WithTxids::Included;
+    return Value::null;
+}
+
+/** One interval of dxGetOrderHistory */
+static Array orderHistoryToJSON(const xAggregate& x, const time_duration& offset, bool withTxids)
+{
+    double volume = x.toVolume.amount<double>();
+    Array ohlc{
+        ArrayIL{util::iso8601(x.timeEnd - offset), x.low, x.high, x.open, x.close, volume}
+    };
+    if (withTxids) {
+        Array orderIds{};
+        for (const auto& id : x.orderIds)
+            orderIds.emplace_back(id);
+        ohlc.emplace_back(orderIds);
+    }
+    return ohlc;
+}
+
+Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
+{
+    if (fHelp) {
+        throw runtime_error("dxGetOrderHistory (maker) (taker) (start time) (end time)"
+                            " (granularity) (order_ids, default=false)[optional]\n"
+                            " (with_inverse, default=false)[optional]\n"
+                            " (limit, default="+std::to_string(xQuery::IntervalLimit{}.count())+")[optional]\n"
+                            "Returns the order history over a specified time interval."
+                            " [start_time] and [end_time] are \n"
+                            "in unix time seconds [granularity] in seconds of supported"
+                            " time interval lengths include: \n"
+                            + xQuery::supported_seconds_csv() + ". [order_ids] is a boolean,"
+                            " defaults to false (not showing ids).\n"
+                            "[with_inverse] is a boolean, defaults to false (not aggregating inverse currency pair).\n"
+                            "[limit] is the maximum number of intervals to return,"
+                            " default="+std::to_string(xQuery::IntervalLimit{}.count())+
+                            " maximum="+std::to_string(xQuery::IntervalLimit::max())+".\n"
+                            "[interval_timestamp] is one of [at_start | at_end], defaults to at_start (timestamp at start of the interval)[optional]\n"
+                            );
+    }
+
+    std::vector<xAggregate> result;
+    time_duration offset;
+    bool withTxids;
+    Value error = queryOrderHistory(params, result, offset, withTxids);
+    if (error.type() != null_type)
+        return error;
+
+    //--Serialize result
+    Array arr{};
+    for (const auto& x : result)
+        arr.emplace_back(orderHistoryToJSON(x, offset, withTxids));
+    return arr;
+}
+
+void dxGetOrderHistory_stream(const json_spirit::Array& params, JSONStreamWriter& writer)
+{
+    std::vector<xAggregate> result;
+    time_duration offset;
+    bool withTxids;
+    Value error = queryOrderHistory(params, result, offset, withTxids);
+    if (error.type() != null_type) {
+        writer.WriteValue(error);
+        return;
+    }
+
+    writer.BeginArray();
+    for (const auto& x : result)
+        writer.WriteValue(orderHistoryToJSON(x, offset, withTxids));
+    writer.EndArray();
 }
 
 //*****************************************************************************
@@ -902,23 +902,33 @@ App::flushCancelledOrders(bpt::time_duration minAge) const
 //******************************************************************************
 void App::appendTransaction(const TransactionDescrPtr & ptr)
 {
-    boost::mutex::scoped_lock l(m_p->m_txLocker);
+    TransactionDescrPtr xtx;
+    OrderBookEvent event = orderAdded;
 
-    if (m_p->m_historicTransactions.count(ptr->id))
     {
-        return;
-    }
+        boost::mutex::scoped_lock l(m_p->m_txLocker);
 
-    if (!m_p->m_transactions.count(ptr->id))
-    {
-        // new transaction, copy data
-        m_p->m_transactions[ptr->id] = ptr;
-    }
-    else
-    {
-        // existing, update timestamp
-        m_p->m_transactions[ptr->id]->updateTimestamp(*ptr);
+        if (m_p->m_historicTransactions.count(ptr->id))
+        {
+            return;
+        }
+
+        if (!m_p->m_transactions.count(ptr->id))
+        {
+            // new transaction, copy data
+            m_p->m_transactions[ptr->id] = ptr;
+        }
+        else
+        {
+            // existing, update timestamp
+            m_p->m_transactions[ptr->id]->updateTimestamp(*ptr);
+            event = orderUpdated;
+        }
+
+        xtx = m_p->m_transactions[ptr->id];
     }
+
+    xuiConnector.NotifyXBridgeOrderBookChanged(xtx, event);
 }
 
 //******************************************************************************
@@ -960,6 +970,8 @@ void App::moveTransactionToHistory(const uint256 & id)
         {
             conn->lockCoins(xtx->usedCoins, false);
         }
+
+        xuiConnector.NotifyXBridgeOrderBookChanged(xtx, orderRemoved);
     }
 
     // remove pending packets for this tx
@@ -1149,6 +1161,8 @@ xbridge::Error App::sendXBridgeTransaction(const std::string & from,
         m_p->m_transactions[id] = ptr;
     }
 
+    xuiConnector.NotifyXBridgeOrderBookChanged(ptr, orderAdded);
+
     LOG() << "order created" << ptr << __FUNCTION__;
 
     return xbridge::Error::SUCCESS;
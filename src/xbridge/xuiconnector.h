@@ -12,6 +12,17 @@ namespace xbridge
 {
 struct TransactionDescr;
 typedef boost::shared_ptr<TransactionDescr> TransactionDescrPtr;
+
+/**
+ * @brief The OrderBookEvent enum - what happened to an order in the list
+ * of open orders
+ */
+enum OrderBookEvent
+{
+    orderAdded   = 0,
+    orderUpdated = 1,
+    orderRemoved = 2
+};
 }
 
 
@@ -22,6 +33,9 @@ public:
 
     boost::signals2::signal<void (const uint256 & id)> NotifyXBridgeTransactionChanged;
 
+    boost::signals2::signal<void (const xbridge::TransactionDescrPtr & tx,
+                                  const xbridge::OrderBookEvent event)> NotifyXBridgeOrderBookChanged;
+
     boost::signals2::signal<void (const std::string & currency,
                                   const std::string & name,
                                   const std::string & address)> NotifyXBridgeAddressBookEntryReceived;
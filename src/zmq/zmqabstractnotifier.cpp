@@ -25,3 +25,13 @@ bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transacti
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyXBridgeOrder(const xbridge::TransactionDescrPtr &/*tx*/, xbridge::OrderBookEvent /*event*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyXBridgeTrade(const xbridge::TransactionDescrPtr &/*tx*/, int /*nPrevState*/)
+{
+    return true;
+}
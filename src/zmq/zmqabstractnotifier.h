@@ -6,6 +6,7 @@
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
 #include "zmqconfig.h"
+#include "xbridge/xuiconnector.h"
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
@@ -35,6 +36,8 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyXBridgeOrder(const xbridge::TransactionDescrPtr &tx, xbridge::OrderBookEvent event);
+    virtual bool NotifyXBridgeTrade(const xbridge::TransactionDescrPtr &tx, int nPrevState);
 
 protected:
     void *psocket;
@@ -9,6 +9,10 @@
 #include "main.h"
 #include "streams.h"
 #include "util.h"
+#include "xbridge/xbridgeapp.h"
+#include "xbridge/xbridgetransactiondescr.h"
+
+#include <boost/bind.hpp>
 
 void zmqError(const char *str)
 {
@@ -41,6 +45,8 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubxbridgeorder"] = CZMQAbstractNotifier::Create<CZMQPublishXBridgeOrderNotifier>;
+    factories["pubxbridgetrade"] = CZMQAbstractNotifier::Create<CZMQPublishXBridgeTradeNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -105,6 +111,9 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    xuiConnector.NotifyXBridgeOrderBookChanged.connect(boost::bind(&CZMQNotificationInterface::NotifyXBridgeOrderBookChanged, this, _1, _2));
+    xuiConnector.NotifyXBridgeTransactionChanged.connect(boost::bind(&CZMQNotificationInterface::NotifyXBridgeTransactionChanged, this, _1));
+
     return true;
 }
 
@@ -114,6 +123,10 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        xuiConnector.NotifyXBridgeOrderBookChanged.disconnect(boost::bind(&CZMQNotificationInterface::NotifyXBridgeOrderBookChanged, this, _1, _2));
+        xuiConnector.NotifyXBridgeTransactionChanged.disconnect(boost::bind(&CZMQNotificationInterface::NotifyXBridgeTransactionChanged, this, _1));
+
+        LOCK(cs);
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -128,6 +141,9 @@ void CZMQNotificationInterface::Shutdown()
 
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
 {
+    // rawblock reads the block under cs_main, take it first as the other
+    // notifications are sent with it held
+    LOCK2(cs_main, cs);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
@@ -145,6 +161,7 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
 
 void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
+    LOCK(cs);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
@@ -162,6 +179,7 @@ void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CB
 
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
 {
+    LOCK(cs);
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
@@ -176,3 +194,78 @@ void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
         }
     }
 }
+
+void CZMQNotificationInterface::PublishXBridgeOrder(const xbridge::TransactionDescrPtr &tx, xbridge::OrderBookEvent event)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyXBridgeOrder(tx, event))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::PublishXBridgeTrade(const xbridge::TransactionDescrPtr &tx, int nPrevState)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyXBridgeTrade(tx, nPrevState))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::NotifyXBridgeOrderBookChanged(const xbridge::TransactionDescrPtr &tx, const xbridge::OrderBookEvent event)
+{
+    LOCK(cs);
+    if (!pcontext)
+        return;
+
+    int nState = tx->state;
+    std::map<uint256, int>::iterator it = mapXBridgeStates.find(tx->id);
+    if (it != mapXBridgeStates.end() && it->second != nState)
+        PublishXBridgeTrade(tx, it->second);
+
+    PublishXBridgeOrder(tx, event);
+
+    if (event == xbridge::orderRemoved)
+        mapXBridgeStates.erase(tx->id);
+    else
+        mapXBridgeStates[tx->id] = nState;
+}
+
+// Sessions change the state of an order in place and then report it by id
+void CZMQNotificationInterface::NotifyXBridgeTransactionChanged(const uint256 &id)
+{
+    xbridge::TransactionDescrPtr tx = xbridge::App::instance().transaction(id);
+    if (!tx)
+        return;
+
+    LOCK(cs);
+    if (!pcontext)
+        return;
+
+    // Orders that already left the book had their last state published then
+    int nState = tx->state;
+    std::map<uint256, int>::iterator it = mapXBridgeStates.find(id);
+    if (it == mapXBridgeStates.end() || it->second == nState)
+        return;
+
+    PublishXBridgeTrade(tx, it->second);
+    it->second = nState;
+    PublishXBridgeOrder(tx, xbridge::orderUpdated);
+}
@@ -5,7 +5,10 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include "sync.h"
+#include "uint256.h"
 #include "validationinterface.h"
+#include "xbridge/xuiconnector.h"
 #include <string>
 #include <map>
 
@@ -28,11 +31,24 @@ protected:
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void NotifyTransactionLock(const CTransaction &tx);
 
+    // XUIConnector
+    void NotifyXBridgeOrderBookChanged(const xbridge::TransactionDescrPtr &tx, const xbridge::OrderBookEvent event);
+    void NotifyXBridgeTransactionChanged(const uint256 &id);
+
 private:
     CZMQNotificationInterface();
 
+    void PublishXBridgeOrder(const xbridge::TransactionDescrPtr &tx, xbridge::OrderBookEvent event);
+    void PublishXBridgeTrade(const xbridge::TransactionDescrPtr &tx, int nPrevState);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    // XBridge events arrive on the session threads, so notifiers are only
+    // used under this lock
+    CCriticalSection cs;
+    // The last published state of each open XBridge order
+    std::map<uint256, int> mapXBridgeStates;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -7,6 +7,8 @@
 #include "main.h"
 #include "util.h"
 #include "crypto/common.h"
+#include "xbridge/posixtimeconversion.h"
+#include "xbridge/xbridgetransactiondescr.h"
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +18,8 @@ static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_XBRIDGEORDER = "xbridgeorder";
+static const char *MSG_XBRIDGETRADE = "xbridgetrade";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -57,6 +61,17 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+// An XBridge order in the layout of the /rest/xbridge/orders.bin entries
+static void SerializeXBridgeOrder(CDataStream &ss, const xbridge::TransactionDescrPtr &tx)
+{
+    ss << tx->id;
+    ss << tx->fromCurrency << (uint64_t)tx->fromAmount;
+    ss << tx->toCurrency << (uint64_t)tx->toAmount;
+    ss << (int64_t)boost::posix_time::to_time_t(tx->txtime);
+    ss << (int64_t)boost::posix_time::to_time_t(tx->created);
+    ss << (int32_t)tx->state;
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -212,3 +227,21 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     ss << transaction;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishXBridgeOrderNotifier::NotifyXBridgeOrder(const xbridge::TransactionDescrPtr &tx, xbridge::OrderBookEvent event)
+{
+    LogPrint("zmq", "zmq: Publish xbridgeorder %s %d\n", tx->id.GetHex(), event);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << (uint8_t)event;
+    SerializeXBridgeOrder(ss, tx);
+    return SendMessage(MSG_XBRIDGEORDER, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishXBridgeTradeNotifier::NotifyXBridgeTrade(const xbridge::TransactionDescrPtr &tx, int nPrevState)
+{
+    LogPrint("zmq", "zmq: Publish xbridgetrade %s %d->%d\n", tx->id.GetHex(), nPrevState, tx->state);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << (int32_t)nPrevState;
+    SerializeXBridgeOrder(ss, tx);
+    return SendMessage(MSG_XBRIDGETRADE, &(*ss.begin()), ss.size());
+}
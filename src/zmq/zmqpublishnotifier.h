@@ -15,6 +15,7 @@ private:
     uint32_t nSequence; // upcounting per message sequence number
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0) { }
 
     /* send zmq multipart message
        parts:
@@ -64,4 +65,16 @@ public:
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishXBridgeOrderNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyXBridgeOrder(const xbridge::TransactionDescrPtr &tx, xbridge::OrderBookEvent event);
+};
+
+class CZMQPublishXBridgeTradeNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyXBridgeTrade(const xbridge::TransactionDescrPtr &tx, int nPrevState);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H